@@ -0,0 +1,1123 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include "btree.h"
+#include "hashindex.h"
+#include "page.h"
+#include "filescan.h"
+#include "exceptions/insufficient_space_exception.h"
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/no_such_key_found_exception.h"
+#include "exceptions/index_scan_completed_exception.h"
+#include "exceptions/end_of_file_exception.h"
+
+using namespace badgerdb;
+
+// -----------------------------------------------------------------------------
+// Globals
+// -----------------------------------------------------------------------------
+const std::string relationName = "benchRel";
+const int	relationSize = 100000;
+const int	numProbes = 200000;
+
+// This is the structure for tuples in the base relation
+
+typedef struct tuple {
+	int i;
+	double d;
+	char s[64];
+} RECORD;
+
+BufMgr * bufMgr = new BufMgr(1000);
+
+// -----------------------------------------------------------------------------
+// Forward declarations
+// -----------------------------------------------------------------------------
+
+void createRelationRandom();
+void createRelationGrouped(int numGroups);
+void deleteRelation(const std::string &indexName);
+double elapsedMicros(std::chrono::steady_clock::time_point start);
+void benchPointLookup();
+void benchBatch();
+void benchLeafFormats();
+void benchThreads();
+void benchDescending();
+void benchRanges();
+void benchCounts();
+void benchCovering();
+void benchSkipScan();
+void benchBloom();
+void benchHash();
+void benchBufferedInserts();
+void benchDeltaStore();
+void benchNodeSearch();
+void benchPinnedLevels();
+
+/**
+ * The benchmarks by the name badgerdb_bench runs them under, in the order "all" runs them.
+ */
+struct Benchmark{
+	const char *name;
+	void (*run)();
+};
+
+const Benchmark benchmarks[] = {
+	{"lookup", benchPointLookup},
+	{"batch", benchBatch},
+	{"leaves", benchLeafFormats},
+	{"threads", benchThreads},
+	{"desc", benchDescending},
+	{"ranges", benchRanges},
+	{"counts", benchCounts},
+	{"covering", benchCovering},
+	{"skip", benchSkipScan},
+	{"bloom", benchBloom},
+	{"hash", benchHash},
+	{"buffered", benchBufferedInserts},
+	{"delta", benchDeltaStore},
+	{"search", benchNodeSearch},
+	{"pinned", benchPinnedLevels}
+};
+const int numBenchmarks = sizeof(benchmarks) / sizeof(benchmarks[0]);
+
+int main(int argc, char **argv)
+{
+	std::string which = argc > 1 ? argv[1] : "all";
+	bool known = which == "all";
+	for(int b = 0; b < numBenchmarks; b++)
+		known |= which == benchmarks[b].name;
+	if(argc > 2 || !known)
+	{
+		std::cerr << "Usage: " << argv[0] << " [all";
+		for(int b = 0; b < numBenchmarks; b++)
+			std::cerr << "|" << benchmarks[b].name;
+		std::cerr << "]" << std::endl;
+		delete bufMgr;
+		return 1;
+	}
+
+	for(int b = 0; b < numBenchmarks; b++)
+		if(which == "all" || which == benchmarks[b].name)
+			benchmarks[b].run();
+
+	delete bufMgr;
+
+	return 0;
+}
+
+// -----------------------------------------------------------------------------
+// Helpers
+// -----------------------------------------------------------------------------
+
+/**
+ * Create a relation with tuples valued 0 to relationSize in random order.
+ */
+void createRelationRandom()
+{
+	try
+	{
+		File::remove(relationName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+	PageFile file(relationName, true);
+
+	RECORD record;
+	memset(record.s, ' ', sizeof(record.s));
+	PageId new_page_number;
+	Page new_page = file.allocatePage(new_page_number);
+
+	std::vector<int> intvec(relationSize);
+	for(int i = 0; i < relationSize; i++)
+		intvec[i] = i;
+	for(int i = relationSize - 1; i > 0; i--)
+		std::swap(intvec[i], intvec[random() % (i + 1)]);
+
+	for(int i = 0; i < relationSize; i++)
+	{
+		sprintf(record.s, "%05d string record", intvec[i]);
+		record.i = intvec[i];
+		record.d = intvec[i];
+		std::string new_data(reinterpret_cast<char*>(&record), sizeof(RECORD));
+
+		while(1)
+		{
+			try
+			{
+				new_page.insertRecord(new_data);
+				break;
+			}
+			catch(const InsufficientSpaceException &e)
+			{
+				file.writePage(new_page_number, new_page);
+				new_page = file.allocatePage(new_page_number);
+			}
+		}
+	}
+
+	file.writePage(new_page_number, new_page);
+}
+
+/**
+ * Create a relation of relationSize tuples whose integer field takes numGroups values and whose double field
+ * takes 1000, both at random.
+ */
+void createRelationGrouped(int numGroups)
+{
+	try
+	{
+		File::remove(relationName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+	PageFile file(relationName, true);
+
+	RECORD record;
+	memset(record.s, ' ', sizeof(record.s));
+	PageId new_page_number;
+	Page new_page = file.allocatePage(new_page_number);
+
+	for(int i = 0; i < relationSize; i++)
+	{
+		record.i = random() % numGroups;
+		record.d = random() % 1000;
+		sprintf(record.s, "%05d string record", i);
+		std::string new_data(reinterpret_cast<char*>(&record), sizeof(RECORD));
+
+		while(1)
+		{
+			try
+			{
+				new_page.insertRecord(new_data);
+				break;
+			}
+			catch(const InsufficientSpaceException &e)
+			{
+				file.writePage(new_page_number, new_page);
+				new_page = file.allocatePage(new_page_number);
+			}
+		}
+	}
+
+	file.writePage(new_page_number, new_page);
+}
+
+/**
+ * Remove the relation and the given index file.
+ */
+void deleteRelation(const std::string &indexName)
+{
+	try
+	{
+		File::remove(indexName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+	try
+	{
+		File::remove(relationName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+}
+
+double elapsedMicros(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+// -----------------------------------------------------------------------------
+// Benchmarks
+// -----------------------------------------------------------------------------
+
+/**
+ * Point lookup latency: BTreeIndex::lookup() against the equivalent
+ * startScan(k, GTE, k, LTE) / scanNext / endScan sequence.
+ */
+void benchPointLookup()
+{
+	std::cout << "Point lookup, " << relationSize << " keys, " << numProbes << " probes" << std::endl;
+	createRelationRandom();
+	std::string indexName;
+	{
+		BTreeIndex index(relationName, indexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+		std::vector<int> probes(numProbes);
+		for(int i = 0; i < numProbes; i++)
+			probes[i] = random() % relationSize;
+
+		long found = 0;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for(int i = 0; i < numProbes; i++)
+		{
+			RecordId rid;
+			try
+			{
+				index.startScan(&probes[i], GTE, &probes[i], LTE);
+				while(1)
+				{
+					index.scanNext(rid);
+					found++;
+				}
+			}
+			catch(const NoSuchKeyFoundException &e)
+			{
+				continue;
+			}
+			catch(const IndexScanCompletedException &e)
+			{
+			}
+			index.endScan();
+		}
+		double scanMicros = elapsedMicros(start);
+		std::cout << "\tstartScan/scanNext: " << scanMicros / numProbes << " us/lookup (" << found << " found)" << std::endl;
+
+		found = 0;
+		std::vector<RecordId> rids;
+		start = std::chrono::steady_clock::now();
+		for(int i = 0; i < numProbes; i++)
+		{
+			rids.clear();
+			found += index.lookup(&probes[i], rids);
+		}
+		double lookupMicros = elapsedMicros(start);
+		std::cout << "\tlookup:             " << lookupMicros / numProbes << " us/lookup (" << found << " found)" << std::endl;
+		std::cout << "\tspeedup:            " << scanMicros / lookupMicros << "x" << std::endl;
+	}
+	deleteRelation(indexName);
+}
+
+/**
+ * Batch throughput: insertBatch()/lookupBatch() against one insertEntry()/lookup() call per key,
+ * on a clustered key range above the keys of the relation.
+ */
+void benchBatch()
+{
+	std::cout << "Batch insert and lookup, " << relationSize << " keys per run" << std::endl;
+	createRelationRandom();
+	std::string indexName;
+	{
+		BTreeIndex index(relationName, indexName, bufMgr, offsetof(tuple,i), INTEGER);
+		RecordId rid;
+		rid.page_number = 1;
+		rid.slot_number = 0;
+		rid.padding = 0;
+
+		// both runs interleave into the same key range: single inserts take the even keys, the batch the odd ones.
+		std::vector<RIDKeyPair<int> > entries(relationSize);
+		for(int i = 0; i < relationSize; i++)
+			entries[i].set(rid, relationSize + 2 * i);
+		for(int i = relationSize - 1; i > 0; i--)
+			std::swap(entries[i], entries[random() % (i + 1)]);
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for(int i = 0; i < relationSize; i++)
+			index.insertEntry(&entries[i].key, entries[i].rid);
+		double singleMicros = elapsedMicros(start);
+
+		for(int i = 0; i < relationSize; i++)
+			entries[i].key++;
+		start = std::chrono::steady_clock::now();
+		index.insertBatch(entries);
+		double batchMicros = elapsedMicros(start);
+		std::cout << "\tinsertEntry: " << singleMicros / relationSize << " us/key" << std::endl;
+		std::cout << "\tinsertBatch: " << batchMicros / relationSize << " us/key (" << singleMicros / batchMicros << "x)" << std::endl;
+
+		std::vector<int> keys(relationSize);
+		for(int i = 0; i < relationSize; i++)
+			keys[i] = relationSize + random() % (2 * relationSize);
+		long found = 0;
+		std::vector<RecordId> rids;
+		start = std::chrono::steady_clock::now();
+		for(int i = 0; i < relationSize; i++)
+		{
+			rids.clear();
+			found += index.lookup(&keys[i], rids);
+		}
+		singleMicros = elapsedMicros(start);
+
+		std::vector<RIDKeyPair<int> > foundEntries;
+		start = std::chrono::steady_clock::now();
+		long batchFound = index.lookupBatch(keys, foundEntries);
+		batchMicros = elapsedMicros(start);
+		std::cout << "\tlookup:      " << singleMicros / relationSize << " us/key (" << found << " found)" << std::endl;
+		std::cout << "\tlookupBatch: " << batchMicros / relationSize << " us/key (" << batchFound << " found, " << singleMicros / batchMicros << "x)" << std::endl;
+	}
+	deleteRelation(indexName);
+}
+
+/**
+ * Array leaves against packed leaves on the same relation: index size, build time, full range scans and
+ * point lookups.
+ */
+void benchLeafFormats()
+{
+	std::cout << "Leaf formats, " << relationSize << " keys" << std::endl;
+	createRelationRandom();
+	const char *names[] = {"array ", "packed"};
+	const LeafFormat formats[] = {ARRAY_LEAVES, PACKED_LEAVES};
+	const int numScans = 20;
+	std::string indexName;
+	for(int f = 0; f < 2; f++)
+	{
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			BTreeIndex index(relationName, indexName, bufMgr, offsetof(tuple,i), INTEGER, formats[f]);
+			double buildMicros = elapsedMicros(start);
+
+			int low = 0, high = relationSize;
+			long found = 0;
+			RecordId rids[256];
+			int n;
+			start = std::chrono::steady_clock::now();
+			for(int i = 0; i < numScans; i++)
+			{
+				index.startScan(&low, GTE, &high, LT);
+				while((n = index.scanNextBatch(rids, 256)) > 0)
+					found += n;
+				index.endScan();
+			}
+			double scanMicros = elapsedMicros(start);
+
+			std::vector<RecordId> lookupRids;
+			start = std::chrono::steady_clock::now();
+			for(int i = 0; i < numProbes; i++)
+			{
+				int key = random() % relationSize;
+				lookupRids.clear();
+				found += index.lookup(&key, lookupRids);
+			}
+			double lookupMicros = elapsedMicros(start);
+			std::cout << "\t" << names[f] << " build: " << buildMicros / relationSize << " us/key, scan: "
+				<< scanMicros * 1000 / numScans / relationSize << " ns/entry, lookup: " << lookupMicros / numProbes
+				<< " us/key (" << found << " found)";
+		}
+		std::ifstream indexFile(indexName.c_str(), std::ios::binary | std::ios::ate);
+		std::cout << ", index file: " << indexFile.tellg() / Page::SIZE << " pages" << std::endl;
+		File::remove(indexName);
+	}
+	deleteRelation(indexName);
+}
+
+/**
+ * Insert and lookup throughput with 1, 2 and 4 threads, each inserting its own interleaved share of a key
+ * range above the keys of the relation and then looking up random keys of the whole index.
+ */
+void benchThreads()
+{
+	std::cout << "Threads, " << relationSize << " inserts and " << numProbes << " lookups per run" << std::endl;
+	createRelationRandom();
+	std::string indexName;
+	double baseInsert = 0, baseLookup = 0;
+	for(int numThreads = 1; numThreads <= 4; numThreads *= 2)
+	{
+		{
+			BTreeIndex index(relationName, indexName, bufMgr, offsetof(tuple,i), INTEGER);
+			std::vector<std::thread> threads;
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for(int t = 0; t < numThreads; t++)
+				threads.push_back(std::thread([&index, t, numThreads]()
+				{
+					RecordId rid;
+					rid.page_number = 1;
+					rid.slot_number = 0;
+					rid.padding = 0;
+					for(int key = relationSize + t; key < 2 * relationSize; key += numThreads)
+						index.insertEntry(&key, rid);
+				}));
+			for(size_t t = 0; t < threads.size(); t++)
+				threads[t].join();
+			double insertMicros = elapsedMicros(start);
+
+			threads.clear();
+			std::vector<long> found(numThreads, 0);
+			start = std::chrono::steady_clock::now();
+			for(int t = 0; t < numThreads; t++)
+				threads.push_back(std::thread([&index, &found, t, numThreads]()
+				{
+					unsigned seed = t + 1;
+					std::vector<RecordId> rids;
+					for(int i = t; i < numProbes; i += numThreads)
+					{
+						int key = rand_r(&seed) % (2 * relationSize);
+						rids.clear();
+						found[t] += index.lookup(&key, rids);
+					}
+				}));
+			for(size_t t = 0; t < threads.size(); t++)
+				threads[t].join();
+			double lookupMicros = elapsedMicros(start);
+
+			long totalFound = 0;
+			for(int t = 0; t < numThreads; t++)
+				totalFound += found[t];
+			if(numThreads == 1)
+			{
+				baseInsert = insertMicros;
+				baseLookup = lookupMicros;
+			}
+			std::cout << "\t" << numThreads << " thread(s): insert " << relationSize / insertMicros << " keys/us ("
+				<< baseInsert / insertMicros << "x), lookup " << numProbes / lookupMicros << " keys/us ("
+				<< baseLookup / lookupMicros << "x, " << totalFound << " found)" << std::endl;
+		}
+		File::remove(indexName);
+	}
+	deleteRelation(indexName);
+}
+
+/**
+ * Largest key of a range, as ORDER BY ... DESC LIMIT 1 asks for it: the first entry of a DESCENDING scan
+ * against running an ASCENDING scan to the end of the range.
+ */
+void benchDescending()
+{
+	std::cout << "Largest key of a range, " << relationSize << " keys" << std::endl;
+	createRelationRandom();
+	std::string indexName;
+	{
+		BTreeIndex index(relationName, indexName, bufMgr, offsetof(tuple,i), INTEGER);
+		const int numScans = 20;
+		const int widths[] = {100, relationSize};
+		for(int w = 0; w < 2; w++)
+		{
+			int low = relationSize - widths[w], high = relationSize;
+			RecordId rids[256];
+			long found = 0;
+			int n;
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for(int i = 0; i < numScans; i++)
+			{
+				index.startScan(&low, GTE, &high, LT);
+				while((n = index.scanNextBatch(rids, 256)) > 0)
+					found += n;
+				index.endScan();
+			}
+			double ascendingMicros = elapsedMicros(start) / numScans;
+
+			start = std::chrono::steady_clock::now();
+			for(int i = 0; i < numProbes; i++)
+			{
+				index.startScan(&low, GTE, &high, LT, DESCENDING);
+				found += index.scanNextBatch(rids, 1);
+				index.endScan();
+			}
+			double descendingMicros = elapsedMicros(start) / numProbes;
+			std::cout << "	" << widths[w] << " keys: ascending to the end " << ascendingMicros << " us, descending "
+				<< descendingMicros << " us (" << ascendingMicros / descendingMicros << "x, " << found << " found)" << std::endl;
+		}
+	}
+	deleteRelation(indexName);
+}
+
+/**
+ * IN lists of random keys: one scanRanges() pass against a startScan(k, GTE, k, LTE) / scanNext / endScan
+ * sequence per key.
+ */
+void benchRanges()
+{
+	std::cout << "IN lists, " << relationSize << " keys" << std::endl;
+	createRelationRandom();
+	std::string indexName;
+	{
+		BTreeIndex index(relationName, indexName, bufMgr, offsetof(tuple,i), INTEGER);
+		const int numLists = 20;
+		const int lengths[] = {10, 1000, 10000};
+		for(int l = 0; l < 3; l++)
+		{
+			std::vector<std::vector<ScanRange<int> > > lists(numLists);
+			for(int i = 0; i < numLists; i++)
+			{
+				std::vector<int> keys(lengths[l]);
+				for(int k = 0; k < lengths[l]; k++)
+					keys[k] = random() % relationSize;
+				std::sort(keys.begin(), keys.end());
+				keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+				lists[i].resize(keys.size());
+				for(size_t k = 0; k < keys.size(); k++)
+					lists[i][k].set(keys[k], GTE, keys[k], LTE);
+			}
+
+			long found = 0;
+			RecordId rid;
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for(int i = 0; i < numLists; i++)
+				for(size_t k = 0; k < lists[i].size(); k++)
+				{
+					index.startScan(&lists[i][k].low, GTE, &lists[i][k].high, LTE);
+					while(index.tryScanNext(rid))
+						found++;
+					index.endScan();
+				}
+			double scanMicros = elapsedMicros(start) / numLists;
+
+			std::vector<RecordId> rids;
+			start = std::chrono::steady_clock::now();
+			for(int i = 0; i < numLists; i++)
+			{
+				rids.clear();
+				found += index.scanRanges(lists[i], rids);
+			}
+			double rangesMicros = elapsedMicros(start) / numLists;
+			std::cout << "	" << lengths[l] << " keys: a scan per key " << scanMicros << " us, scanRanges "
+				<< rangesMicros << " us (" << scanMicros / rangesMicros << "x, " << found << " found)" << std::endl;
+		}
+	}
+	deleteRelation(indexName);
+}
+
+/**
+ * COUNT(*) of a key range: countRange() against counting the entries of a batched scan, and the cost of keeping
+ * the counts: building an index without them against building one with them.
+ */
+void benchCounts()
+{
+	std::cout << "Range counts, " << relationSize << " keys" << std::endl;
+	createRelationRandom();
+	std::string indexName;
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		{
+			BTreeIndex index(relationName, indexName, bufMgr, offsetof(tuple,i), INTEGER);
+		}
+		double plainMicros = elapsedMicros(start);
+		File::remove(indexName);
+		start = std::chrono::steady_clock::now();
+		BTreeIndex index(relationName, indexName, bufMgr, offsetof(tuple,i), INTEGER, ARRAY_LEAVES,
+			std::vector<PayloadColumn>(), 0, true);
+		double countedMicros = elapsedMicros(start);
+		std::cout << "	build: " << plainMicros / relationSize << " us/key without counts, " << countedMicros / relationSize
+			<< " us/key with counts" << std::endl;
+		const int numScans = 20;
+		const int widths[] = {100, 10000, relationSize};
+		for(int w = 0; w < 3; w++)
+		{
+			int low = (relationSize - widths[w]) / 2, high = low + widths[w];
+			RecordId rids[256];
+			long found = 0;
+			int n;
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for(int i = 0; i < numScans; i++)
+			{
+				index.startScan(&low, GTE, &high, LT);
+				while((n = index.scanNextBatch(rids, 256)) > 0)
+					found += n;
+				index.endScan();
+			}
+			double scanMicros = elapsedMicros(start) / numScans;
+
+			start = std::chrono::steady_clock::now();
+			for(int i = 0; i < numProbes; i++)
+				found += index.countRange(&low, GTE, &high, LT);
+			double countMicros = elapsedMicros(start) / numProbes;
+			std::cout << "	" << widths[w] << " keys: scan " << scanMicros << " us, countRange "
+				<< countMicros << " us (" << scanMicros / countMicros << "x, " << found << " found)" << std::endl;
+		}
+	}
+	deleteRelation(indexName);
+}
+
+/**
+ * SUM of the double field over a key range: a scan of an index on the integer field that reads every record
+ * against a scan of a covering index on the integer field with the double field as payload.
+ */
+void benchCovering()
+{
+	std::cout << "Covering scans, " << relationSize << " keys" << std::endl;
+	createRelationRandom();
+	std::string indexName;
+	const int numScans = 20;
+	const int widths[] = {100, 10000, relationSize};
+	double fetchMicros[3];
+	{
+		PageFile file(relationName, false);
+		BTreeIndex index(relationName, indexName, bufMgr, offsetof(tuple,i), INTEGER);
+		for(int w = 0; w < 3; w++)
+		{
+			int low = (relationSize - widths[w]) / 2, high = low + widths[w];
+			RecordId rids[256];
+			double sum = 0;
+			int n;
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for(int i = 0; i < numScans; i++)
+			{
+				index.startScan(&low, GTE, &high, LT);
+				while((n = index.scanNextBatch(rids, 256)) > 0)
+					for(int j = 0; j < n; j++)
+					{
+						Page *page;
+						bufMgr->readPage(&file, rids[j].page_number, page);
+						sum += reinterpret_cast<const RECORD*>(page->getRecord(rids[j]).data())->d;
+						bufMgr->unPinPage(&file, rids[j].page_number, false);
+					}
+				index.endScan();
+			}
+			fetchMicros[w] = elapsedMicros(start) / numScans;
+			std::cout << "	" << widths[w] << " keys: scan and fetch " << fetchMicros[w] << " us (sum " << sum << ")" << std::endl;
+		}
+		bufMgr->flushFile(&file);
+	}
+	File::remove(indexName);
+	{
+		std::vector<PayloadColumn> columns(1);
+		columns[0].offset = offsetof(tuple,d);
+		columns[0].length = sizeof(double);
+		BTreeIndex index(relationName, indexName, bufMgr, offsetof(tuple,i), INTEGER, ARRAY_LEAVES, columns);
+		for(int w = 0; w < 3; w++)
+		{
+			int low = (relationSize - widths[w]) / 2, high = low + widths[w];
+			RecordId rids[256];
+			double payloads[256];
+			double sum = 0;
+			int n;
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for(int i = 0; i < numScans; i++)
+			{
+				index.startScan(&low, GTE, &high, LT);
+				while((n = index.scanNextBatch(rids, reinterpret_cast<char*>(payloads), 256)) > 0)
+					for(int j = 0; j < n; j++)
+						sum += payloads[j];
+				index.endScan();
+			}
+			double coveringMicros = elapsedMicros(start) / numScans;
+			std::cout << "	" << widths[w] << " keys: covering scan " << coveringMicros << " us (" << fetchMicros[w] / coveringMicros
+				<< "x, sum " << sum << ")" << std::endl;
+		}
+	}
+	deleteRelation(indexName);
+}
+
+/**
+ * A filter on the second attribute of a composite (integer, double) index: a scan of the relation against
+ * skipScan(), as the number of distinct first attribute values grows.
+ */
+void benchSkipScan()
+{
+	std::cout << "Skip-scans, " << relationSize << " keys" << std::endl;
+	const int numScans = 20;
+	const int groups[] = {10, 100, 1000};
+	std::vector<KeyColumn> columns(2);
+	columns[0].offset = offsetof(tuple,i);
+	columns[0].type = INTEGER;
+	columns[1].offset = offsetof(tuple,d);
+	columns[1].type = DOUBLE;
+	std::string indexName;
+	for(int g = 0; g < 3; g++)
+	{
+		createRelationGrouped(groups[g]);
+		RECORD low, high;
+		low.d = 500;
+		high.d = 505;
+		long scanFound = 0;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for(int i = 0; i < numScans; i++)
+		{
+			FileScan fscan(relationName, bufMgr);
+			RecordId rid;
+			try
+			{
+				while(1)
+				{
+					fscan.scanNext(rid);
+					double d = reinterpret_cast<const RECORD*>(fscan.getRecord().data())->d;
+					if(d >= low.d && d < high.d)
+						scanFound++;
+				}
+			}
+			catch(const EndOfFileException &e)
+			{
+			}
+		}
+		double scanMicros = elapsedMicros(start) / numScans;
+
+		long skipFound = 0;
+		double skipMicros;
+		{
+			BTreeIndex index(relationName, indexName, bufMgr, columns);
+			std::vector<RecordId> rids;
+			start = std::chrono::steady_clock::now();
+			for(int i = 0; i < numScans; i++)
+			{
+				rids.clear();
+				skipFound += index.skipScan(&low, GTE, &high, LT, rids);
+			}
+			skipMicros = elapsedMicros(start) / numScans;
+		}
+		std::cout << "	" << groups[g] << " groups: relation scan " << scanMicros << " us, skipScan " << skipMicros
+			<< " us (" << scanMicros / skipMicros << "x, " << scanFound / numScans << " and " << skipFound / numScans
+			<< " found)" << std::endl;
+		deleteRelation(indexName);
+	}
+}
+
+/**
+ * Lookups of keys that are mostly absent, as in an anti-join: an index without and one with a Bloom filter of
+ * 10 bits per key.
+ */
+void benchBloom()
+{
+	std::cout << "Bloom filters, " << relationSize << " keys, " << numProbes << " probes" << std::endl;
+	createRelationRandom();
+	std::string indexName;
+	const int hitPercents[] = {0, 10, 50};
+	double plainMicros[3];
+	for(int bits = 0; bits <= 10; bits += 10)
+	{
+		{
+			BTreeIndex index(relationName, indexName, bufMgr, offsetof(tuple,i), INTEGER, ARRAY_LEAVES,
+				std::vector<PayloadColumn>(), bits);
+			for(int h = 0; h < 3; h++)
+			{
+				// both indexes get the same probes.
+				srandom(h + 1);
+				std::vector<int> probes(numProbes);
+				for(int i = 0; i < numProbes; i++)
+					probes[i] = (int)(random() % 100) < hitPercents[h] ? random() % relationSize : relationSize + random() % relationSize;
+
+				long found = 0;
+				std::vector<RecordId> rids;
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				for(int i = 0; i < numProbes; i++)
+				{
+					rids.clear();
+					found += index.lookup(&probes[i], rids);
+				}
+				double micros = elapsedMicros(start) / numProbes;
+				if(bits == 0)
+				{
+					plainMicros[h] = micros;
+					std::cout << "	" << hitPercents[h] << "% present: lookup " << micros << " us (" << found << " found)" << std::endl;
+				}
+				else
+					std::cout << "	" << hitPercents[h] << "% present: lookup with filter " << micros << " us ("
+						<< plainMicros[h] / micros << "x, " << found << " found)" << std::endl;
+			}
+		}
+		File::remove(indexName);
+	}
+	deleteRelation(indexName);
+}
+
+/**
+ * Point lookup latency: BTreeIndex::lookup() against HashIndex::lookup() on the same keys.
+ */
+void benchHash()
+{
+	std::cout << "Hash index, " << relationSize << " keys, " << numProbes << " probes" << std::endl;
+	createRelationRandom();
+	std::vector<int> probes(numProbes);
+	for(int i = 0; i < numProbes; i++)
+		probes[i] = random() % relationSize;
+	std::string indexName, hashIndexName;
+	double treeMicros;
+	{
+		BTreeIndex index(relationName, indexName, bufMgr, offsetof(tuple,i), INTEGER);
+		long found = 0;
+		std::vector<RecordId> rids;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for(int i = 0; i < numProbes; i++)
+		{
+			rids.clear();
+			found += index.lookup(&probes[i], rids);
+		}
+		treeMicros = elapsedMicros(start) / numProbes;
+		std::cout << "	B+ Tree lookup " << treeMicros << " us (" << found << " found)" << std::endl;
+	}
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		HashIndex index(relationName, hashIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		double buildMillis = elapsedMicros(start) / 1000;
+		long found = 0;
+		std::vector<RecordId> rids;
+		start = std::chrono::steady_clock::now();
+		for(int i = 0; i < numProbes; i++)
+		{
+			rids.clear();
+			found += index.lookup(&probes[i], rids);
+		}
+		double hashMicros = elapsedMicros(start) / numProbes;
+		std::cout << "	hash lookup " << hashMicros << " us (" << treeMicros / hashMicros << "x, " << found
+			<< " found), built in " << buildMillis << " ms with a directory of 2^" << index.depth() << std::endl;
+	}
+	File::remove(hashIndexName);
+	deleteRelation(indexName);
+}
+
+/**
+ * Random inserts into an index larger than a small buffer pool, straight into the leaves against through the
+ * insert buffer and through the message buffers of the nonleaves: time and pages read and written.
+ */
+void benchBufferedInserts()
+{
+	const int numFrames = 64;
+	const int capacity = 20000;
+	std::cout << "Buffered inserts, " << relationSize << " random keys into " << relationSize << ", " << numFrames
+		<< " buffer frames" << std::endl;
+	createRelationRandom();
+	srandom(1);
+	std::vector<int> keys(relationSize);
+	for(int i = 0; i < relationSize; i++)
+		keys[i] = random() % relationSize;
+	std::string indexName;
+	double plainMicros = 0;
+	for(int buffered = 0; buffered <= 2; buffered++)
+	{
+		BufMgr smallBufMgr(numFrames);
+		{
+			BTreeIndex index(relationName, indexName, &smallBufMgr, offsetof(tuple,i), INTEGER);
+			index.setInsertBuffer(buffered == 1 ? capacity : 0);
+			index.setNodeBuffers(buffered == 2);
+			RecordId rid;
+			rid.page_number = 1;
+			rid.slot_number = 0;
+			rid.padding = 0;
+			smallBufMgr.clearBufStats();
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for(int i = 0; i < relationSize; i++)
+				index.insertEntry(&keys[i], rid);
+			index.flushInserts();
+			double micros = elapsedMicros(start) / relationSize;
+			BufStats &stats = smallBufMgr.getBufStats();
+			if(buffered == 0)
+			{
+				plainMicros = micros;
+				std::cout << "	insertEntry: " << micros << " us/key, ";
+			}
+			else if(buffered == 1)
+				std::cout << "	buffered, " << capacity << " entries: " << micros << " us/key (" << plainMicros / micros << "x), ";
+			else
+				std::cout << "	message buffers: " << micros << " us/key (" << plainMicros / micros << "x), ";
+			std::cout << stats.diskreads << " pages read, " << stats.diskwrites << " written" << std::endl;
+		}
+		File::remove(indexName);
+	}
+	deleteRelation(indexName);
+}
+
+/**
+ * Random inserts by one thread while another scans ranges of the index, straight into the leaves against
+ * through the insert buffer merged by a thread of the index: insert latency and the rate of scans meanwhile.
+ */
+void benchDeltaStore()
+{
+	const int numFrames = 64;
+	const int capacity = 20000;
+	const int scanWidth = 1000;
+	std::cout << "Inserts with concurrent scans, " << relationSize << " random keys into " << relationSize << ", "
+		<< numFrames << " buffer frames" << std::endl;
+	createRelationRandom();
+	srandom(1);
+	std::vector<int> keys(relationSize);
+	for(int i = 0; i < relationSize; i++)
+		keys[i] = random() % relationSize;
+	std::string indexName;
+	double plainMicros = 0;
+	for(int buffered = 0; buffered <= 1; buffered++)
+	{
+		BufMgr smallBufMgr(numFrames);
+		{
+			BTreeIndex index(relationName, indexName, &smallBufMgr, offsetof(tuple,i), INTEGER);
+			index.setInsertBuffer(buffered ? capacity : 0, true);
+			std::atomic<bool> inserting(true);
+			long numScans = 0, numScanned = 0;
+			std::thread scanner([&]()
+			{
+				BTreeScanCursor cursor(&index);
+				RecordId rids[256];
+				unsigned seed = 1;
+				int n;
+				while(inserting)
+				{
+					int low = rand_r(&seed) % relationSize, high = low + scanWidth;
+					if(cursor.tryStartScan(&low, GTE, &high, LT))
+					{
+						while((n = cursor.scanNextBatch(rids, 256)) > 0)
+							numScanned += n;
+						cursor.endScan();
+					}
+					numScans++;
+				}
+			});
+			RecordId rid;
+			rid.page_number = 1;
+			rid.slot_number = 0;
+			rid.padding = 0;
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for(int i = 0; i < relationSize; i++)
+				index.insertEntry(&keys[i], rid);
+			double micros = elapsedMicros(start) / relationSize;
+			inserting = false;
+			scanner.join();
+			index.flushInserts();
+			if(buffered == 0)
+			{
+				plainMicros = micros;
+				std::cout << "	insertEntry: " << micros << " us/key, ";
+			}
+			else
+				std::cout << "	delta store, merged in the background every " << capacity << " entries: " << micros
+					<< " us/key (" << plainMicros / micros << "x), ";
+			std::cout << numScans << " scans of " << numScanned << " entries meanwhile, "
+				<< numScans / (micros * relationSize / 1000) << " scans/ms" << std::endl;
+		}
+		File::remove(indexName);
+	}
+	deleteRelation(indexName);
+}
+
+/**
+ * Searches in full int leaves and nonleaves, more of them than fit in the caches: the interpolation search of
+ * the nodes against binary search over their keys and, for nonleaves, against the search of descents with an
+ * Eytzinger cache, which searches copies of the nodes that interpolation mispredicts, for keys spaced evenly
+ * and for cubes.
+ */
+void benchNodeSearch()
+{
+	const int numNodes = 4096;
+	std::cout << "Node search, " << numNodes << " full int leaves and nonleaves, " << numProbes << " probes" << std::endl;
+	std::vector<Page> pages(2 * numNodes);
+	std::vector<int> probeNodes(numProbes), probeKeys(numProbes);
+	for(int skewed = 0; skewed <= 1; skewed++)
+	{
+		RecordId rid;
+		rid.page_number = 1;
+		rid.slot_number = 0;
+		rid.padding = 0;
+		for(int n = 0; n < numNodes; n++)
+		{
+			LeafNodeInt *leaf = (LeafNodeInt*)&pages[n];
+			NonLeafNodeInt *nonLeaf = (NonLeafNodeInt*)&pages[numNodes + n];
+			leaf->init(0, ARRAY_LEAVES);
+			nonLeaf->init(1, 0, 0, false);
+			for(int i = 0; i < INTARRAYLEAFSIZE; i++)
+			{
+				int key = skewed ? i * i * i / 1000 : 3 * i;
+				leaf->insert(i, key, rid);
+				if(i < INTARRAYNONLEAFSIZE)
+					nonLeaf->insert(i, key, 0, 0);
+			}
+		}
+		srandom(1);
+		for(int i = 0; i < numProbes; i++)
+		{
+			probeNodes[i] = random() % numNodes;
+			int k = random() % INTARRAYNONLEAFSIZE;
+			probeKeys[i] = skewed ? k * k * k / 1000 : 3 * k;
+		}
+		// the first search of a node that interpolation mispredicts copies it.
+		EytzingerCache copies(numNodes);
+		for(int i = 0; i < numProbes; i++)
+		{
+			const Page *page = &pages[numNodes + probeNodes[i]];
+			copies.searchNode(page, 0, (const NonLeafNodeInt*)page, probeKeys[i], false, nullptr);
+		}
+		for(int nonLeaves = 0; nonLeaves <= 1; nonLeaves++)
+		{
+			// the node's own search, binary search over its keys and the search of descents with Eytzinger copies.
+			double micros[3];
+			long sum[3] = {0, 0, 0};
+			for(int method = 0; method <= 1 + nonLeaves; method++)
+			{
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				for(int i = 0; i < numProbes; i++)
+				{
+					const Page *page = &pages[nonLeaves * numNodes + probeNodes[i]];
+					const int *keys = nonLeaves ? ((const NonLeafNodeInt*)page)->keyArray : ((const LeafNodeInt*)page)->keyArray;
+					int size = nonLeaves ? ((const NonLeafNodeInt*)page)->size : ((const LeafNodeInt*)page)->size;
+					int index = 0;
+					if(method == 2)
+						index = copies.searchNode(page, 0, (const NonLeafNodeInt*)page, probeKeys[i], false, nullptr);
+					else if(method == 1)
+						index = std::lower_bound(keys, keys + size, probeKeys[i]) - keys;
+					else if(nonLeaves)
+						index = ((const NonLeafNodeInt*)page)->lowerBound(probeKeys[i]);
+					else
+						index = ((const LeafNodeInt*)page)->lowerBound(0, probeKeys[i]);
+					sum[method] += index;
+				}
+				micros[method] = elapsedMicros(start);
+			}
+			std::cout << "	" << (skewed ? "cubes, " : "evenly spaced, ") << (nonLeaves ? "nonleaves: " : "leaves: ")
+				<< 1000 * micros[0] / numProbes << " ns/search, binary search " << 1000 * micros[1] / numProbes
+				<< " ns/search (" << micros[1] / micros[0] << "x)";
+			if(nonLeaves)
+				std::cout << ", with Eytzinger copies " << 1000 * micros[2] / numProbes << " ns/search (" << micros[1] / micros[2] << "x)";
+			std::cout << (sum[0] == sum[1] && (!nonLeaves || sum[2] == sum[1]) ? "" : ", results differ") << std::endl;
+		}
+	}
+}
+
+/**
+ * Lookups in a tree with two levels of nonleaves, from one thread and from four, with the nonleaves read through
+ * the buffer manager against kept pinned and taken from the frames cached in the index.
+ */
+void benchPinnedLevels()
+{
+	const int numExtra = 4 * relationSize;
+	std::cout << "Pinned upper levels, " << relationSize + numExtra << " keys, " << numProbes << " lookups per run" << std::endl;
+	createRelationRandom();
+	std::string indexName;
+	{
+		BTreeIndex index(relationName, indexName, bufMgr, offsetof(tuple,i), INTEGER);
+		std::vector<int> keys(numExtra);
+		for(int i = 0; i < numExtra; i++)
+			keys[i] = relationSize + i;
+		std::random_shuffle(keys.begin(), keys.end());
+		RecordId rid;
+		rid.page_number = 1;
+		rid.slot_number = 0;
+		rid.padding = 0;
+		for(int i = 0; i < numExtra; i++)
+			index.insertEntry(&keys[i], rid);
+
+		for(int numThreads = 1; numThreads <= 4; numThreads *= 4)
+		{
+			double micros[2];
+			long found[2] = {0, 0};
+			for(int pinned = 0; pinned <= 1; pinned++)
+			{
+				index.setPinnedLevels(pinned ? 8 : 0);
+				std::vector<std::thread> threads;
+				std::vector<long> threadFound(numThreads, 0);
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				for(int t = 0; t < numThreads; t++)
+					threads.push_back(std::thread([&index, &threadFound, t, numThreads, numExtra]()
+					{
+						unsigned seed = t + 1;
+						std::vector<RecordId> rids;
+						for(int i = t; i < numProbes; i += numThreads)
+						{
+							int key = rand_r(&seed) % (relationSize + numExtra);
+							rids.clear();
+							threadFound[t] += index.lookup(&key, rids);
+						}
+					}));
+				for(size_t t = 0; t < threads.size(); t++)
+					threads[t].join();
+				micros[pinned] = elapsedMicros(start);
+				for(int t = 0; t < numThreads; t++)
+					found[pinned] += threadFound[t];
+			}
+			std::cout << "\t" << numThreads << " thread(s): through the buffer manager " << micros[0] / numProbes
+				<< " us/lookup, " << index.numPinnedPages() << " pages pinned " << micros[1] / numProbes << " us/lookup ("
+				<< micros[0] / micros[1] << "x" << (found[0] == found[1] ? "" : ", results differ") << ")" << std::endl;
+		}
+	}
+	deleteRelation(indexName);
+}
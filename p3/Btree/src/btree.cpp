@@ -5,6 +5,14 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <algorithm>
+#include <cstring>
+#include <climits>
+#include <set>
+#include <new>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include "btree.h"
 #include "filescan.h"
 #include "exceptions/bad_index_info_exception.h"
@@ -22,642 +30,5420 @@
 namespace badgerdb
 {
 
+    // -----------------------------------------------------------------------------
+    // Nodes
+    // -----------------------------------------------------------------------------
+
+    /**
+     * Number of keys past the predicted position an interpolation search compares one by one before it
+     * falls back to binary search, half a cache line of int keys.
+     */
+    static const int INTERPOLATIONWINDOW = 8;
+
+    /**
+     * Index of the first of the sorted keys [from, to) that is not less than key, or greater than key with
+     * upper set, found by binary search.
+     */
+    template <class T>
+    static int searchKeys(const T* keys, int from, int to, const T& key, bool upper){
+        return (upper ? std::upper_bound(keys + from, keys + to, key) : std::lower_bound(keys + from, keys + to, key)) - keys;
+    }
+
+    /**
+     * Interpolation step of searchKeys() for int keys, which are mostly dense and near uniform. The position is
+     * predicted from the keys at the ends of the range by linear interpolation and corrected by comparing up to
+     * INTERPOLATIONWINDOW keys on the side the answer lies on, usually within the cache line of the prediction.
+     * Readers that search a node without its latch may see the keys out of order; the result still lies in [from, to].
+     * @param index		Receives the index searchKeys() returns, if the prediction was close enough
+     * @return False if the answer lies further away from the prediction, where the keys are skewed. from and to
+     * are then narrowed to the keys binary search goes on with.
+     */
+    static bool interpolateKeys(const int* keys, int& from, int& to, const int& key, bool upper, int& index){
+        if(to - from <= 2 * INTERPOLATIONWINDOW)
+            return false;
+        // the index searched for is that of the first key not less than target.
+        long long target = upper ? (long long)key + 1 : key;
+        if(keys[from] >= target){
+            index = from;
+            return true;
+        }
+        if(keys[to - 1] < target){
+            index = to;
+            return true;
+        }
+        // the answer lies in (low, high]: keys[low] is less than target and keys[high] is not.
+        int low = from, high = to - 1;
+        int lowKey = keys[low], highKey = keys[high];
+        if(!(lowKey < highKey)){
+            from = low + 1;
+            to = high;
+            return false;
+        }
+        int pos = low + (int)((target - lowKey) * (high - low) / ((long long)highKey - lowKey));
+        pos = std::min(std::max(pos, low + 1), high - 1);
+        // the key at the far end of the window tells whether the answer lies in it before the window is read.
+        if(keys[pos] < target){
+            int end = std::min(high, pos + INTERPOLATIONWINDOW);
+            if(keys[end] < target){
+                from = end + 1;
+                to = high;
+                return false;
+            }
+            index = end;
+            for(int i = pos + 1; i < end; i++)
+                if(keys[i] >= target){
+                    index = i;
+                    break;
+                }
+            return true;
+        }
+        int start = std::max(low, pos - INTERPOLATIONWINDOW);
+        if(keys[start] >= target){
+            from = low + 1;
+            to = start;
+            return false;
+        }
+        index = start + 1;
+        for(int i = pos; i > start + 1; i--)
+            if(keys[i - 1] < target){
+                index = i;
+                break;
+            }
+        return true;
+    }
+
+    /**
+     * searchKeys() for int keys: interpolateKeys(), and binary search over what is left if its prediction misses.
+     */
+    static int searchKeys(const int* keys, int from, int to, const int& key, bool upper){
+        int index;
+        if(interpolateKeys(keys, from, to, key, upper, index))
+            return index;
+        return searchKeys<int>(keys, from, to, key, upper);
+    }
+
+    template <class T>
+    void NonLeafNode<T>::init(int level, PageId firstChild, std::uint32_t count, bool counted){
+        type = counted ? COUNTEDNONLEAF : NONLEAF;
+        size = 0;
+        this->level = level;
+        children()[0] = firstChild;
+        setCount(0, count);
+    }
+
+    template <class T>
+    void NonLeafNode<T>::moveChildren(int to, const NonLeafNode* source, int from, int numMoved){
+        std::memmove(children() + to, source->children() + from, numMoved * sizeof(PageId));
+        if(counted())
+            std::memmove(counts() + to, source->counts() + from, numMoved * sizeof(std::uint32_t));
+    }
+
+    template <class T>
+    T NonLeafNode<T>::key(int i) const{
+        return keyArray[i];
+    }
+
+    template <class T>
+    PageId NonLeafNode<T>::child(int i) const{
+        return children()[i];
+    }
+
+    template <class T>
+    std::uint32_t NonLeafNode<T>::count(int i) const{
+        return counted() ? __atomic_load_n(&counts()[i], __ATOMIC_RELAXED) : 0;
+    }
+
+    template <class T>
+    void NonLeafNode<T>::setCount(int i, std::uint32_t count){
+        if(counted())
+            counts()[i] = count;
+    }
+
+    template <class T>
+    void NonLeafNode<T>::addCount(int i, int delta){
+        __atomic_fetch_add(&counts()[i], delta, __ATOMIC_RELAXED);
+    }
+
+    template <class T>
+    std::uint32_t NonLeafNode<T>::total() const{
+        std::uint32_t sum = 0;
+        for(int i = 0; i <= size; i++)
+            sum += count(i);
+        return sum;
+    }
+
+    template <class T>
+    int NonLeafNode<T>::lowerBound(const T& key) const{
+        return searchKeys(keyArray, 0, size, key, false);
+    }
+
+    template <class T>
+    int NonLeafNode<T>::upperBound(const T& key) const{
+        return searchKeys(keyArray, 0, size, key, true);
+    }
+
+    template <class T>
+    bool NonLeafNode<T>::plausible() const{
+        return (type == NONLEAF || type == COUNTEDNONLEAF) && size >= 0 && size <= capacity() && (level == 0 || level == 1);
+    }
+
+    template <class T>
+    bool NonLeafNode<T>::insert(int pos, const T& key, PageId pageNo, std::uint32_t count){
+        if(size == capacity())
+            return false;
+        int numMoved = size - pos;
+        std::memmove(keyArray + pos + 1, keyArray + pos, numMoved * sizeof(T));
+        moveChildren(pos + 2, this, pos + 1, numMoved);
+        keyArray[pos] = key;
+        children()[pos + 1] = pageNo;
+        setCount(pos + 1, count);
+        size++;
+        return true;
+    }
+
+    template <class T>
+    void NonLeafNode<T>::remove(int pos){
+        int numMoved = size - pos - 1;
+        std::memmove(keyArray + pos, keyArray + pos + 1, numMoved * sizeof(T));
+        moveChildren(pos + 1, this, pos + 2, numMoved);
+        size--;
+    }
+
+    template <class T>
+    bool NonLeafNode<T>::replaceKey(int i, const T& key){
+        keyArray[i] = key;
+        return true;
+    }
+
+    template <class T>
+    T NonLeafNode<T>::split(NonLeafNode* right, int pos, const T& key, PageId pageNo, std::uint32_t count, bool append){
+        // the middle key of the capacity() + 1 keys moves up into the parent.
+        right->type = type;
+        right->level = level;
+        int midIndex = (capacity() + 1) / 2;
+        T midKey;
+        if(append){
+            // appending to the right edge of the tree: nothing will land left of key again,
+            // so this node stays full and key moves up with pageNo alone on its right.
+            midKey = key;
+            right->size = 0;
+            right->children()[0] = pageNo;
+            right->setCount(0, count);
+        } else if(pos < midIndex){
+            // new key lands in the left half, keyArray[midIndex - 1] moves up.
+            midKey = keyArray[midIndex - 1];
+            right->size = size - midIndex;
+            std::memcpy(right->keyArray, keyArray + midIndex, right->size * sizeof(T));
+            right->moveChildren(0, this, midIndex, right->size + 1);
+            size = midIndex - 1;
+            insert(pos, key, pageNo, count);
+        } else if(pos == midIndex){
+            // new key is the middle key, pageNo becomes the first child of the right half.
+            midKey = key;
+            right->size = size - midIndex;
+            std::memcpy(right->keyArray, keyArray + midIndex, right->size * sizeof(T));
+            right->children()[0] = pageNo;
+            right->setCount(0, count);
+            right->moveChildren(1, this, midIndex + 1, right->size);
+            size = midIndex;
+        } else{
+            // new key lands in the right half, keyArray[midIndex] moves up.
+            midKey = keyArray[midIndex];
+            right->size = size - midIndex - 1;
+            std::memcpy(right->keyArray, keyArray + midIndex + 1, right->size * sizeof(T));
+            right->moveChildren(0, this, midIndex + 1, right->size + 1);
+            size = midIndex;
+            right->insert(pos - midIndex - 1, key, pageNo, count);
+        }
+        return midKey;
+    }
+
+    template <class T>
+    bool NonLeafNode<T>::underfull() const{
+        return size < capacity() / 2;
+    }
+
+    template <class T>
+    bool NonLeafNode<T>::merge(const T& separator, NonLeafNode* right){
+        int total = size + right->size;
+        if(total + 1 > capacity())
+            return false;
+        // the separator comes down between the keys of the two nodes.
+        keyArray[size] = separator;
+        std::memcpy(keyArray + size + 1, right->keyArray, right->size * sizeof(T));
+        moveChildren(size + 1, right, 0, right->size + 1);
+        size = total + 1;
+        return true;
+    }
+
+    template <class T>
+    bool NonLeafNode<T>::redistribute(NonLeafNode* right, NonLeafNode* parent, int sepIndex){
+        int total = size + right->size;
+        T separator = parent->keyArray[sepIndex];
+        if(size < total / 2){
+            // rotate the first numMoved children of the right node through the separator into this one.
+            int numMoved = total / 2 - size;
+            keyArray[size] = separator;
+            std::memcpy(keyArray + size + 1, right->keyArray, (numMoved - 1) * sizeof(T));
+            moveChildren(size + 1, right, 0, numMoved);
+            parent->keyArray[sepIndex] = right->keyArray[numMoved - 1];
+            size += numMoved;
+            right->size -= numMoved;
+            std::memmove(right->keyArray, right->keyArray + numMoved, right->size * sizeof(T));
+            right->moveChildren(0, right, numMoved, right->size + 1);
+        } else if(size > total / 2){
+            // rotate the last numMoved children of this node through the separator into the right one.
+            int numMoved = size - total / 2;
+            std::memmove(right->keyArray + numMoved, right->keyArray, right->size * sizeof(T));
+            right->moveChildren(numMoved, right, 0, right->size + 1);
+            right->keyArray[numMoved - 1] = separator;
+            std::memcpy(right->keyArray, keyArray + size - numMoved + 1, (numMoved - 1) * sizeof(T));
+            right->moveChildren(0, this, size - numMoved + 1, numMoved);
+            parent->keyArray[sepIndex] = keyArray[size - numMoved];
+            size -= numMoved;
+            right->size += numMoved;
+        }
+        return true;
+    }
+
+    template <class T>
+    void LeafNode<T>::init(PageId rightSib, LeafFormat format, int payloadLength){
+        if(format == POSTING_LEAVES){
+            postings()->init(rightSib);
+            return;
+        }
+        if(format == PACKED_LEAVES){
+            packed()->init(rightSib);
+            return;
+        }
+        if(format == COVERING_LEAVES){
+            covering()->init(rightSib, payloadLength);
+            return;
+        }
+        type = LEAF;
+        size = 0;
+        rightSibPageNo = rightSib;
+    }
+
+    template <class T>
+    T LeafNode<T>::key(int i) const{
+        if(type == POSTINGLEAF)
+            return postings()->key(i);
+        if(type == PACKEDLEAF)
+            return packed()->key(i);
+        if(type == COVERINGLEAF)
+            return covering()->key(i);
+        return keyArray[i];
+    }
+
+    template <class T>
+    RecordId LeafNode<T>::rid(int i) const{
+        if(type == POSTINGLEAF)
+            return postings()->rid(i);
+        if(type == PACKEDLEAF)
+            return packed()->rid(i);
+        if(type == COVERINGLEAF)
+            return covering()->rid(i);
+        return ridArray[i];
+    }
+
+    template <class T>
+    void LeafNode<T>::copyRids(int from, int count, RecordId* out, RidReadPosition* position) const{
+        if(type == POSTINGLEAF){
+            postings()->copyRids(from, count, out, position);
+            return;
+        }
+        if(type == PACKEDLEAF){
+            packed()->copyRids(from, count, out);
+            return;
+        }
+        if(type == COVERINGLEAF){
+            covering()->copyRids(from, count, out);
+            return;
+        }
+        std::memcpy(out, ridArray + from, count * sizeof(RecordId));
+    }
+
+    template <class T>
+    void LeafNode<T>::copyPayloads(int from, int count, char* out) const{
+        if(type == COVERINGLEAF)
+            covering()->copyPayloads(from, count, out);
+    }
+
+    template <class T>
+    int LeafNode<T>::lowerBound(int from, const T& key) const{
+        if(type == POSTINGLEAF)
+            return postings()->lowerBound(from, key);
+        if(type == PACKEDLEAF)
+            return packed()->lowerBound(from, key);
+        if(type == COVERINGLEAF)
+            return covering()->lowerBound(from, key);
+        return searchKeys(keyArray, from, size, key, false);
+    }
+
+    template <class T>
+    int LeafNode<T>::upperBound(int from, const T& key) const{
+        if(type == POSTINGLEAF)
+            return postings()->upperBound(from, key);
+        if(type == PACKEDLEAF)
+            return packed()->upperBound(from, key);
+        if(type == COVERINGLEAF)
+            return covering()->upperBound(from, key);
+        return searchKeys(keyArray, from, size, key, true);
+    }
+
+    template <class T>
+    bool LeafNode<T>::insert(int pos, const T& key, RecordId rid, const char* payload){
+        if(type == POSTINGLEAF)
+            return postings()->insert(pos, key, rid);
+        if(type == PACKEDLEAF)
+            return packed()->insert(pos, key, rid);
+        if(type == COVERINGLEAF)
+            return covering()->insert(pos, key, rid, payload);
+        if(size == KeyTraits<T>::LEAFSIZE)
+            return false;
+        int numMoved = size - pos;
+        std::memmove(keyArray + pos + 1, keyArray + pos, numMoved * sizeof(T));
+        std::memmove(ridArray + pos + 1, ridArray + pos, numMoved * sizeof(RecordId));
+        keyArray[pos] = key;
+        ridArray[pos] = rid;
+        size++;
+        return true;
+    }
+
+    template <class T>
+    void LeafNode<T>::remove(int pos){
+        if(type == POSTINGLEAF){
+            postings()->remove(pos);
+            return;
+        }
+        if(type == PACKEDLEAF){
+            packed()->remove(pos);
+            return;
+        }
+        if(type == COVERINGLEAF){
+            covering()->remove(pos);
+            return;
+        }
+        int numMoved = size - pos - 1;
+        std::memmove(keyArray + pos, keyArray + pos + 1, numMoved * sizeof(T));
+        std::memmove(ridArray + pos, ridArray + pos + 1, numMoved * sizeof(RecordId));
+        size--;
+    }
+
+    template <class T>
+    int LeafNode<T>::insertSorted(const RIDKeyPair<T>* entries, int count){
+        if(type == POSTINGLEAF)
+            return postings()->insertSorted(entries, count);
+        if(type == PACKEDLEAF)
+            return packed()->insertSorted(entries, count);
+        if(type == COVERINGLEAF)
+            return covering()->insertSorted(entries, count);
+        int numMerged = std::min(count, KeyTraits<T>::LEAFSIZE - size);
+        // merge back to front, so every entry moves at most once.
+        int src = size - 1, dst = size + numMerged - 1;
+        for(int j = numMerged - 1; j >= 0; dst--){
+            if(src >= 0 && entries[j].key < keyArray[src]){
+                keyArray[dst] = keyArray[src];
+                ridArray[dst] = ridArray[src];
+                src--;
+            } else{
+                keyArray[dst] = entries[j].key;
+                ridArray[dst] = entries[j].rid;
+                j--;
+            }
+        }
+        size += numMerged;
+        return numMerged;
+    }
+
+    template <class T>
+    void LeafNode<T>::split(LeafNode* right, int pos, const T& key, RecordId rid, const char* payload, bool append){
+        if(type == POSTINGLEAF){
+            postings()->split(right->postings(), pos, key, rid, append);
+            return;
+        }
+        if(type == PACKEDLEAF){
+            packed()->split(right->packed(), pos, key, rid, append);
+            return;
+        }
+        if(type == COVERINGLEAF){
+            covering()->split(right->covering(), pos, key, rid, payload, append);
+            return;
+        }
+        // the left midIndex of the LEAFSIZE + 1 entries stay in place, the rest move to right.
+        right->type = LEAF;
+        int midIndex = append ? size : (KeyTraits<T>::LEAFSIZE + 1) / 2;
+        int firstMoved = pos < midIndex ? midIndex - 1 : midIndex;
+        right->size = size - firstMoved;
+        std::memcpy(right->keyArray, keyArray + firstMoved, right->size * sizeof(T));
+        std::memcpy(right->ridArray, ridArray + firstMoved, right->size * sizeof(RecordId));
+        size = firstMoved;
+        if(pos < midIndex)
+            insert(pos, key, rid);
+        else
+            right->insert(pos - midIndex, key, rid);
+    }
+
+    template <class T>
+    T LeafNode<T>::separator(const LeafNode* right) const{
+        return right->key(0);
+    }
+
+    template <class T>
+    bool LeafNode<T>::underfull() const{
+        if(type == POSTINGLEAF)
+            return postings()->underfull();
+        if(type == PACKEDLEAF)
+            return packed()->underfull();
+        if(type == COVERINGLEAF)
+            return covering()->underfull();
+        return size < KeyTraits<T>::LEAFMINSIZE;
+    }
+
+    template <class T>
+    bool LeafNode<T>::merge(LeafNode* right){
+        if(type == POSTINGLEAF)
+            return postings()->merge(right->postings());
+        if(type == PACKEDLEAF)
+            return packed()->merge(right->packed());
+        if(type == COVERINGLEAF)
+            return covering()->merge(right->covering());
+        int total = size + right->size;
+        if(total > KeyTraits<T>::LEAFSIZE)
+            return false;
+        std::memcpy(keyArray + size, right->keyArray, right->size * sizeof(T));
+        std::memcpy(ridArray + size, right->ridArray, right->size * sizeof(RecordId));
+        size = total;
+        return true;
+    }
+
+    template <class T>
+    bool LeafNode<T>::redistribute(LeafNode* right, NonLeafNode<T>* parent, int sepIndex){
+        if(type == POSTINGLEAF)
+            return postings()->redistribute(right->postings(), parent, sepIndex);
+        if(type == PACKEDLEAF)
+            return packed()->redistribute(right->packed(), parent, sepIndex);
+        if(type == COVERINGLEAF)
+            return covering()->redistribute(right->covering(), parent, sepIndex);
+        int total = size + right->size;
+        if(size < total / 2){
+            // move the head of the right leaf to the tail of this one.
+            int numMoved = total / 2 - size;
+            std::memcpy(keyArray + size, right->keyArray, numMoved * sizeof(T));
+            std::memcpy(ridArray + size, right->ridArray, numMoved * sizeof(RecordId));
+            size += numMoved;
+            right->size -= numMoved;
+            std::memmove(right->keyArray, right->keyArray + numMoved, right->size * sizeof(T));
+            std::memmove(right->ridArray, right->ridArray + numMoved, right->size * sizeof(RecordId));
+        } else if(size > total / 2){
+            // move the tail of this leaf to the head of the right one.
+            int numMoved = size - total / 2;
+            std::memmove(right->keyArray + numMoved, right->keyArray, right->size * sizeof(T));
+            std::memmove(right->ridArray + numMoved, right->ridArray, right->size * sizeof(RecordId));
+            size -= numMoved;
+            right->size += numMoved;
+            std::memcpy(right->keyArray, keyArray + size, numMoved * sizeof(T));
+            std::memcpy(right->ridArray, ridArray + size, numMoved * sizeof(RecordId));
+        }
+        return parent->replaceKey(sepIndex, separator(right));
+    }
+
+    /**
+     * Number of bytes of key before its zero padding.
+     */
+    static int keyLength(const StringKey& key){
+        int length = STRINGSIZE;
+        while(length > 0 && key.data[length - 1] == '\0')
+            length--;
+        return length;
+    }
+
+    /**
+     * Number of leading bytes, at most n, that a and b have in common.
+     */
+    static int commonPrefixLength(const char* a, const char* b, int n){
+        int length = 0;
+        while(length < n && a[length] == b[length])
+            length++;
+        return length;
+    }
+
+    /**
+     * Shortest key that is greater than left, unless left equals right, and not greater than right:
+     * the prefix of right up to and including its first byte that differs from left.
+     */
+    static StringKey shortestSeparator(const StringKey& left, const StringKey& right){
+        int length = std::min(commonPrefixLength(left.data, right.data, STRINGSIZE) + 1, STRINGSIZE);
+        StringKey separator;
+        std::memcpy(separator.data, right.data, length);
+        std::memset(separator.data + length, 0, STRINGSIZE - length);
+        return separator;
+    }
+
+    /**
+     * Prefix and slot length of a string node holding the sorted keys[0, count). Sorted keys share the prefix
+     * of the first and the last one. Without truncate every slot keeps the rest of its key including the
+     * zero padding, with it the slots are as long as the longest key without its padding.
+     */
+    static void slotLayout(const StringKey* keys, int count, bool truncate, int& prefixLength, int& slotLength){
+        prefixLength = count > 0 ? commonPrefixLength(keys[0].data, keys[count - 1].data, STRINGSIZE) : 0;
+        if(!truncate){
+            slotLength = STRINGSIZE - prefixLength;
+            return;
+        }
+        slotLength = 0;
+        for(int i = 0; i < count; i++)
+            slotLength = std::max(slotLength, keyLength(keys[i]) - prefixLength);
+    }
+
+    /**
+     * Key i of a string node.
+     */
+    template <class N>
+    static StringKey slotKey(const N* node, int i){
+        StringKey key;
+        int length = node->prefixLength + node->slotLength;
+        std::memcpy(key.data, node->prefix, node->prefixLength);
+        std::memcpy(key.data + node->prefixLength, node->slots() + i * node->slotLength, node->slotLength);
+        std::memset(key.data + length, 0, STRINGSIZE - length);
+        return key;
+    }
+
+    /**
+     * Binary search the keys [from, node->size) of a string node, comparing key to the slots only.
+     * @return Index of the first key not less than key, or greater than key with upper set.
+     */
+    template <class N>
+    static int searchSlots(const N* node, int from, const StringKey& key, bool upper){
+        int cmp = std::memcmp(key.data, node->prefix, node->prefixLength);
+        if(cmp < 0)
+            return from;
+        if(cmp > 0)
+            return node->size;
+        // stored keys are zero past their slot, so key is greater than a key with the same slot bytes
+        // exactly if it has a non-zero byte there.
+        bool longer = false;
+        for(int i = node->prefixLength + node->slotLength; i < STRINGSIZE; i++)
+            longer |= key.data[i] != '\0';
+        bool skipEqual = upper || longer;
+        const char* slots = node->slots();
+        const char* suffix = key.data + node->prefixLength;
+        int low = from, high = node->size;
+        while(low < high){
+            int mid = (low + high) / 2;
+            int c = std::memcmp(slots + mid * node->slotLength, suffix, node->slotLength);
+            if(c < 0 || (c == 0 && skipEqual))
+                low = mid + 1;
+            else
+                high = mid;
+        }
+        return low;
+    }
+
+    /**
+     * Index in [first, last] closest to preferred for which feasible holds.
+     * @return The index, or -1 if feasible holds for none.
+     */
+    template <class F>
+    static int closestFeasible(int preferred, int first, int last, F feasible){
+        for(int d = 0; preferred - d >= first || preferred + d <= last; d++){
+            if(preferred - d >= first && preferred - d <= last && feasible(preferred - d))
+                return preferred - d;
+            if(d > 0 && preferred + d >= first && preferred + d <= last && feasible(preferred + d))
+                return preferred + d;
+        }
+        return -1;
+    }
+
+    void NonLeafNode<StringKey>::init(int level, PageId firstChild, std::uint32_t count, bool counted){
+        type = counted ? COUNTEDNONLEAF : NONLEAF;
+        size = 0;
+        this->level = level;
+        prefixLength = 0;
+        slotLength = 0;
+        std::memcpy(data, &firstChild, sizeof(PageId));
+        setCount(0, count);
+    }
+
+    StringKey NonLeafNode<StringKey>::key(int i) const{
+        return slotKey(this, i);
+    }
+
+    PageId NonLeafNode<StringKey>::child(int i) const{
+        return *(const PageId*)(data + i * childLength());
+    }
+
+    std::uint32_t NonLeafNode<StringKey>::count(int i) const{
+        return counted() ? __atomic_load_n(&((const ChildEntry*)data)[i].count, __ATOMIC_RELAXED) : 0;
+    }
+
+    void NonLeafNode<StringKey>::setCount(int i, std::uint32_t count){
+        if(counted())
+            ((ChildEntry*)data)[i].count = count;
+    }
+
+    void NonLeafNode<StringKey>::addCount(int i, int delta){
+        __atomic_fetch_add(&((ChildEntry*)data)[i].count, delta, __ATOMIC_RELAXED);
+    }
+
+    std::uint32_t NonLeafNode<StringKey>::total() const{
+        std::uint32_t sum = 0;
+        for(int i = 0; i <= size; i++)
+            sum += count(i);
+        return sum;
+    }
+
+    int NonLeafNode<StringKey>::lowerBound(const StringKey& key) const{
+        return searchSlots(this, 0, key, false);
+    }
+
+    int NonLeafNode<StringKey>::upperBound(const StringKey& key) const{
+        return searchSlots(this, 0, key, true);
+    }
+
+    bool NonLeafNode<StringKey>::plausible() const{
+        return (type == NONLEAF || type == COUNTEDNONLEAF) && size >= 0 && (level == 0 || level == 1) && prefixLength >= 0
+            && prefixLength <= STRINGSIZE && slotLength >= 0 && slotLength <= STRINGSIZE - prefixLength
+            && usedLength(size, slotLength) <= STRINGNODEDATASIZE;
+    }
+
+    bool NonLeafNode<StringKey>::insert(int pos, const StringKey& key, PageId pageNo, std::uint32_t count){
+        ChildEntry entry;
+        entry.pageNo = pageNo;
+        entry.count = count;
+        if(size == 0 || std::memcmp(key.data, prefix, prefixLength) != 0 || keyLength(key) - prefixLength > slotLength){
+            // key needs a shorter prefix or longer slots, re-encode the whole node.
+            std::vector<StringKey> keys(size);
+            std::vector<ChildEntry> children(size + 1);
+            decode(keys.data(), children.data());
+            keys.insert(keys.begin() + pos, key);
+            children.insert(children.begin() + pos + 1, entry);
+            if(!fits(keys.data(), size + 1))
+                return false;
+            encode(keys.data(), children.data(), size + 1);
+            return true;
+        }
+        if(usedLength(size + 1, slotLength) > STRINGNODEDATASIZE)
+            return false;
+        char* oldSlots = slots();
+        std::memmove(oldSlots - slotLength, oldSlots, pos * slotLength);
+        std::memcpy(oldSlots + (pos - 1) * slotLength, key.data + prefixLength, slotLength);
+        char* children = data + (pos + 1) * childLength();
+        std::memmove(children + childLength(), children, (size - pos) * childLength());
+        std::memcpy(children, &entry, childLength());
+        size++;
+        return true;
+    }
+
+    void NonLeafNode<StringKey>::remove(int pos){
+        char* oldSlots = slots();
+        std::memmove(oldSlots + slotLength, oldSlots, pos * slotLength);
+        char* children = data + (pos + 1) * childLength();
+        std::memmove(children, children + childLength(), (size - pos - 1) * childLength());
+        size--;
+    }
+
+    bool NonLeafNode<StringKey>::replaceKey(int i, const StringKey& key){
+        if(std::memcmp(key.data, prefix, prefixLength) == 0 && keyLength(key) - prefixLength <= slotLength){
+            std::memcpy(slots() + i * slotLength, key.data + prefixLength, slotLength);
+            return true;
+        }
+        std::vector<StringKey> keys(size);
+        std::vector<ChildEntry> children(size + 1);
+        decode(keys.data(), children.data());
+        keys[i] = key;
+        if(!fits(keys.data(), size))
+            return false;
+        encode(keys.data(), children.data(), size);
+        return true;
+    }
+
+    StringKey NonLeafNode<StringKey>::split(NonLeafNode* right, int pos, const StringKey& key, PageId pageNo, std::uint32_t count, bool append){
+        ChildEntry entry;
+        entry.pageNo = pageNo;
+        entry.count = count;
+        std::vector<StringKey> keys(size);
+        std::vector<ChildEntry> children(size + 1);
+        decode(keys.data(), children.data());
+        keys.insert(keys.begin() + pos, key);
+        children.insert(children.begin() + pos + 1, entry);
+        int numKeys = size + 1;
+        // key m moves up. With m = pos both halves hold old keys only and fit, so the search always succeeds.
+        int m = pos;
+        if(!append){
+            const StringKey* k = keys.data();
+            m = closestFeasible(numKeys / 2, 0, numKeys - 1, [this, k, numKeys](int i){
+                return fits(k, i) && fits(k + i + 1, numKeys - i - 1);
+            });
+        }
+        StringKey midKey = keys[m];
+        right->type = type;
+        right->level = level;
+        right->encode(keys.data() + m + 1, children.data() + m + 1, numKeys - m - 1);
+        encode(keys.data(), children.data(), m);
+        return midKey;
+    }
+
+    bool NonLeafNode<StringKey>::underfull() const{
+        return usedLength(size, slotLength) < STRINGNODEDATASIZE / 2;
+    }
+
+    bool NonLeafNode<StringKey>::merge(const StringKey& separator, NonLeafNode* right){
+        int count = size + 1 + right->size;
+        std::vector<StringKey> keys(count);
+        std::vector<ChildEntry> children(count + 1);
+        decode(keys.data(), children.data());
+        keys[size] = separator;
+        right->decode(keys.data() + size + 1, children.data() + size + 1);
+        if(!fits(keys.data(), count))
+            return false;
+        encode(keys.data(), children.data(), count);
+        return true;
+    }
+
+    bool NonLeafNode<StringKey>::redistribute(NonLeafNode* right, NonLeafNode* parent, int sepIndex){
+        int count = size + 1 + right->size;
+        std::vector<StringKey> keys(count);
+        std::vector<ChildEntry> children(count + 1);
+        decode(keys.data(), children.data());
+        keys[size] = parent->key(sepIndex);
+        right->decode(keys.data() + size + 1, children.data() + size + 1);
+        // key m of the concatenation moves up as the new separator.
+        const StringKey* k = keys.data();
+        int m = closestFeasible(count / 2, 0, count - 1, [this, k, count](int i){
+            return fits(k, i) && fits(k + i + 1, count - i - 1);
+        });
+        if(m < 0 || m == size || !parent->replaceKey(sepIndex, keys[m]))
+            return false;
+        right->encode(keys.data() + m + 1, children.data() + m + 1, count - m - 1);
+        encode(keys.data(), children.data(), m);
+        return true;
+    }
+
+    void NonLeafNode<StringKey>::decode(StringKey* keys, ChildEntry* children) const{
+        for(int i = 0; i < size; i++)
+            keys[i] = key(i);
+        for(int i = 0; i <= size; i++){
+            children[i].pageNo = child(i);
+            children[i].count = count(i);
+        }
+    }
+
+    void NonLeafNode<StringKey>::encode(const StringKey* keys, const ChildEntry* children, int count){
+        slotLayout(keys, count, true, prefixLength, slotLength);
+        if(count > 0)
+            std::memcpy(prefix, keys[0].data, prefixLength);
+        size = count;
+        for(int i = 0; i <= count; i++)
+            std::memcpy(data + i * childLength(), &children[i], childLength());
+        char* keySlots = slots();
+        for(int i = 0; i < count; i++)
+            std::memcpy(keySlots + i * slotLength, keys[i].data + prefixLength, slotLength);
+    }
+
+    bool NonLeafNode<StringKey>::fits(const StringKey* keys, int count) const{
+        int prefixLength, slotLength;
+        slotLayout(keys, count, true, prefixLength, slotLength);
+        return usedLength(count, slotLength) <= STRINGNODEDATASIZE;
+    }
+
+    void LeafNode<StringKey>::init(PageId rightSib, LeafFormat format, int payloadLength){
+        if(format == POSTING_LEAVES){
+            postings()->init(rightSib);
+            return;
+        }
+        if(format == COVERING_LEAVES){
+            covering()->init(rightSib, payloadLength);
+            return;
+        }
+        type = LEAF;
+        size = 0;
+        rightSibPageNo = rightSib;
+        prefixLength = 0;
+        slotLength = STRINGSIZE;
+    }
+
+    StringKey LeafNode<StringKey>::key(int i) const{
+        if(type == POSTINGLEAF)
+            return postings()->key(i);
+        if(type == COVERINGLEAF)
+            return covering()->key(i);
+        return slotKey(this, i);
+    }
+
+    RecordId LeafNode<StringKey>::rid(int i) const{
+        if(type == POSTINGLEAF)
+            return postings()->rid(i);
+        if(type == COVERINGLEAF)
+            return covering()->rid(i);
+        RecordId rid;
+        std::memcpy(&rid, data + i * sizeof(RecordId), sizeof(RecordId));
+        return rid;
+    }
+
+    void LeafNode<StringKey>::copyRids(int from, int count, RecordId* out, RidReadPosition* position) const{
+        if(type == POSTINGLEAF){
+            postings()->copyRids(from, count, out, position);
+            return;
+        }
+        if(type == COVERINGLEAF){
+            covering()->copyRids(from, count, out);
+            return;
+        }
+        std::memcpy(out, data + from * sizeof(RecordId), count * sizeof(RecordId));
+    }
+
+    void LeafNode<StringKey>::copyPayloads(int from, int count, char* out) const{
+        if(type == COVERINGLEAF)
+            covering()->copyPayloads(from, count, out);
+    }
+
+    int LeafNode<StringKey>::lowerBound(int from, const StringKey& key) const{
+        if(type == POSTINGLEAF)
+            return postings()->lowerBound(from, key);
+        if(type == COVERINGLEAF)
+            return covering()->lowerBound(from, key);
+        return searchSlots(this, from, key, false);
+    }
+
+    int LeafNode<StringKey>::upperBound(int from, const StringKey& key) const{
+        if(type == POSTINGLEAF)
+            return postings()->upperBound(from, key);
+        if(type == COVERINGLEAF)
+            return covering()->upperBound(from, key);
+        return searchSlots(this, from, key, true);
+    }
+
+    bool LeafNode<StringKey>::insert(int pos, const StringKey& key, RecordId rid, const char* payload){
+        if(type == POSTINGLEAF)
+            return postings()->insert(pos, key, rid);
+        if(type == COVERINGLEAF)
+            return covering()->insert(pos, key, rid, payload);
+        if(size == 0 || std::memcmp(key.data, prefix, prefixLength) != 0){
+            // key needs a shorter prefix, re-encode the whole leaf.
+            std::vector<StringKey> keys(size);
+            std::vector<RecordId> rids(size);
+            decode(keys.data(), rids.data());
+            keys.insert(keys.begin() + pos, key);
+            rids.insert(rids.begin() + pos, rid);
+            if(!fits(keys.data(), size + 1))
+                return false;
+            encode(keys.data(), rids.data(), size + 1);
+            return true;
+        }
+        if((size + 1) * ((int)sizeof(RecordId) + slotLength) > STRINGNODEDATASIZE)
+            return false;
+        char* oldSlots = slots();
+        std::memmove(oldSlots - slotLength, oldSlots, pos * slotLength);
+        std::memcpy(oldSlots + (pos - 1) * slotLength, key.data + prefixLength, slotLength);
+        char* rids = data + pos * sizeof(RecordId);
+        std::memmove(rids + sizeof(RecordId), rids, (size - pos) * sizeof(RecordId));
+        std::memcpy(rids, &rid, sizeof(RecordId));
+        size++;
+        return true;
+    }
+
+    void LeafNode<StringKey>::remove(int pos){
+        if(type == POSTINGLEAF){
+            postings()->remove(pos);
+            return;
+        }
+        if(type == COVERINGLEAF){
+            covering()->remove(pos);
+            return;
+        }
+        char* oldSlots = slots();
+        std::memmove(oldSlots + slotLength, oldSlots, pos * slotLength);
+        char* rids = data + pos * sizeof(RecordId);
+        std::memmove(rids, rids + sizeof(RecordId), (size - pos - 1) * sizeof(RecordId));
+        size--;
+    }
+
+    int LeafNode<StringKey>::insertSorted(const RIDKeyPair<StringKey>* entries, int count){
+        if(type == POSTINGLEAF)
+            return postings()->insertSorted(entries, count);
+        if(type == COVERINGLEAF)
+            return covering()->insertSorted(entries, count);
+        int pos = 0;
+        for(int j = 0; j < count; j++){
+            pos = lowerBound(pos, entries[j].key);
+            if(!insert(pos, entries[j].key, entries[j].rid))
+                return j;
+        }
+        return count;
+    }
+
+    void LeafNode<StringKey>::split(LeafNode* right, int pos, const StringKey& key, RecordId rid, const char* payload, bool append){
+        if(type == POSTINGLEAF){
+            postings()->split(right->postings(), pos, key, rid, append);
+            return;
+        }
+        if(type == COVERINGLEAF){
+            covering()->split(right->covering(), pos, key, rid, payload, append);
+            return;
+        }
+        std::vector<StringKey> keys(size);
+        std::vector<RecordId> rids(size);
+        decode(keys.data(), rids.data());
+        keys.insert(keys.begin() + pos, key);
+        rids.insert(rids.begin() + pos, rid);
+        int count = size + 1;
+        // a key between the first and the last one shares their prefix, so both halves of the middle split fit.
+        // A key at either end may shorten the prefix; splitting it off alone then always fits.
+        const StringKey* k = keys.data();
+        int m = closestFeasible(append ? count - 1 : count / 2, 1, count - 1, [k, count](int i){
+            return fits(k, i) && fits(k + i, count - i);
+        });
+        right->type = LEAF;
+        right->encode(keys.data() + m, rids.data() + m, count - m);
+        encode(keys.data(), rids.data(), m);
+    }
+
+    StringKey LeafNode<StringKey>::separator(const LeafNode* right) const{
+        return shortestSeparator(key(size - 1), right->key(0));
+    }
+
+    bool LeafNode<StringKey>::underfull() const{
+        if(type == POSTINGLEAF)
+            return postings()->underfull();
+        if(type == COVERINGLEAF)
+            return covering()->underfull();
+        return size * ((int)sizeof(RecordId) + slotLength) < STRINGNODEDATASIZE / 2;
+    }
+
+    bool LeafNode<StringKey>::merge(LeafNode* right){
+        if(type == POSTINGLEAF)
+            return postings()->merge(right->postings());
+        if(type == COVERINGLEAF)
+            return covering()->merge(right->covering());
+        int count = size + right->size;
+        std::vector<StringKey> keys(count);
+        std::vector<RecordId> rids(count);
+        decode(keys.data(), rids.data());
+        right->decode(keys.data() + size, rids.data() + size);
+        if(!fits(keys.data(), count))
+            return false;
+        encode(keys.data(), rids.data(), count);
+        return true;
+    }
+
+    bool LeafNode<StringKey>::redistribute(LeafNode* right, NonLeafNode<StringKey>* parent, int sepIndex){
+        if(type == POSTINGLEAF)
+            return postings()->redistribute(right->postings(), parent, sepIndex);
+        if(type == COVERINGLEAF)
+            return covering()->redistribute(right->covering(), parent, sepIndex);
+        int count = size + right->size;
+        std::vector<StringKey> keys(count);
+        std::vector<RecordId> rids(count);
+        decode(keys.data(), rids.data());
+        right->decode(keys.data() + size, rids.data() + size);
+        const StringKey* k = keys.data();
+        int m = closestFeasible(count / 2, 1, count - 1, [k, count](int i){
+            return fits(k, i) && fits(k + i, count - i);
+        });
+        if(m < 0 || m == size || !parent->replaceKey(sepIndex, shortestSeparator(keys[m - 1], keys[m])))
+            return false;
+        right->encode(keys.data() + m, rids.data() + m, count - m);
+        encode(keys.data(), rids.data(), m);
+        return true;
+    }
+
+    void LeafNode<StringKey>::decode(StringKey* keys, RecordId* rids) const{
+        for(int i = 0; i < size; i++)
+            keys[i] = key(i);
+        std::memcpy(rids, data, size * sizeof(RecordId));
+    }
+
+    void LeafNode<StringKey>::encode(const StringKey* keys, const RecordId* rids, int count){
+        slotLayout(keys, count, false, prefixLength, slotLength);
+        if(count > 0)
+            std::memcpy(prefix, keys[0].data, prefixLength);
+        size = count;
+        std::memcpy(data, rids, count * sizeof(RecordId));
+        char* keySlots = slots();
+        for(int i = 0; i < count; i++)
+            std::memcpy(keySlots + i * slotLength, keys[i].data + prefixLength, slotLength);
+    }
+
+    bool LeafNode<StringKey>::fits(const StringKey* keys, int count){
+        int prefixLength, slotLength;
+        slotLayout(keys, count, false, prefixLength, slotLength);
+        return count * ((int)sizeof(RecordId) + slotLength) <= STRINGNODEDATASIZE;
+    }
+
+    /**
+     * True if record id a comes before b, ordered by page and then slot.
+     */
+    static bool ridLess(const RecordId& a, const RecordId& b){
+        if(a.page_number != b.page_number)
+            return a.page_number < b.page_number;
+        return a.slot_number < b.slot_number;
+    }
+
+    /**
+     * Order of the entries of a posting list leaf: by key, then by record id.
+     */
+    template <class T>
+    static bool entryLess(const RIDKeyPair<T>& a, const RIDKeyPair<T>& b){
+        if(a.key != b.key)
+            return a.key < b.key;
+        return ridLess(a.rid, b.rid);
+    }
+
+    /**
+     * Most bytes putRid() writes for one record id.
+     */
+    static const int MAXRIDLENGTH = 8;
+
+    /**
+     * Write value as a varint: seven bits per byte starting with the lowest ones, the high bit set on every
+     * byte but the last.
+     * @return Number of bytes written.
+     */
+    static int putVarint(unsigned char* out, unsigned value){
+        int length = 0;
+        while(value >= 0x80){
+            out[length++] = (unsigned char)(value | 0x80);
+            value >>= 7;
+        }
+        out[length++] = (unsigned char)value;
+        return length;
+    }
+
+    /**
+     * Number of bytes putVarint() writes for value.
+     */
+    static int varintLength(unsigned value){
+        int length = 1;
+        for(; value >= 0x80; value >>= 7)
+            length++;
+        return length;
+    }
+
+    /**
+     * Read a varint written by putVarint() and move in past it.
+     */
+    static unsigned getVarint(const unsigned char*& in){
+        unsigned value = 0;
+        for(int shift = 0; ; shift += 7){
+            unsigned char byte = *in++;
+            value |= (unsigned)(byte & 0x7f) << shift;
+            if(byte < 0x80)
+                return value;
+        }
+    }
+
+    /**
+     * Write rid as its gap to prev, which must not come after it: the page gap, then the slot gap if both are
+     * on the same page and the slot itself otherwise. Gaps to the zero record id encode the first rid of a list.
+     * @return Number of bytes written.
+     */
+    static int putRid(unsigned char* out, const RecordId& prev, const RecordId& rid){
+        int length = putVarint(out, rid.page_number - prev.page_number);
+        if(rid.page_number == prev.page_number)
+            return length + putVarint(out + length, rid.slot_number - prev.slot_number);
+        return length + putVarint(out + length, rid.slot_number);
+    }
+
+    /**
+     * Number of bytes putRid() writes for rid after prev.
+     */
+    static int ridLength(const RecordId& prev, const RecordId& rid){
+        if(rid.page_number == prev.page_number)
+            return 1 + varintLength(rid.slot_number - prev.slot_number);
+        return varintLength(rid.page_number - prev.page_number) + varintLength(rid.slot_number);
+    }
+
+    /**
+     * Read a record id written by putRid() after prev and move in past it.
+     */
+    static RecordId getRid(const unsigned char*& in, const RecordId& prev){
+        RecordId rid;
+        rid.page_number = prev.page_number + getVarint(in);
+        unsigned slot = getVarint(in);
+        rid.slot_number = rid.page_number == prev.page_number ? prev.slot_number + slot : slot;
+        rid.padding = 0;
+        return rid;
+    }
+
+    /**
+     * Write the sorted rids[0, count) as one list.
+     * @return Number of bytes written.
+     */
+    static int putRidList(unsigned char* out, const RecordId* rids, int count){
+        int length = 0;
+        RecordId prev = RecordId();
+        for(int i = 0; i < count; i++){
+            length += putRid(out + length, prev, rids[i]);
+            prev = rids[i];
+        }
+        return length;
+    }
+
+    template <class T>
+    void PostingLeafNode<T>::init(PageId rightSib){
+        type = POSTINGLEAF;
+        size = 0;
+        rightSibPageNo = rightSib;
+        keyCount = 0;
+        listLength = 0;
+    }
+
+    template <class T>
+    int PostingLeafNode<T>::groupOf(int i) const{
+        // the last key whose first entry is not after i.
+        const PostingGroup<T>* dir = groups();
+        int low = 0, high = keyCount;
+        while(high - low > 1){
+            int mid = (low + high) / 2;
+            if(dir[mid].first <= i)
+                low = mid;
+            else
+                high = mid;
+        }
+        return low;
+    }
+
+    template <class T>
+    int PostingLeafNode<T>::groupSize(int g) const{
+        return (g + 1 < keyCount ? groups()[g + 1].first : size) - groups()[g].first;
+    }
+
+    template <class T>
+    int PostingLeafNode<T>::listEnd(int g) const{
+        return g + 1 < keyCount ? groups()[g + 1].offset : listLength;
+    }
+
+    template <class T>
+    int PostingLeafNode<T>::freeSpace() const{
+        return POSTINGNODEDATASIZE - listLength - keyCount * (int)sizeof(PostingGroup<T>);
+    }
+
+    template <class T>
+    T PostingLeafNode<T>::key(int i) const{
+        return groups()[groupOf(i)].key;
+    }
+
+    template <class T>
+    RecordId PostingLeafNode<T>::rid(int i) const{
+        RecordId rid;
+        copyRids(i, 1, &rid, nullptr);
+        return rid;
+    }
+
+    template <class T>
+    void PostingLeafNode<T>::copyRids(int from, int count, RecordId* out, RidReadPosition* position) const{
+        if(count == 0)
+            return;
+        const PostingGroup<T>* dir = groups();
+        const unsigned char* lists = (const unsigned char*)data;
+        int g = groupOf(from);
+        const unsigned char* in;
+        RecordId prev;
+        if(position != nullptr && position->entry == from && from != dir[g].first){
+            in = lists + position->offset;
+            prev = position->last;
+        } else{
+            // decode the list of the key from its start up to entry from.
+            in = lists + dir[g].offset;
+            prev = RecordId();
+            for(int i = dir[g].first; i < from; i++)
+                prev = getRid(in, prev);
+        }
+        int end = from + count;
+        for(int i = from; i < end; i++){
+            if(g + 1 < keyCount && i == dir[g + 1].first){
+                // the lists lie back to back, the one of the next key starts right here.
+                g++;
+                prev = RecordId();
+            }
+            prev = getRid(in, prev);
+            *out++ = prev;
+        }
+        if(position != nullptr){
+            position->entry = end;
+            position->offset = in - lists;
+            position->last = prev;
+        }
+    }
+
+    template <class T>
+    int PostingLeafNode<T>::lowerBound(int from, const T& key) const{
+        const PostingGroup<T>* dir = groups();
+        int g = std::lower_bound(dir, dir + keyCount, key, [](const PostingGroup<T>& group, const T& k){
+            return group.key < k;
+        }) - dir;
+        return std::max(from, g < keyCount ? dir[g].first : size);
+    }
+
+    template <class T>
+    int PostingLeafNode<T>::upperBound(int from, const T& key) const{
+        const PostingGroup<T>* dir = groups();
+        int g = std::upper_bound(dir, dir + keyCount, key, [](const T& k, const PostingGroup<T>& group){
+            return k < group.key;
+        }) - dir;
+        return std::max(from, g < keyCount ? dir[g].first : size);
+    }
+
+    template <class T>
+    bool PostingLeafNode<T>::insert(int pos, const T& key, RecordId rid){
+        PostingGroup<T>* dir = groups();
+        int g = std::lower_bound(dir, dir + keyCount, key, [](const PostingGroup<T>& group, const T& k){
+            return group.key < k;
+        }) - dir;
+        unsigned char bytes[MAXRIDLENGTH];
+        if(g == keyCount || dir[g].key != key){
+            // a new key, with a directory entry and a list of its own in front of those of key g.
+            int length = putRid(bytes, RecordId(), rid);
+            if(length + (int)sizeof(PostingGroup<T>) > freeSpace())
+                return false;
+            int first = g < keyCount ? dir[g].first : size;
+            int offset = g < keyCount ? dir[g].offset : listLength;
+            std::memmove(dir - 1, dir, g * sizeof(PostingGroup<T>));
+            keyCount++;
+            dir = groups();
+            dir[g].key = key;
+            dir[g].first = first;
+            dir[g].offset = offset;
+            dir[g].last = rid;
+            spliceList(g, offset, offset, bytes, length);
+        } else if(!ridLess(rid, dir[g].last)){
+            // record ids mostly arrive in ascending order, those only need their gap to the last one appended.
+            int length = putRid(bytes, dir[g].last, rid);
+            if(length > freeSpace())
+                return false;
+            int end = listEnd(g);
+            spliceList(g, end, end, bytes, length);
+            dir[g].last = rid;
+        } else{
+            // re-encode the list with rid in its place.
+            int count = groupSize(g);
+            std::vector<RecordId> rids(count);
+            decodeList(g, rids.data());
+            rids.insert(std::upper_bound(rids.begin(), rids.end(), rid, ridLess), rid);
+            std::vector<unsigned char> list((count + 1) * MAXRIDLENGTH);
+            int length = putRidList(list.data(), rids.data(), count + 1);
+            int end = listEnd(g);
+            if(length - (end - dir[g].offset) > freeSpace())
+                return false;
+            spliceList(g, dir[g].offset, end, list.data(), length);
+        }
+        for(int h = g + 1; h < keyCount; h++)
+            dir[h].first++;
+        size++;
+        return true;
+    }
+
+    template <class T>
+    void PostingLeafNode<T>::remove(int pos){
+        PostingGroup<T>* dir = groups();
+        int g = groupOf(pos);
+        int count = groupSize(g);
+        if(count == 1){
+            // the key goes with its only record id.
+            spliceList(g, dir[g].offset, listEnd(g), nullptr, 0);
+            std::memmove(dir + 1, dir, g * sizeof(PostingGroup<T>));
+            keyCount--;
+            dir = groups();
+            g--;
+        } else{
+            // the gap across a dropped record id never takes more bytes than the two gaps it replaces.
+            std::vector<RecordId> rids(count);
+            decodeList(g, rids.data());
+            rids.erase(rids.begin() + (pos - dir[g].first));
+            std::vector<unsigned char> list((count - 1) * MAXRIDLENGTH);
+            int length = putRidList(list.data(), rids.data(), count - 1);
+            spliceList(g, dir[g].offset, listEnd(g), list.data(), length);
+            dir[g].last = rids.back();
+        }
+        for(int h = g + 1; h < keyCount; h++)
+            dir[h].first--;
+        size--;
+    }
+
+    template <class T>
+    int PostingLeafNode<T>::insertSorted(const RIDKeyPair<T>* entries, int count){
+        for(int j = 0; j < count; j++){
+            if(!insert(0, entries[j].key, entries[j].rid))
+                return j;
+        }
+        return count;
+    }
+
+    template <class T>
+    void PostingLeafNode<T>::split(PostingLeafNode* right, int pos, const T& key, RecordId rid, bool append){
+        std::vector<RIDKeyPair<T> > entries(size);
+        decode(entries.data());
+        RIDKeyPair<T> entry;
+        entry.set(rid, key);
+        entries.insert(std::upper_bound(entries.begin(), entries.end(), entry, entryLess<T>), entry);
+        int count = size + 1;
+        // both halves of the middle split take about half a page; with append the old entries stay and fit.
+        const RIDKeyPair<T>* e = entries.data();
+        int m = closestFeasible(append ? count - 1 : count / 2, 1, count - 1, [e, count](int i){
+            return fits(e, i) && fits(e + i, count - i);
+        });
+        right->type = POSTINGLEAF;
+        right->encode(e + m, count - m);
+        encode(e, m);
+    }
+
+    template <class T>
+    bool PostingLeafNode<T>::underfull() const{
+        return listLength + keyCount * (int)sizeof(PostingGroup<T>) < POSTINGNODEDATASIZE / 2;
+    }
+
+    template <class T>
+    bool PostingLeafNode<T>::merge(PostingLeafNode* right){
+        int count = size + right->size;
+        std::vector<RIDKeyPair<T> > entries(count);
+        decode(entries.data());
+        right->decode(entries.data() + size);
+        // a key may continue from the end of this leaf into the right one, with its record ids in any order.
+        std::inplace_merge(entries.begin(), entries.begin() + size, entries.end(), entryLess<T>);
+        if(!fits(entries.data(), count))
+            return false;
+        encode(entries.data(), count);
+        return true;
+    }
+
+    template <class T>
+    bool PostingLeafNode<T>::redistribute(PostingLeafNode* right, NonLeafNode<T>* parent, int sepIndex){
+        int count = size + right->size;
+        std::vector<RIDKeyPair<T> > entries(count);
+        decode(entries.data());
+        right->decode(entries.data() + size);
+        std::inplace_merge(entries.begin(), entries.begin() + size, entries.end(), entryLess<T>);
+        const RIDKeyPair<T>* e = entries.data();
+        int m = closestFeasible(count / 2, 1, count - 1, [e, count](int i){
+            return fits(e, i) && fits(e + i, count - i);
+        });
+        if(m < 0 || m == size || !parent->replaceKey(sepIndex, e[m].key))
+            return false;
+        right->encode(e + m, count - m);
+        encode(e, m);
+        return true;
+    }
+
+    template <class T>
+    void PostingLeafNode<T>::decodeList(int g, RecordId* out) const{
+        const unsigned char* in = (const unsigned char*)data + groups()[g].offset;
+        RecordId prev = RecordId();
+        for(int i = 0, count = groupSize(g); i < count; i++)
+            out[i] = prev = getRid(in, prev);
+    }
+
+    template <class T>
+    void PostingLeafNode<T>::spliceList(int g, int from, int to, const unsigned char* bytes, int length){
+        unsigned char* lists = (unsigned char*)data;
+        int delta = length - (to - from);
+        std::memmove(lists + to + delta, lists + to, listLength - to);
+        std::copy(bytes, bytes + length, lists + from);
+        listLength += delta;
+        PostingGroup<T>* dir = groups();
+        for(int h = g + 1; h < keyCount; h++)
+            dir[h].offset += delta;
+    }
+
+    template <class T>
+    void PostingLeafNode<T>::decode(RIDKeyPair<T>* entries) const{
+        const PostingGroup<T>* dir = groups();
+        const unsigned char* in = (const unsigned char*)data;
+        for(int g = 0, i = 0; g < keyCount; g++){
+            RecordId prev = RecordId();
+            for(int end = i + groupSize(g); i < end; i++){
+                prev = getRid(in, prev);
+                entries[i].set(prev, dir[g].key);
+            }
+        }
+    }
+
+    template <class T>
+    void PostingLeafNode<T>::encode(const RIDKeyPair<T>* entries, int count){
+        // the directory ends at the end of data, so count the keys first.
+        keyCount = 0;
+        for(int i = 0; i < count; i++)
+            if(i == 0 || entries[i].key != entries[i - 1].key)
+                keyCount++;
+        size = count;
+        listLength = 0;
+        PostingGroup<T>* dir = groups();
+        unsigned char* lists = (unsigned char*)data;
+        RecordId prev = RecordId();
+        for(int i = 0, g = -1; i < count; i++){
+            if(i == 0 || entries[i].key != entries[i - 1].key){
+                g++;
+                dir[g].key = entries[i].key;
+                dir[g].first = i;
+                dir[g].offset = listLength;
+                prev = RecordId();
+            }
+            listLength += putRid(lists + listLength, prev, entries[i].rid);
+            prev = dir[g].last = entries[i].rid;
+        }
+    }
+
+    template <class T>
+    bool PostingLeafNode<T>::fits(const RIDKeyPair<T>* entries, int count){
+        int length = 0;
+        RecordId prev = RecordId();
+        for(int i = 0; i < count; i++){
+            if(i == 0 || entries[i].key != entries[i - 1].key){
+                length += sizeof(PostingGroup<T>);
+                prev = RecordId();
+            }
+            length += ridLength(prev, entries[i].rid);
+            prev = entries[i].rid;
+        }
+        return length <= POSTINGNODEDATASIZE;
+    }
+
+    /**
+     * Number of bits needed to write value, 0 for 0.
+     */
+    static int bitWidth(unsigned value){
+        return value == 0 ? 0 : 32 - __builtin_clz(value);
+    }
+
+    /**
+     * Number of words every lane of a bit packed stream of rows rows of bits bit values takes.
+     */
+    static int laneWords(int rows, int bits){
+        return (rows * bits + 31) / 32;
+    }
+
+    /**
+     * Most rows of four entries a packed leaf has room for with the given bit widths.
+     */
+    static int packedRows(int keyBits, int pageBits, int slotBits){
+        int rowBits = keyBits + pageBits + slotBits;
+        int rows = rowBits == 0 ? PACKEDLEAFSIZE / 4 : std::min(PACKEDLEAFSIZE / 4, PACKEDNODEDATAWORDS / 4 * 32 / rowBits);
+        // every stream rounds its lanes up to whole words.
+        while(laneWords(rows, keyBits) + laneWords(rows, pageBits) + laneWords(rows, slotBits) > PACKEDNODEDATAWORDS / 4)
+            rows--;
+        return rows;
+    }
+
+    /**
+     * Value i of a bit packed stream of bits bit values.
+     */
+    static unsigned getPacked(const unsigned* stream, int bits, int i){
+        if(bits == 0)
+            return 0;
+        int bit = (i / 4) * bits, shift = bit % 32;
+        const unsigned* word = stream + (bit / 32) * 4 + i % 4;
+        unsigned value = word[0] >> shift;
+        if(shift + bits > 32)
+            value |= word[4] << (32 - shift);
+        return bits == 32 ? value : value & ((1u << bits) - 1);
+    }
+
+    /**
+     * Unpack rows [row, row + count) of a bit packed stream of bits bit values to out, four values per row.
+     * The four lanes of a row sit at the same bit offset, so one vector shift and mask unpacks the whole row.
+     */
+    static void unpackRowRange(const unsigned* stream, int bits, int row, int count, unsigned* out){
+        if(bits == 0){
+            std::fill(out, out + 4 * count, 0u);
+            return;
+        }
+        unsigned mask = bits == 32 ? ~0u : (1u << bits) - 1;
+#ifdef __SSE2__
+        const __m128i maskVector = _mm_set1_epi32(mask);
+        for(int r = 0; r < count; r++){
+            int bit = (row + r) * bits, shift = bit % 32;
+            const __m128i* word = (const __m128i*)(stream + (bit / 32) * 4);
+            __m128i values = _mm_srl_epi32(_mm_loadu_si128(word), _mm_cvtsi32_si128(shift));
+            if(shift + bits > 32)
+                values = _mm_or_si128(values, _mm_sll_epi32(_mm_loadu_si128(word + 1), _mm_cvtsi32_si128(32 - shift)));
+            _mm_storeu_si128((__m128i*)(out + 4 * r), _mm_and_si128(values, maskVector));
+        }
+#else
+        for(int r = 0; r < count; r++){
+            int bit = (row + r) * bits, shift = bit % 32;
+            const unsigned* word = stream + (bit / 32) * 4;
+            for(int lane = 0; lane < 4; lane++){
+                unsigned value = word[lane] >> shift;
+                if(shift + bits > 32)
+                    value |= word[lane + 4] << (32 - shift);
+                out[4 * r + lane] = value & mask;
+            }
+        }
+#endif
+    }
+
+    /**
+     * Overwrite rows [row, row + count) of a bit packed stream of bits bit values with values[0, 4 * count), each of
+     * which fits in bits bits. The bits of the rows around them are kept.
+     */
+    static void packRowRange(const unsigned* values, int bits, int row, int count, unsigned* stream){
+        if(bits == 0)
+            return;
+        unsigned mask = bits == 32 ? ~0u : (1u << bits) - 1;
+#ifdef __SSE2__
+        const __m128i maskVector = _mm_set1_epi32(mask);
+        for(int r = 0; r < count; r++){
+            int bit = (row + r) * bits, shift = bit % 32;
+            __m128i* word = (__m128i*)(stream + (bit / 32) * 4);
+            __m128i rowValues = _mm_loadu_si128((const __m128i*)(values + 4 * r));
+            __m128i low = _mm_cvtsi32_si128(shift), high = _mm_cvtsi32_si128(32 - shift);
+            _mm_storeu_si128(word, _mm_or_si128(_mm_andnot_si128(_mm_sll_epi32(maskVector, low), _mm_loadu_si128(word)),
+                    _mm_sll_epi32(rowValues, low)));
+            if(shift + bits > 32)
+                _mm_storeu_si128(word + 1, _mm_or_si128(_mm_andnot_si128(_mm_srl_epi32(maskVector, high), _mm_loadu_si128(word + 1)),
+                        _mm_srl_epi32(rowValues, high)));
+        }
+#else
+        for(int r = 0; r < count; r++){
+            int bit = (row + r) * bits, shift = bit % 32;
+            unsigned* word = stream + (bit / 32) * 4;
+            for(int lane = 0; lane < 4; lane++){
+                unsigned value = values[4 * r + lane];
+                word[lane] = (word[lane] & ~(mask << shift)) | (value << shift);
+                if(shift + bits > 32)
+                    word[lane + 4] = (word[lane + 4] & ~(mask >> (32 - shift))) | (value >> (32 - shift));
+            }
+        }
+#endif
+    }
+
+#ifdef __SSE2__
+    /**
+     * Unpack 32 rows of BITS bit values, which take exactly BITS words per lane, from block to out. With the width
+     * known at compile time every shift is a constant and the loop unrolls into straight line code.
+     */
+    template <int BITS>
+    static void unpackBlock(const unsigned* block, unsigned* out){
+        const __m128i mask = _mm_set1_epi32(BITS == 32 ? ~0u : (1u << BITS) - 1);
+        const __m128i* in = (const __m128i*)block;
+#pragma GCC unroll 32
+        for(int r = 0; r < 32; r++){
+            const int bit = r * BITS, shift = bit % 32;
+            __m128i values = _mm_srli_epi32(_mm_loadu_si128(in + bit / 32), shift);
+            if(shift + BITS > 32)
+                values = _mm_or_si128(values, _mm_slli_epi32(_mm_loadu_si128(in + bit / 32 + 1), 32 - shift));
+            _mm_storeu_si128((__m128i*)out + r, _mm_and_si128(values, mask));
+        }
+    }
+
+    /**
+     * Pack 32 rows of values, each of which fits in BITS bits, into the BITS words per lane of block.
+     */
+    template <int BITS>
+    static void packBlock(const unsigned* values, unsigned* block){
+        const __m128i* in = (const __m128i*)values;
+        __m128i* out = (__m128i*)block;
+        __m128i word = _mm_setzero_si128();
+#pragma GCC unroll 32
+        for(int r = 0; r < 32; r++){
+            const int bit = r * BITS, shift = bit % 32;
+            __m128i rowValues = _mm_loadu_si128(in + r);
+            word = _mm_or_si128(word, _mm_slli_epi32(rowValues, shift));
+            if(shift + BITS >= 32){
+                _mm_storeu_si128(out + bit / 32, word);
+                word = shift + BITS > 32 ? _mm_srli_epi32(rowValues, 32 - shift) : _mm_setzero_si128();
+            }
+        }
+    }
+
+    /**
+     * The kernels above for every width, indexed by it.
+     */
+    static void (*const unpackBlocks[33])(const unsigned*, unsigned*) = {
+        unpackBlock<0>, unpackBlock<1>, unpackBlock<2>, unpackBlock<3>, unpackBlock<4>, unpackBlock<5>, unpackBlock<6>,
+        unpackBlock<7>, unpackBlock<8>, unpackBlock<9>, unpackBlock<10>, unpackBlock<11>, unpackBlock<12>, unpackBlock<13>,
+        unpackBlock<14>, unpackBlock<15>, unpackBlock<16>, unpackBlock<17>, unpackBlock<18>, unpackBlock<19>, unpackBlock<20>,
+        unpackBlock<21>, unpackBlock<22>, unpackBlock<23>, unpackBlock<24>, unpackBlock<25>, unpackBlock<26>, unpackBlock<27>,
+        unpackBlock<28>, unpackBlock<29>, unpackBlock<30>, unpackBlock<31>, unpackBlock<32>
+    };
+    static void (*const packBlocks[33])(const unsigned*, unsigned*) = {
+        packBlock<0>, packBlock<1>, packBlock<2>, packBlock<3>, packBlock<4>, packBlock<5>, packBlock<6>,
+        packBlock<7>, packBlock<8>, packBlock<9>, packBlock<10>, packBlock<11>, packBlock<12>, packBlock<13>,
+        packBlock<14>, packBlock<15>, packBlock<16>, packBlock<17>, packBlock<18>, packBlock<19>, packBlock<20>,
+        packBlock<21>, packBlock<22>, packBlock<23>, packBlock<24>, packBlock<25>, packBlock<26>, packBlock<27>,
+        packBlock<28>, packBlock<29>, packBlock<30>, packBlock<31>, packBlock<32>
+    };
+#endif
+
+    /**
+     * Unpack rows [row, row + count) like unpackRowRange(), but runs of 32 rows starting at a multiple of 32 go
+     * through the kernel for the width.
+     */
+    static void unpackRows(const unsigned* stream, int bits, int row, int count, unsigned* out){
+        int done = std::min(count, (32 - row % 32) % 32);
+        unpackRowRange(stream, bits, row, done, out);
+#ifdef __SSE2__
+        for(; count - done >= 32; done += 32)
+            unpackBlocks[bits](stream + (row + done) / 32 * bits * 4, out + 4 * done);
+#endif
+        unpackRowRange(stream, bits, row + done, count - done, out + 4 * done);
+    }
+
+    /**
+     * Overwrite rows [row, row + count) like packRowRange(), but through the kernel for the width where it can.
+     */
+    static void packRows(const unsigned* values, int bits, int row, int count, unsigned* stream){
+        int done = std::min(count, (32 - row % 32) % 32);
+        packRowRange(values, bits, row, done, stream);
+#ifdef __SSE2__
+        for(; count - done >= 32; done += 32)
+            packBlocks[bits](values + 4 * done, stream + (row + done) / 32 * bits * 4);
+#endif
+        packRowRange(values + 4 * done, bits, row + done, count - done, stream);
+    }
+
+    /**
+     * Move values [pos, size) of a bit packed stream of bits bit values one lane on and write value at pos, or with
+     * remove set, drop value pos and move the values after it one lane back. Only the rows from pos on are touched.
+     */
+    static void shiftPacked(unsigned* stream, int bits, int pos, int size, bool remove, unsigned value){
+        if(bits == 0)
+            return;
+        unsigned buffer[PACKEDLEAFSIZE];
+        int row = pos / 4, count = (remove ? size + 3 : size + 4) / 4 - row, first = pos - 4 * row;
+        unpackRows(stream, bits, row, count, buffer);
+        if(remove){
+            std::memmove(buffer + first, buffer + first + 1, (size - pos - 1) * sizeof(unsigned));
+        } else{
+            std::memmove(buffer + first + 1, buffer + first, (size - pos) * sizeof(unsigned));
+            buffer[first] = value;
+        }
+        packRows(buffer, bits, row, count, stream);
+    }
+
+    /**
+     * The int a key is packed as, and back. Packed leaves are compiled for every key type but only INTEGER indexes
+     * use them, so a COMPOSITE key, which has no such conversion, never gets here.
+     */
+    template <class T>
+    static int packedKey(const T& key){
+        return (int)key;
+    }
+
+    static int packedKey(const CompositeKey&){
+        return 0;
+    }
+
+    template <class T>
+    static T unpackedKey(int value){
+        return (T)value;
+    }
+
+    template <>
+    CompositeKey unpackedKey<CompositeKey>(int){
+        return CompositeKey();
+    }
+
+    /**
+     * Bit widths of a packed leaf holding the sorted entries[0, count).
+     */
+    template <class T>
+    static void packedWidths(const RIDKeyPair<T>* entries, int count, int& keyBits, int& pageBits, int& slotBits){
+        keyBits = pageBits = slotBits = 0;
+        if(count == 0)
+            return;
+        PageId minPage = entries[0].rid.page_number, maxPage = minPage;
+        unsigned slots = 0;
+        for(int i = 0; i < count; i++){
+            minPage = std::min(minPage, entries[i].rid.page_number);
+            maxPage = std::max(maxPage, entries[i].rid.page_number);
+            slots |= entries[i].rid.slot_number;
+        }
+        keyBits = bitWidth((unsigned)packedKey(entries[count - 1].key) - (unsigned)packedKey(entries[0].key));
+        pageBits = bitWidth(maxPage - minPage);
+        slotBits = bitWidth(slots);
+    }
+
+    template <class T>
+    void PackedLeafNode<T>::init(PageId rightSib){
+        type = PACKEDLEAF;
+        size = 0;
+        rightSibPageNo = rightSib;
+        encode(nullptr, 0);
+    }
+
+    template <class T>
+    unsigned* PackedLeafNode<T>::pageStream(){
+        return data + 4 * laneWords(rows, keyBits);
+    }
+
+    template <class T>
+    const unsigned* PackedLeafNode<T>::pageStream() const{
+        return data + 4 * laneWords(rows, keyBits);
+    }
+
+    template <class T>
+    unsigned* PackedLeafNode<T>::slotStream(){
+        return pageStream() + 4 * laneWords(rows, pageBits);
+    }
+
+    template <class T>
+    const unsigned* PackedLeafNode<T>::slotStream() const{
+        return pageStream() + 4 * laneWords(rows, pageBits);
+    }
+
+    template <class T>
+    T PackedLeafNode<T>::key(int i) const{
+        return unpackedKey<T>((int)((unsigned)keyBase + getPacked(keyStream(), keyBits, i)));
+    }
+
+    template <class T>
+    RecordId PackedLeafNode<T>::rid(int i) const{
+        RecordId rid;
+        rid.page_number = pageBase + getPacked(pageStream(), pageBits, i);
+        rid.slot_number = getPacked(slotStream(), slotBits, i);
+        rid.padding = 0;
+        return rid;
+    }
+
+    template <class T>
+    void PackedLeafNode<T>::copyRids(int from, int count, RecordId* out) const{
+        // unpack 32 rows at a time, aligned so that every full chunk goes through the kernel for the width.
+        const int chunkRows = 32;
+        unsigned pages[4 * chunkRows], slots[4 * chunkRows];
+        RecordId rids[4 * chunkRows];
+        int end = from + count;
+        for(int row = from / 4 / chunkRows * chunkRows; row * 4 < end; row += chunkRows){
+            int numRows = std::min(chunkRows, (end + 3) / 4 - row);
+            unpackRows(pageStream(), pageBits, row, numRows, pages);
+            unpackRows(slotStream(), slotBits, row, numRows, slots);
+#ifdef __SSE2__
+            // a record id is its page number followed by its slot number and zero padding, so interleaving the
+            // page numbers with the slot numbers as 32 bit lanes builds two record ids per vector.
+            const __m128i base = _mm_set1_epi32(pageBase);
+            for(int r = 0; r < numRows; r++){
+                __m128i rowPages = _mm_add_epi32(_mm_loadu_si128((const __m128i*)(pages + 4 * r)), base);
+                __m128i rowSlots = _mm_loadu_si128((const __m128i*)(slots + 4 * r));
+                _mm_storeu_si128((__m128i*)(rids + 4 * r), _mm_unpacklo_epi32(rowPages, rowSlots));
+                _mm_storeu_si128((__m128i*)(rids + 4 * r + 2), _mm_unpackhi_epi32(rowPages, rowSlots));
+            }
+#else
+            for(int i = 0; i < 4 * numRows; i++){
+                rids[i].page_number = pageBase + pages[i];
+                rids[i].slot_number = slots[i];
+                rids[i].padding = 0;
+            }
+#endif
+            int first = std::max(from, row * 4), last = std::min(end, (row + numRows) * 4);
+            std::memcpy(out + (first - from), rids + (first - row * 4), (last - first) * sizeof(RecordId));
+        }
+    }
+
+    template <class T>
+    int PackedLeafNode<T>::lowerBound(int from, const T& key) const{
+        int low = from, high = size;
+        while(low < high){
+            int mid = (low + high) / 2;
+            if(this->key(mid) < key)
+                low = mid + 1;
+            else
+                high = mid;
+        }
+        return low;
+    }
+
+    template <class T>
+    int PackedLeafNode<T>::upperBound(int from, const T& key) const{
+        int low = from, high = size;
+        while(low < high){
+            int mid = (low + high) / 2;
+            if(key < this->key(mid))
+                high = mid;
+            else
+                low = mid + 1;
+        }
+        return low;
+    }
+
+    template <class T>
+    bool PackedLeafNode<T>::insert(int pos, const T& key, RecordId rid){
+        unsigned keyOffset = (unsigned)packedKey(key) - (unsigned)keyBase, pageOffset = rid.page_number - pageBase;
+        if(size > 0 && size < 4 * rows && !(key < unpackedKey<T>(keyBase)) && rid.page_number >= pageBase && bitWidth(keyOffset) <= keyBits
+                && bitWidth(pageOffset) <= pageBits && bitWidth(rid.slot_number) <= slotBits){
+            // the entry fits the bit widths, so only the entries from pos on move.
+            shiftPacked(keyStream(), keyBits, pos, size, false, keyOffset);
+            shiftPacked(pageStream(), pageBits, pos, size, false, pageOffset);
+            shiftPacked(slotStream(), slotBits, pos, size, false, rid.slot_number);
+            size++;
+            return true;
+        }
+        std::vector<RIDKeyPair<T> > entries(size + 1);
+        decode(entries.data());
+        std::copy_backward(entries.begin() + pos, entries.end() - 1, entries.end());
+        entries[pos].set(rid, key);
+        if(!fits(entries.data(), size + 1))
+            return false;
+        encode(entries.data(), size + 1);
+        return true;
+    }
+
+    template <class T>
+    void PackedLeafNode<T>::remove(int pos){
+        // the bit widths stay, fewer entries never need wider ones.
+        shiftPacked(keyStream(), keyBits, pos, size, true, 0);
+        shiftPacked(pageStream(), pageBits, pos, size, true, 0);
+        shiftPacked(slotStream(), slotBits, pos, size, true, 0);
+        size--;
+    }
+
+    template <class T>
+    int PackedLeafNode<T>::insertSorted(const RIDKeyPair<T>* entries, int count){
+        if(count == 0)
+            return 0;
+        std::vector<RIDKeyPair<T> > merged(size + count);
+        decode(merged.data());
+        // widths only grow with every entry taken, so take entries until the next one does not fit.
+        PageId minPage = size > 0 ? pageBase : entries[0].rid.page_number, maxPage = minPage;
+        unsigned slots = 0;
+        for(int i = 0; i < size; i++){
+            maxPage = std::max(maxPage, merged[i].rid.page_number);
+            slots |= merged[i].rid.slot_number;
+        }
+        T minKey = size > 0 ? std::min(merged[0].key, entries[0].key) : entries[0].key;
+        int numMerged = 0;
+        for(; numMerged < count; numMerged++){
+            const RIDKeyPair<T>& entry = entries[numMerged];
+            PageId low = std::min(minPage, entry.rid.page_number), high = std::max(maxPage, entry.rid.page_number);
+            T maxKey = size > 0 ? std::max(merged[size - 1].key, entry.key) : entry.key;
+            int keyBits = bitWidth((unsigned)packedKey(maxKey) - (unsigned)packedKey(minKey));
+            int rowsNeeded = (size + numMerged + 1 + 3) / 4;
+            if(rowsNeeded > packedRows(keyBits, bitWidth(high - low), bitWidth(slots | entry.rid.slot_number)))
+                break;
+            minPage = low;
+            maxPage = high;
+            slots |= entry.rid.slot_number;
+        }
+        std::vector<RIDKeyPair<T> > leaf(merged.begin(), merged.begin() + size);
+        std::merge(leaf.begin(), leaf.end(), entries, entries + numMerged, merged.begin(), [](const RIDKeyPair<T>& a, const RIDKeyPair<T>& b){
+            return a.key < b.key;
+        });
+        encode(merged.data(), size + numMerged);
+        return numMerged;
+    }
+
+    template <class T>
+    void PackedLeafNode<T>::split(PackedLeafNode* right, int pos, const T& key, RecordId rid, bool append){
+        std::vector<RIDKeyPair<T> > entries(size + 1);
+        decode(entries.data());
+        std::copy_backward(entries.begin() + pos, entries.end() - 1, entries.end());
+        entries[pos].set(rid, key);
+        int count = size + 1;
+        // PACKEDLEAFSIZE leaves room for the middle split of entries of any width; with append the old entries
+        // stay and fit.
+        const RIDKeyPair<T>* e = entries.data();
+        int m = closestFeasible(append ? count - 1 : count / 2, 1, count - 1, [e, count](int i){
+            return fits(e, i) && fits(e + i, count - i);
+        });
+        right->type = PACKEDLEAF;
+        right->encode(e + m, count - m);
+        encode(e, m);
+    }
+
+    template <class T>
+    bool PackedLeafNode<T>::underfull() const{
+        return size < 2 * rows;
+    }
+
+    template <class T>
+    bool PackedLeafNode<T>::merge(PackedLeafNode* right){
+        int count = size + right->size;
+        std::vector<RIDKeyPair<T> > entries(count);
+        decode(entries.data());
+        right->decode(entries.data() + size);
+        if(!fits(entries.data(), count))
+            return false;
+        encode(entries.data(), count);
+        return true;
+    }
+
+    template <class T>
+    bool PackedLeafNode<T>::redistribute(PackedLeafNode* right, NonLeafNode<T>* parent, int sepIndex){
+        int count = size + right->size;
+        std::vector<RIDKeyPair<T> > entries(count);
+        decode(entries.data());
+        right->decode(entries.data() + size);
+        const RIDKeyPair<T>* e = entries.data();
+        int m = closestFeasible(count / 2, 1, count - 1, [e, count](int i){
+            return fits(e, i) && fits(e + i, count - i);
+        });
+        if(m < 0 || m == size || !parent->replaceKey(sepIndex, e[m].key))
+            return false;
+        right->encode(e + m, count - m);
+        encode(e, m);
+        return true;
+    }
+
+    template <class T>
+    void PackedLeafNode<T>::decode(RIDKeyPair<T>* entries) const{
+        unsigned keys[PACKEDLEAFSIZE], pages[PACKEDLEAFSIZE], slots[PACKEDLEAFSIZE];
+        int numRows = (size + 3) / 4;
+        unpackRows(keyStream(), keyBits, 0, numRows, keys);
+        unpackRows(pageStream(), pageBits, 0, numRows, pages);
+        unpackRows(slotStream(), slotBits, 0, numRows, slots);
+        for(int i = 0; i < size; i++){
+            entries[i].key = unpackedKey<T>((int)((unsigned)keyBase + keys[i]));
+            entries[i].rid.page_number = pageBase + pages[i];
+            entries[i].rid.slot_number = slots[i];
+            entries[i].rid.padding = 0;
+        }
+    }
+
+    template <class T>
+    void PackedLeafNode<T>::encode(const RIDKeyPair<T>* entries, int count){
+        int widths[3];
+        packedWidths(entries, count, widths[0], widths[1], widths[2]);
+        keyBits = widths[0];
+        pageBits = widths[1];
+        slotBits = widths[2];
+        padding = 0;
+        // size the streams for as many rows as fit, so that later inserts find free lanes.
+        rows = packedRows(keyBits, pageBits, slotBits);
+        size = count;
+        keyBase = count > 0 ? packedKey(entries[0].key) : 0;
+        pageBase = count > 0 ? entries[0].rid.page_number : 0;
+        for(int i = 0; i < count; i++)
+            pageBase = std::min(pageBase, entries[i].rid.page_number);
+        unsigned values[PACKEDLEAFSIZE];
+        int numRows = (count + 3) / 4;
+        std::fill(values + count, values + 4 * numRows, 0u);
+        for(int i = 0; i < count; i++)
+            values[i] = (unsigned)packedKey(entries[i].key) - (unsigned)keyBase;
+        packRows(values, keyBits, 0, numRows, keyStream());
+        for(int i = 0; i < count; i++)
+            values[i] = entries[i].rid.page_number - pageBase;
+        packRows(values, pageBits, 0, numRows, pageStream());
+        for(int i = 0; i < count; i++)
+            values[i] = entries[i].rid.slot_number;
+        packRows(values, slotBits, 0, numRows, slotStream());
+    }
+
+    template <class T>
+    bool PackedLeafNode<T>::fits(const RIDKeyPair<T>* entries, int count){
+        int keyBits, pageBits, slotBits;
+        packedWidths(entries, count, keyBits, pageBits, slotBits);
+        return (count + 3) / 4 <= packedRows(keyBits, pageBits, slotBits);
+    }
+
+    template <class T>
+    void CoveringLeafNode<T>::init(PageId rightSib, int payloadLength){
+        type = COVERINGLEAF;
+        size = 0;
+        rightSibPageNo = rightSib;
+        this->payloadLength = payloadLength;
+    }
+
+    template <class T>
+    T CoveringLeafNode<T>::key(int i) const{
+        T key;
+        std::memcpy(&key, entry(i), sizeof(T));
+        return key;
+    }
+
+    template <class T>
+    RecordId CoveringLeafNode<T>::rid(int i) const{
+        RecordId rid;
+        std::memcpy(&rid, entry(i) + sizeof(T), sizeof(RecordId));
+        return rid;
+    }
+
+    template <class T>
+    void CoveringLeafNode<T>::copyRids(int from, int count, RecordId* out) const{
+        for(int i = 0; i < count; i++)
+            std::memcpy(out + i, entry(from + i) + sizeof(T), sizeof(RecordId));
+    }
+
+    template <class T>
+    void CoveringLeafNode<T>::copyPayloads(int from, int count, char* out) const{
+        for(int i = 0; i < count; i++)
+            std::memcpy(out + i * payloadLength, entry(from + i) + sizeof(T) + sizeof(RecordId), payloadLength);
+    }
+
+    template <class T>
+    int CoveringLeafNode<T>::lowerBound(int from, const T& key) const{
+        int low = from, high = size;
+        while(low < high){
+            int mid = (low + high) / 2;
+            if(this->key(mid) < key)
+                low = mid + 1;
+            else
+                high = mid;
+        }
+        return low;
+    }
+
+    template <class T>
+    int CoveringLeafNode<T>::upperBound(int from, const T& key) const{
+        int low = from, high = size;
+        while(low < high){
+            int mid = (low + high) / 2;
+            if(key < this->key(mid))
+                high = mid;
+            else
+                low = mid + 1;
+        }
+        return low;
+    }
+
+    template <class T>
+    bool CoveringLeafNode<T>::insert(int pos, const T& key, RecordId rid, const char* payload){
+        if(size == capacity())
+            return false;
+        std::memmove(entry(pos + 1), entry(pos), (size - pos) * entryLength());
+        char* slot = entry(pos);
+        std::memcpy(slot, &key, sizeof(T));
+        std::memcpy(slot + sizeof(T), &rid, sizeof(RecordId));
+        if(payload != nullptr)
+            std::memcpy(slot + sizeof(T) + sizeof(RecordId), payload, payloadLength);
+        else
+            std::memset(slot + sizeof(T) + sizeof(RecordId), 0, payloadLength);
+        size++;
+        return true;
+    }
+
+    template <class T>
+    void CoveringLeafNode<T>::remove(int pos){
+        std::memmove(entry(pos), entry(pos + 1), (size - pos - 1) * entryLength());
+        size--;
+    }
+
+    template <class T>
+    int CoveringLeafNode<T>::insertSorted(const RIDKeyPair<T>* entries, int count){
+        int pos = 0;
+        for(int j = 0; j < count; j++){
+            pos = upperBound(pos, entries[j].key);
+            if(!insert(pos, entries[j].key, entries[j].rid, nullptr))
+                return j;
+        }
+        return count;
+    }
+
+    template <class T>
+    void CoveringLeafNode<T>::split(CoveringLeafNode* right, int pos, const T& key, RecordId rid, const char* payload, bool append){
+        // like an array leaf: the left midIndex of the capacity() + 1 entries stay in place, the rest move to right.
+        right->type = COVERINGLEAF;
+        right->payloadLength = payloadLength;
+        int midIndex = append ? size : (capacity() + 1) / 2;
+        int firstMoved = pos < midIndex ? midIndex - 1 : midIndex;
+        right->size = size - firstMoved;
+        std::memcpy(right->entry(0), entry(firstMoved), right->size * entryLength());
+        size = firstMoved;
+        if(pos < midIndex)
+            insert(pos, key, rid, payload);
+        else
+            right->insert(pos - midIndex, key, rid, payload);
+    }
+
+    template <class T>
+    bool CoveringLeafNode<T>::underfull() const{
+        return size < capacity() / 2;
+    }
+
+    template <class T>
+    bool CoveringLeafNode<T>::merge(CoveringLeafNode* right){
+        if(size + right->size > capacity())
+            return false;
+        std::memcpy(entry(size), right->entry(0), right->size * entryLength());
+        size += right->size;
+        return true;
+    }
+
+    template <class T>
+    bool CoveringLeafNode<T>::redistribute(CoveringLeafNode* right, NonLeafNode<T>* parent, int sepIndex){
+        int total = size + right->size;
+        if(size == total / 2)
+            return false;
+        // the first key of the right leaf after the move separates the two, set it before anything moves.
+        T separator = size < total / 2 ? right->key(total / 2 - size) : key(total / 2);
+        if(!parent->replaceKey(sepIndex, separator))
+            return false;
+        if(size < total / 2){
+            // move the head of the right leaf to the tail of this one.
+            int numMoved = total / 2 - size;
+            std::memcpy(entry(size), right->entry(0), numMoved * entryLength());
+            size += numMoved;
+            right->size -= numMoved;
+            std::memmove(right->entry(0), right->entry(numMoved), right->size * entryLength());
+        } else{
+            // move the tail of this leaf to the head of the right one.
+            int numMoved = size - total / 2;
+            std::memmove(right->entry(numMoved), right->entry(0), right->size * entryLength());
+            size -= numMoved;
+            right->size += numMoved;
+            std::memcpy(right->entry(0), entry(size), numMoved * entryLength());
+        }
+        return true;
+    }
+
+    // -----------------------------------------------------------------------------
+    // DeltaStore
+    // -----------------------------------------------------------------------------
+
+    template <class T>
+    DeltaStore<T>::DeltaStore()
+        : count(0), randomState(0x9e3779b9)
+    {
+        head = allocNode(MAXHEIGHT);
+    }
+
+    template <class T>
+    DeltaStore<T>::~DeltaStore()
+    {
+        clear();
+        freeNode(head);
+    }
+
+    /**
+     * Allocate an entry linked into height levels, with its next pointers null.
+     */
+    template <class T>
+    typename DeltaStore<T>::Node* DeltaStore<T>::allocNode(int height)
+    {
+        void *memory = ::operator new(sizeof(Node) + (height - 1) * sizeof(std::atomic<Node*>));
+        Node *node = new (memory) Node();
+        for(int level = 0; level < height; level++)
+            node->next[level].store(nullptr, std::memory_order_relaxed);
+        return node;
+    }
+
+    template <class T>
+    void DeltaStore<T>::freeNode(Node* node)
+    {
+        node->~Node();
+        ::operator delete(node);
+    }
+
+    /**
+     * Add an entry after the entries with an equal key. The entry is linked in bottom-up, each level with a
+     * release store once its own next pointer is set, so a reader following any level finds it complete.
+     * @param key
+     * @param rid
+     */
+    template <class T>
+    void DeltaStore<T>::insert(const T& key, const RecordId rid)
+    {
+        std::lock_guard<std::mutex> guard(insertMutex);
+        Node *preds[MAXHEIGHT];
+        Node *node = head;
+        for(int level = MAXHEIGHT - 1; level >= 0; level--){
+            Node *next = node->successor(level);
+            while(next != nullptr && !(key < next->entry.key)){
+                node = next;
+                next = node->successor(level);
+            }
+            preds[level] = node;
+        }
+        // xorshift; each further level with probability 1/4.
+        int height = 1;
+        while(height < MAXHEIGHT){
+            randomState ^= randomState << 13;
+            randomState ^= randomState >> 17;
+            randomState ^= randomState << 5;
+            if(randomState & 3)
+                break;
+            height++;
+        }
+        Node *newNode = allocNode(height);
+        newNode->entry.set(rid, key);
+        for(int level = 0; level < height; level++){
+            newNode->next[level].store(preds[level]->next[level].load(std::memory_order_relaxed), std::memory_order_relaxed);
+            preds[level]->next[level].store(newNode, std::memory_order_release);
+        }
+        count++;
+    }
+
+    /**
+     * First entry whose key is not below key, or above it if strict; null if there is none.
+     * @param key
+     * @param strict
+     */
+    template <class T>
+    const typename DeltaStore<T>::Node* DeltaStore<T>::seek(const T& key, bool strict) const
+    {
+        const Node *node = head;
+        for(int level = MAXHEIGHT - 1; level >= 0; level--){
+            const Node *next = node->successor(level);
+            while(next != nullptr && (strict ? !(key < next->entry.key) : next->entry.key < key)){
+                node = next;
+                next = node->successor(level);
+            }
+        }
+        return node->successor(0);
+    }
+
+    /**
+     * Remove all entries. Nothing else may use the store meanwhile.
+     */
+    template <class T>
+    void DeltaStore<T>::clear()
+    {
+        Node *node = head->successor(0);
+        while(node != nullptr){
+            Node *next = node->successor(0);
+            freeNode(node);
+            node = next;
+        }
+        for(int level = 0; level < MAXHEIGHT; level++)
+            head->next[level].store(nullptr, std::memory_order_relaxed);
+        count = 0;
+    }
+
+    template class DeltaStore<int>;
+    template class DeltaStore<double>;
+    template class DeltaStore<StringKey>;
+    template class DeltaStore<CompositeKey>;
+
+    // -----------------------------------------------------------------------------
+    // EytzingerCache
+    // -----------------------------------------------------------------------------
+
+    EytzingerCache::EytzingerCache(int numSlots)
+        : slots(new Slot[numSlots]), numSlots(numSlots)
+    {
+        for(int i = 0; i < numSlots; i++){
+            slots[i].sequence = 0;
+            slots[i].page = nullptr;
+        }
+    }
+
+    EytzingerCache::~EytzingerCache()
+    {
+        delete[] slots;
+    }
+
+    EytzingerCache::Slot& EytzingerCache::slotOf(const Page* page) const
+    {
+        // the frames of the buffer pool lie next to each other, so neighbouring frames get neighbouring slots.
+        return slots[(reinterpret_cast<std::uintptr_t>(page) / sizeof(Page)) % numSlots];
+    }
+
+    bool EytzingerCache::search(const Page* page, std::uint32_t version, int key, bool upper, int& index) const
+    {
+        const Slot &slot = slotOf(page);
+        std::uint32_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if(sequence % 2 == 1 || slot.page != page || slot.version != version)
+            return false;
+        int size = slot.size;
+        int k = 1;
+        while(k <= size){
+            // the sixteen keys four levels down lie next to each other, in one cache line.
+            __builtin_prefetch(slot.keys + 16 * k);
+            k = 2 * k + (upper ? slot.keys[k] <= key : slot.keys[k] < key);
+        }
+        // undo the steps to the right after the last step to the left, which was taken at the key searched for.
+        k >>= __builtin_ffs(~k);
+        int result = k == 0 ? size : slot.ranks[k];
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(slot.sequence.load(std::memory_order_relaxed) != sequence)
+            return false;
+        index = result;
+        return true;
+    }
+
+    void EytzingerCache::build(const Page* page, std::uint32_t version, const NonLeafNode<int>* node, const BufMgr* bufMgr)
+    {
+        Slot &slot = slotOf(page);
+        std::uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+        if(sequence % 2 == 1 || !slot.sequence.compare_exchange_strong(sequence, sequence + 1, std::memory_order_acquire))
+            return;
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.size = node->plausible() ? node->size : 0;
+        fill(slot, node, 0, 1);
+        // a node read without its latch may have changed while it was copied.
+        slot.page = bufMgr == nullptr || bufMgr->validateVersion(page, version) ? page : nullptr;
+        slot.version = version;
+        slot.sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    int EytzingerCache::searchNode(const Page* page, std::uint32_t version, const NonLeafNode<int>* node, int key, bool upper, const BufMgr* bufMgr)
+    {
+        int from = 0, to = node->size, index;
+        // only nodes whose keys interpolation mispredicts are copied, so a node with a copy is searched there.
+        if(search(page, version, key, upper, index))
+            return index;
+        if(interpolateKeys(node->keyArray, from, to, key, upper, index))
+            return index;
+        build(page, version, node, bufMgr);
+        return searchKeys<int>(node->keyArray, from, to, key, upper);
+    }
+
+    int EytzingerCache::fill(Slot& slot, const NonLeafNode<int>* node, int i, int k)
+    {
+        if(k <= slot.size){
+            i = fill(slot, node, i, 2 * k);
+            slot.keys[k] = node->keyArray[i];
+            slot.ranks[k] = i;
+            i = fill(slot, node, i + 1, 2 * k + 1);
+        }
+        return i;
+    }
+
+    // -----------------------------------------------------------------------------
+    // BTreeIndex
+    // -----------------------------------------------------------------------------
+
+    /**
+     * BTreeIndex Constructor.
+     * Check to see if the corresponding index file exists. If so, open the file.
+     * If not, create it and insert entries for every tuple in the base relation using FileScan class.
+     *
+     * @param relationName        Name of file.
+     * @param outIndexName        Return the name of index file.
+     * @param bufMgrIn						Buffer Manager Instance
+     * @param attrByteOffset			Offset of attribute, over which index is to be built, in the record
+     * @param attrType						Datatype of attribute over which index is built
+     * @param leafFormat					Layout of the leaves if the index is created; an existing index keeps the one it was created with
+     * @param payloadColumns			Columns of the records to copy into the leaf entries if the index is created
+     * @param bloomBitsPerKey		Bits per entry of a Bloom filter over the keys if the index is created, 0 for none
+     * @param countEntries		Whether the nonleaves keep the number of entries below each child, if the index is created
+     * @throws  BadIndexInfoException     If the index file already exists for the corresponding attribute, but values in metapage(relationName, attribute byte offset, attribute type etc.) do not match with values received through constructor parameters.
+     * @throws  BadIndexInfoException     If the payload columns are too many, too long or out of range, or bloomBitsPerKey is negative.
+     */
+    BTreeIndex::BTreeIndex(const std::string & relationName,
+            std::string & outIndexName,
+            BufMgr *bufMgrIn,
+            const int attrByteOffset,
+            const Datatype attrType,
+            const LeafFormat leafFormat,
+            const std::vector<PayloadColumn> & payloadColumns,
+            const int bloomBitsPerKey,
+            const bool countEntries)
+        : scanCursor(this)
+    {
+        // Add your code below. Please do not remove this line.
+        bufMgr = bufMgrIn;
+        attributeType = attrType;
+        this->attrByteOffset = attrByteOffset;
+        // find index file.
+        std::ostringstream idxStr;
+        idxStr << relationName << '.' << attrByteOffset;
+        outIndexName = idxStr.str();
+        openIndex(relationName, outIndexName, leafFormat, payloadColumns, bloomBitsPerKey, countEntries);
+    }
+
+    /**
+     * Number of bytes an attribute of the given type takes in a normalized COMPOSITE key, or 0 if the type cannot
+     * be part of one.
+     */
+    static int keyColumnWidth(Datatype type){
+        switch(type){
+            case INTEGER: return sizeof(int);
+            case DOUBLE: return sizeof(double);
+            case STRING: return STRINGSIZE;
+            default: return 0;
+        }
+    }
+
+    /**
+     * BTreeIndex Constructor for a COMPOSITE key over several attributes.
+     *
+     * @param relationName        Name of file.
+     * @param outIndexName        Return the name of index file.
+     * @param bufMgrIn						Buffer Manager Instance
+     * @param keyColumns					Attributes of the key, most significant first
+     * @param leafFormat					Layout of the leaves if the index is created
+     * @param payloadColumns			Columns of the records to copy into the leaf entries if the index is created
+     * @param bloomBitsPerKey		Bits per entry of a Bloom filter over the keys if the index is created, 0 for none
+     * @param countEntries		Whether the nonleaves keep the number of entries below each child, if the index is created
+     * @throws  BadIndexInfoException     If the key attributes, the payload columns or bloomBitsPerKey are not valid.
+     */
+    BTreeIndex::BTreeIndex(const std::string & relationName,
+            std::string & outIndexName,
+            BufMgr *bufMgrIn,
+            const std::vector<KeyColumn> & keyColumns,
+            const LeafFormat leafFormat,
+            const std::vector<PayloadColumn> & payloadColumns,
+            const int bloomBitsPerKey,
+            const bool countEntries)
+        : scanCursor(this)
+    {
+        if(keyColumns.size() < 2 || keyColumns.size() > (size_t)MAXKEYCOLUMNS)
+            throw BadIndexInfoException("A composite key needs two to MAXKEYCOLUMNS attributes");
+        int keyLength = 0;
+        for(size_t i = 0; i < keyColumns.size(); i++){
+            if(keyColumns[i].offset < 0 || keyColumnWidth(keyColumns[i].type) == 0)
+                throw BadIndexInfoException("Key attribute out of range");
+            keyLength += keyColumnWidth(keyColumns[i].type);
+        }
+        if(keyLength > COMPOSITESIZE)
+            throw BadIndexInfoException("Key attributes too long");
+        bufMgr = bufMgrIn;
+        attributeType = COMPOSITE;
+        attrByteOffset = keyColumns[0].offset;
+        this->keyColumns = keyColumns;
+        // find index file, named after all key attributes.
+        std::ostringstream idxStr;
+        idxStr << relationName;
+        for(size_t i = 0; i < keyColumns.size(); i++)
+            idxStr << '.' << keyColumns[i].offset;
+        outIndexName = idxStr.str();
+        openIndex(relationName, outIndexName, leafFormat, payloadColumns, bloomBitsPerKey, countEntries);
+    }
+
+    /**
+     * The constructors once the attributes of the key are set: open or create the index file and insert entries
+     * for every tuple in the base relation.
+     * @param relationName
+     * @param indexName			Name of the index file
+     * @param leafFormat
+     * @param payloadColumns
+     * @param bloomBitsPerKey	Bits per entry of the Bloom filter built once the tuples are in, if the index is created
+     * @param countEntries
+     * @throws  BadIndexInfoException If the payload columns are too many, too long or out of range, or bloomBitsPerKey is negative.
+     */
+    void BTreeIndex::openIndex(const std::string & relationName, const std::string & indexName, const LeafFormat leafFormat,
+                               const std::vector<PayloadColumn> & payloadColumns, int bloomBitsPerKey, bool countEntries)
+    {
+        rightmostVersion = 0;
+        eytzingerCache = nullptr;
+        this->bloomBitsPerKey = 0;
+        bloomCapacity = 0;
+        pinnedLevels = 0;
+        numOpenScans = 0;
+        for(int i = 0; i < PINNEDSLOTS; i++){
+            pinnedPages[i].pageNo = MAX_PAGEID;
+            pinnedPages[i].page = nullptr;
+        }
+        insertBufferCapacity = 0;
+        insertBufferGeneration = 0;
+        nodeBuffering = false;
+        backgroundMerge = mergeRequested = stopMerging = false;
+        // only INTEGER keys have a packed layout.
+        this->leafFormat = leafFormat == PACKED_LEAVES && attributeType != INTEGER ? ARRAY_LEAVES : leafFormat;
+        this->countEntries = countEntries;
+        // payload columns make the index covering, and only covering indexes have covering leaves.
+        if(payloadColumns.size() > (size_t)MAXPAYLOADCOLUMNS)
+            throw BadIndexInfoException("Too many payload columns");
+        this->payloadColumns = payloadColumns;
+        payloadLength = 0;
+        for(size_t i = 0; i < payloadColumns.size(); i++){
+            if(payloadColumns[i].offset < 0 || payloadColumns[i].length < 1)
+                throw BadIndexInfoException("Payload column out of range");
+            payloadLength += payloadColumns[i].length;
+        }
+        if(payloadLength > MAXPAYLOADLENGTH)
+            throw BadIndexInfoException("Payload columns too long");
+        if(bloomBitsPerKey < 0)
+            throw BadIndexInfoException("Negative Bloom filter size");
+        if(!payloadColumns.empty())
+            this->leafFormat = COVERING_LEAVES;
+        else if(this->leafFormat == COVERING_LEAVES)
+            this->leafFormat = ARRAY_LEAVES;
+        // set up index file.
+        bool created = false;
+        if(BlobFile::exists(indexName)){
+            // index file exists.
+            file = new BlobFile(indexName, false);
+            headerPageNum = file->getFirstPageNo();
+            Page *metaPage;
+            bufMgr->readPage(file, headerPageNum, metaPage);
+            bufMgr->unPinPage(file, headerPageNum, false);
+            // set up insert related global vars.
+            IndexMetaInfo *metaInfo = (IndexMetaInfo*)metaPage;
+            rootPageNum = metaInfo->rootPageNo;
+            leafOccupancy = metaInfo->leafOccupancy;
+            nodeOccupancy = metaInfo->nodeOccupancy;
+            depth = metaInfo->depth;
+            freePageNum = metaInfo->freePageNo;
+            this->leafFormat = metaInfo->leafFormat;
+            this->payloadColumns.assign(metaInfo->payloadColumns, metaInfo->payloadColumns + metaInfo->numPayloadColumns);
+            payloadLength = 0;
+            for(size_t i = 0; i < this->payloadColumns.size(); i++)
+                payloadLength += this->payloadColumns[i].length;
+            keyColumns.assign(metaInfo->keyColumns, metaInfo->keyColumns + metaInfo->numKeyColumns);
+            bloomPages.assign(metaInfo->bloomPageNos, metaInfo->bloomPageNos + metaInfo->numBloomPages);
+            this->bloomBitsPerKey = metaInfo->bloomBitsPerKey;
+            bloomCapacity = metaInfo->bloomCapacity;
+            this->countEntries = metaInfo->countEntries;
+            // nonleaves that still hold buffered entries keep buffering inserts, so no insert splits them under a
+            // shared treeLatch.
+            for(PageId pageNo = metaInfo->nodeBufferPageNo; pageNo != MAX_PAGEID; ){
+                Page *page;
+                bufMgr->readPage(file, pageNo, page);
+                NodeBufferPage *bufferPage = (NodeBufferPage*)page;
+                NodeBuffer buffer;
+                buffer.pageNo = pageNo;
+                buffer.height = bufferPage->height;
+                nodeBuffers[bufferPage->nodePageNo] = buffer;
+                PageId nextPageNo = bufferPage->nextPageNo;
+                bufMgr->unPinPage(file, pageNo, false);
+                pageNo = nextPageNo;
+            }
+            nodeBuffering = !nodeBuffers.empty();
+        } else{
+            // index file doesn't exist.
+            created = true;
+            file =  new BlobFile(indexName, true);
+            Page *metaPage, *rootPage;
+            PageId newRootPageNum;
+            bufMgr->allocPage(file, headerPageNum, metaPage);
+            bufMgr->allocPage(file, newRootPageNum, rootPage);
+            rootPageNum = newRootPageNum;
+            // set up global var.
+            leafOccupancy = 0;
+            nodeOccupancy = 0;
+            depth = 0;
+            freePageNum = MAX_PAGEID;
+            // set up meta info.
+            IndexMetaInfo *metaInfo = (IndexMetaInfo*)metaPage;
+            strcpy(metaInfo->relationName, relationName.c_str());
+            metaInfo->nodeBufferPageNo = MAX_PAGEID;
+            bufMgr->unPinPage(file, headerPageNum, true);
+            // set up root node.
+            switch(attributeType){
+                case INTEGER: ((LeafNodeInt*)rootPage)->init(MAX_PAGEID, this->leafFormat, payloadLength); break;
+                case DOUBLE: ((LeafNodeDouble*)rootPage)->init(MAX_PAGEID, this->leafFormat, payloadLength); break;
+                case STRING: ((LeafNodeString*)rootPage)->init(MAX_PAGEID, this->leafFormat, payloadLength); break;
+                case COMPOSITE: ((LeafNodeComposite*)rootPage)->init(MAX_PAGEID, this->leafFormat, payloadLength); break;
+            }
+            bufMgr->unPinPage(file, rootPageNum, true);
+        }
+        // insert all tuples in relation file to this BTree.
+        FileScan fscan = FileScan(relationName, bufMgr);
+        try{
+            RecordId scanRid;
+            while(1){
+                fscan.scanNext(scanRid);
+                std::string recordStr = fscan.getRecord();
+                insertRecord(recordStr.c_str(), scanRid);
+            }
+        } catch(const EndOfFileException &e){
+        }
+        // the filter of a new index is sized for the tuples just inserted, later inserts add to it.
+        if(created && bloomBitsPerKey > 0){
+            this->bloomBitsPerKey = bloomBitsPerKey;
+            switch(attributeType){
+                case INTEGER: buildBloomFilter<int>(leafOccupancy); break;
+                case DOUBLE: buildBloomFilter<double>(leafOccupancy); break;
+                case STRING: buildBloomFilter<StringKey>(leafOccupancy); break;
+                case COMPOSITE: buildBloomFilter<CompositeKey>(leafOccupancy); break;
+            }
+        }
+    }
+
+    /**
+     * BTreeIndex Destructor.
+     * End any initialized scan, flush index file, after unpinning any pinned pages, from the buffer manager
+     * and delete file instance thereby closing the index file.
+     * Destructor should not throw any exceptions. All exceptions should be caught in here itself.
+     */
+    BTreeIndex::~BTreeIndex()
+    {
+        // Add your code below. Please do not remove this line.
+        // end possible scan.
+        if(scanCursor.isExecuting()) endScan();
+        // merge the inserts still in the buffer, into the message buffers if the nonleaves have them.
+        stopMergeThread();
+        flushInsertBuffer(true);
+        delete eytzingerCache;
+        unpinIndexPages();
+        // the message buffers stay in the file, on a list from the meta page.
+        PageId nodeBufferPageNo = MAX_PAGEID;
+        for(std::map<PageId, NodeBuffer>::const_iterator it = nodeBuffers.begin(); it != nodeBuffers.end(); ++it){
+            Page *page;
+            bufMgr->readPage(file, it->second.pageNo, page);
+            ((NodeBufferPage*)page)->nextPageNo = nodeBufferPageNo;
+            bufMgr->unPinPage(file, it->second.pageNo, true);
+            nodeBufferPageNo = it->second.pageNo;
+        }
+        // update meta page.
+        Page *metaPage;
+        bufMgr->readPage(file, headerPageNum, metaPage);
+        IndexMetaInfo *metaInfo = (IndexMetaInfo*)metaPage;
+        metaInfo->attrType = attributeType;
+        metaInfo->attrByteOffset = attrByteOffset;
+        metaInfo->rootPageNo = rootPageNum;
+        metaInfo->leafOccupancy = leafOccupancy;
+        metaInfo->nodeOccupancy = nodeOccupancy;
+        metaInfo->depth = depth;
+        metaInfo->freePageNo = freePageNum;
+        metaInfo->leafFormat = leafFormat;
+        metaInfo->numPayloadColumns = payloadColumns.size();
+        std::copy(payloadColumns.begin(), payloadColumns.end(), metaInfo->payloadColumns);
+        metaInfo->numKeyColumns = keyColumns.size();
+        std::copy(keyColumns.begin(), keyColumns.end(), metaInfo->keyColumns);
+        metaInfo->numBloomPages = bloomPages.size();
+        metaInfo->bloomBitsPerKey = bloomBitsPerKey;
+        metaInfo->bloomCapacity = bloomCapacity;
+        metaInfo->countEntries = countEntries;
+        metaInfo->nodeBufferPageNo = nodeBufferPageNo;
+        std::copy(bloomPages.begin(), bloomPages.end(), metaInfo->bloomPageNos);
+        bufMgr->unPinPage(file, headerPageNum, true);
+        // flush index file.
+        bufMgr->flushFile(file);
+        // delete index file.
+        delete file;
+    }
+
+    /**
+     * Print the statistics about this Tree.
+     */
+    void BTreeIndex::printTreeStatus(){
+        printf("Tree Status: \n");
+        Page *metaPage;
+        bufMgr->readPage(file, headerPageNum, metaPage);
+        bufMgr->unPinPage(file, headerPageNum, false);
+        IndexMetaInfo *metaInfo = (IndexMetaInfo*)metaPage;
+        printf("\trelationName: %s\n", metaInfo->relationName);
+        printf("\tdepth: %d\n", depth.load());
+        printf("\theaderPageNum: %d\n", headerPageNum);
+        printf("\trootPageNum: %d\n", rootPageNum.load());
+        printf("\tleafOccupancy: %d\n", leafOccupancy.load());
+        printf("\tnodeOccupancy: %d\n", nodeOccupancy.load());
+        printf("\tINTARRAYNONLEAFSIZE: %d\n", INTARRAYNONLEAFSIZE);
+        printf("\tINTARRAYLEAFSIZE: %d\n", INTARRAYLEAFSIZE);
+    }
+
+    /**
+     * Print the statistics of a node. Recognize node type within method.
+     * @param id
+     * @param page
+     */
+    template <class T>
+    void BTreeIndex::printNode(PageId id, Page* page){
+        Nodetype type = *(Nodetype*)page;
+        if(type == NONLEAF || type == COUNTEDNONLEAF){
+            NonLeafNode<T> *node = (NonLeafNode<T>*)page;
+            std::cout << "Internal node " << id << " Stats:" << std::endl;
+            std::cout << "\tsize: " << node->size << std::endl;
+            if(node->size != 0)
+                std::cout << "\tminKey: " << node->key(0) << " maxKey: " << node->key(node->size - 1) << std::endl;
+            std::cout << "\tkeyArray: ";
+            for(int i = 0; i < node->size; i++)
+                std::cout << node->key(i) << " ";
+            std::cout << std::endl;
+            std::cout << "\tchildren: ";
+            for(int i = 0; i < node->size + 1; i++)
+                std::cout << node->child(i) << " ";
+            std::cout << std::endl;
+        } else{
+            LeafNode<T> *node = (LeafNode<T>*)page;
+            std::cout << "Leaf node " << id << " Stats:" << std::endl;
+            std::cout << "\tsize: " << node->size << std::endl;
+            if(node->size != 0)
+                std::cout << "\tminKey: " << node->key(0) << " maxKey: " << node->key(node->size - 1) << std::endl;
+            std::cout << "\trightSib: " << node->rightSibPageNo << std::endl;
+            std::cout << "\tkeyArray: ";
+            for(int i = 0; i < node->size; i++)
+                std::cout << node->key(i) << " ";
+            std::cout << std::endl;
+        }
+    }
+
+    /**
+     * The cached rightmost path for key type T, one of rightmostPathInt, rightmostPathDouble and rightmostPathString.
+     */
+    template <>
+    std::vector<PathEntry<int> >& BTreeIndex::rightmostPath<int>(){
+        return rightmostPathInt;
+    }
+
+    template <>
+    std::vector<PathEntry<double> >& BTreeIndex::rightmostPath<double>(){
+        return rightmostPathDouble;
+    }
+
+    template <>
+    std::vector<PathEntry<StringKey> >& BTreeIndex::rightmostPath<StringKey>(){
+        return rightmostPathString;
+    }
+
+    template <>
+    std::vector<PathEntry<CompositeKey> >& BTreeIndex::rightmostPath<CompositeKey>(){
+        return rightmostPathComposite;
+    }
+
+    /**
+     * The insert buffer for key type T, one of insertBufferInt, insertBufferDouble, insertBufferString and
+     * insertBufferComposite.
+     */
+    template <>
+    DeltaStore<int>& BTreeIndex::insertBuffer<int>(){
+        return insertBufferInt;
+    }
+
+    template <>
+    DeltaStore<double>& BTreeIndex::insertBuffer<double>(){
+        return insertBufferDouble;
+    }
+
+    template <>
+    DeltaStore<StringKey>& BTreeIndex::insertBuffer<StringKey>(){
+        return insertBufferString;
+    }
+
+    template <>
+    DeltaStore<CompositeKey>& BTreeIndex::insertBuffer<CompositeKey>(){
+        return insertBufferComposite;
+    }
+
+    /**
+     * Check that T is the key type of the index.
+     * @throws  BadIndexInfoException If the index is built over an attribute of another type.
+     */
+    template <class T>
+    void BTreeIndex::checkKeyType(){
+        if(KeyTraits<T>::TYPE != attributeType)
+            throw BadIndexInfoException("Key type does not match the attribute type of the index");
+    }
+
+    /**
+     * Push the root onto the empty path.
+     * @param path
+     */
+    template <class T>
+    void BTreeIndex::pushRoot(std::vector<PathEntry<T> > &path, PageId pageNo, bool isLeaf){
+        PathEntry<T> root;
+        root.pageNo = pageNo;
+        root.childIndex = 0;
+        root.isLeaf = isLeaf;
+        root.hasLow = root.hasHigh = false;
+        root.low = root.high = T();
+        path.push_back(root);
+    }
+
+    /**
+     * Descend from the root to the leaf key is routed to with optimistic lock coupling: nonleaves are read
+     * without latching them and validated against their versions once the child is known and pinned, and the
+     * descent starts over from the root if any of them changed. The leaf is left pinned and latched.
+     * @param key
+     * @param exclusive		True to latch the leaf exclusively
+     * @param leafPage		Receives the pinned leaf
+     * @param path			Receives the root-to-leaf path, if not null
+     * @param last			True to descend to the last leaf that may hold key rather than the first
+     * @return Page number of the leaf.
+     */
+    template <class T>
+    int BTreeIndex::childIndex(const NonLeafNode<T>* node, const Page* page, std::uint32_t version, const T& key, bool last){
+        return last ? node->upperBound(key) : node->lowerBound(key);
+    }
+
+    template <>
+    int BTreeIndex::childIndex<int>(const NonLeafNodeInt* node, const Page* page, std::uint32_t version, const int& key, bool last){
+        if(eytzingerCache != nullptr)
+            return eytzingerCache->searchNode(page, version, node, key, last, bufMgr);
+        return last ? node->upperBound(key) : node->lowerBound(key);
+    }
+
+    template <class T>
+    PageId BTreeIndex::latchLeaf(const T& key, bool exclusive, Page *&leafPage, std::vector<PathEntry<T> > *path, bool last){
+        while(1){
+            PageId pageNo = rootPageNum;
+            Page *page;
+            bool pinned = readIndexPage(pageNo, page);
+            // only deletes, which run alone, change what kind of node a page holds.
+            Nodetype type = ((NonLeafNode<T>*)page)->type;
+            bool isLeaf = type != NONLEAF && type != COUNTEDNONLEAF;
+            // the leaf goes back to the caller, who unpins it, so it gets a pin of its own even if a page that
+            // left the tree was kept pinned in its frame.
+            if(isLeaf && pinned){
+                bufMgr->readPage(file, pageNo, page);
+                pinned = false;
+            }
+            if(path != nullptr){
+                path->clear();
+                pushRoot(*path, pageNo, isLeaf);
+            }
+            if(isLeaf){
+                bufMgr->latchPage(page, exclusive);
+                // a root that split before it was latched is no longer the root.
+                if(rootPageNum == pageNo){
+                    leafPage = page;
+                    return pageNo;
+                }
+                bufMgr->unlatchPage(page, exclusive);
+                releaseIndexPage(pageNo, pinned);
+                continue;
+            }
+            std::uint32_t version = bufMgr->readVersion(page);
+            bool restart = rootPageNum != pageNo || (pinned && !pinValid(pageNo, page));
+            while(!restart && !isLeaf){
+                NonLeafNode<T> *node = (NonLeafNode<T>*)page;
+                PageId childPageNo = MAX_PAGEID;
+                if(node->plausible()){
+                    // equal keys descend to the left, or to the right for last, duplicates of a separator may sit
+                    // on both sides of it.
+                    int index = childIndex(node, page, version, key, last);
+                    if(path != nullptr)
+                        descendChild(*path, node, index);
+                    childPageNo = node->child(index);
+                    isLeaf = node->level == 1;
+                }
+                // until the node is validated its child may be garbage, not a page of the tree.
+                if(!bufMgr->validateVersion(page, version)){
+                    restart = true;
+                    break;
+                }
+                Page *childPage;
+                bool childPinned = false;
+                if(isLeaf)
+                    bufMgr->readPage(file, childPageNo, childPage);
+                else
+                    childPinned = readIndexPage(childPageNo, childPage);
+                std::uint32_t childVersion = 0;
+                if(isLeaf)
+                    bufMgr->latchPage(childPage, exclusive);
+                else
+                    childVersion = bufMgr->readVersion(childPage);
+                // the child may have split, and the key moved to a new sibling, before it was latched or read,
+                // and the frame of a child taken from a slot may have been given to another page.
+                if(!bufMgr->validateVersion(page, version) || (childPinned && !pinValid(childPageNo, childPage))){
+                    if(isLeaf)
+                        bufMgr->unlatchPage(childPage, exclusive);
+                    releaseIndexPage(childPageNo, childPinned);
+                    restart = true;
+                    break;
+                }
+                releaseIndexPage(pageNo, pinned);
+                pageNo = childPageNo;
+                page = childPage;
+                pinned = childPinned;
+                version = childVersion;
+            }
+            if(!restart){
+                leafPage = page;
+                return pageNo;
+            }
+            releaseIndexPage(pageNo, pinned);
+        }
+    }
+
+    /**
+     * Descend from the root to the leaf key is routed to, latching every node on the way exclusively. A split
+     * below a nonleaf that hasRoom() stops there, so once one is latched its ancestors are unlatched and unpinned.
+     * @param path			Receives the root-to-leaf path
+     * @param key
+     * @param pages			Receives the pinned pages of path, root first
+     * @return Index in path of the first node still latched and pinned; those before it are released.
+     */
+    template <class T>
+    size_t BTreeIndex::latchPath(std::vector<PathEntry<T> > &path, const T& key, std::vector<Page*> &pages){
+        PageId pageNo;
+        Page *page;
+        while(1){
+            pageNo = rootPageNum;
+            bufMgr->readPage(file, pageNo, page);
+            bufMgr->latchPage(page, true);
+            // a root that split before it was latched is no longer the root.
+            if(rootPageNum == pageNo)
+                break;
+            bufMgr->unlatchPage(page, true);
+            bufMgr->unPinPage(file, pageNo, false);
+        }
+        Nodetype type = ((NonLeafNode<T>*)page)->type;
+        path.clear();
+        pages.clear();
+        pushRoot(path, pageNo, type != NONLEAF && type != COUNTEDNONLEAF);
+        pages.push_back(page);
+        size_t first = 0;
+        while(!path.back().isLeaf){
+            NonLeafNode<T> *node = (NonLeafNode<T>*)page;
+            descendChild(path, node, node->lowerBound(key));
+            bufMgr->readPage(file, path.back().pageNo, page);
+            bufMgr->latchPage(page, true);
+            pages.push_back(page);
+            if(path.back().isLeaf || !((NonLeafNode<T>*)page)->hasRoom())
+                continue;
+            for(; first + 1 < path.size(); first++){
+                bufMgr->unlatchPage(pages[first], true);
+                bufMgr->unPinPage(file, path[first].pageNo, false);
+            }
+        }
+        return first;
+    }
+
+    /**
+     * Allocate a page for a new node, taking it off the free list if there is one there.
+     * The page comes back pinned.
+     * @param pageNo
+     * @param page
+     */
+    void BTreeIndex::allocIndexPage(PageId &pageNo, Page *&page){
+        std::lock_guard<std::mutex> guard(allocMutex);
+        if(freePageNum == MAX_PAGEID){
+            bufMgr->allocPage(file, pageNo, page);
+            return;
+        }
+        pageNo = freePageNum;
+        bufMgr->readPage(file, pageNo, page);
+        freePageNum = ((FreePage*)page)->nextFreePageNo;
+    }
+
+    /**
+     * Put a page that no longer belongs to the tree on the free list.
+     * BlobFile cannot delete pages, so the index file keeps its size and recycles them instead.
+     * @param pageNo
+     */
+    void BTreeIndex::freeIndexPage(PageId pageNo){
+        Page *page;
+        unpinIndexPage(pageNo);
+        bufMgr->readPage(file, pageNo, page);
+        std::lock_guard<std::mutex> guard(allocMutex);
+        ((FreePage*)page)->nextFreePageNo = freePageNum;
+        bufMgr->unPinPage(file, pageNo, true);
+        freePageNum = pageNo;
+    }
+
+    void BTreeIndex::pinIndexPage(PageId pageNo){
+        PinnedPage *freeSlot = nullptr;
+        for(int i = 0; i < PINNEDPROBES; i++){
+            PinnedPage &slot = pinnedPages[(pageNo + i) % PINNEDSLOTS];
+            PageId slotPageNo = slot.pageNo.load(std::memory_order_relaxed);
+            if(slotPageNo == pageNo)
+                return;
+            if(slotPageNo == MAX_PAGEID && freeSlot == nullptr)
+                freeSlot = &slot;
+        }
+        if(freeSlot == nullptr)
+            return;
+        Page *page;
+        bufMgr->readPage(file, pageNo, page);
+        freeSlot->page.store(page, std::memory_order_relaxed);
+        freeSlot->pageNo.store(pageNo, std::memory_order_release);
+    }
+
+    void BTreeIndex::unpinIndexPage(PageId pageNo){
+        for(int i = 0; i < PINNEDPROBES; i++){
+            PinnedPage &slot = pinnedPages[(pageNo + i) % PINNEDSLOTS];
+            if(slot.pageNo.load(std::memory_order_relaxed) == pageNo){
+                // the page is unpinned only after the slot is emptied, so a descent that still finds pageNo
+                // here after reading the version of the frame reads the page itself.
+                slot.pageNo.store(MAX_PAGEID, std::memory_order_relaxed);
+                bufMgr->unPinPage(file, pageNo, false);
+                return;
+            }
+        }
+    }
+
+    void BTreeIndex::unpinIndexPages(){
+        for(int i = 0; i < PINNEDSLOTS; i++){
+            PageId pageNo = pinnedPages[i].pageNo.load(std::memory_order_relaxed);
+            if(pageNo != MAX_PAGEID)
+                unpinIndexPage(pageNo);
+        }
+    }
+
+    template <class T>
+    void BTreeIndex::pinUpperLevels(){
+        // level by level from the root, the children of the last level pinned and of the lowest nonleaves
+        // are not opened.
+        PageId rootNo = rootPageNum;
+        std::vector<PageId> nonLeaves, level(1, rootNo), below;
+        for(int i = 0; i < pinnedLevels && !level.empty(); i++){
+            below.clear();
+            for(size_t j = 0; j < level.size(); j++){
+                Page *page;
+                bufMgr->readPage(file, level[j], page);
+                bufMgr->latchPage(page, false);
+                NonLeafNode<T> *node = (NonLeafNode<T>*)page;
+                if(node->type == NONLEAF || node->type == COUNTEDNONLEAF){
+                    nonLeaves.push_back(level[j]);
+                    for(int k = 0; i + 1 < pinnedLevels && node->level != 1 && k <= node->size; k++)
+                        below.push_back(node->child(k));
+                }
+                bufMgr->unlatchPage(page, false);
+                bufMgr->unPinPage(file, level[j], false);
+            }
+            level.swap(below);
+        }
+        std::lock_guard<std::mutex> guard(pinMutex);
+        if(rootPageNum != rootNo)
+            return;
+        unpinIndexPages();
+        for(size_t i = 0; i < nonLeaves.size(); i++)
+            pinIndexPage(nonLeaves[i]);
+    }
+
+    bool BTreeIndex::readIndexPage(PageId pageNo, Page *&page){
+        for(int i = 0; i < PINNEDPROBES; i++){
+            const PinnedPage &slot = pinnedPages[(pageNo + i) % PINNEDSLOTS];
+            if(slot.pageNo.load(std::memory_order_acquire) == pageNo){
+                page = slot.page.load(std::memory_order_relaxed);
+                return true;
+            }
+        }
+        bufMgr->readPage(file, pageNo, page);
+        return false;
+    }
+
+    bool BTreeIndex::pinValid(PageId pageNo, const Page* page) const{
+        std::atomic_thread_fence(std::memory_order_acquire);
+        for(int i = 0; i < PINNEDPROBES; i++){
+            const PinnedPage &slot = pinnedPages[(pageNo + i) % PINNEDSLOTS];
+            if(slot.pageNo.load(std::memory_order_relaxed) == pageNo)
+                return slot.page.load(std::memory_order_relaxed) == page;
+        }
+        return false;
+    }
+
+    void BTreeIndex::releaseIndexPage(PageId pageNo, bool pinned){
+        if(!pinned)
+            bufMgr->unPinPage(file, pageNo, false);
+    }
+
+    /**
+     * Odd multipliers that pick the bit of a key in each word of its Bloom filter block from the low half of its hash.
+     */
+    static const std::uint32_t bloomSalts[BLOOMBLOCKWORDS] = {
+        0x47b6137bu, 0x44974d91u, 0x8824ad5bu, 0xa2b7289du, 0x705495c7u, 0x2df1424bu, 0x9efc4947u, 0x5c6bfb31u
+    };
+
+    template <class T>
+    void BTreeIndex::buildBloomFilter(int numKeys){
+        for(size_t i = 0; i < bloomPages.size(); i++)
+            freeIndexPage(bloomPages[i]);
+        bloomPages.clear();
+        long numBits = std::max(1L, (long)numKeys) * bloomBitsPerKey;
+        long numPages = (numBits + Page::SIZE * 8 - 1) / (Page::SIZE * 8);
+        numPages = std::min((long)MAXBLOOMPAGES, std::max(1L, numPages));
+        // a filter of the largest size is never replaced.
+        bloomCapacity = numPages == MAXBLOOMPAGES ? INT_MAX : numPages * Page::SIZE * 8 / bloomBitsPerKey;
+        for(long i = 0; i < numPages; i++){
+            PageId pageNo;
+            Page *page;
+            allocIndexPage(pageNo, page);
+            std::memset(((BloomPage*)page)->words, 0, sizeof(BloomPage));
+            bufMgr->unPinPage(file, pageNo, true);
+            bloomPages.push_back(pageNo);
+        }
+        // add the keys leaf by leaf, from the leftmost leaf.
+        PageId pageNo = rootPageNum;
+        Page *page;
+        for(int level = depth; level > 0; level--){
+            bufMgr->readPage(file, pageNo, page);
+            PageId childPageNo = ((NonLeafNode<T>*)page)->child(0);
+            bufMgr->unPinPage(file, pageNo, false);
+            pageNo = childPageNo;
+        }
+        while(pageNo != MAX_PAGEID){
+            bufMgr->readPage(file, pageNo, page);
+            LeafNode<T> *node = (LeafNode<T>*)page;
+            for(int i = 0; i < node->size; i++)
+                addToBloomFilter(node->key(i));
+            PageId nextPageNo = node->rightSibPageNo;
+            bufMgr->unPinPage(file, pageNo, false);
+            pageNo = nextPageNo;
+        }
+        // and the keys still waiting in the insert buffer and the message buffers.
+        for(const typename DeltaStore<T>::Node *node = insertBuffer<T>().first(); node != nullptr; node = node->successor(0))
+            addToBloomFilter(node->entry.key);
+        for(std::map<PageId, NodeBuffer>::const_iterator it = nodeBuffers.begin(); it != nodeBuffers.end(); ++it){
+            bufMgr->readPage(file, it->second.pageNo, page);
+            NodeBufferPage *bufferPage = (NodeBufferPage*)page;
+            for(int i = 0; i < bufferPage->size; i++)
+                addToBloomFilter(bufferPage->entries<T>()[i].key);
+            bufMgr->unPinPage(file, it->second.pageNo, false);
+        }
+    }
+
+    void BTreeIndex::growBloomFilter(){
+        if(bloomBitsPerKey == 0 || leafOccupancy <= bloomCapacity)
+            return;
+        EpochGuard treeGuard(treeLatch, true);
+        // another insert may have grown it meanwhile.
+        if(leafOccupancy <= bloomCapacity)
+            return;
+        switch(attributeType){
+            case INTEGER: buildBloomFilter<int>(2 * leafOccupancy); break;
+            case DOUBLE: buildBloomFilter<double>(2 * leafOccupancy); break;
+            case STRING: buildBloomFilter<StringKey>(2 * leafOccupancy); break;
+            case COMPOSITE: buildBloomFilter<CompositeKey>(2 * leafOccupancy); break;
+        }
+    }
+
+    std::uint64_t* BTreeIndex::readBloomBlock(std::uint64_t hash, PageId &pageNo){
+        // the high half of the hash picks the block, scaled to the number of blocks instead of taken modulo.
+        std::uint64_t numBlocks = bloomPages.size() * BLOOMBLOCKSPERPAGE;
+        std::uint64_t block = ((hash >> 32) * numBlocks) >> 32;
+        pageNo = bloomPages[block / BLOOMBLOCKSPERPAGE];
+        Page *page;
+        bufMgr->readPage(file, pageNo, page);
+        return ((BloomPage*)page)->words + block % BLOOMBLOCKSPERPAGE * BLOOMBLOCKWORDS;
+    }
+
+    template <class T>
+    void BTreeIndex::addToBloomFilter(const T& key){
+        std::uint64_t hash = keyHash(key);
+        PageId pageNo;
+        std::uint64_t *words = readBloomBlock(hash, pageNo);
+        for(int i = 0; i < BLOOMBLOCKWORDS; i++)
+            __atomic_fetch_or(&words[i], std::uint64_t(1) << (((std::uint32_t)hash * bloomSalts[i]) >> 26), __ATOMIC_RELAXED);
+        bufMgr->unPinPage(file, pageNo, true);
+    }
+
+    template <class T>
+    bool BTreeIndex::mayContainTyped(const T& key){
+        if(bloomPages.empty())
+            return true;
+        std::uint64_t hash = keyHash(key);
+        PageId pageNo;
+        const std::uint64_t *words = readBloomBlock(hash, pageNo);
+        bool found = true;
+        for(int i = 0; i < BLOOMBLOCKWORDS && found; i++){
+            std::uint64_t bit = std::uint64_t(1) << (((std::uint32_t)hash * bloomSalts[i]) >> 26);
+            found = (__atomic_load_n(&words[i], __ATOMIC_RELAXED) & bit) != 0;
+        }
+        bufMgr->unPinPage(file, pageNo, false);
+        return found;
+    }
+
+    /**
+     * Allocate a new root above leftPageNo and rightPageNo, separated by key. All keys in leftPage are smaller than
+     * those in the right page.
+     * @param key
+     * @param leftPageNo
+     * @param leftCount		Number of leaf entries below leftPageNo
+     * @param rightPageNo
+     * @param rightCount		Number of leaf entries below rightPageNo
+     * @param level			1 if the children are leaves, 0 otherwise
+     */
+    template <class T>
+    void BTreeIndex::insertNewRoot(const T& key, PageId leftPageNo, std::uint32_t leftCount, PageId rightPageNo, std::uint32_t rightCount, int level){
+        PageId newRootPageNum;
+        Page *rootPage;
+        allocIndexPage(newRootPageNum, rootPage);
+        NonLeafNode<T> *rootNode = (NonLeafNode<T>*)rootPage;
+        rootNode->init(level, leftPageNo, leftCount, countEntries);
+        rootNode->insert(0, key, rightPageNo, rightCount);
+        bufMgr->unPinPage(file, newRootPageNum, true);
+        nodeOccupancy++;
+        depth++;
+        // descents that read the new number find the root filled in. The pinned levels moved one level down,
+        // the insert pins them again from the new root once it has released its latches.
+        rootPageNum = newRootPageNum;
+    }
+
+    /**
+     * Insert key and the new right sibling pageNo of the child at childIndex into the nonleaf at the end
+     * of path, or into a new root if path is empty. Full nonleaves are split in place and the split is
+     * propagated further up the path.
+     * @param path
+     * @param childIndex
+     * @param leftCount		Number of leaf entries left below the child at childIndex
+     * @param key
+     * @param pageNo
+     * @param count			Number of leaf entries below pageNo
+     * @param level			1 if pageNo is a leaf, 0 otherwise
+     */
+    template <class T>
+    void BTreeIndex::insertNonLeaf(std::vector<PathEntry<T> > &path, int childIndex, std::uint32_t leftCount, const T& key, PageId pageNo, std::uint32_t count, int level){
+        if(path.empty()){
+            insertNewRoot(key, rootPageNum, leftCount, pageNo, count, level);
+            return;
+        }
+        PathEntry<T> target = path.back();
+        path.pop_back();
+        Page *targetPage;
+        bufMgr->readPage(file, target.pageNo, targetPage);
+        NonLeafNode<T> *targetNode = (NonLeafNode<T>*)targetPage;
+        // the new sibling goes right after the child that split, its separator in front of it. The entries
+        // of the child are only divided between the two, so the counts above this node stay as they are.
+        int pos = childIndex;
+        targetNode->setCount(childIndex, leftCount);
+        if(targetNode->insert(pos, key, pageNo, count)){
+            nodeOccupancy++;
+            bufMgr->unPinPage(file, target.pageNo, true);
+            return;
+        }
+
+        // split: the lower keys stay in place, the upper ones are moved to a new right sibling and
+        // the middle key moves up into the parent. Appending to the right edge of the tree keeps
+        // the node full, nothing will land left of key again.
+        Page *newPage;
+        PageId newPageNo;
+        allocIndexPage(newPageNo, newPage);
+        NonLeafNode<T> *newNode = (NonLeafNode<T>*)newPage;
+        T midKey = targetNode->split(newNode, pos, key, pageNo, count, !target.hasHigh && pos == targetNode->size);
+        std::uint32_t targetCount = targetNode->total(), newCount = newNode->total();
+        bufMgr->unPinPage(file, target.pageNo, true);
+        bufMgr->unPinPage(file, newPageNo, true);
+        if(!nodeBuffers.empty())
+            splitNodeBuffer(target.pageNo, newPageNo, midKey);
+        // path now holds the ancestors of the node, as many as its level lies below the root.
+        if((int)path.size() < pinnedLevels){
+            std::lock_guard<std::mutex> guard(pinMutex);
+            pinIndexPage(newPageNo);
+        }
+        insertNonLeaf(path, target.childIndex, targetCount, midKey, newPageNo, newCount, 0);
+    }
+
+    /**
+     * Add delta to the entry counts that the nonleaves on the root-to-leaf path keep for the path below them.
+     * Inserts that only latch their leaf count their entry concurrently, so the counts are updated atomically,
+     * and without new page versions, which would send optimistic descents through the nonleaves back to the root.
+     * Does nothing if the index does not count entries.
+     * @param path
+     * @param delta
+     */
+    template <class T>
+    void BTreeIndex::countPath(const std::vector<PathEntry<T> > &path, int delta){
+        if(!countEntries)
+            return;
+        for(size_t i = 0; i + 1 < path.size(); i++){
+            Page *page;
+            bufMgr->readPage(file, path[i].pageNo, page);
+            ((NonLeafNode<T>*)page)->addCount(path[i + 1].childIndex, delta);
+            bufMgr->markDirty(page);
+            bufMgr->unPinPage(file, path[i].pageNo, false);
+        }
+    }
+
+    /**
+     * Insert the key-rid pair into the leaf at the end of path. If the leaf is full it is split in place
+     * and the split is propagated to the ancestors recorded on the path.
+     * @param path
+     * @param key
+     * @param rid
+     * @param payload
+     */
+    template <class T>
+    void BTreeIndex::insertLeaf(std::vector<PathEntry<T> > &path, const T& key, const RecordId rid, const char* payload){
+        countPath(path, 1);
+        PathEntry<T> target = path.back();
+        path.pop_back();
+        Page *targetPage;
+        bufMgr->readPage(file, target.pageNo, targetPage);
+        LeafNode<T> *targetNode = (LeafNode<T>*)targetPage;
+        leafOccupancy++;
+        // find the target index that maintains the ascending order upon inserting new key.
+        int pos = targetNode->lowerBound(0, key);
+        if(targetNode->insert(pos, key, rid, payload)){
+            bufMgr->unPinPage(file, target.pageNo, true);
+            return;
+        }
+
+        // split: the lower entries stay in place, the rest are moved to a new right sibling and a
+        // separator between the two goes into the parent. Appending to the rightmost leaf keeps it
+        // full and starts the new leaf with key alone, so ascending inserts leave every leaf but the
+        // last one completely filled.
+        Page *newPage;
+        PageId newPageNo;
+        allocIndexPage(newPageNo, newPage);
+        LeafNode<T> *newNode = (LeafNode<T>*)newPage;
+        targetNode->split(newNode, pos, key, rid, payload, !target.hasHigh && pos == targetNode->size);
+        newNode->rightSibPageNo = targetNode->rightSibPageNo;
+        targetNode->rightSibPageNo = newPageNo;
+        T midKey = targetNode->separator(newNode);
+        std::uint32_t targetCount = targetNode->size, newCount = newNode->size;
+        bufMgr->unPinPage(file, target.pageNo, true);
+        bufMgr->unPinPage(file, newPageNo, true);
+        {
+            std::lock_guard<std::mutex> guard(pathMutex);
+            rightmostPath<T>().clear();
+            rightmostVersion++;
+        }
+        insertNonLeaf(path, target.childIndex, targetCount, midKey, newPageNo, newCount, 1);
+    }
+
+    /**
+     * Insert a new entry using the pair <value,rid>.
+     * Start from root to recursively find out the leaf to insert the entry in. The insertion may cause splitting of leaf node.
+     * This splitting will require addition of new leaf page number entry into the parent non-leaf, which may in-turn get split.
+     * This may continue all the way upto the root causing the root to get split. If root gets split, metapage needs to be changed accordingly.
+     * Make sure to unpin pages as soon as you can.
+     * The root-to-leaf path is recorded during descent, so splits reach the parents without any parent pointers
+     * and only ever touch the split node, its new sibling and the parent. Keys that belong to the rightmost leaf
+     * reuse its cached path and skip the descent.
+     * May be called from several threads at once, together with lookup() and scans through BTreeScanCursor.
+     * @param key			Key to insert, pointer to integer/double/char string
+     * @param rid			Record ID of a record whose entry is getting inserted into the index.
+     * @throws  BadIndexInfoException If the index has payload columns, whose entries are inserted through insertRecord().
+     */
+    void BTreeIndex::insertEntry(const void *key, const RecordId rid)
+    {
+        // Add your code below. Please do not remove this line.
+        if(!payloadColumns.empty())
+            throw BadIndexInfoException("Entries of a covering index need their payload columns");
+        if(insertBufferCapacity > 0){
+            int pending = 0;
+            {
+                EpochGuard treeGuard(treeLatch, false);
+                switch(attributeType){
+                    case INTEGER: pending = bufferInsert(*(const int*)key, rid); break;
+                    case DOUBLE: pending = bufferInsert(*(const double*)key, rid); break;
+                    case STRING: pending = bufferInsert(StringKey((const char*)key), rid); break;
+                    case COMPOSITE: pending = bufferInsert(compositeKey((const char*)key), rid); break;
+                }
+            }
+            if(pending >= insertBufferCapacity)
+                requestMerge(pending);
+            growBloomFilter();
+            return;
+        }
+        {
+            // inserts into the message buffers run alone.
+            EpochGuard treeGuard(treeLatch, nodeBuffering);
+            switch(attributeType){
+                case INTEGER: insertTyped(*(const int*)key, rid, nullptr); break;
+                case DOUBLE: insertTyped(*(const double*)key, rid, nullptr); break;
+                case STRING: insertTyped(StringKey((const char*)key), rid, nullptr); break;
+                case COMPOSITE: insertTyped(compositeKey((const char*)key), rid, nullptr); break;
+            }
+        }
+        growBloomFilter();
+    }
+
+    /**
+     * Insert the entry of a whole record: its key at the attribute offset of the index and, in a covering index,
+     * its payload columns.
+     * @param record		The record, as returned by FileScan::getRecord()
+     * @param rid			Record ID of the record
+     */
+    void BTreeIndex::insertRecord(const char *record, const RecordId rid)
+    {
+        {
+            EpochGuard treeGuard(treeLatch, nodeBuffering);
+            insertRecordEntry(record, rid);
+        }
+        growBloomFilter();
+    }
+
+    /**
+     * Insert the entry of record with the payload columns of the record. The caller holds treeLatch shared, or
+     * exclusively if inserts go into the message buffers.
+     * @param record
+     * @param rid
+     */
+    void BTreeIndex::insertRecordEntry(const char *record, const RecordId rid)
+    {
+        char payload[MAXPAYLOADLENGTH];
+        char *end = payload;
+        for(size_t i = 0; i < payloadColumns.size(); i++){
+            std::memcpy(end, record + payloadColumns[i].offset, payloadColumns[i].length);
+            end += payloadColumns[i].length;
+        }
+        const char *key = record + attrByteOffset;
+        switch(attributeType){
+            case INTEGER: insertTyped(*(const int*)key, rid, payload); break;
+            case DOUBLE: insertTyped(*(const double*)key, rid, payload); break;
+            case STRING: insertTyped(StringKey(key), rid, payload); break;
+            case COMPOSITE: insertTyped(compositeKey(record), rid, payload); break;
+        }
+    }
+
+    /**
+     * insertEntry() and insertRecord() once the key type of the index is known. While the nonleaves buffer
+     * inserts, the entry goes into the buffer of the root and the caller holds treeLatch exclusively. Otherwise
+     * most inserts land in a leaf with room and only latch that leaf exclusively. Those that split it descend again latching the path exclusively,
+     * keeping only the nonleaves the split may reach, and split along it.
+     * @param key
+     * @param rid
+     * @param payload		Payload of the entry in a covering index, null otherwise
+     */
+    template <class T>
+    void BTreeIndex::insertTyped(const T& key, const RecordId rid, const char* payload)
+    {
+        // the key is in the filter before it is in the tree, so no lookup that finds the entry is turned away.
+        if(!bloomPages.empty())
+            addToBloomFilter(key);
+        if(nodeBuffering && depth > 0){
+            std::vector<RIDKeyPair<T> > entries(1);
+            entries[0].set(rid, key);
+            bufferAtNodes(entries, depth);
+            return;
+        }
+        if(insertOptimistic(key, rid, payload))
+            return;
+        PageId rootNo;
+        {
+            EpochGuard countGuard(countLatch, true, countEntries);
+            std::vector<PathEntry<T> > path;
+            std::vector<Page*> pages;
+            size_t first = latchPath(path, key, pages);
+            rootNo = path[0].pageNo;
+            std::vector<PathEntry<T> > splitPath(path);
+            insertLeaf(splitPath, key, rid, payload);
+            for(size_t i = path.size(); i-- > first; ){
+                bufMgr->unlatchPage(pages[i], true);
+                bufMgr->unPinPage(file, path[i].pageNo, false);
+            }
+        }
+        // the pinned levels moved one level down if the root split, and the new root is pinned ahead of them.
+        if(pinnedLevels > 0 && rootPageNum != rootNo)
+            pinUpperLevels<T>();
+    }
+
+    /**
+     * Insert the entry into its leaf if that has room, with only the leaf latched exclusively.
+     * @param key
+     * @param rid
+     * @param payload
+     * @return False if the leaf is full and has to be split; nothing was inserted then.
+     */
+    template <class T>
+    bool BTreeIndex::insertOptimistic(const T& key, const RecordId rid, const char* payload)
+    {
+        // no split may move the children of the path between the descent and counting the entry in them.
+        EpochGuard countGuard(countLatch, false, countEntries);
+        std::vector<PathEntry<T> > path;
+        unsigned version;
+        {
+            std::lock_guard<std::mutex> guard(pathMutex);
+            std::vector<PathEntry<T> > &cachedPath = rightmostPath<T>();
+            if(!cachedPath.empty() && cachedPath.back().covers(key))
+                path = cachedPath;
+            version = rightmostVersion;
+        }
+        PageId pageNo = MAX_PAGEID;
+        Page *page;
+        if(!path.empty()){
+            // the cached leaf is only still the rightmost one if no split or merge cleared the cache
+            // before it was latched.
+            pageNo = path.back().pageNo;
+            bufMgr->readPage(file, pageNo, page);
+            bufMgr->latchPage(page, true);
+            std::lock_guard<std::mutex> guard(pathMutex);
+            if(rightmostVersion != version){
+                bufMgr->unlatchPage(page, true);
+                bufMgr->unPinPage(file, pageNo, false);
+                pageNo = MAX_PAGEID;
+            }
+        }
+        if(pageNo == MAX_PAGEID){
+            pageNo = latchLeaf(key, true, page, &path);
+            std::lock_guard<std::mutex> guard(pathMutex);
+            if(!path.back().hasHigh && rightmostVersion == version)
+                rightmostPath<T>() = path;
+        }
+
+        LeafNode<T> *node = (LeafNode<T>*)page;
+        bool inserted = node->insert(node->lowerBound(0, key), key, rid, payload);
+        if(inserted)
+            leafOccupancy++;
+        bufMgr->unlatchPage(page, true);
+        bufMgr->unPinPage(file, pageNo, inserted);
+        if(inserted)
+            countPath(path, 1);
+        return inserted;
+    }
+
+    /**
+     * Delete the entry <key,rid>. A leaf left less than half full is merged with a
+     * sibling if both fit in one page, and otherwise refills itself from it; nonleaves that lose a key
+     * this way are rebalanced in turn, and a root left with a single child is collapsed. Pages freed by
+     * merges are reused by later splits. No scan may be executing on the index while entries are deleted.
+     * Waits for the operations running in other threads and runs alone, so no pages are latched.
+     * @param key			Key of the entry, pointer to integer/double/char string
+     * @param rid			Record ID of the entry
+     * @return True if the entry was found and deleted, false if the index holds no such entry.
+     */
+    bool BTreeIndex::deleteEntry(const void *key, const RecordId rid)
+    {
+        EpochGuard treeGuard(treeLatch, true);
+        if(numOpenScans > 0)
+            throw BadIndexInfoException("Entries cannot be deleted while a scan is open");
+        flushInsertBuffer();
+        switch(attributeType){
+            case INTEGER: return deleteTyped(*(const int*)key, rid);
+            case DOUBLE: return deleteTyped(*(const double*)key, rid);
+            case STRING: return deleteTyped(StringKey((const char*)key), rid);
+            case COMPOSITE: return deleteTyped(compositeKey((const char*)key), rid);
+        }
+        return false;
+    }
+
+    /**
+     * deleteEntry() once the key type of the index is known.
+     * @param key
+     * @param rid
+     * @return True if the entry was found and deleted.
+     */
+    template <class T>
+    bool BTreeIndex::deleteTyped(const T& key, const RecordId rid)
+    {
+        std::vector<PathEntry<T> > path;
+        std::vector<RecordId> runRids;
+        descendPath(path, key);
+        while(1){
+            PageId pageNo = path.back().pageNo;
+            Page *page;
+            bufMgr->readPage(file, pageNo, page);
+            LeafNode<T> *node = (LeafNode<T>*)page;
+            int first = node->lowerBound(0, key);
+            int last = node->upperBound(first, key);
+            runRids.resize(last - first);
+            node->copyRids(first, last - first, runRids.data());
+            int pos = first + (std::find(runRids.begin(), runRids.end(), rid) - runRids.begin());
+            if(pos < last){
+                node->remove(pos);
+                leafOccupancy--;
+                bool underfull = path.size() > 1 && node->underfull();
+                bufMgr->unPinPage(file, pageNo, true);
+                countPath(path, -1);
+                if(underfull)
+                    rebalance(path);
+                return true;
+            }
+            bool exhausted = last == node->size;
+            bufMgr->unPinPage(file, pageNo, false);
+            // a run of duplicates that reaches the end of the leaf may continue in the next one.
+            if(!exhausted || !nextLeafPath(path))
+                return false;
+        }
+    }
+
+    /**
+     * Restore the minimum occupancy of the underfull node at the end of path by merging it with or
+     * refilling it from a sibling under the same parent, then rebalance the parent if it lost a key.
+     * A root nonleaf left with a single child is removed and the child becomes the root.
+     * @param path
+     */
+    template <class T>
+    void BTreeIndex::rebalance(std::vector<PathEntry<T> > &path)
+    {
+        // separators and the root move below, so the cached right edge may no longer be accurate.
+        {
+            std::lock_guard<std::mutex> guard(pathMutex);
+            rightmostPath<T>().clear();
+            rightmostVersion++;
+        }
+        PathEntry<T> target = path.back();
+        path.pop_back();
+        if(path.empty()){
+            Page *rootPage;
+            bufMgr->readPage(file, rootPageNum, rootPage);
+            NonLeafNode<T> *rootNode = (NonLeafNode<T>*)rootPage;
+            PageId onlyChild = rootNode->child(0);
+            bool collapse = (rootNode->type == NONLEAF || rootNode->type == COUNTEDNONLEAF) && rootNode->size == 0;
+            bufMgr->unPinPage(file, rootPageNum, false);
+            if(collapse){
+                freeIndexPage(rootPageNum);
+                rootPageNum = onlyChild;
+                depth--;
+                // the levels below moved one level up, so the pinned levels take in one more.
+                if(pinnedLevels > 0)
+                    pinUpperLevels<T>();
+            }
+            return;
+        }
+
+        PageId parentPageNo = path.back().pageNo;
+        Page *parentPage;
+        bufMgr->readPage(file, parentPageNo, parentPage);
+        NonLeafNode<T> *parentNode = (NonLeafNode<T>*)parentPage;
+        if(parentNode->size == 0){
+            // the node is an only child, which only happens under a nonleaf started by an append split.
+            // Such a parent is underfull itself, rebalancing it gives the node siblings.
+            bufMgr->unPinPage(file, parentPageNo, false);
+            rebalance(path);
+            return;
+        }
+        // the underfull node and its right sibling, or its left one if it is the last child.
+        int leftIndex = target.childIndex < parentNode->size ? target.childIndex : target.childIndex - 1;
+        PageId leftPageNo = parentNode->child(leftIndex), rightPageNo = parentNode->child(leftIndex + 1);
+        Page *leftPage, *rightPage;
+        bufMgr->readPage(file, leftPageNo, leftPage);
+        bufMgr->readPage(file, rightPageNo, rightPage);
+        // merge the two if they fit in one page, otherwise even them out.
+        bool merged, redistributed = false;
+        std::uint32_t leftCount, rightCount;
+        if(target.isLeaf){
+            LeafNode<T> *leftNode = (LeafNode<T>*)leftPage, *rightNode = (LeafNode<T>*)rightPage;
+            merged = leftNode->merge(rightNode);
+            if(merged)
+                // the right leaf is unlinked from the leaf level.
+                leftNode->rightSibPageNo = rightNode->rightSibPageNo;
+            else
+                redistributed = leftNode->redistribute(rightNode, parentNode, leftIndex);
+            leftCount = leftNode->size;
+            rightCount = rightNode->size;
+        } else{
+            NonLeafNode<T> *leftNode = (NonLeafNode<T>*)leftPage, *rightNode = (NonLeafNode<T>*)rightPage;
+            // the separator comes down between the keys of the two nodes.
+            merged = leftNode->merge(parentNode->key(leftIndex), rightNode);
+            if(!merged)
+                redistributed = leftNode->redistribute(rightNode, parentNode, leftIndex);
+            leftCount = leftNode->total();
+            rightCount = rightNode->total();
+        }
+        // entries only move between the two, so the counts above the parent stay as they are.
+        if(merged)
+            parentNode->setCount(leftIndex, leftCount);
+        else if(redistributed){
+            parentNode->setCount(leftIndex, leftCount);
+            parentNode->setCount(leftIndex + 1, rightCount);
+        }
+        bufMgr->unPinPage(file, leftPageNo, merged || redistributed);
+        bufMgr->unPinPage(file, rightPageNo, redistributed);
+        if(!merged){
+            bufMgr->unPinPage(file, parentPageNo, redistributed);
+            return;
+        }
+
+        // drop the separator and the right node from the parent.
+        parentNode->remove(leftIndex);
+        // a nonleaf merge keeps the separator, it only moves down into the merged node.
+        if(target.isLeaf)
+            nodeOccupancy--;
+        bool parentUnderfull = path.size() > 1 ? parentNode->underfull() : parentNode->size == 0;
+        bufMgr->unPinPage(file, parentPageNo, true);
+        freeIndexPage(rightPageNo);
+        if(parentUnderfull)
+            rebalance(path);
+    }
+
+    /**
+     * Find all entries whose key equals the given key. Descends once from the root, binary-searches the
+     * target leaf and only moves on to right siblings while they continue a run of duplicates.
+     * Each page on the way is pinned exactly once. May be called from several threads at once, together
+     * with insertEntry() and scans through BTreeScanCursor.
+     * @param key			Key to look up, pointer to integer/double/char string
+     * @param outRids		Record ids of all matching entries are appended to this
+     * @return Number of matching entries found.
+     */
+    int BTreeIndex::lookup(const void *key, std::vector<RecordId> &outRids)
+    {
+        EpochGuard treeGuard(treeLatch, false);
+        switch(attributeType){
+            case INTEGER: return lookupTyped(*(const int*)key, outRids);
+            case DOUBLE: return lookupTyped(*(const double*)key, outRids);
+            case STRING: return lookupTyped(StringKey((const char*)key), outRids);
+            case COMPOSITE: return lookupTyped(compositeKey((const char*)key), outRids);
+        }
+        return 0;
+    }
+
+    bool BTreeIndex::mayContain(const void *key)
+    {
+        EpochGuard treeGuard(treeLatch, false);
+        switch(attributeType){
+            case INTEGER: return mayContainTyped(*(const int*)key);
+            case DOUBLE: return mayContainTyped(*(const double*)key);
+            case STRING: return mayContainTyped(StringKey((const char*)key));
+            case COMPOSITE: return mayContainTyped(compositeKey((const char*)key));
+        }
+        return true;
+    }
+
+    /**
+     * lookup() once the key type of the index is known.
+     * @param key
+     * @param outRids
+     * @return Number of matching entries found.
+     */
+    template <class T>
+    int BTreeIndex::lookupTyped(const T& key, std::vector<RecordId> &outRids)
+    {
+        if(!mayContainTyped(key))
+            return 0;
+        int numFound = 0;
+        Page *page;
+        PageId pageNo = latchLeaf(key, false, page);
+        while(1){
+            LeafNode<T> *node = (LeafNode<T>*)page;
+            int first = node->lowerBound(0, key);
+            int last = node->upperBound(first, key);
+            size_t numOut = outRids.size();
+            outRids.resize(numOut + last - first);
+            node->copyRids(first, last - first, outRids.data() + numOut);
+            numFound += last - first;
+            // matches may only continue in the right sibling if this leaf was exhausted. It is latched
+            // before this leaf is released, so a split in between cannot move matches past the lookup.
+            PageId nextPageNo = last == node->size ? node->rightSibPageNo : MAX_PAGEID;
+            Page *nextPage = nullptr;
+            if(nextPageNo != MAX_PAGEID){
+                bufMgr->readPage(file, nextPageNo, nextPage);
+                bufMgr->latchPage(nextPage, false);
+            }
+            bufMgr->unlatchPage(page, false);
+            bufMgr->unPinPage(file, pageNo, false);
+            if(nextPage == nullptr)
+                break;
+            pageNo = nextPageNo;
+            page = nextPage;
+        }
+        // entries not yet merged into the tree.
+        const DeltaStore<T> &buffer = insertBuffer<T>();
+        if(buffer.size() > 0)
+            for(const typename DeltaStore<T>::Node *node = buffer.seek(key, false);
+                    node != nullptr && !(key < node->entry.key); node = node->successor(0)){
+                outRids.push_back(node->entry.rid);
+                numFound++;
+            }
+        if(!nodeBuffers.empty()){
+            ScanRange<T> range;
+            range.set(key, GTE, key, LTE);
+            std::vector<RIDKeyPair<T> > buffered;
+            collectBuffered(rootPageNum, range, buffered);
+            for(size_t i = 0; i < buffered.size(); i++)
+                outRids.push_back(buffered[i].rid);
+            numFound += buffered.size();
+        }
+        return numFound;
+    }
+
+    /**
+     * Move the path to the leaf that key is routed to. Pops entries whose range does not cover key and
+     * descends from the deepest remaining one, starting at the root if the path is empty.
+     * @param path
+     * @param key
+     */
+    template <class T>
+    void BTreeIndex::descendPath(std::vector<PathEntry<T> > &path, const T& key)
+    {
+        while(!path.empty() && !path.back().covers(key))
+            path.pop_back();
+        if(path.empty())
+            pushRoot(path, rootPageNum, depth == 0);
+        while(!path.back().isLeaf){
+            PageId pageNo = path.back().pageNo;
+            Page *page;
+            bool pinned = readIndexPage(pageNo, page);
+            NonLeafNode<T> *node = (NonLeafNode<T>*)page;
+            descendChild(path, node, node->lowerBound(key));
+            releaseIndexPage(pageNo, pinned);
+        }
+    }
+
+    /**
+     * Push child index of node, which is the pinned page of the nonleaf at the end of path, onto path.
+     * @param path
+     * @param node
+     * @param index
+     */
+    template <class T>
+    void BTreeIndex::descendChild(std::vector<PathEntry<T> > &path, NonLeafNode<T> *node, int index)
+    {
+        const PathEntry<T> &parent = path.back();
+        PathEntry<T> child;
+        child.pageNo = node->child(index);
+        child.childIndex = index;
+        child.isLeaf = node->level == 1;
+        // child i is routed the keys in (keyArray[i-1], keyArray[i]], narrowed by the parent's own range.
+        child.hasLow = index > 0 || parent.hasLow;
+        child.low = index > 0 ? node->key(index - 1) : parent.low;
+        child.hasHigh = index < node->size || parent.hasHigh;
+        child.high = index < node->size ? node->key(index) : parent.high;
+        path.push_back(child);
+    }
+
+    /**
+     * Move the path from its leaf to the path of the next leaf to the right.
+     * @param path
+     * @return False if the leaf was the rightmost one; path is left empty then.
+     */
+    template <class T>
+    bool BTreeIndex::nextLeafPath(std::vector<PathEntry<T> > &path)
+    {
+        // climb to the lowest ancestor that has a child right of the path, then take leftmost children down.
+        int childIndex = path.back().childIndex;
+        path.pop_back();
+        while(!path.empty()){
+            PageId pageNo = path.back().pageNo;
+            Page *page;
+            bufMgr->readPage(file, pageNo, page);
+            NonLeafNode<T> *node = (NonLeafNode<T>*)page;
+            if(childIndex < node->size){
+                descendChild(path, node, childIndex + 1);
+                bufMgr->unPinPage(file, pageNo, false);
+                while(!path.back().isLeaf){
+                    pageNo = path.back().pageNo;
+                    bufMgr->readPage(file, pageNo, page);
+                    descendChild(path, (NonLeafNode<T>*)page, 0);
+                    bufMgr->unPinPage(file, pageNo, false);
+                }
+                return true;
+            }
+            bufMgr->unPinPage(file, pageNo, false);
+            childIndex = path.back().childIndex;
+            path.pop_back();
+        }
+        return false;
+    }
+
+    /**
+     * Move the path from its leaf to the path of the next leaf to the left, latching each nonleaf shared while
+     * it is read. Splits only move keys and children to the right, so if the path is outdated by them, it
+     * is moved to a leaf somewhere left of its leaf instead.
+     * @param path
+     * @return False if the leaf was the leftmost one; path is left empty then.
+     */
+    template <class T>
+    bool BTreeIndex::prevLeafPath(std::vector<PathEntry<T> > &path)
+    {
+        // climb to the lowest ancestor that has a child left of the path, then take rightmost children down.
+        int childIndex = path.back().childIndex;
+        path.pop_back();
+        while(!path.empty() && childIndex == 0){
+            childIndex = path.back().childIndex;
+            path.pop_back();
+        }
+        if(path.empty())
+            return false;
+        // a split of the ancestor may have moved the child at childIndex and those after it to a new node.
+        childIndex--;
+        while(1){
+            PageId pageNo = path.back().pageNo;
+            Page *page;
+            bufMgr->readPage(file, pageNo, page);
+            bufMgr->latchPage(page, false);
+            NonLeafNode<T> *node = (NonLeafNode<T>*)page;
+            descendChild(path, node, std::min(childIndex, node->size));
+            bufMgr->unlatchPage(page, false);
+            bufMgr->unPinPage(file, pageNo, false);
+            if(path.back().isLeaf)
+                return true;
+            childIndex = INT_MAX;
+        }
+    }
+
+    /**
+     * Latch the left sibling of leaf pageNo shared. path is the root-to-leaf path of pageNo or of a leaf left
+     * of it, recorded by an earlier descent and possibly outdated by splits since; it is moved to a leaf left
+     * of pageNo, from which the sibling is reached through right sibling links. The caller has no latch.
+     * @param path
+     * @param pageNo
+     * @param leafPage		Receives the pinned sibling
+     * @return Page number of the sibling, or MAX_PAGEID if pageNo is the leftmost leaf.
+     */
+    template <class T>
+    PageId BTreeIndex::latchLeftSibling(std::vector<PathEntry<T> > &path, PageId pageNo, Page *&leafPage)
+    {
+        if(path.back().pageNo == pageNo && !prevLeafPath(path))
+            return MAX_PAGEID;
+        PageId leafPageNo = path.back().pageNo;
+        Page *page;
+        bufMgr->readPage(file, leafPageNo, page);
+        bufMgr->latchPage(page, false);
+        // leaves split since the path was recorded lie between its leaf and pageNo. Latching left to right,
+        // like scans and splits do, cannot deadlock.
+        while(((LeafNode<T>*)page)->rightSibPageNo != pageNo){
+            PageId rightPageNo = ((LeafNode<T>*)page)->rightSibPageNo;
+            Page *rightPage = nullptr;
+            if(rightPageNo != MAX_PAGEID){
+                bufMgr->readPage(file, rightPageNo, rightPage);
+                bufMgr->latchPage(rightPage, false);
+            }
+            bufMgr->unlatchPage(page, false);
+            bufMgr->unPinPage(file, leafPageNo, false);
+            // pageNo is no longer linked in, which only a delete since the scan started can do.
+            if(rightPage == nullptr)
+                return MAX_PAGEID;
+            leafPageNo = rightPageNo;
+            page = rightPage;
+        }
+        leafPage = page;
+        return leafPageNo;
+    }
+
+    /**
+     * Append the entries [first, last) of the leaf, whose key is key, to outEntries.
+     */
+    template <class T>
+    static void appendEntries(const LeafNode<T> *node, int first, int last, const T& key, std::vector<RIDKeyPair<T> > &outEntries)
+    {
+        RidReadPosition position;
+        position.entry = -1;
+        size_t numOut = outEntries.size();
+        outEntries.resize(numOut + last - first);
+        for(int i = first; i < last; i++){
+            RIDKeyPair<T> &entry = outEntries[numOut + i - first];
+            node->copyRids(i, 1, &entry.rid, &position);
+            entry.key = key;
+        }
+    }
+
+    /**
+     * Append the entries equal to key found in the right siblings of a leaf whose run of matches
+     * reached its last slot.
+     * @param rightSibPageNo
+     * @param key
+     * @param outEntries
+     * @return Number of matching entries found.
+     */
+    template <class T>
+    int BTreeIndex::lookupSiblings(PageId rightSibPageNo, const T& key, std::vector<RIDKeyPair<T> > &outEntries)
+    {
+        int numFound = 0;
+        PageId pageNo = rightSibPageNo;
+        while(pageNo != MAX_PAGEID){
+            Page *page;
+            bufMgr->readPage(file, pageNo, page);
+            LeafNode<T> *node = (LeafNode<T>*)page;
+            int first = node->lowerBound(0, key);
+            int last = node->upperBound(first, key);
+            appendEntries(node, first, last, key, outEntries);
+            numFound += last - first;
+            PageId nextPageNo = last == node->size ? node->rightSibPageNo : MAX_PAGEID;
+            bufMgr->unPinPage(file, pageNo, false);
+            pageNo = nextPageNo;
+        }
+        return numFound;
+    }
+
+    /**
+     * Look up a batch of keys. The keys are sorted and the root-to-leaf path is reused between neighbouring
+     * keys, so each leaf is pinned once for all keys that land in it. Runs alone like deleteEntry().
+     * @param keys			Keys to look up, in any order
+     * @param outEntries	Key-rid pairs of all matching entries are appended to this, in key order
+     * @return Number of matching entries found.
+     * @throws  BadIndexInfoException If T is not the type of the attribute the index is built over.
+     */
+    template <class T>
+    int BTreeIndex::lookupBatch(const std::vector<T> &keys, std::vector<RIDKeyPair<T> > &outEntries)
+    {
+        checkKeyType<T>();
+        EpochGuard treeGuard(treeLatch, true);
+        flushInsertBuffer();
+        std::vector<T> sortedKeys;
+        sortedKeys.reserve(keys.size());
+        for(size_t k = 0; k < keys.size(); k++)
+            if(mayContainTyped(keys[k]))
+                sortedKeys.push_back(keys[k]);
+        std::sort(sortedKeys.begin(), sortedKeys.end());
+        std::vector<PathEntry<T> > path;
+        int numFound = 0;
+        size_t i = 0;
+        while(i < sortedKeys.size()){
+            descendPath(path, sortedKeys[i]);
+            const PathEntry<T> &leafEntry = path.back();
+            Page *page;
+            bufMgr->readPage(file, leafEntry.pageNo, page);
+            LeafNode<T> *node = (LeafNode<T>*)page;
+            // keys are ascending, so each search resumes where the previous one stopped.
+            int pos = 0;
+            for(; i < sortedKeys.size() && leafEntry.covers(sortedKeys[i]); i++){
+                const T &key = sortedKeys[i];
+                pos = node->lowerBound(pos, key);
+                int last = node->upperBound(pos, key);
+                appendEntries(node, pos, last, key, outEntries);
+                numFound += last - pos;
+                if(last == node->size)
+                    numFound += lookupSiblings(node->rightSibPageNo, key, outEntries);
+            }
+            bufMgr->unPinPage(file, leafEntry.pageNo, false);
+        }
+        return numFound;
+    }
+
+    /**
+     * Find all entries in any of a list of key ranges in one pass, such as the ranges of an IN list or of ORs
+     * of ranges. The leaf level is walked left to right; between ranges the root-to-leaf path is only climbed
+     * as far as the gap to the next range needs. Runs alone like deleteEntry().
+     * @param ranges		Ranges to scan, ascending and not overlapping
+     * @param outRids		Record ids of all matching entries are appended to this, in key order
+     * @return Number of matching entries found.
+     * @throws  BadIndexInfoException If T is not the type of the attribute the index is built over.
+     * @throws  BadOpcodesException If an operator of a range is not one of its expected values
+     * @throws  BadScanrangeException If a range has low > high, or the ranges are not ascending and disjoint
+     */
+    template <class T>
+    int BTreeIndex::scanRanges(const std::vector<ScanRange<T> > &ranges, std::vector<RecordId> &outRids)
+    {
+        checkKeyType<T>();
+        for(size_t r = 0; r < ranges.size(); r++){
+            const ScanRange<T> &range = ranges[r];
+            if(range.lowOp != GT && range.lowOp != GTE)
+                throw BadOpcodesException();
+            if(range.highOp != LT && range.highOp != LTE)
+                throw BadOpcodesException();
+            if(range.high < range.low || (r > 0 && !ranges[r - 1].precedes(range)))
+                throw BadScanrangeException();
+        }
+
+        EpochGuard treeGuard(treeLatch, true);
+        flushInsertBuffer();
+        std::vector<PathEntry<T> > path;
+        Page *page = nullptr;
+        int numFound = 0, pos = 0;
+        for(size_t r = 0; r < ranges.size(); r++){
+            const ScanRange<T> &range = ranges[r];
+            // a range that starts in the current leaf is searched from where the last one stopped.
+            if(page == nullptr || !path.back().covers(range.low)){
+                if(page != nullptr)
+                    bufMgr->unPinPage(file, path.back().pageNo, false);
+                descendPath(path, range.low);
+                bufMgr->readPage(file, path.back().pageNo, page);
+                pos = 0;
+            }
+            numFound += scanLeafRange(path, page, pos, range, outRids);
+            if(page == nullptr)
+                return numFound;
+        }
+        if(page != nullptr)
+            bufMgr->unPinPage(file, path.back().pageNo, false);
+        return numFound;
+    }
+
+    template <class T>
+    int BTreeIndex::scanLeafRange(std::vector<PathEntry<T> > &path, Page *&page, int &pos, const ScanRange<T> &range,
+            std::vector<RecordId> &outRids)
+    {
+        int numFound = 0;
+        while(1){
+            LeafNode<T> *node = (LeafNode<T>*)page;
+            if(pos < node->size && !range.satisfiesLow(node->key(pos)))
+                pos = range.lowOp == GT ? node->upperBound(pos, range.low) : node->lowerBound(pos, range.low);
+            int end = node->size;
+            if(pos < end && !range.satisfiesHigh(node->key(end - 1)))
+                end = range.highOp == LT ? node->lowerBound(pos, range.high) : node->upperBound(pos, range.high);
+            size_t numOut = outRids.size();
+            outRids.resize(numOut + end - pos);
+            node->copyRids(pos, end - pos, outRids.data() + numOut);
+            numFound += end - pos;
+            pos = end;
+            if(end < node->size)
+                return numFound;
+            // the range may run on into the next leaf; the path follows, so later ranges still climb from it.
+            bufMgr->unPinPage(file, path.back().pageNo, false);
+            if(!nextLeafPath(path)){
+                page = nullptr;
+                return numFound;
+            }
+            bufMgr->readPage(file, path.back().pageNo, page);
+            pos = 0;
+        }
+    }
+
+    int BTreeIndex::skipScan(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp,
+            std::vector<RecordId> &outRids)
+    {
+        if(attributeType != COMPOSITE)
+            throw BadIndexInfoException("Skip-scan needs a composite key");
+        if(lowOp != GT && lowOp != GTE)
+            throw BadOpcodesException();
+        if(highOp != LT && highOp != LTE)
+            throw BadOpcodesException();
+        const int prefixLength = keyColumnWidth(keyColumns[0].type);
+        ScanRange<CompositeKey> range;
+        range.set(compositeKey((const char*)lowVal), lowOp, compositeKey((const char*)highVal), highOp);
+        if(std::memcmp(range.high.data + prefixLength, range.low.data + prefixLength, COMPOSITESIZE - prefixLength) < 0)
+            throw BadScanrangeException();
+
+        EpochGuard treeGuard(treeLatch, true);
+        flushInsertBuffer();
+        std::vector<PathEntry<CompositeKey> > path;
+        CompositeKey seek;
+        std::memset(seek.data, 0, COMPOSITESIZE);
+        Page *page = nullptr;
+        int numFound = 0, pos = 0;
+        while(1){
+            // find the first entry at or after seek, whose first attribute is the next value to search under.
+            if(page == nullptr || !path.back().covers(seek)){
+                if(page != nullptr)
+                    bufMgr->unPinPage(file, path.back().pageNo, false);
+                descendPath(path, seek);
+                bufMgr->readPage(file, path.back().pageNo, page);
+                pos = 0;
+            }
+            LeafNodeComposite *node = (LeafNodeComposite*)page;
+            pos = node->lowerBound(pos, seek);
+            while(pos == node->size){
+                bufMgr->unPinPage(file, path.back().pageNo, false);
+                if(!nextLeafPath(path))
+                    return numFound;
+                bufMgr->readPage(file, path.back().pageNo, page);
+                node = (LeafNodeComposite*)page;
+                pos = node->lowerBound(0, seek);
+            }
+            const CompositeKey first = node->key(pos);
+            std::memcpy(range.low.data, first.data, prefixLength);
+            std::memcpy(range.high.data, first.data, prefixLength);
+            if(node->key(pos) < range.low && !path.back().covers(range.low)){
+                bufMgr->unPinPage(file, path.back().pageNo, false);
+                descendPath(path, range.low);
+                bufMgr->readPage(file, path.back().pageNo, page);
+                pos = 0;
+            }
+            numFound += scanLeafRange(path, page, pos, range, outRids);
+            if(page == nullptr)
+                return numFound;
+            // seek past every entry with this first attribute: the next value of the prefix, as a big-endian number.
+            seek = first;
+            std::memset(seek.data + prefixLength, 0, COMPOSITESIZE - prefixLength);
+            int i = prefixLength - 1;
+            for(; i >= 0 && seek.data[i] == 0xff; i--)
+                seek.data[i] = 0;
+            if(i < 0)
+                break;
+            seek.data[i]++;
+        }
+        bufMgr->unPinPage(file, path.back().pageNo, false);
+        return numFound;
+    }
+
+    CompositeKey BTreeIndex::compositeKey(const char* record) const
+    {
+        if(attributeType != COMPOSITE)
+            throw BadIndexInfoException("Index does not have a composite key");
+        // each attribute is encoded so that comparing the keys bytewise orders them like the attributes in turn.
+        CompositeKey key;
+        std::memset(key.data, 0, COMPOSITESIZE);
+        unsigned char *out = key.data;
+        for(size_t c = 0; c < keyColumns.size(); c++){
+            const char *attr = record + keyColumns[c].offset;
+            switch(keyColumns[c].type){
+                case INTEGER: {
+                    // flipping the sign bit orders negative values before positive ones.
+                    int value;
+                    std::memcpy(&value, attr, sizeof(int));
+                    std::uint32_t bits = (std::uint32_t)value ^ 0x80000000u;
+                    for(int i = 3; i >= 0; i--, bits >>= 8)
+                        out[i] = bits & 0xff;
+                    out += sizeof(int);
+                    break;
+                }
+                case DOUBLE: {
+                    // positive values get the sign bit set; negative ones have all bits flipped, reversing their order.
+                    double value;
+                    std::memcpy(&value, attr, sizeof(double));
+                    if(value == 0)
+                        value = 0;
+                    std::uint64_t bits;
+                    std::memcpy(&bits, &value, sizeof(double));
+                    bits = (bits >> 63) ? ~bits : bits | (std::uint64_t(1) << 63);
+                    for(int i = 7; i >= 0; i--, bits >>= 8)
+                        out[i] = bits & 0xff;
+                    out += sizeof(double);
+                    break;
+                }
+                case STRING:
+                    strncpy((char*)out, attr, STRINGSIZE);
+                    out += STRINGSIZE;
+                    break;
+                default:
+                    break;
+            }
+        }
+        return key;
+    }
+
+    /**
+     * Number of entries whose key is less than key, or not greater than key if inclusive is set. Sums the
+     * counts of the children left of the path to key and the position of key in its leaf. Separators route
+     * equal keys to the left for lowerBound() and to the right for upperBound(), so the children left of the
+     * path only hold smaller keys, or not greater ones, and those right of it only greater ones, or not smaller.
+     * @param key
+     * @param inclusive
+     */
+    template <class T>
+    int BTreeIndex::rankTyped(const T& key, bool inclusive)
+    {
+        int numBefore = 0;
+        PageId pageNo = rootPageNum;
+        bool isLeaf = depth == 0;
+        Page *page;
+        while(!isLeaf){
+            bufMgr->readPage(file, pageNo, page);
+            NonLeafNode<T> *node = (NonLeafNode<T>*)page;
+            int index = inclusive ? node->upperBound(key) : node->lowerBound(key);
+            for(int i = 0; i < index; i++)
+                numBefore += node->count(i);
+            isLeaf = node->level == 1;
+            PageId childPageNo = node->child(index);
+            bufMgr->unPinPage(file, pageNo, false);
+            pageNo = childPageNo;
+        }
+        bufMgr->readPage(file, pageNo, page);
+        LeafNode<T> *node = (LeafNode<T>*)page;
+        numBefore += inclusive ? node->upperBound(0, key) : node->lowerBound(0, key);
+        bufMgr->unPinPage(file, pageNo, false);
+        return numBefore;
+    }
+
+    /**
+     * Count the entries in a key range without reading them, as the difference of the ranks of its ends.
+     * Runs alone like deleteEntry().
+     * @param lowVal	Low value of range, pointer to integer / double / char string
+     * @param lowOp		Low operator (GT/GTE)
+     * @param highVal	High value of range, pointer to integer / double / char string
+     * @param highOp	High operator (LT/LTE)
+     * @return Number of entries in the range.
+     * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values
+     * @throws  BadScanrangeException If lowVal > highval
+     */
+    int BTreeIndex::countRange(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp)
+    {
+        if(lowOp != GT && lowOp != GTE)
+            throw BadOpcodesException();
+        if(highOp != LT && highOp != LTE)
+            throw BadOpcodesException();
+        if(!countEntries)
+            throw BadIndexInfoException("Index does not count entries");
+        EpochGuard treeGuard(treeLatch, true);
+        flushInsertBuffer();
+        switch(attributeType){
+            case INTEGER: return countRangeTyped(*(const int*)lowVal, lowOp, *(const int*)highVal, highOp);
+            case DOUBLE: return countRangeTyped(*(const double*)lowVal, lowOp, *(const double*)highVal, highOp);
+            case STRING: return countRangeTyped(StringKey((const char*)lowVal), lowOp, StringKey((const char*)highVal), highOp);
+            case COMPOSITE: return countRangeTyped(compositeKey((const char*)lowVal), lowOp, compositeKey((const char*)highVal), highOp);
+        }
+        return 0;
+    }
+
+    /**
+     * countRange() once the key type of the index is known.
+     */
+    template <class T>
+    int BTreeIndex::countRangeTyped(const T& lowVal, const Operator lowOp, const T& highVal, const Operator highOp)
+    {
+        if(highVal < lowVal)
+            throw BadScanrangeException();
+        // entries up to the high end, less those below the low end.
+        int numUpToHigh = rankTyped(highVal, highOp == LTE);
+        int numBelowLow = rankTyped(lowVal, lowOp == GT);
+        return std::max(0, numUpToHigh - numBelowLow);
+    }
+
+    /**
+     * Number of entries whose key is less than the given key. Runs alone like deleteEntry().
+     * @param key			Pointer to integer/double/char string
+     */
+    int BTreeIndex::rank(const void* key)
+    {
+        if(!countEntries)
+            throw BadIndexInfoException("Index does not count entries");
+        EpochGuard treeGuard(treeLatch, true);
+        flushInsertBuffer();
+        switch(attributeType){
+            case INTEGER: return rankTyped(*(const int*)key, false);
+            case DOUBLE: return rankTyped(*(const double*)key, false);
+            case STRING: return rankTyped(StringKey((const char*)key), false);
+            case COMPOSITE: return rankTyped(compositeKey((const char*)key), false);
+        }
+        return 0;
+    }
+
     /**
-     * BTreeIndex Constructor.
-     * Check to see if the corresponding index file exists. If so, open the file.
-     * If not, create it and insert entries for every tuple in the base relation using FileScan class.
-     *
-     * @param relationName        Name of file.
-     * @param outIndexName        Return the name of index file.
-     * @param bufMgrIn						Buffer Manager Instance
-     * @param attrByteOffset			Offset of attribute, over which index is to be built, in the record
-     * @param attrType						Datatype of attribute over which index is built
-     * @throws  BadIndexInfoException     If the index file already exists for the corresponding attribute, but values in metapage(relationName, attribute byte offset, attribute type etc.) do not match with values received through constructor parameters.
+     * Find the entry at position i in key order. Each nonleaf on the way is passed through the child whose
+     * entries cover position i, which is then made relative to that child. Runs alone like deleteEntry().
+     * @param i				Position of the entry, from 0
+     * @param outEntry		Receives the key and record id of the entry
+     * @return False if the index holds no more than i entries.
+     * @throws  BadIndexInfoException If T is not the type of the attribute the index is built over.
      */
-    BTreeIndex::BTreeIndex(const std::string & relationName,
-            std::string & outIndexName,
-            BufMgr *bufMgrIn,
-            const int attrByteOffset,
-            const Datatype attrType)
+    template <class T>
+    bool BTreeIndex::select(int i, RIDKeyPair<T>& outEntry)
     {
-        // Add your code below. Please do not remove this line.
-        bufMgr = bufMgrIn;
-        attributeType = attrType;
-        this->attrByteOffset = attrByteOffset;
-        // find index file.
-        std::ostringstream idxStr;
-        idxStr << relationName << '.' << attrByteOffset;
-        std::string indexName = idxStr.str();
-        outIndexName = indexName;
-        // set up index file.
-        if(BlobFile::exists(indexName)){
-            // index file exists.
-            file = new BlobFile(indexName, false);
-            headerPageNum = file->getFirstPageNo();
-            Page *metaPage;
-            bufMgr->readPage(file, headerPageNum, metaPage);
-            bufMgr->unPinPage(file, headerPageNum, false);
-            // set up insert related global vars.
-            IndexMetaInfo *metaInfo = (IndexMetaInfo*)metaPage;
-            rootPageNum = metaInfo->rootPageNo;
-            leafOccupancy = metaInfo->leafOccupancy;
-            nodeOccupancy = metaInfo->nodeOccupancy;
-            depth = metaInfo->depth;
-        } else{
-            // index file doesn't exist.
-            file =  new BlobFile(indexName, true);
-            Page *metaPage, *rootPage;
-            bufMgr->allocPage(file, headerPageNum, metaPage);
-            bufMgr->allocPage(file, rootPageNum, rootPage);
-            // set up global var.
-            leafOccupancy = 0;
-            nodeOccupancy = 0;
-            depth = 0;
-            // set up meta info.
-            IndexMetaInfo *metaInfo = (IndexMetaInfo*)metaPage;
-            strcpy(metaInfo->relationName, relationName.c_str());
-            bufMgr->unPinPage(file, headerPageNum, true);
-            // set up root node.
-            LeafNodeInt *rootNode = (LeafNodeInt*)rootPage;
-            rootNode->type = LEAF;
-            rootNode->size = 0;
-            rootNode->parentId = MAX_PAGEID;
-            rootNode->rightSibPageNo = MAX_PAGEID;
-            bufMgr->unPinPage(file, rootPageNum, true);
+        checkKeyType<T>();
+        if(!countEntries)
+            throw BadIndexInfoException("Index does not count entries");
+        EpochGuard treeGuard(treeLatch, true);
+        flushInsertBuffer();
+        if(i < 0)
+            return false;
+        PageId pageNo = rootPageNum;
+        bool isLeaf = depth == 0;
+        Page *page;
+        while(!isLeaf){
+            bufMgr->readPage(file, pageNo, page);
+            NonLeafNode<T> *node = (NonLeafNode<T>*)page;
+            int index = 0;
+            while(index < node->size && i >= (int)node->count(index)){
+                i -= node->count(index);
+                index++;
+            }
+            isLeaf = node->level == 1;
+            PageId childPageNo = node->child(index);
+            bufMgr->unPinPage(file, pageNo, false);
+            pageNo = childPageNo;
         }
-        // insert all tuples in relation file to this BTree.
-        FileScan fscan = FileScan(relationName, bufMgr);
-        try{
-            RecordId scanRid;
-            while(1){
-                fscan.scanNext(scanRid);
-                std::string recordStr = fscan.getRecord();
-                const char *record = recordStr.c_str();
-                int key = *((int *)(record + attrByteOffset));
-                insertEntry(const_cast<const int*>(&key), scanRid);
+        bufMgr->readPage(file, pageNo, page);
+        LeafNode<T> *node = (LeafNode<T>*)page;
+        bool found = i < node->size;
+        if(found){
+            outEntry.key = node->key(i);
+            node->copyRids(i, 1, &outEntry.rid);
+        }
+        bufMgr->unPinPage(file, pageNo, false);
+        return found;
+    }
+
+    /**
+     * Insert a batch of entries. The entries are sorted and the root-to-leaf path is reused between
+     * neighbouring keys; all entries that land in the same leaf are merged into it in one pass.
+     * Equivalent to calling insertEntry() for every entry. Runs alone like deleteEntry().
+     * @param entries		Key-rid pairs to insert, in any order
+     * @throws  BadIndexInfoException If T is not the type of the attribute the index is built over, or the index has payload columns.
+     */
+    template <class T>
+    void BTreeIndex::insertBatch(const std::vector<RIDKeyPair<T> > &entries)
+    {
+        checkKeyType<T>();
+        if(!payloadColumns.empty())
+            throw BadIndexInfoException("Entries of a covering index need their payload columns");
+        EpochGuard treeGuard(treeLatch, true);
+        if(!bloomPages.empty())
+            for(size_t i = 0; i < entries.size(); i++)
+                addToBloomFilter(entries[i].key);
+        std::vector<RIDKeyPair<T> > sortedEntries(entries);
+        std::sort(sortedEntries.begin(), sortedEntries.end());
+        insertSorted(sortedEntries);
+        if(bloomBitsPerKey > 0 && leafOccupancy > bloomCapacity)
+            buildBloomFilter<T>(2 * leafOccupancy);
+    }
+
+    /**
+     * Merge sorted entries into the leaves, reusing the root-to-leaf path between neighbouring keys; all entries
+     * that land in the same leaf are merged into it in one pass, and a leaf that fills up is split.
+     * @param sortedEntries
+     */
+    template <class T>
+    void BTreeIndex::insertSorted(const std::vector<RIDKeyPair<T> > &sortedEntries)
+    {
+        std::vector<PathEntry<T> > path;
+        size_t i = 0;
+        while(i < sortedEntries.size()){
+            descendPath(path, sortedEntries[i].key);
+            const PathEntry<T> &leafEntry = path.back();
+            size_t groupEnd = i;
+            while(groupEnd < sortedEntries.size() && leafEntry.covers(sortedEntries[groupEnd].key))
+                groupEnd++;
+
+            Page *page;
+            bufMgr->readPage(file, leafEntry.pageNo, page);
+            LeafNode<T> *node = (LeafNode<T>*)page;
+            int numMerged = node->insertSorted(&sortedEntries[i], groupEnd - i);
+            leafOccupancy += numMerged;
+            bufMgr->unPinPage(file, leafEntry.pageNo, numMerged > 0);
+            if(numMerged > 0)
+                countPath(path, numMerged);
+            i += numMerged;
+
+            if(i < groupEnd){
+                // the leaf is full, split it along the current path. The split changes the
+                // nodes on the path, so the next key descends from the root again.
+                insertLeaf(path, sortedEntries[i].key, sortedEntries[i].rid, nullptr);
+                i++;
+                path.clear();
             }
-        } catch(const EndOfFileException &e){
         }
-        // set up scan related global vars.
-        currentPageNum = MAX_PAGEID;
-        currentPageData = nullptr;
-        nextEntry = -1;
-        scanExecuting = false;
     }
 
     /**
-     * BTreeIndex Destructor.
-     * End any initialized scan, flush index file, after unpinning any pinned pages, from the buffer manager
-     * and delete file instance thereby closing the index file.
-     * Destructor should not throw any exceptions. All exceptions should be caught in here itself.
+     * Buffer inserts in a delta store in memory and merge them into the tree capacity at a time, in one sorted pass.
+     * @param capacity		Number of pending entries at which they are merged, 0 to insert straight into the leaves again
+     * @param background	True to merge in a thread of the index
+     * @throws  BadIndexInfoException If capacity is negative, or the index has payload columns.
+     */
+    void BTreeIndex::setInsertBuffer(int capacity, bool background)
+    {
+        if(capacity < 0)
+            throw BadIndexInfoException("Insert buffer capacity must not be negative");
+        if(!payloadColumns.empty())
+            throw BadIndexInfoException("Inserts into a covering index cannot be buffered");
+        // the merge thread takes treeLatch, stop it before holding that.
+        stopMergeThread();
+        {
+            EpochGuard treeGuard(treeLatch, true);
+            flushInsertBuffer();
+            insertBufferCapacity = capacity;
+        }
+        if(capacity > 0 && background){
+            std::lock_guard<std::mutex> guard(mergeMutex);
+            backgroundMerge = true;
+            mergeRequested = stopMerging = false;
+            mergeThread = std::thread(&BTreeIndex::mergeLoop, this);
+        }
+    }
+
+    /**
+     * Have the insert buffer merged into the tree, by the merge thread if it is keeping up. If the buffer grew
+     * to twice its capacity the inserting thread merges it, so the buffer stays bounded.
+     * @param pending		Number of entries in the buffer
+     */
+    void BTreeIndex::requestMerge(int pending)
+    {
+        {
+            std::lock_guard<std::mutex> guard(mergeMutex);
+            if(backgroundMerge && pending < 2 * insertBufferCapacity){
+                mergeRequested = true;
+                mergeCondition.notify_one();
+                return;
+            }
+        }
+        flushInserts();
+    }
+
+    void BTreeIndex::mergeLoop()
+    {
+        std::unique_lock<std::mutex> lock(mergeMutex);
+        while(!stopMerging){
+            if(!mergeRequested){
+                mergeCondition.wait(lock);
+                continue;
+            }
+            mergeRequested = false;
+            lock.unlock();
+            flushInserts();
+            lock.lock();
+        }
+    }
+
+    void BTreeIndex::stopMergeThread()
+    {
+        {
+            std::lock_guard<std::mutex> guard(mergeMutex);
+            if(!backgroundMerge)
+                return;
+            backgroundMerge = false;
+            stopMerging = true;
+        }
+        mergeCondition.notify_one();
+        mergeThread.join();
+    }
+
+    void BTreeIndex::flushInserts()
+    {
+        EpochGuard treeGuard(treeLatch, true);
+        flushInsertBuffer();
+    }
+
+    /**
+     * Search copies of int nonleaves in Eytzinger order on optimistic descents.
+     * @param numNodes		Number of nonleaves to keep copies of, 0 to search the nodes themselves again
+     * @throws  BadIndexInfoException If numNodes is negative, or the index is not over an INTEGER attribute.
+     */
+    void BTreeIndex::setEytzingerSearch(int numNodes)
+    {
+        if(numNodes < 0)
+            throw BadIndexInfoException("Number of Eytzinger nodes must not be negative");
+        if(attributeType != INTEGER)
+            throw BadIndexInfoException("Eytzinger search needs an INTEGER attribute");
+        EpochGuard treeGuard(treeLatch, true);
+        delete eytzingerCache;
+        eytzingerCache = numNodes > 0 ? new EytzingerCache(numNodes) : nullptr;
+    }
+
+    void BTreeIndex::setPinnedLevels(int levels)
+    {
+        if(levels < 0)
+            throw BadIndexInfoException("Number of pinned levels must not be negative");
+        EpochGuard treeGuard(treeLatch, true);
+        pinnedLevels = levels;
+        switch(attributeType){
+            case INTEGER: pinUpperLevels<int>(); break;
+            case DOUBLE: pinUpperLevels<double>(); break;
+            case STRING: pinUpperLevels<StringKey>(); break;
+            case COMPOSITE: pinUpperLevels<CompositeKey>(); break;
+        }
+    }
+
+    int BTreeIndex::numPinnedPages()
+    {
+        EpochGuard treeGuard(treeLatch, false);
+        int numPinned = 0;
+        for(int i = 0; i < PINNEDSLOTS; i++)
+            if(pinnedPages[i].pageNo.load(std::memory_order_relaxed) != MAX_PAGEID)
+                numPinned++;
+        return numPinned;
+    }
+
+    int BTreeIndex::numBufferedInserts()
+    {
+        EpochGuard treeGuard(treeLatch, false);
+        int numBuffered = 0;
+        for(std::map<PageId, NodeBuffer>::const_iterator it = nodeBuffers.begin(); it != nodeBuffers.end(); ++it){
+            Page *page;
+            bufMgr->readPage(file, it->second.pageNo, page);
+            numBuffered += ((NodeBufferPage*)page)->size;
+            bufMgr->unPinPage(file, it->second.pageNo, false);
+        }
+        switch(attributeType){
+            case INTEGER: return numBuffered + insertBufferInt.size();
+            case DOUBLE: return numBuffered + insertBufferDouble.size();
+            case STRING: return numBuffered + insertBufferString.size();
+            case COMPOSITE: return numBuffered + insertBufferComposite.size();
+        }
+        return numBuffered;
+    }
+
+    /**
+     * Add the entry to the insert buffer. The key goes into the Bloom filter first, so lookups that find the
+     * entry in the buffer are not turned away.
+     * @param key
+     * @param rid
+     * @return Number of entries in the buffer.
+     */
+    template <class T>
+    int BTreeIndex::bufferInsert(const T& key, const RecordId rid)
+    {
+        if(!bloomPages.empty())
+            addToBloomFilter(key);
+        DeltaStore<T> &buffer = insertBuffer<T>();
+        buffer.insert(key, rid);
+        return buffer.size();
+    }
+
+    /**
+     * flushInsertBuffer() once the key type of the index is known. The buffer is already in key order, so its
+     * entries are merged into the leaves left to right, each leaf they land in read and written once.
+     */
+    template <class T>
+    void BTreeIndex::flushInsertBufferTyped(bool keepNodeBuffers)
+    {
+        DeltaStore<T> &buffer = insertBuffer<T>();
+        if(buffer.size() > 0){
+            std::vector<RIDKeyPair<T> > sortedEntries;
+            sortedEntries.reserve(buffer.size());
+            for(const typename DeltaStore<T>::Node *node = buffer.first(); node != nullptr; node = node->successor(0))
+                sortedEntries.push_back(node->entry);
+            buffer.clear();
+            if(keepNodeBuffers && nodeBuffering && depth > 0)
+                bufferAtNodes(sortedEntries, depth);
+            else{
+                insertSorted(sortedEntries);
+                insertBufferGeneration++;
+            }
+        }
+        if(!keepNodeBuffers)
+            flushNodeBuffers<T>();
+    }
+
+    /**
+     * Merge the entries of the insert buffer into the tree and empty it, and push the message buffers of the
+     * nonleaves down into the leaves unless keepNodeBuffers is set. The caller holds treeLatch exclusively.
+     * @param keepNodeBuffers
+     */
+    void BTreeIndex::flushInsertBuffer(bool keepNodeBuffers)
+    {
+        switch(attributeType){
+            case INTEGER: flushInsertBufferTyped<int>(keepNodeBuffers); break;
+            case DOUBLE: flushInsertBufferTyped<double>(keepNodeBuffers); break;
+            case STRING: flushInsertBufferTyped<StringKey>(keepNodeBuffers); break;
+            case COMPOSITE: flushInsertBufferTyped<CompositeKey>(keepNodeBuffers); break;
+        }
+    }
+
+    template <class T>
+    void BTreeIndex::bufferAtNodes(const std::vector<RIDKeyPair<T> > &sortedEntries, int height)
+    {
+        size_t i = 0;
+        while(i < sortedEntries.size()){
+            // route the next entry down to its nonleaf height levels above the leaves, and take along the entries
+            // after it that are routed there too.
+            std::vector<PathEntry<T> > path;
+            pushRoot(path, rootPageNum, false);
+            for(int level = depth; level > height; level--){
+                PageId pageNo = path.back().pageNo;
+                Page *page;
+                bufMgr->readPage(file, pageNo, page);
+                NonLeafNode<T> *node = (NonLeafNode<T>*)page;
+                descendChild(path, node, node->lowerBound(sortedEntries[i].key));
+                bufMgr->unPinPage(file, pageNo, false);
+            }
+            size_t end = i + 1;
+            while(end < sortedEntries.size() && path.back().covers(sortedEntries[end].key))
+                end++;
+            PageId nodePageNo = path.back().pageNo;
+            std::map<PageId, NodeBuffer>::iterator it = nodeBuffers.find(nodePageNo);
+            Page *page;
+            if(it == nodeBuffers.end()){
+                NodeBuffer buffer;
+                buffer.height = height;
+                allocIndexPage(buffer.pageNo, page);
+                NodeBufferPage *bufferPage = (NodeBufferPage*)page;
+                bufferPage->nodePageNo = nodePageNo;
+                bufferPage->nextPageNo = MAX_PAGEID;
+                bufferPage->height = height;
+                bufferPage->size = 0;
+                it = nodeBuffers.insert(std::make_pair(nodePageNo, buffer)).first;
+            } else
+                bufMgr->readPage(file, it->second.pageNo, page);
+            NodeBufferPage *bufferPage = (NodeBufferPage*)page;
+            int room = NodeBufferPage::capacity<T>() - bufferPage->size;
+            if(room == 0){
+                bufMgr->unPinPage(file, it->second.pageNo, false);
+                flushNodeBuffer<T>(nodePageNo);
+                continue;
+            }
+            end = std::min(end, i + room);
+            std::copy(sortedEntries.begin() + i, sortedEntries.begin() + end, bufferPage->entries<T>() + bufferPage->size);
+            bufferPage->size += end - i;
+            bufMgr->unPinPage(file, it->second.pageNo, true);
+            i = end;
+        }
+    }
+
+    template <class T>
+    void BTreeIndex::flushNodeBuffer(PageId pageNo)
+    {
+        NodeBuffer buffer = nodeBuffers[pageNo];
+        Page *page;
+        bufMgr->readPage(file, buffer.pageNo, page);
+        NodeBufferPage *bufferPage = (NodeBufferPage*)page;
+        std::vector<RIDKeyPair<T> > sortedEntries(bufferPage->entries<T>(), bufferPage->entries<T>() + bufferPage->size);
+        bufferPage->size = 0;
+        bufMgr->unPinPage(file, buffer.pageNo, true);
+        std::sort(sortedEntries.begin(), sortedEntries.end());
+        if(buffer.height > 1){
+            bufferAtNodes(sortedEntries, buffer.height - 1);
+            return;
+        }
+        insertSorted(sortedEntries);
+        insertBufferGeneration++;
+    }
+
+    template <class T>
+    void BTreeIndex::flushNodeBuffers()
+    {
+        // a buffer is pushed down before those below it, and again whenever a split gave a buffer to a new
+        // sibling of a nonleaf that was already pushed down.
+        for(int height = depth; height > 0 && !nodeBuffers.empty(); height--){
+            std::set<PageId> flushed;
+            bool found = true;
+            while(found){
+                found = false;
+                for(std::map<PageId, NodeBuffer>::const_iterator it = nodeBuffers.begin(); it != nodeBuffers.end(); ++it)
+                    if(it->second.height == height && flushed.insert(it->first).second){
+                        found = true;
+                        flushNodeBuffer<T>(it->first);
+                        break;
+                    }
+            }
+        }
+        for(std::map<PageId, NodeBuffer>::const_iterator it = nodeBuffers.begin(); it != nodeBuffers.end(); ++it)
+            freeIndexPage(it->second.pageNo);
+        nodeBuffers.clear();
+    }
+
+    template <class T>
+    void BTreeIndex::splitNodeBuffer(PageId pageNo, PageId newPageNo, const T& midKey)
+    {
+        std::map<PageId, NodeBuffer>::const_iterator it = nodeBuffers.find(pageNo);
+        if(it == nodeBuffers.end())
+            return;
+        NodeBuffer buffer = it->second;
+        Page *page;
+        bufMgr->readPage(file, buffer.pageNo, page);
+        NodeBufferPage *bufferPage = (NodeBufferPage*)page;
+        RIDKeyPair<T> *entries = bufferPage->entries<T>();
+        // keys equal to midKey stay on the left, where descents route them.
+        std::vector<RIDKeyPair<T> > moved;
+        int kept = 0;
+        for(int i = 0; i < bufferPage->size; i++){
+            if(midKey < entries[i].key)
+                moved.push_back(entries[i]);
+            else
+                entries[kept++] = entries[i];
+        }
+        bufferPage->size = kept;
+        bufMgr->unPinPage(file, buffer.pageNo, !moved.empty());
+        if(moved.empty())
+            return;
+        allocIndexPage(buffer.pageNo, page);
+        bufferPage = (NodeBufferPage*)page;
+        bufferPage->nodePageNo = newPageNo;
+        bufferPage->nextPageNo = MAX_PAGEID;
+        bufferPage->height = buffer.height;
+        bufferPage->size = moved.size();
+        std::copy(moved.begin(), moved.end(), bufferPage->entries<T>());
+        bufMgr->unPinPage(file, buffer.pageNo, true);
+        nodeBuffers[newPageNo] = buffer;
+    }
+
+    template <class T>
+    void BTreeIndex::collectBuffered(PageId pageNo, const ScanRange<T> &range, std::vector<RIDKeyPair<T> > &entries)
+    {
+        Page *page;
+        std::map<PageId, NodeBuffer>::const_iterator it = nodeBuffers.find(pageNo);
+        if(it != nodeBuffers.end()){
+            bufMgr->readPage(file, it->second.pageNo, page);
+            NodeBufferPage *bufferPage = (NodeBufferPage*)page;
+            for(int i = 0; i < bufferPage->size; i++){
+                const RIDKeyPair<T> &entry = bufferPage->entries<T>()[i];
+                if(range.satisfiesLow(entry.key) && range.satisfiesHigh(entry.key))
+                    entries.push_back(entry);
+            }
+            bufMgr->unPinPage(file, it->second.pageNo, false);
+        }
+        bufMgr->readPage(file, pageNo, page);
+        NonLeafNode<T> *node = (NonLeafNode<T>*)page;
+        // child i is routed the keys in (key(i - 1), key(i)].
+        std::vector<PageId> children;
+        for(int i = 0; node->level != 1 && i <= node->size; i++)
+            if((i == 0 || range.satisfiesHigh(node->key(i - 1))) && (i == node->size || range.satisfiesLow(node->key(i))))
+                children.push_back(node->child(i));
+        bufMgr->unPinPage(file, pageNo, false);
+        for(size_t i = 0; i < children.size(); i++)
+            collectBuffered(children[i], range, entries);
+    }
+
+    void BTreeIndex::setNodeBuffers(bool enabled)
+    {
+        if(enabled && !payloadColumns.empty())
+            throw BadIndexInfoException("Inserts into a covering index cannot be buffered");
+        EpochGuard treeGuard(treeLatch, true);
+        if(!enabled){
+            switch(attributeType){
+                case INTEGER: flushNodeBuffers<int>(); break;
+                case DOUBLE: flushNodeBuffers<double>(); break;
+                case STRING: flushNodeBuffers<StringKey>(); break;
+                case COMPOSITE: flushNodeBuffers<CompositeKey>(); break;
+            }
+        }
+        nodeBuffering = enabled;
+    }
+
+    template int BTreeIndex::lookupBatch<int>(const std::vector<int> &, std::vector<RIDKeyPair<int> > &);
+    template int BTreeIndex::lookupBatch<double>(const std::vector<double> &, std::vector<RIDKeyPair<double> > &);
+    template int BTreeIndex::lookupBatch<StringKey>(const std::vector<StringKey> &, std::vector<RIDKeyPair<StringKey> > &);
+    template int BTreeIndex::scanRanges<int>(const std::vector<ScanRange<int> > &, std::vector<RecordId> &);
+    template int BTreeIndex::scanRanges<double>(const std::vector<ScanRange<double> > &, std::vector<RecordId> &);
+    template int BTreeIndex::scanRanges<StringKey>(const std::vector<ScanRange<StringKey> > &, std::vector<RecordId> &);
+    template bool BTreeIndex::select<int>(int, RIDKeyPair<int> &);
+    template bool BTreeIndex::select<double>(int, RIDKeyPair<double> &);
+    template bool BTreeIndex::select<StringKey>(int, RIDKeyPair<StringKey> &);
+    template void BTreeIndex::insertBatch<int>(const std::vector<RIDKeyPair<int> > &);
+    template void BTreeIndex::insertBatch<double>(const std::vector<RIDKeyPair<double> > &);
+    template void BTreeIndex::insertBatch<StringKey>(const std::vector<RIDKeyPair<StringKey> > &);
+    template int BTreeIndex::lookupBatch<CompositeKey>(const std::vector<CompositeKey> &, std::vector<RIDKeyPair<CompositeKey> > &);
+    template int BTreeIndex::scanRanges<CompositeKey>(const std::vector<ScanRange<CompositeKey> > &, std::vector<RecordId> &);
+    template bool BTreeIndex::select<CompositeKey>(int, RIDKeyPair<CompositeKey> &);
+    template void BTreeIndex::insertBatch<CompositeKey>(const std::vector<RIDKeyPair<CompositeKey> > &);
+
+    /**
+     * Begin a filtered scan of the index.  For instance, if the method is called
+     * using ("a",GT,"d",LTE) then we should seek all entries with a value
+     * greater than "a" and less than or equal to "d".
+     * If another scan is already executing, that needs to be ended here.
+     * Set up all the variables for scan. Start from root to find out the leaf page that contains the first RecordID
+     * that satisfies the scan parameters. Keep that page pinned in the buffer pool.
+     * @param lowVal	Low value of range, pointer to integer / double / char string
+     * @param lowOp		Low operator (GT/GTE)
+     * @param highVal	High value of range, pointer to integer / double / char string
+     * @param highOp	High operator (LT/LTE)
+     * @param order		ASCENDING to return entries from the low end up, DESCENDING from the high end down
+     * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values
+     * @throws  BadScanrangeException If lowVal > highval
+     * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
+     */
+    void BTreeIndex::startScan(const void* lowValParm,
+                       const Operator lowOpParm,
+                       const void* highValParm,
+                       const Operator highOpParm,
+                       const ScanOrder orderParm)
+    {
+        //Add your code below. Please do not remove this line.
+        scanCursor.startScan(lowValParm, lowOpParm, highValParm, highOpParm, orderParm);
+    }
+
+    /**
+     * Non-throwing variant of startScan(). Range and operator errors are still reported through exceptions,
+     * but an empty range is reported through the return value.
+     * @param lowVal	Low value of range, pointer to integer / double / char string
+     * @param lowOp		Low operator (GT/GTE)
+     * @param highVal	High value of range, pointer to integer / double / char string
+     * @param highOp	High operator (LT/LTE)
+     * @param order		ASCENDING to return entries from the low end up, DESCENDING from the high end down
+     * @return True if a scan was started, false if no key in the B+ tree satisfies the scan criteria.
+     * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values
+     * @throws  BadScanrangeException If lowVal > highval
+     */
+    bool BTreeIndex::tryStartScan(const void* lowValParm,
+                       const Operator lowOpParm,
+                       const void* highValParm,
+                       const Operator highOpParm,
+                       const ScanOrder orderParm)
+    {
+        return scanCursor.tryStartScan(lowValParm, lowOpParm, highValParm, highOpParm, orderParm);
+    }
+
+    /**
+     * Fetch the record id of the next index entry that matches the scan.
+     * Return the next record from current page being scanned.
+     * If current page has been scanned to its entirety, move on to the right sibling of current page,
+     * if any exists, to start scanning that page. Make sure to unpin any pages that are no longer required.
+     * @param outRid	RecordId of next record found that satisfies the scan criteria returned in this
+     * @throws ScanNotInitializedException If no scan has been initialized.
+     * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
+     */
+    void BTreeIndex::scanNext(RecordId& outRid)
+    {
+        // Add your code below. Please do not remove this line.
+        scanCursor.scanNext(outRid);
+    }
+
+    /**
+     * Non-throwing variant of scanNext().
+     * @param outRid	RecordId of next record found that satisfies the scan criteria returned in this
+     * @return True if outRid was filled in, false if the scan is completed.
+     * @throws ScanNotInitializedException If no scan has been initialized.
+     */
+    bool BTreeIndex::tryScanNext(RecordId& outRid)
+    {
+        return scanCursor.tryScanNext(outRid);
+    }
+
+    /**
+     * Fetch up to maxRids record ids of the next index entries that match the scan. Qualifying entries of the
+     * current leaf are copied out in a single block copy before moving on to the right sibling.
+     * @param outRids	Array of at least maxRids record ids the results are written to
+     * @param maxRids	Maximum number of record ids to return
+     * @return Number of record ids written to outRids. Less than maxRids only if the scan is completed.
+     * @throws ScanNotInitializedException If no scan has been initialized.
+     */
+    int BTreeIndex::scanNextBatch(RecordId* outRids, int maxRids)
+    {
+        return scanCursor.scanNextBatch(outRids, maxRids);
+    }
+
+    /**
+     * Fetch up to maxRids record ids of the next index entries that match the scan together with their payloads.
+     * The payloads are copied out of the leaves along with the record ids.
+     * @param outRids	Array of at least maxRids record ids the results are written to
+     * @param outPayloads	Array of at least maxRids payloads the payloads are written to
+     * @param maxRids	Maximum number of record ids to return
+     * @return Number of record ids written to outRids. Less than maxRids only if the scan is completed.
+     * @throws ScanNotInitializedException If no scan has been initialized.
+     */
+    int BTreeIndex::scanNextBatch(RecordId* outRids, char* outPayloads, int maxRids)
+    {
+        return scanCursor.scanNextBatch(outRids, outPayloads, maxRids);
+    }
+
+    /**
+     * Terminate the current scan. Unpin any pinned pages. Reset scan specific variables.
+     * @throws ScanNotInitializedException If no scan has been initialized.
+     */
+    void BTreeIndex::endScan()
+    {
+        // Add your code below. Please do not remove this line.
+        scanCursor.endScan();
+    }
+
+    // -----------------------------------------------------------------------------
+    // BTreeScanCursor
+    // -----------------------------------------------------------------------------
+
+    /**
+     * BTreeScanCursor Constructor. The cursor is idle until startScan() is called.
+     * @param index	Index to scan
+     */
+    BTreeScanCursor::BTreeScanCursor(BTreeIndex *index)
+        : index(index), scanExecuting(false), nextEntry(-1),
+          currentPageNum(BTreeIndex::MAX_PAGEID), currentPageData(nullptr),
+          pageVersion(0), hasLast(false), resumeAfterLast(false), order(ASCENDING), nextDelta(0), deltaGeneration(0)
+    {
+        ridPosition.entry = -1;
+    }
+
+    /**
+     * BTreeScanCursor Destructor. Ends the scan, unpinning its leaf, if one is executing.
      */
-    BTreeIndex::~BTreeIndex()
+    BTreeScanCursor::~BTreeScanCursor()
     {
-        // Add your code below. Please do not remove this line.
-        // end possible scan.
         if(scanExecuting) endScan();
-        // update meta page.
-        Page *metaPage;
-        bufMgr->readPage(file, headerPageNum, metaPage);
-        IndexMetaInfo *metaInfo = (IndexMetaInfo*)metaPage;
-        metaInfo->attrType = attributeType;
-        metaInfo->attrByteOffset = attrByteOffset;
-        metaInfo->rootPageNo = rootPageNum;
-        metaInfo->leafOccupancy = leafOccupancy;
-        metaInfo->nodeOccupancy = nodeOccupancy;
-        metaInfo->depth = depth;
-        bufMgr->unPinPage(file, headerPageNum, true);
-        // flush index file.
-        bufMgr->flushFile(file);
-        // delete index file.
-        delete file;
     }
 
     /**
-     * Print the statistics about this Tree.
+     * Low and high values of the current scan range for each key type.
      */
-    void BTreeIndex::printTreeStatus(){
-        printf("Tree Status: \n");
-        Page *metaPage;
-        bufMgr->readPage(file, headerPageNum, metaPage);
-        bufMgr->unPinPage(file, headerPageNum, false);
-        IndexMetaInfo *metaInfo = (IndexMetaInfo*)metaPage;
-        printf("\trelationName: %s\n", metaInfo->relationName);
-        printf("\tdepth: %d\n", depth);
-        printf("\theaderPageNum: %d\n", headerPageNum);
-        printf("\trootPageNum: %d\n", rootPageNum);
-        printf("\tleafOccupancy: %d\n", leafOccupancy);
-        printf("\tnodeOccupancy: %d\n", nodeOccupancy);
-        printf("\tINTARRAYNONLEAFSIZE: %d\n", INTARRAYNONLEAFSIZE);
-        printf("\tINTARRAYLEAFSIZE: %d\n", INTARRAYLEAFSIZE);
+    template <>
+    int& BTreeScanCursor::lowVal<int>(){
+        return lowValInt;
+    }
+
+    template <>
+    double& BTreeScanCursor::lowVal<double>(){
+        return lowValDouble;
+    }
+
+    template <>
+    StringKey& BTreeScanCursor::lowVal<StringKey>(){
+        return lowValString;
+    }
+
+    template <>
+    CompositeKey& BTreeScanCursor::lowVal<CompositeKey>(){
+        return lowValComposite;
+    }
+
+    template <>
+    int& BTreeScanCursor::highVal<int>(){
+        return highValInt;
+    }
+
+    template <>
+    double& BTreeScanCursor::highVal<double>(){
+        return highValDouble;
+    }
+
+    template <>
+    StringKey& BTreeScanCursor::highVal<StringKey>(){
+        return highValString;
+    }
+
+    template <>
+    CompositeKey& BTreeScanCursor::highVal<CompositeKey>(){
+        return highValComposite;
     }
 
     /**
-     * Print the statistics of a node. Recognize node type within method.
-     * @param id
-     * @param page
+     * Key of the last entry returned for each key type.
      */
-        void BTreeIndex::printNode(PageId id, Page* page){
-            Nodetype type = *(Nodetype*)page;
-            if(type == NONLEAF){
-                NonLeafNodeInt *node = (NonLeafNodeInt*)page;
-                printf("Internal node %d Stats:\n", id);
-                printf("\tsize: %d\n", node->size);
-                if(node->size != 0)
-                    printf("\tminKey: %d maxKey: %d\n", node->keyArray[0], node->keyArray[node->size - 1]);
-                printf("\tkeyArray: ");
-                for(int i = 0; i < node->size; i++)
-                    printf("%d ", node->keyArray[i]);
-                printf("\n");
-                printf("\tchildren: ");
-                for(int i = 0; i < node->size + 1; i++)
-                    printf("%d ", node->pageNoArray[i]);
-                printf("\n");
-            } else{
-                LeafNodeInt *node = (LeafNodeInt*)page;
-                printf("Leaf node %d Stats:\n", id);
-                printf("\tsize: %d\n", node->size);
-                if(node->size != 0)
-                    printf("\tminKey: %d maxKey: %d\n", node->keyArray[0], node->keyArray[node->size - 1]);
-                printf("\trightSib: %d\n", node->rightSibPageNo);
-                printf("\tkeyArray: ");
-                for(int i = 0; i < node->size; i++)
-                    printf("%d ", node->keyArray[i]);
-                printf("\n");
-            }
-        }
+    template <>
+    int& BTreeScanCursor::lastVal<int>(){
+        return lastValInt;
+    }
+
+    template <>
+    double& BTreeScanCursor::lastVal<double>(){
+        return lastValDouble;
+    }
+
+    template <>
+    StringKey& BTreeScanCursor::lastVal<StringKey>(){
+        return lastValString;
+    }
+
+    template <>
+    CompositeKey& BTreeScanCursor::lastVal<CompositeKey>(){
+        return lastValComposite;
+    }
 
     /**
-     * Recursively find the PageId of the target leaf node.
-     * @param pageId
-     * @param key
-     * @return
+     * Path of the current DESCENDING scan for each key type.
      */
-    PageId BTreeIndex::findTargetLeafHelper(PageId pageId, const void *key){
-        Page *page;
-        bufMgr->readPage(file, pageId, page);
-        bufMgr->unPinPage(file, pageId, false);
-        NonLeafNodeInt* node = ((NonLeafNodeInt*)page);
-        PageId targetPageId;
-
-        // targetIndex should meet the following condition: keyArray[targetIndex] >= key > keyArray[targetIndex-1].
-        int targetIndex = 0, intKey = *(int*)key;
-        while(targetIndex < node->size && node->keyArray[targetIndex] <= intKey)
-            targetIndex++;
-
-        if(node->level == 1){
-            // base case.
-            targetPageId = node->pageNoArray[targetIndex];
-        } else{
-            // recursive case.
-            targetPageId = findTargetLeafHelper(node->pageNoArray[targetIndex], key);
-        }
+    template <>
+    std::vector<PathEntry<int> >& BTreeScanCursor::path<int>(){
+        return pathInt;
+    }
+
+    template <>
+    std::vector<PathEntry<double> >& BTreeScanCursor::path<double>(){
+        return pathDouble;
+    }
+
+    template <>
+    std::vector<PathEntry<StringKey> >& BTreeScanCursor::path<StringKey>(){
+        return pathString;
+    }
 
-        return targetPageId;
+    template <>
+    std::vector<PathEntry<CompositeKey> >& BTreeScanCursor::path<CompositeKey>(){
+        return pathComposite;
     }
 
     /**
-     * Return the leaf node PageId to insert the key in.
-     * @param key
-     * @return Leaf node PageId to insert the key in.
+     * Insert buffer snapshot of the current scan for each key type.
      */
-    PageId BTreeIndex::findTargetLeaf(const void *key){
-        if(depth == 0)
-            return rootPageNum;
-        else
-            return findTargetLeafHelper(rootPageNum, key);
+    template <>
+    std::vector<RIDKeyPair<int> >& BTreeScanCursor::delta<int>(){
+        return deltaInt;
+    }
+
+    template <>
+    std::vector<RIDKeyPair<double> >& BTreeScanCursor::delta<double>(){
+        return deltaDouble;
+    }
+
+    template <>
+    std::vector<RIDKeyPair<StringKey> >& BTreeScanCursor::delta<StringKey>(){
+        return deltaString;
+    }
+
+    template <>
+    std::vector<RIDKeyPair<CompositeKey> >& BTreeScanCursor::delta<CompositeKey>(){
+        return deltaComposite;
     }
 
     /**
-     * Checks whether the node is full.
-     * @param node
-     * @return True if the node is full, false otherwise.
-     */
-    bool BTreeIndex::isFull(PageId targetId){
-        Page *node;
-        bufMgr->readPage(file, targetId, node);
-        bufMgr->unPinPage(file, targetId, false);
-        Nodetype type = *(Nodetype*)node; // Nodetype is the first attribute for both types of nodes.
-        if(type == NONLEAF)
-            return ((NonLeafNodeInt*)node)->size == INTARRAYNONLEAFSIZE;
-        else
-            return ((LeafNodeInt*)node)->size == INTARRAYLEAFSIZE;
+     * Copy the entries of the range in the insert buffer of the index and in the message buffers of its nonleaves
+     * into the snapshot, in key order, and position the scan at its first entry, or past its last one for a
+     * DESCENDING scan. The caller holds treeLatch shared.
+     */
+    template <class T>
+    void BTreeScanCursor::snapshotDelta(){
+        std::vector<RIDKeyPair<T> > &snapshot = delta<T>();
+        snapshot.clear();
+        const DeltaStore<T> &buffer = index->insertBuffer<T>();
+        deltaGeneration = index->insertBufferGeneration;
+        if(buffer.size() > 0)
+            for(const typename DeltaStore<T>::Node *node = buffer.seek(lowVal<T>(), lowOp == GT);
+                    node != nullptr && satisfiesHigh(node->entry.key); node = node->successor(0))
+                snapshot.push_back(node->entry);
+        if(!index->nodeBuffers.empty()){
+            ScanRange<T> range;
+            range.set(lowVal<T>(), lowOp, highVal<T>(), highOp);
+            std::vector<RIDKeyPair<T> > buffered;
+            index->collectBuffered(index->rootPageNum, range, buffered);
+            std::sort(buffered.begin(), buffered.end());
+            size_t middle = snapshot.size();
+            snapshot.insert(snapshot.end(), buffered.begin(), buffered.end());
+            std::inplace_merge(snapshot.begin(), snapshot.begin() + middle, snapshot.end(),
+                [](const RIDKeyPair<T> &a, const RIDKeyPair<T> &b){ return a.key < b.key; });
+        }
+        nextDelta = order == DESCENDING ? snapshot.size() : 0;
     }
 
     /**
-     * Assume leaf is not full. Insert the key-rid pair into the leaf.
-     * @param node
-     * @param key
-     * @param rid
+     * Drop the record ids of entries [from, from + count) of node that are in the snapshot from rids.
+     * @return Number of record ids kept, at the front of rids.
      */
-    void BTreeIndex::naiveInsertLeaf(PageId targetLeafId, const void *key, const RecordId rid){
-        Page *targetLeaf;
-        bufMgr->readPage(file, targetLeafId, targetLeaf);
-        LeafNodeInt *leafNode = (LeafNodeInt*)targetLeaf;
-        // find the target index that maintains the ascending order upon inserting new key.
-        int targetIndex = 0, intKey = *(int*)key;
-        while(targetIndex < leafNode->size && leafNode->keyArray[targetIndex] < intKey)
-            targetIndex++;
-        // insert key and rid to targetIndex.
-        for(int i = leafNode->size; i > targetIndex; i--){
-            leafNode->keyArray[i] = leafNode->keyArray[i - 1];
-            leafNode->ridArray[i] = leafNode->ridArray[i - 1];
-        }
-        leafNode->keyArray[targetIndex] = intKey;
-        leafNode->ridArray[targetIndex] = rid;
-        leafNode->size++;
-        bufMgr->unPinPage(file, targetLeafId, true);
-        leafOccupancy++;
+    template <class T>
+    int BTreeScanCursor::dropMerged(LeafNode<T> *node, int from, RecordId* rids, int count){
+        const std::vector<RIDKeyPair<T> > &snapshot = delta<T>();
+        // the last entry of the snapshot returned so far, if any.
+        const RIDKeyPair<T> *passed = nullptr;
+        if(order == DESCENDING ? nextDelta < (int)snapshot.size() : nextDelta > 0)
+            passed = &snapshot[order == DESCENDING ? nextDelta : nextDelta - 1];
+        int kept = 0;
+        for(int i = 0; i < count; i++){
+            const T &key = node->key(from + i);
+            if(passed != nullptr && (order == DESCENDING ? passed->key < key : key < passed->key))
+                continue;
+            RIDKeyPair<T> probe;
+            probe.set(rids[i], key);
+            probe.rid.page_number = 0;
+            // entries with equal keys are in insertion order, so only the first of them is found by binary search.
+            typename std::vector<RIDKeyPair<T> >::const_iterator it = std::lower_bound(snapshot.begin(), snapshot.end(), probe);
+            while(it != snapshot.end() && !(probe.key < it->key) && !(it->rid == rids[i]))
+                ++it;
+            if(it == snapshot.end() || probe.key < it->key)
+                rids[kept++] = rids[i];
+        }
+        return kept;
     }
 
     /**
-     * Assume nonleaf is not full, Insert the key-pageNo pair into the nonleaf.
-     * @param targetNonLeaf
+     * Checks whether the key satisfies the high end of the current scan range.
      * @param key
-     * @param pageNo
+     * @return True if key is below the high value (LT) or not above it (LTE).
      */
-    void BTreeIndex::naiveInsertNonLeaf(PageId targetNonLeafId, const void *key, PageId pageNo){
-        Page *targetNonLeaf;
-        bufMgr->readPage(file, targetNonLeafId, targetNonLeaf);
-        NonLeafNodeInt *nonLeafNode = (NonLeafNodeInt*)targetNonLeaf;
-        // find the target index that maintains the ascending order upon inserting new key.
-        int targetIndex = 0, intKey = *(int*)key;
-        while(targetIndex < nonLeafNode->size && nonLeafNode->keyArray[targetIndex] < intKey)
-            targetIndex++;
-        // inserting key and pageNo to targetIndex and targetIndex + 1, respectively.
-        // assume minKeyIn(pageNo) > maxKeyIn(pageNoArray[targetIndex]).
-        for (int i = nonLeafNode->size; i > targetIndex; i--) {
-            nonLeafNode->keyArray[i] = nonLeafNode->keyArray[i - 1];
-            nonLeafNode->pageNoArray[i + 1] = nonLeafNode->pageNoArray[i];
-        }
-        nonLeafNode->keyArray[targetIndex] = intKey;
-        nonLeafNode->pageNoArray[targetIndex + 1] = pageNo;
-        nonLeafNode->size++;
-        bufMgr->unPinPage(file, targetNonLeafId, true);
-        nodeOccupancy++;
+    template <class T>
+    bool BTreeScanCursor::satisfiesHigh(const T& key){
+        return highOp == LT ? key < highVal<T>() : !(highVal<T>() < key);
     }
 
     /**
-     * Insert key, leftPageNo, and rightPageNo to the empty (newly created) root. All keys in leftPage are smaller than
-     * those in the right page.
+     * Checks whether the key satisfies the low end of the current scan range.
      * @param key
-     * @param leftPageNo
-     * @param rightPageNo
+     * @return True if key is above the low value (GT) or not below it (GTE).
      */
-    void BTreeIndex::insertNewRoot(const void *key, PageId leftPageNo, PageId rightPageNo){
-        Page *rootPage;
-        int intKey = *(int*)key;
-        bufMgr->readPage(file, rootPageNum, rootPage);
-        NonLeafNodeInt *rootNode = (NonLeafNodeInt*)rootPage;
-        rootNode->keyArray[0] = intKey;
-        rootNode->pageNoArray[0] = leftPageNo;
-        rootNode->pageNoArray[1] = rightPageNo;
-        rootNode->size++;
-        bufMgr->unPinPage(file, rootPageNum, true);
-        nodeOccupancy++;
+    template <class T>
+    bool BTreeScanCursor::satisfiesLow(const T& key){
+        return lowOp == GT ? lowVal<T>() < key : !(key < lowVal<T>());
     }
 
     /**
-     * Assume nonleaf is full. Insert key-pageNo pair and perform recursive split.
-     * @param targetNonLeafId
-     * @param key
-     * @param pageNo
+     * Index of the first entry in the leaf that satisfies the low end of the current scan range.
+     * @param node
+     * @return Index in [0, node->size]; node->size if no entry in this leaf qualifies.
      */
-    void BTreeIndex::insertNonLeaf(PageId targetNonLeafId, const void *key, PageId pageNo){
-        printf("inserting NonLeaf, target id: %d\n", targetNonLeafId);
-        // create newNonLeaf
-        Page *targetNonLeaf, *newNonLeaf;
-        PageId newNonLeafId;
-        bufMgr->readPage(file, targetNonLeafId, targetNonLeaf);
-        bufMgr->allocPage(file, newNonLeafId, newNonLeaf);
-        NonLeafNodeInt *targetNode = (NonLeafNodeInt*)targetNonLeaf;
-        NonLeafNodeInt *newNode = (NonLeafNodeInt*)newNonLeaf;
-        newNode->type = NONLEAF;
-        newNode->level = targetNode->level;
-
-        // split keys into left keys, mid key, and right keys.
-        int midIndex = (INTARRAYNONLEAFSIZE + 1) / 2;
-        int leftKeys[INTARRAYNONLEAFSIZE], rightKeys[INTARRAYNONLEAFSIZE], totalKeys[INTARRAYNONLEAFSIZE + 1];
-        int leftSize = 0, rightSize = 0, intKey = *(int*)key, i, j;
-        for(i = 0; i < INTARRAYNONLEAFSIZE && targetNode->keyArray[i] < intKey; i++)
-            totalKeys[i] = targetNode->keyArray[i];
-        totalKeys[i] = intKey;
-        for(; i < INTARRAYNONLEAFSIZE; i++)
-            totalKeys[i + 1] = targetNode->keyArray[i];
-        for(i = 0; i < midIndex; i++) {
-            leftKeys[i] = totalKeys[i];
-            leftSize++;
-        }
-        int *midKey = new int;
-        *midKey = totalKeys[i++];
-        for(j = i; j < INTARRAYNONLEAFSIZE + 1; j++) {
-            rightKeys[j - i] = totalKeys[j];
-            rightSize++;
-        }
-        // split pageNo into left pageNo and right pageNo.
-        int leftPageNo[INTARRAYNONLEAFSIZE + 1], rightPageNo[INTARRAYNONLEAFSIZE + 1], totalPageNo[INTARRAYNONLEAFSIZE + 2];
-        for(i = 0; i < INTARRAYNONLEAFSIZE + 1 && targetNode->keyArray[i] < intKey; i++)
-            totalPageNo[i] = targetNode->pageNoArray[i];
-        totalPageNo[i] = pageNo; //   i = insert key index + 1
-        for(; i < INTARRAYNONLEAFSIZE + 1; i++)
-            totalPageNo[i + 1] = targetNode->pageNoArray[i];
-        for(i = 0; i <= midIndex; i++)
-            leftPageNo[i] = totalPageNo[i];
-        for(j = i; j < INTARRAYNONLEAFSIZE + 2; j++)
-            rightPageNo[j - i] = totalPageNo[j];
-        // assign left to targetNonLeaf, right to newNonLeaf
-        targetNode->size = leftSize;
-        std::copy(std::begin(leftKeys), std::end(leftKeys), std::begin(targetNode->keyArray));
-        std::copy(std::begin(leftPageNo), std::end(leftPageNo), std::begin(targetNode->pageNoArray));
-        newNode->size = rightSize;
-        std::copy(std::begin(rightKeys), std::end(rightKeys), std::begin(newNode->keyArray));
-        std::copy(std::begin(rightPageNo), std::end(rightPageNo), std::begin(newNode->pageNoArray));
-
-        // change the parent entry for children in right node.
-        for(i = 0; i < rightSize + 1; i++){
-            Page *childPage;
-            PageId childPageId = newNode->pageNoArray[i];
-            bufMgr->readPage(file, childPageId, childPage);
-            if(targetNode->level == 0){
-                NonLeafNodeInt* childNode = (NonLeafNodeInt*)childPage;
-                childNode->parentId = newNonLeafId;
-            } else{
-                LeafNodeInt* childNode = (LeafNodeInt*)childPage;
-                childNode->parentId = newNonLeafId;
-            }
-            bufMgr->unPinPage(file, childPageId, true);
-        }
-        nodeOccupancy++;
-        // find parent for targetNonLeaf and newNonLeaf.
-        PageId parentPageId;
-        if(targetNode->parentId == MAX_PAGEID){
-            // targetNode is root, allocate and setup parent page.
-            Page *parentPage;
-            bufMgr->allocPage(file, parentPageId, parentPage);
-            NonLeafNodeInt *parentNode = (NonLeafNodeInt*)parentPage;
-            parentNode->type = NONLEAF;
-            parentNode->parentId = MAX_PAGEID;
-            parentNode->size = 0;
-            parentNode->level = 0;
-            bufMgr->unPinPage(file, parentPageId, true);
-            rootPageNum = parentPageId;
-            depth++;
-            // link targetNonLeaf and newNonLeaf to parent.
-            targetNode->parentId = newNode->parentId = parentPageId;
-            bufMgr->unPinPage(file, targetNonLeafId, true);
-            bufMgr->unPinPage(file, newNonLeafId, true);
-            // insert mid key to parent.
-            insertNewRoot(midKey, targetNonLeafId, newNonLeafId);
-        } else{
-            parentPageId = targetNode->parentId;
-            // link targetNonLeaf and newNonLeaf to parent.
-            newNode->parentId = parentPageId;
-            bufMgr->unPinPage(file, targetNonLeafId, true);
-            bufMgr->unPinPage(file, newNonLeafId, true);
-            // insert mid key to parent.
-            if(isFull(parentPageId)){
-                insertNonLeaf(parentPageId, midKey, newNonLeafId); // todo: passing stack pointer to another call.
-            } else {
-                naiveInsertNonLeaf(parentPageId, midKey, newNonLeafId);
-            }
+    template <class T>
+    int BTreeScanCursor::lowBoundIndex(LeafNode<T> *node){
+        // a descending scan asks every leaf, most of which lie entirely inside the range.
+        if(node->size > 0 && satisfiesLow(node->key(0)))
+            return 0;
+        if(lowOp == GT)
+            return node->upperBound(0, lowVal<T>());
+        return node->lowerBound(0, lowVal<T>());
+    }
+
+    /**
+     * Index one past the last entry, starting at nextEntry, of the current leaf that satisfies
+     * the high end of the current scan range.
+     * @param node
+     * @return Index in [nextEntry, node->size].
+     */
+    template <class T>
+    int BTreeScanCursor::highBoundIndex(LeafNode<T> *node){
+        // most leaves of a range lie entirely inside it, check the last key before searching.
+        if(nextEntry == node->size || satisfiesHigh(node->key(node->size - 1)))
+            return node->size;
+        if(highOp == LT)
+            return node->lowerBound(nextEntry, highVal<T>());
+        return node->upperBound(nextEntry, highVal<T>());
+    }
+
+    /**
+     * Index of the entry after the last one returned in the latched current leaf. If that entry is not in
+     * the leaf, the end of its run of equal keys while it may lie further right, else the start of the run.
+     * @param node
+     * @param movedOn		True if the leaf comes after the one the entry was returned from
+     */
+    template <class T>
+    int BTreeScanCursor::resumeIndex(LeafNode<T> *node, bool movedOn){
+        const T &key = lastVal<T>();
+        int first = node->lowerBound(0, key);
+        int last = node->upperBound(first, key);
+        std::vector<RecordId> runRids(last - first);
+        node->copyRids(first, last - first, runRids.data());
+        int pos = first + (std::find(runRids.begin(), runRids.end(), lastRid) - runRids.begin());
+        resumeAfterLast = false;
+        if(pos < last)
+            return pos + 1;
+        // a split moves the entries from some point on to a new right sibling, the entry went there with
+        // everything after it. Further splits may have moved it on past this leaf as well.
+        if(!movedOn || last == node->size){
+            resumeAfterLast = true;
+            return last;
         }
+        return first;
     }
 
     /**
-     * Assume leaf is full. Insert key-rid pair and perform recursive split.
-     * @param targetLeafId
-     * @param key
-     * @param rid
+     * Index of the last entry returned by a DESCENDING scan in the latched current leaf, which is where the
+     * scan goes on below. A split may have moved the entry to a leaf further right; the current leaf is moved
+     * there then. If the entry is gone, the start of its run of equal keys.
      */
-    void BTreeIndex::insertLeaf(PageId targetLeafId, const void *key, const RecordId rid){
-        Page *targetLeaf, *newLeaf;
-        PageId newLeafId;
-        bufMgr->readPage(file, targetLeafId, targetLeaf);
-        bufMgr->allocPage(file, newLeafId, newLeaf);
-        LeafNodeInt *targetNode = (LeafNodeInt*)targetLeaf;
-        LeafNodeInt *newNode = (LeafNodeInt*)newLeaf;
-        newNode->type = LEAF;
-        int midIndex = (INTARRAYLEAFSIZE + 1) / 2;
-        // split keys and ids into left keys, right keys, and left ids, right ids, where right is bigger than left.
-        int leftKeys[INTARRAYLEAFSIZE], rightKeys[INTARRAYLEAFSIZE], totalKeys[INTARRAYLEAFSIZE + 1];
-        int leftSize = 0, rightSize = 0, intKey = *(int*)key, i, j;
-        RecordId leftIds[INTARRAYLEAFSIZE], rightIds[INTARRAYLEAFSIZE], totalIds[INTARRAYLEAFSIZE + 1];
-        for(i = 0; i < INTARRAYLEAFSIZE && targetNode->keyArray[i] < intKey; i++) {
-            totalKeys[i] = targetNode->keyArray[i];
-            totalIds[i] = targetNode->ridArray[i];
-        }
-        totalKeys[i] = intKey;
-        totalIds[i] = rid;
-        for(; i < INTARRAYLEAFSIZE; i++){
-            totalKeys[i + 1] = targetNode->keyArray[i];
-            totalIds[i + 1] = targetNode->ridArray[i];
-        }
-        for(i = 0; i < midIndex; i++){
-            leftKeys[i] = totalKeys[i];
-            leftIds[i] = totalIds[i];
-            leftSize++;
-        }
-        int *midKey = new int;
-        *midKey = totalKeys[i];
-        for(j = i; j < INTARRAYLEAFSIZE + 1; j++){
-            rightKeys[j - i] = totalKeys[j];
-            rightIds[j - i] = totalIds[j];
-            rightSize++;
-        }
-        // let targetNode be the left node, newNode be the right node.
-        targetNode->size = leftSize;
-        std::copy(std::begin(leftKeys), std::end(leftKeys), std::begin(targetNode->keyArray));
-        std::copy(std::begin(leftIds), std::end(leftIds), std::begin(targetNode->ridArray));
-        newNode->size = rightSize;
-        std::copy(std::begin(rightKeys), std::end(rightKeys), std::begin(newNode->keyArray));
-        std::copy(std::begin(rightIds), std::end(rightIds), std::begin(newNode->ridArray));
-        newNode->rightSibPageNo = targetNode->rightSibPageNo;
-        targetNode->rightSibPageNo = newLeafId;
-        leafOccupancy++;
-        // link newNode to targetNode's parent node.
-        PageId parentPageId;
-        if(targetNode->parentId == MAX_PAGEID){
-            // targetNode is root, allocate and setup parent page.
-            Page *parentPage;
-            bufMgr->allocPage(file, parentPageId, parentPage);
-            NonLeafNodeInt *parentNode = (NonLeafNodeInt*)parentPage;
-            parentNode->type = NONLEAF;
-            parentNode->parentId = MAX_PAGEID;
-            parentNode->size = 0;
-            parentNode->level = 1;
-            bufMgr->unPinPage(file, parentPageId, true);
-            rootPageNum = parentPageId;
-            depth++;
-            // link targetNonLeaf and newNonLeaf to parent.
-            targetNode->parentId = newNode->parentId = parentPageId;
-            bufMgr->unPinPage(file, targetLeafId, true);
-            bufMgr->unPinPage(file, newLeafId, true);
-            // insert midKey to parent.
-            insertNewRoot(midKey, targetLeafId, newLeafId);
-        } else{
-            parentPageId = targetNode->parentId;
-            newNode->parentId = parentPageId;
-            bufMgr->unPinPage(file, targetLeafId, true);
-            bufMgr->unPinPage(file, newLeafId, true);
-            if(isFull(parentPageId)){
-                insertNonLeaf(parentPageId, midKey, newLeafId);
-            } else {
-                naiveInsertNonLeaf(parentPageId, midKey, newLeafId); // todo: check
+    template <class T>
+    int BTreeScanCursor::resumeBeforeLast(){
+        const T &key = lastVal<T>();
+        while(1){
+            LeafNode<T> *node = (LeafNode<T>*)currentPageData;
+            int first = node->lowerBound(0, key);
+            int last = node->upperBound(first, key);
+            std::vector<RecordId> runRids(last - first);
+            node->copyRids(first, last - first, runRids.data());
+            int pos = first + (std::find(runRids.begin(), runRids.end(), lastRid) - runRids.begin());
+            if(pos < last)
+                return pos;
+            // a split moves the entries from some point on to a new right sibling, the entry went there with
+            // everything after it, and the entries of that sibling before it were not returned yet.
+            PageId rightSibPageNo = node->rightSibPageNo;
+            if(last < node->size || rightSibPageNo == BTreeIndex::MAX_PAGEID)
+                return first;
+            Page *rightPage;
+            index->bufMgr->readPage(index->file, rightSibPageNo, rightPage);
+            index->bufMgr->latchPage(rightPage, false);
+            LeafNode<T> *right = (LeafNode<T>*)rightPage;
+            if(right->size == 0 || key < right->key(0)){
+                index->bufMgr->unlatchPage(rightPage, false);
+                index->bufMgr->unPinPage(index->file, rightSibPageNo, false);
+                return first;
             }
+            index->bufMgr->unlatchPage(currentPageData, false);
+            index->bufMgr->unPinPage(index->file, currentPageNum, false);
+            currentPageNum = rightSibPageNo;
+            currentPageData = rightPage;
         }
     }
 
     /**
-     * Insert a new entry using the pair <value,rid>.
-     * Start from root to recursively find out the leaf to insert the entry in. The insertion may cause splitting of leaf node.
-     * This splitting will require addition of new leaf page number entry into the parent non-leaf, which may in-turn get split.
-     * This may continue all the way upto the root causing the root to get split. If root gets split, metapage needs to be changed accordingly.
-     * Make sure to unpin pages as soon as you can.
-     * @param key			Key to insert, pointer to integer/double/char string
-     * @param rid			Record ID of a record whose entry is getting inserted into the index.
+     * Set scanExecuting, and count the scan among the open scans of the index while it is set.
      */
-    void BTreeIndex::insertEntry(const void *key, const RecordId rid)
-    {
-        // Add your code below. Please do not remove this line.
-        PageId targetLeafId = findTargetLeaf(key);
-        if(isFull(targetLeafId)){
-            insertLeaf(targetLeafId, key, rid);
-        }else{
-            naiveInsertLeaf(targetLeafId, key, rid);
-        }
+    void BTreeScanCursor::setExecuting(bool executing){
+        if(executing != scanExecuting)
+            index->numOpenScans += executing ? 1 : -1;
+        scanExecuting = executing;
     }
 
     /**
-     * Find the index of the given key in leaf node
-     * @param key
-     * @param leaf node
-     * @param the updated leaf node contains given key
-     * @param the page id of new leaf node
+     * Release the latch of the current leaf, remembering its version.
      */
-    int BTreeIndex::searchHelper(const void *key, LeafNodeInt* node, LeafNodeInt*& new_node, PageId& new_id)
-    {
-        int targetIndex = -1;
+    void BTreeScanCursor::unlatchCurrent(){
+        pageVersion = index->bufMgr->pageVersion(currentPageData);
+        index->bufMgr->unlatchPage(currentPageData, false);
+    }
 
-        // the node found is the last node, no right sibling
-        for (int i = 0; i < node->size; i++) {
-            if (node->keyArray[i] >= *((int*)key)) {
-                targetIndex = i;
-                break;
-            }
-        }
+    /**
+     * Unpin the current leaf, which is not latched, and leave the scan exhausted.
+     */
+    void BTreeScanCursor::releaseCurrent(){
+        index->bufMgr->unPinPage(index->file, currentPageNum, false);
+        currentPageNum = BTreeIndex::MAX_PAGEID;
+        currentPageData = nullptr;
+    }
 
-        // if -1, move on to next page
-        while (targetIndex == -1 && node->rightSibPageNo != MAX_PAGEID) {
-            // update node
-            bufMgr->unPinPage(file, ((Page*)node)->page_number(), false);
-            currentPageNum = node->rightSibPageNo;
-            Page *rightSibpage;
-            bufMgr->readPage(file, node->rightSibPageNo, rightSibpage);
-            node = (LeafNodeInt*)rightSibpage;
-            new_node = node; // return the new node TODO
-            new_id = node->rightSibPageNo;
+    /**
+     * Unpin the current scan leaf and pin its right sibling, latching it before the current leaf is
+     * released. Leaves the scan exhausted (currentPageNum = BTreeIndex::MAX_PAGEID) if there is no right sibling, and
+     * nextEntry at the first entry of the sibling that is in range and was not returned yet otherwise.
+     * @return True if a right sibling was pinned.
+     */
+    template <class T>
+    bool BTreeScanCursor::advanceScanLeaf(){
+        PageId rightSibPageNo = ((LeafNode<T>*)currentPageData)->rightSibPageNo;
+        Page *rightPage = nullptr;
+        if(rightSibPageNo != BTreeIndex::MAX_PAGEID){
+            index->bufMgr->readPage(index->file, rightSibPageNo, rightPage);
+            index->bufMgr->latchPage(rightPage, false);
+        }
+        index->bufMgr->unlatchPage(currentPageData, false);
+        index->bufMgr->unPinPage(index->file, currentPageNum, false);
+        currentPageNum = rightSibPageNo;
+        currentPageData = rightPage;
+        nextEntry = 0;
+        ridPosition.entry = -1;
+        if(rightPage == nullptr)
+            return false;
+        if(resumeAfterLast)
+            nextEntry = resumeIndex((LeafNode<T>*)currentPageData, true);
+        else if(!hasLast)
+            // a split since the scan started may have moved keys below the range into this leaf.
+            nextEntry = lowBoundIndex((LeafNode<T>*)currentPageData);
+        return true;
+    }
 
-            for (int i = 0; i < node->size; i++) {
-                if (node->keyArray[i] >= *((int*)key)) {
-                    targetIndex = i;
-                    break;
-                }
-            }
+    /**
+     * Unpin the current scan leaf, which is latched, and pin and latch its left sibling, found through the
+     * path of the scan. Leaves the scan exhausted if there is no left sibling, and nextEntry one past the last
+     * entry of the sibling that is in range and was not returned yet otherwise.
+     * @return True if a left sibling was pinned.
+     */
+    template <class T>
+    bool BTreeScanCursor::retreatScanLeaf(){
+        // leaves are latched left to right, let go of this one before latching one to its left.
+        PageId pageNo = currentPageNum;
+        index->bufMgr->unlatchPage(currentPageData, false);
+        releaseCurrent();
+        Page *leftPage;
+        PageId leftPageNo = index->latchLeftSibling(path<T>(), pageNo, leftPage);
+        ridPosition.entry = -1;
+        if(leftPageNo == BTreeIndex::MAX_PAGEID)
+            return false;
+        currentPageNum = leftPageNo;
+        currentPageData = leftPage;
+        LeafNode<T> *node = (LeafNode<T>*)currentPageData;
+        nextEntry = node->size;
+        if(!hasLast){
+            // a split since the scan started may have moved keys above the range into this leaf.
+            nextEntry = 0;
+            nextEntry = highBoundIndex(node);
         }
+        return true;
+    }
 
-        return targetIndex;
+    /**
+     * Latch the last leaf that may hold entries satisfying the high end of the range and position nextEntry
+     * one past the last of them, moving left past leaves that hold none. Starts a DESCENDING scan.
+     * @return False if no leaf holds an entry satisfying the high end; the scan is left exhausted then.
+     */
+    template <class T>
+    bool BTreeScanCursor::seekHigh(){
+        // LTE ranges end with the duplicates of the high value, which may run on past the first leaf holding it.
+        currentPageNum = index->latchLeaf(highVal<T>(), false, currentPageData, &path<T>(), highOp == LTE);
+        ridPosition.entry = -1;
+        nextEntry = 0;
+        nextEntry = highBoundIndex((LeafNode<T>*)currentPageData);
+        while(nextEntry == 0){
+            if(!retreatScanLeaf<T>())
+                return false;
+        }
+        return true;
     }
 
     /**
      * Begin a filtered scan of the index.  For instance, if the method is called
      * using ("a",GT,"d",LTE) then we should seek all entries with a value
      * greater than "a" and less than or equal to "d".
-     * If another scan is already executing, that needs to be ended here.
+     * If this cursor is already executing a scan, that needs to be ended here.
      * Set up all the variables for scan. Start from root to find out the leaf page that contains the first RecordID
      * that satisfies the scan parameters. Keep that page pinned in the buffer pool.
      * @param lowVal	Low value of range, pointer to integer / double / char string
      * @param lowOp		Low operator (GT/GTE)
      * @param highVal	High value of range, pointer to integer / double / char string
      * @param highOp	High operator (LT/LTE)
+     * @param order		ASCENDING to return entries from the low end up, DESCENDING from the high end down
      * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values
      * @throws  BadScanrangeException If lowVal > highval
      * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
      */
-    void BTreeIndex::startScan(const void* lowValParm,
+    void BTreeScanCursor::startScan(const void* lowValParm,
                        const Operator lowOpParm,
                        const void* highValParm,
-                       const Operator highOpParm)
+                       const Operator highOpParm,
+                       const ScanOrder orderParm)
     {
-        //Add your code below. Please do not remove this line.
-        // convert the input to int (assumed only use integer)
-        lowValInt = *((int*)lowValParm);
-        highValInt = *((int*)highValParm);
-        lowOp = lowOpParm;
-        highOp = highOpParm;
+        if(!tryStartScan(lowValParm, lowOpParm, highValParm, highOpParm, orderParm))
+            throw NoSuchKeyFoundException();
+    }
+
+    /**
+     * Non-throwing variant of startScan(). Range and operator errors are still reported through exceptions,
+     * but an empty range is reported through the return value.
+     * @param lowVal	Low value of range, pointer to integer / double / char string
+     * @param lowOp		Low operator (GT/GTE)
+     * @param highVal	High value of range, pointer to integer / double / char string
+     * @param highOp	High operator (LT/LTE)
+     * @param order		ASCENDING to return entries from the low end up, DESCENDING from the high end down
+     * @return True if a scan was started, false if no key in the B+ tree satisfies the scan criteria.
+     * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values
+     * @throws  BadScanrangeException If lowVal > highval
+     */
+    bool BTreeScanCursor::tryStartScan(const void* lowValParm,
+                       const Operator lowOpParm,
+                       const void* highValParm,
+                       const Operator highOpParm,
+                       const ScanOrder orderParm)
+    {
+        switch(index->attributeType){
+            case INTEGER:
+                return tryStartTyped(*(const int*)lowValParm, lowOpParm, *(const int*)highValParm, highOpParm, orderParm);
+            case DOUBLE:
+                return tryStartTyped(*(const double*)lowValParm, lowOpParm, *(const double*)highValParm, highOpParm, orderParm);
+            case STRING:
+                return tryStartTyped(StringKey((const char*)lowValParm), lowOpParm, StringKey((const char*)highValParm), highOpParm, orderParm);
+            case COMPOSITE:
+                return tryStartTyped(index->compositeKey((const char*)lowValParm), lowOpParm, index->compositeKey((const char*)highValParm), highOpParm, orderParm);
+        }
+        return false;
+    }
 
+    /**
+     * tryStartScan() once the key type of the index is known.
+     */
+    template <class T>
+    bool BTreeScanCursor::tryStartTyped(const T& lowValParm,
+                       const Operator lowOpParm,
+                       const T& highValParm,
+                       const Operator highOpParm,
+                       const ScanOrder orderParm)
+    {
         // low value should be less than or equal to high value
-        if (lowValInt > highValInt)
+        if (highValParm < lowValParm)
             throw BadScanrangeException();
 
         // only support GT, GTE and LT, LTE operators
-        if (lowOp != GT && lowOp != GTE)
+        if (lowOpParm != GT && lowOpParm != GTE)
             throw BadOpcodesException();
-        if (highOp != LT && highOp != LTE)
+        if (highOpParm != LT && highOpParm != LTE)
             throw BadOpcodesException();
 
-        // If another scan is already executing, that needs to be ended here.
-        if (scanExecuting) {
+        // If this cursor is already executing a scan, that needs to be ended here.
+        if (scanExecuting)
             endScan();
-            return;
+
+        lowVal<T>() = lowValParm;
+        highVal<T>() = highValParm;
+        lowOp = lowOpParm;
+        highOp = highOpParm;
+        order = orderParm;
+        hasLast = resumeAfterLast = false;
+
+        EpochGuard treeGuard(index->treeLatch, false);
+        // entries of the range in the insert buffer are returned along with those of the tree, which may hold none.
+        snapshotDelta<T>();
+        setExecuting(!delta<T>().empty());
+        if (order == DESCENDING) {
+            // find the page that may contain the last rid in given range, then check it against the low end.
+            if (!seekHigh<T>())
+                return scanExecuting;
+            if (!satisfiesLow(((LeafNode<T>*)currentPageData)->key(nextEntry - 1))) {
+                index->bufMgr->unlatchPage(currentPageData, false);
+                releaseCurrent();
+                nextEntry = -1;
+                return scanExecuting;
+            }
+            unlatchCurrent();
+            setExecuting(true);
+            return true;
         }
 
         // first find the page that may contain first rid in given range
-        PageId target_page_id = findTargetLeaf(lowValParm);
-        Page *page;
-        bufMgr->readPage(file, target_page_id, page);
-        LeafNodeInt* curr_leaf_node = ((LeafNodeInt*)page);
-        LeafNodeInt* target_node = curr_leaf_node; // store the updated node after search
-
-        // we then do the search to see if it really exists
-        int key_index = searchHelper(lowValParm, curr_leaf_node, target_node,target_page_id);
-        if (key_index == -1) {
-            bufMgr->unPinPage(file, target_page_id, false);
-            throw NoSuchKeyFoundException();
+        currentPageNum = index->latchLeaf(lowValParm, false, currentPageData);
+        nextEntry = lowBoundIndex((LeafNode<T>*)currentPageData);
+        ridPosition.entry = -1;
+
+        // the first qualifying key may live in a right sibling.
+        while (nextEntry == ((LeafNode<T>*)currentPageData)->size) {
+            if (!advanceScanLeaf<T>())
+                return scanExecuting;
         }
-        else { // found
-            if (lowOp == GTE) {
-                currentPageNum = target_page_id;
-                currentPageData = (Page*)target_node;
-                nextEntry = key_index;
-            }
-            if (lowOp == GT) {
-                // if first key returned equals the lower bound, next key is the target
-                if (target_node->keyArray[key_index] == lowValInt) {
-                    // next key is in next entry
-                    if (key_index == target_node->size - 1) {
-                        bufMgr->unPinPage(file, target_page_id, false);
-                        currentPageNum = target_node->rightSibPageNo;
-                        Page *rightSibpage;
-                        if(target_node->rightSibPageNo != MAX_PAGEID){
-                            bufMgr->readPage(file, target_node->rightSibPageNo, rightSibpage);
-                            currentPageData = rightSibpage;
-                            nextEntry = 0;
-                        }
-                    }
-                    else {
-                        currentPageNum = target_page_id;
-                        currentPageData = (Page*)target_node;
-                        nextEntry = key_index + 1;
-                    }
-                }
-                else { // returned one is correct one
-                    currentPageNum = target_page_id;
-                    currentPageData = (Page*)target_node;
-                    nextEntry = key_index;
-                }
-            }
+
+        // we then check the first key against the high end of the range.
+        if (!satisfiesHigh(((LeafNode<T>*)currentPageData)->key(nextEntry))) {
+            index->bufMgr->unlatchPage(currentPageData, false);
+            releaseCurrent();
+            nextEntry = -1;
+            return scanExecuting;
         }
-        scanExecuting = true;
+        // the leaf stays pinned but not latched between calls.
+        unlatchCurrent();
+        setExecuting(true);
+        return true;
     }
 
     /**
@@ -669,89 +5455,239 @@ namespace badgerdb
      * @throws ScanNotInitializedException If no scan has been initialized.
      * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
      */
-    void BTreeIndex::scanNext(RecordId& outRid)
+    void BTreeScanCursor::scanNext(RecordId& outRid)
+    {
+        if(!tryScanNext(outRid))
+            throw IndexScanCompletedException();
+    }
+
+    /**
+     * Non-throwing variant of scanNext().
+     * @param outRid	RecordId of next record found that satisfies the scan criteria returned in this
+     * @return True if outRid was filled in, false if the scan is completed.
+     * @throws ScanNotInitializedException If no scan has been initialized.
+     */
+    bool BTreeScanCursor::tryScanNext(RecordId& outRid)
+    {
+        return scanNextBatch(&outRid, 1) == 1;
+    }
+
+    /**
+     * Fetch up to maxRids record ids of the next index entries that match the scan. Qualifying entries of the
+     * current leaf are copied out in a single block copy before moving on to the right sibling.
+     * @param outRids	Array of at least maxRids record ids the results are written to
+     * @param maxRids	Maximum number of record ids to return
+     * @return Number of record ids written to outRids. Less than maxRids only if the scan is completed.
+     * @throws ScanNotInitializedException If no scan has been initialized.
+     */
+    int BTreeScanCursor::scanNextBatch(RecordId* outRids, int maxRids)
+    {
+        return scanNextBatch(outRids, nullptr, maxRids);
+    }
+
+    /**
+     * Fetch up to maxRids record ids of the next index entries that match the scan together with their payloads.
+     * @param outRids	Array of at least maxRids record ids the results are written to
+     * @param outPayloads	Array of at least maxRids payloads the payloads are written to, or null to skip them
+     * @param maxRids	Maximum number of record ids to return
+     * @return Number of record ids written to outRids. Less than maxRids only if the scan is completed.
+     * @throws ScanNotInitializedException If no scan has been initialized.
+     */
+    int BTreeScanCursor::scanNextBatch(RecordId* outRids, char* outPayloads, int maxRids)
     {
-        // Add your code below. Please do not remove this line.
         if(!scanExecuting)
             throw ScanNotInitializedException();
 
-        // check if currentPageNum is valid
-        LeafNodeInt* curr_node = nullptr;
-        if (currentPageData != nullptr)
-            curr_node = (LeafNodeInt*)currentPageData;
-        else {
-            endScan();
-            return;
+        if(order == DESCENDING){
+            switch(index->attributeType){
+                case INTEGER: return scanPrevBatchTyped<int>(outRids, outPayloads, maxRids);
+                case DOUBLE: return scanPrevBatchTyped<double>(outRids, outPayloads, maxRids);
+                case STRING: return scanPrevBatchTyped<StringKey>(outRids, outPayloads, maxRids);
+                case COMPOSITE: return scanPrevBatchTyped<CompositeKey>(outRids, outPayloads, maxRids);
+            }
+        }
+        switch(index->attributeType){
+            case INTEGER: return scanNextBatchTyped<int>(outRids, outPayloads, maxRids);
+            case DOUBLE: return scanNextBatchTyped<double>(outRids, outPayloads, maxRids);
+            case STRING: return scanNextBatchTyped<StringKey>(outRids, outPayloads, maxRids);
+            case COMPOSITE: return scanNextBatchTyped<CompositeKey>(outRids, outPayloads, maxRids);
         }
+        return 0;
+    }
 
-        // get info for next entry to scan
-        int key = curr_node->keyArray[nextEntry];
-
-        if (highOp == LT) {
-            if (key < highValInt) {
-                outRid = curr_node->ridArray[nextEntry];
-                // update nextEntry
-                if (nextEntry == curr_node->size - 1) {
-                    bufMgr->unPinPage(file, currentPageNum, false);
-                    currentPageNum = curr_node->rightSibPageNo;
-                    Page *rightSibpage;
-                    if(curr_node->rightSibPageNo != MAX_PAGEID){
-                        bufMgr->readPage(file, curr_node->rightSibPageNo, rightSibpage);
-                        currentPageData = rightSibpage;
-                        nextEntry = 0;
-                    } else {
-                        throw IndexScanCompletedException();
-                    }
-                } else {
-                    nextEntry++;
+    /**
+     * scanNextBatch() once the key type of the index is known.
+     */
+    template <class T>
+    int BTreeScanCursor::scanNextBatchTyped(RecordId* outRids, char* outPayloads, int maxRids)
+    {
+        EpochGuard treeGuard(index->treeLatch, false);
+        if(currentPageNum != BTreeIndex::MAX_PAGEID){
+            index->bufMgr->latchPage(currentPageData, false);
+            if(index->bufMgr->pageVersion(currentPageData) != pageVersion){
+                // another thread changed the leaf since the last call, entries may have moved.
+                LeafNode<T> *node = (LeafNode<T>*)currentPageData;
+                nextEntry = hasLast ? resumeIndex(node, false) : lowBoundIndex(node);
+                ridPosition.entry = -1;
+            }
+        }
+        const std::vector<RIDKeyPair<T> > &snapshot = delta<T>();
+        // once the insert buffer was merged, the leaves hold the entries of the snapshot as well.
+        bool merged = !snapshot.empty() && index->insertBufferGeneration != deltaGeneration;
+        int count = 0;
+        while(count < maxRids){
+            if(currentPageNum == BTreeIndex::MAX_PAGEID){
+                // the tree is exhausted, the rest of the snapshot follows.
+                if(nextDelta == (int)snapshot.size())
+                    break;
+                outRids[count++] = snapshot[nextDelta++].rid;
+                continue;
+            }
+            LeafNode<T> *node = (LeafNode<T>*)currentPageData;
+            if(nextEntry == node->size){
+                advanceScanLeaf<T>();
+                continue;
+            }
+            // copy the qualifying run of this leaf in one pass, up to the next entry of the snapshot, which
+            // follows the entries of the tree with an equal key.
+            int highEnd = highBoundIndex(node);
+            int runEnd = highEnd;
+            if(nextDelta < (int)snapshot.size() && nextEntry < runEnd){
+                const T &deltaKey = snapshot[nextDelta].key;
+                if(deltaKey < node->key(nextEntry)){
+                    outRids[count++] = snapshot[nextDelta++].rid;
+                    continue;
                 }
-            } else {
-                throw IndexScanCompletedException();
-            }
-        }
-
-        if (highOp == LTE) {
-            if (key <= highValInt) {
-                outRid = curr_node->ridArray[nextEntry];
-                // update nextEntry
-                if (nextEntry == curr_node->size - 1) {
-                    bufMgr->unPinPage(file, currentPageNum, false);
-                    currentPageNum = curr_node->rightSibPageNo;
-                    Page *rightSibpage;
-                    if(curr_node->rightSibPageNo != MAX_PAGEID){
-                        bufMgr->readPage(file, curr_node->rightSibPageNo, rightSibpage);
-                        currentPageData = rightSibpage;
-                        nextEntry = 0;
-                    } else {
-                        throw IndexScanCompletedException();
-                    }
-                } else {
-                    nextEntry++;
+                runEnd = node->upperBound(nextEntry, deltaKey);
+                runEnd = std::min(runEnd, highEnd);
+            }
+            int n = std::min(maxRids - count, runEnd - nextEntry);
+            node->copyRids(nextEntry, n, outRids + count, &ridPosition);
+            if(outPayloads != nullptr)
+                node->copyPayloads(nextEntry, n, outPayloads + count * index->payloadLength);
+            if(n > 0){
+                hasLast = true;
+                lastRid = outRids[count + n - 1];
+                lastVal<T>() = node->key(nextEntry + n - 1);
+            }
+            count += merged ? dropMerged(node, nextEntry, outRids + count, n) : n;
+            nextEntry += n;
+            if(nextEntry == highEnd && highEnd < node->size){
+                // hit a key past the high end, nothing further can qualify.
+                index->bufMgr->unlatchPage(currentPageData, false);
+                releaseCurrent();
+            }
+        }
+        if(currentPageNum != BTreeIndex::MAX_PAGEID)
+            unlatchCurrent();
+        return count;
+    }
+
+    /**
+     * Copy the payloads of entries [from, from + count) of node to out, last first.
+     */
+    template <class T>
+    static void copyPayloadsReversed(const LeafNode<T>* node, int from, int count, char* out, int payloadLength){
+        for(int i = 0; i < count; i++)
+            node->copyPayloads(from + count - 1 - i, 1, out + i * payloadLength);
+    }
+
+    /**
+     * scanNextBatch() of a DESCENDING scan once the key type of the index is known.
+     */
+    template <class T>
+    int BTreeScanCursor::scanPrevBatchTyped(RecordId* outRids, char* outPayloads, int maxRids)
+    {
+        EpochGuard treeGuard(index->treeLatch, false);
+        if(currentPageNum != BTreeIndex::MAX_PAGEID){
+            index->bufMgr->latchPage(currentPageData, false);
+            if(index->bufMgr->pageVersion(currentPageData) != pageVersion){
+                // another thread changed the leaf since the last call, entries may have moved.
+                if(hasLast)
+                    nextEntry = resumeBeforeLast<T>();
+                else{
+                    index->bufMgr->unlatchPage(currentPageData, false);
+                    releaseCurrent();
+                    seekHigh<T>();
+                }
+                ridPosition.entry = -1;
+            }
+        }
+        const std::vector<RIDKeyPair<T> > &snapshot = delta<T>();
+        // once the insert buffer was merged, the leaves hold the entries of the snapshot as well.
+        bool merged = !snapshot.empty() && index->insertBufferGeneration != deltaGeneration;
+        int count = 0;
+        while(count < maxRids){
+            if(currentPageNum == BTreeIndex::MAX_PAGEID){
+                // the tree is exhausted, the rest of the snapshot follows.
+                if(nextDelta == 0)
+                    break;
+                outRids[count++] = snapshot[--nextDelta].rid;
+                continue;
+            }
+            LeafNode<T> *node = (LeafNode<T>*)currentPageData;
+            // copy the qualifying run of this leaf below nextEntry in one pass, down to the next entry of the
+            // snapshot, which comes before the entries of the tree with an equal key, then put it in descending order.
+            int lowIndex = lowBoundIndex(node);
+            int runStart = std::min(lowIndex, nextEntry);
+            int runFloor = runStart;
+            if(nextDelta > 0 && nextEntry > runStart){
+                const T &deltaKey = snapshot[nextDelta - 1].key;
+                if(!(deltaKey < node->key(nextEntry - 1))){
+                    outRids[count++] = snapshot[--nextDelta].rid;
+                    continue;
+                }
+                runFloor = std::max(runStart, node->upperBound(runStart, deltaKey));
+            }
+            int n = std::min(maxRids - count, nextEntry - runFloor);
+            node->copyRids(nextEntry - n, n, outRids + count);
+            if(outPayloads != nullptr)
+                copyPayloadsReversed(node, nextEntry - n, n, outPayloads + count * index->payloadLength, index->payloadLength);
+            if(n > 0){
+                hasLast = true;
+                lastRid = outRids[count];
+                lastVal<T>() = node->key(nextEntry - n);
+            }
+            int kept = merged ? dropMerged(node, nextEntry - n, outRids + count, n) : n;
+            std::reverse(outRids + count, outRids + count + kept);
+            count += kept;
+            nextEntry -= n;
+            if(nextEntry == runStart){
+                if(lowIndex > 0){
+                    // hit a key below the low end, nothing further can qualify.
+                    index->bufMgr->unlatchPage(currentPageData, false);
+                    releaseCurrent();
                 }
-            } else {
-                throw IndexScanCompletedException();
+                else
+                    retreatScanLeaf<T>();
             }
         }
+        if(currentPageNum != BTreeIndex::MAX_PAGEID)
+            unlatchCurrent();
+        return count;
     }
 
     /**
      * Terminate the current scan. Unpin any pinned pages. Reset scan specific variables.
      * @throws ScanNotInitializedException If no scan has been initialized.
      */
-    void BTreeIndex::endScan()
+    void BTreeScanCursor::endScan()
     {
-        // Add your code below. Please do not remove this line.
         if (!scanExecuting)
             throw ScanNotInitializedException();
 
         // unpins all the pages that have been pinned for the purpose of the scan
-        if (currentPageNum != MAX_PAGEID)
-            bufMgr->unPinPage(file, currentPageNum, false);
+        if (currentPageNum != BTreeIndex::MAX_PAGEID)
+            index->bufMgr->unPinPage(index->file, currentPageNum, false);
 
         // clear the relative fields
-        currentPageNum = MAX_PAGEID;
+        deltaInt.clear();
+        deltaDouble.clear();
+        deltaString.clear();
+        deltaComposite.clear();
+        currentPageNum = BTreeIndex::MAX_PAGEID;
         currentPageData = nullptr;
         nextEntry = -1;
-        scanExecuting = false;
+        setExecuting(false);
     }
 }
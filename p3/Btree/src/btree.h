@@ -11,6 +11,13 @@
 #include <string>
 #include "string.h"
 #include <sstream>
+#include <vector>
+#include <map>
+#include <cstddef>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
 
 #include "types.h"
 #include "page.h"
@@ -20,6 +27,8 @@
 namespace badgerdb
 {
 
+class BTreeIndex;
+
 /**
  * @brief Datatype enumeration type.
  */
@@ -27,13 +36,29 @@ enum Datatype
 {
 	INTEGER = 0,
 	DOUBLE = 1,
-	STRING = 2
+	STRING = 2,
+	COMPOSITE = 3	/* Several attributes compared one after the other, see KeyColumn */
 };
 
 enum Nodetype
 {
     LEAF,
-    NONLEAF
+    NONLEAF,
+    POSTINGLEAF,
+    PACKEDLEAF,
+    COVERINGLEAF,
+    COUNTEDNONLEAF
+};
+
+/**
+ * @brief Leaf layouts an index can be created with. Passed to the BTreeIndex constructor.
+ */
+enum LeafFormat
+{
+	ARRAY_LEAVES = 0,	/* One key-rid slot per entry */
+	POSTING_LEAVES = 1,	/* Each distinct key once, with a compressed list of its record ids */
+	PACKED_LEAVES = 2,	/* Keys and record ids bit packed as offsets from the smallest ones, INTEGER keys only */
+	COVERING_LEAVES = 3	/* One key-rid slot per entry followed by the payload columns of its record, see PayloadColumn */
 };
 
 /**
@@ -47,6 +72,30 @@ enum Operator
 	GT		/* Greater Than */
 };
 
+/**
+ * @brief Order a scan returns its entries in. Passed to BTreeIndex::startScan() method.
+ */
+enum ScanOrder
+{
+	ASCENDING = 0,	/* From the low end of the range up */
+	DESCENDING = 1	/* From the high end of the range down */
+};
+
+
+/**
+ * @brief Size of String key.
+ */
+const  int STRINGSIZE = 10;
+
+/**
+ * @brief Number of bytes of the normalized key of a COMPOSITE index, enough for an INTEGER, a DOUBLE and a STRING.
+ */
+const  int COMPOSITESIZE = 24;
+
+/**
+ * @brief Most attributes a COMPOSITE key may have.
+ */
+const  int MAXKEYCOLUMNS = 4;
 
 /**
  * @brief Number of key slots in B+Tree leaf for INTEGER key.
@@ -54,12 +103,315 @@ enum Operator
 //                                                  sibling ptr             key               rid
 const  int INTARRAYLEAFSIZE = ( Page::SIZE - sizeof( PageId ) ) / ( sizeof( int ) + sizeof( RecordId ) ) - 1;
 
+/**
+ * @brief Number of key slots in B+Tree leaf for DOUBLE key.
+ */
+//                                                     sibling ptr               key               rid
+const  int DOUBLEARRAYLEAFSIZE = ( Page::SIZE - sizeof( PageId ) ) / ( sizeof( double ) + sizeof( RecordId ) ) - 1;
+
+/**
+ * @brief Number of key slots in B+Tree leaf for STRING key.
+ */
+//                                                    sibling ptr           key                      rid
+const  int STRINGARRAYLEAFSIZE = ( Page::SIZE - sizeof( PageId ) ) / ( STRINGSIZE * sizeof( char ) + sizeof( RecordId ) ) - 1;
+
+/**
+ * @brief Number of key slots in B+Tree leaf for COMPOSITE key.
+ */
+//                                                       sibling ptr        key              rid
+const  int COMPOSITEARRAYLEAFSIZE = ( Page::SIZE - sizeof( PageId ) ) / ( COMPOSITESIZE + sizeof( RecordId ) ) - 1;
+
 /**
  * @brief Number of key slots in B+Tree non-leaf for INTEGER key.
  */
 //                                                     level     extra pageNo                  key       pageNo
 const  int INTARRAYNONLEAFSIZE = ( Page::SIZE - sizeof( int ) - sizeof( PageId ) ) / ( sizeof( int ) + sizeof( PageId ) ) - 1;
 
+/**
+ * @brief Number of key slots in B+Tree non-leaf for DOUBLE key.
+ */
+//                                                        level     extra pageNo                 key            pageNo   -1 due to structure padding
+const  int DOUBLEARRAYNONLEAFSIZE = ( Page::SIZE - sizeof( int ) - sizeof( PageId ) ) / ( sizeof( double ) + sizeof( PageId ) ) - 1;
+
+/**
+ * @brief Number of key slots in B+Tree non-leaf for INTEGER key of an index that counts entries, whose
+ * non-leaves also store the number of leaf entries below each child.
+ */
+//                                                             level     extra pageNo/count                            key       pageNo/count
+const  int INTARRAYCOUNTEDNONLEAFSIZE = ( Page::SIZE - sizeof( int ) - sizeof( PageId ) - sizeof( std::uint32_t ) ) / ( sizeof( int ) + sizeof( PageId ) + sizeof( std::uint32_t ) ) - 1;
+
+/**
+ * @brief Number of key slots in B+Tree non-leaf for DOUBLE key of an index that counts entries.
+ */
+//                                                                level     extra pageNo/count                           key            pageNo/count   -1 due to structure padding
+const  int DOUBLEARRAYCOUNTEDNONLEAFSIZE = ( Page::SIZE - sizeof( int ) - sizeof( PageId ) - sizeof( std::uint32_t ) ) / ( sizeof( double ) + sizeof( PageId ) + sizeof( std::uint32_t ) ) - 1;
+
+/**
+ * @brief Number of key slots in B+Tree non-leaf for STRING key.
+ */
+//                                                        level        extra pageNo             key                      pageNo
+const  int STRINGARRAYNONLEAFSIZE = ( Page::SIZE - sizeof( int ) - sizeof( PageId ) ) / ( STRINGSIZE * sizeof( char ) + sizeof( PageId ) ) - 1;
+
+/**
+ * @brief Number of key slots in B+Tree non-leaf for COMPOSITE key.
+ */
+//                                                        level     extra pageNo                 key         pageNo
+const  int COMPOSITEARRAYNONLEAFSIZE = ( Page::SIZE - sizeof( int ) - sizeof( PageId ) ) / ( COMPOSITESIZE + sizeof( PageId ) ) - 1;
+
+/**
+ * @brief Number of key slots in B+Tree non-leaf for COMPOSITE key of an index that counts entries.
+ */
+//                                                                level     extra pageNo/count                           key         pageNo/count
+const  int COMPOSITEARRAYCOUNTEDNONLEAFSIZE = ( Page::SIZE - sizeof( int ) - sizeof( PageId ) - sizeof( std::uint32_t ) ) / ( COMPOSITESIZE + sizeof( PageId ) + sizeof( std::uint32_t ) ) - 1;
+
+/**
+ * @brief Number of bytes of a STRING node page left for keys and record ids or child page numbers. STRING nodes
+ * store the prefix shared by all their keys once, so how many entries fit in this depends on the keys.
+ */
+//                                                  type/size/sibling or level  prefixLength/slotLength  prefix
+const  int STRINGNODEDATASIZE = Page::SIZE - 3 * sizeof( int ) - 2 * sizeof( int ) - STRINGSIZE;
+
+/**
+ * @brief Number of bytes of a posting list leaf left for its key directory and record id lists.
+ */
+//                                                  type/size/sibling  keyCount/listLength
+const  int POSTINGNODEDATASIZE = Page::SIZE - 3 * sizeof( int ) - 2 * sizeof( int );
+
+/**
+ * @brief Number of 32 bit words of a packed leaf left for its bit packed keys and record ids.
+ */
+//                                                  type/size/sibling  keyBase/pageBase  bit widths  rows
+const  int PACKEDNODEDATAWORDS = ( Page::SIZE - 3 * sizeof( int ) - 2 * sizeof( int ) - sizeof( int ) - sizeof( int ) ) / sizeof( unsigned );
+
+/**
+ * @brief Most entries a packed leaf holds. Twice the number of entries of full bit width that fit, less one row
+ * of four, so that a full leaf always splits into two that fit, however wide the entries are.
+ */
+//                                                     rows of four at                         key           page             slot
+const  int PACKEDLEAFSIZE = 2 * 4 * ( PACKEDNODEDATAWORDS / 4 * 32 / ( 8 * ( sizeof( int ) + sizeof( PageId ) + sizeof( SlotId ) ) ) ) - 4;
+
+/**
+ * @brief Number of bytes of a covering leaf left for its entries.
+ */
+//                                                  type/size/sibling  payloadLength
+const  int COVERINGNODEDATASIZE = Page::SIZE - 3 * sizeof( int ) - sizeof( int );
+
+/**
+ * @brief Most payload columns a covering index may include.
+ */
+const  int MAXPAYLOADCOLUMNS = 8;
+
+/**
+ * @brief Most bytes the payload columns of a covering index may take per entry, so that a leaf still holds a few
+ * dozen entries.
+ */
+const  int MAXPAYLOADLENGTH = 256;
+
+/**
+ * @brief Number of 64 bit words of a block of a Bloom filter, one cache line. A key sets and tests one bit in
+ * each word of a single block.
+ */
+const  int BLOOMBLOCKWORDS = 8;
+
+/**
+ * @brief Number of Bloom filter blocks in a page.
+ */
+const  int BLOOMBLOCKSPERPAGE = Page::SIZE / ( BLOOMBLOCKWORDS * sizeof( std::uint64_t ) );
+
+/**
+ * @brief Most pages the Bloom filter of an index may take, enough for about 1.6 million keys at 10 bits each.
+ */
+const  int MAXBLOOMPAGES = 256;
+
+/**
+ * @brief Slots of the table of pinned upper nonleaves of an index, which bounds the number of pages it keeps pinned.
+ */
+const  int PINNEDSLOTS = 64;
+
+/**
+ * @brief Slots from the one of its page number on that a pinned nonleaf may take, so that nonleaves whose page
+ * numbers collide are still pinned.
+ */
+const  int PINNEDPROBES = 4;
+
+/**
+ * @brief A STRING key as it is stored in the tree: the first STRINGSIZE characters of the attribute, padded
+ * with zero bytes. Keys compare byte by byte, which orders them like strncmp( a, b, STRINGSIZE ).
+ */
+class StringKey{
+public:
+	char data[ STRINGSIZE ];
+
+	StringKey() = default;
+
+	explicit StringKey( const char* s )
+	{
+		strncpy( data, s, STRINGSIZE );
+	}
+
+	bool operator<( const StringKey& rhs ) const
+	{
+		return memcmp( data, rhs.data, STRINGSIZE ) < 0;
+	}
+
+	bool operator==( const StringKey& rhs ) const
+	{
+		return memcmp( data, rhs.data, STRINGSIZE ) == 0;
+	}
+
+	bool operator!=( const StringKey& rhs ) const
+	{
+		return !( *this == rhs );
+	}
+};
+
+inline std::ostream& operator<<( std::ostream& os, const StringKey& key )
+{
+	return os.write( key.data, strnlen( key.data, STRINGSIZE ) );
+}
+
+/**
+ * @brief An attribute of a COMPOSITE key: the attribute of type type at offset in the record. Passed to the
+ * BTreeIndex constructor for composite keys.
+ */
+struct KeyColumn{
+	int offset;
+	Datatype type;
+};
+
+/**
+ * @brief A COMPOSITE key as it is stored in the tree: its attributes normalized one after the other, so that
+ * keys compare byte by byte like their attributes compare one after the other. INTEGER attributes take four
+ * bytes, big-endian with the sign bit flipped, DOUBLE attributes eight, big-endian with the sign bit flipped for
+ * positive values and all bits for negative ones, and STRING attributes STRINGSIZE, as in a StringKey. The
+ * remaining bytes are zero. Built by BTreeIndex::compositeKey().
+ */
+class CompositeKey{
+public:
+	unsigned char data[ COMPOSITESIZE ];
+
+	bool operator<( const CompositeKey& rhs ) const
+	{
+		return memcmp( data, rhs.data, COMPOSITESIZE ) < 0;
+	}
+
+	bool operator==( const CompositeKey& rhs ) const
+	{
+		return memcmp( data, rhs.data, COMPOSITESIZE ) == 0;
+	}
+
+	bool operator!=( const CompositeKey& rhs ) const
+	{
+		return !( *this == rhs );
+	}
+};
+
+inline std::ostream& operator<<( std::ostream& os, const CompositeKey& key )
+{
+	static const char digits[] = "0123456789abcdef";
+	for( int i = 0; i < COMPOSITESIZE; i++ )
+		os << digits[ key.data[ i ] >> 4 ] << digits[ key.data[ i ] & 15 ];
+	return os;
+}
+
+/**
+ * @brief Spread the bits of h over all of the result (the finalizer of MurmurHash3).
+ */
+inline std::uint64_t mixHash( std::uint64_t h )
+{
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdull;
+	h ^= h >> 33;
+	h *= 0xc4ceb93fe53a4e53ull;
+	h ^= h >> 33;
+	return h;
+}
+
+/**
+ * @brief Hash of length bytes (FNV-1a, mixed).
+ */
+inline std::uint64_t bytesHash( const unsigned char* bytes, int length )
+{
+	std::uint64_t h = 0xcbf29ce484222325ull;
+	for( int i = 0; i < length; i++ )
+		h = ( h ^ bytes[ i ] ) * 0x100000001b3ull;
+	return mixHash( h );
+}
+
+/**
+ * @brief Hash of a key, for the Bloom filter of a BTreeIndex and the buckets of a HashIndex. Keys that compare
+ * equal hash the same.
+ */
+inline std::uint64_t keyHash( int key )
+{
+	return mixHash( ( std::uint32_t )key );
+}
+
+inline std::uint64_t keyHash( double key )
+{
+	// 0.0 and -0.0 are the same key.
+	if( key == 0 )
+		key = 0;
+	std::uint64_t bits;
+	memcpy( &bits, &key, sizeof( double ) );
+	return mixHash( bits );
+}
+
+inline std::uint64_t keyHash( const StringKey& key )
+{
+	return bytesHash( ( const unsigned char* )key.data, STRINGSIZE );
+}
+
+inline std::uint64_t keyHash( const CompositeKey& key )
+{
+	return bytesHash( key.data, COMPOSITESIZE );
+}
+
+/**
+ * @brief Per key type constants of the tree. The tree routines are templates over the key type and read
+ * the node fanouts from here, so every key type gets its own node layout fixed at compile time.
+ * COUNTEDNONLEAFSIZE is the fanout of the non-leaves of indexes that count entries. Non-root leaves that drop
+ * below LEAFMINSIZE, and non-leaves that drop below half their fanout, on a deletion are merged with or
+ * refilled from a sibling.
+ */
+template <class T>
+struct KeyTraits;
+
+template <>
+struct KeyTraits<int>{
+	static const Datatype TYPE = INTEGER;
+	static const int LEAFSIZE = INTARRAYLEAFSIZE;
+	static const int NONLEAFSIZE = INTARRAYNONLEAFSIZE;
+	static const int COUNTEDNONLEAFSIZE = INTARRAYCOUNTEDNONLEAFSIZE;
+	static const int LEAFMINSIZE = INTARRAYLEAFSIZE / 2;
+};
+
+template <>
+struct KeyTraits<double>{
+	static const Datatype TYPE = DOUBLE;
+	static const int LEAFSIZE = DOUBLEARRAYLEAFSIZE;
+	static const int NONLEAFSIZE = DOUBLEARRAYNONLEAFSIZE;
+	static const int COUNTEDNONLEAFSIZE = DOUBLEARRAYCOUNTEDNONLEAFSIZE;
+	static const int LEAFMINSIZE = DOUBLEARRAYLEAFSIZE / 2;
+};
+
+template <>
+struct KeyTraits<CompositeKey>{
+	static const Datatype TYPE = COMPOSITE;
+	static const int LEAFSIZE = COMPOSITEARRAYLEAFSIZE;
+	static const int NONLEAFSIZE = COMPOSITEARRAYNONLEAFSIZE;
+	static const int COUNTEDNONLEAFSIZE = COMPOSITEARRAYCOUNTEDNONLEAFSIZE;
+	static const int LEAFMINSIZE = COMPOSITEARRAYLEAFSIZE / 2;
+};
+
+/**
+ * STRING nodes are prefix compressed and size themselves by bytes, see LeafNode<StringKey>.
+ */
+template <>
+struct KeyTraits<StringKey>{
+	static const Datatype TYPE = STRING;
+};
+
 /**
  * @brief Structure to store a key-rid pair. It is used to pass the pair to functions that 
  * add to or make changes to the leaf node pages of the tree. Is templated for the key member.
@@ -76,6 +428,50 @@ public:
 	}
 };
 
+/**
+ * @brief Structure to store one range of a multi-range scan, which is passed to BTreeIndex::scanRanges().
+ * The operators are those of BTreeIndex::startScan(). Is templated for the key members.
+ */
+template <class T>
+class ScanRange{
+public:
+	T low;
+	Operator lowOp;
+	T high;
+	Operator highOp;
+	void set( T l, Operator lOp, T h, Operator hOp )
+	{
+		low = l;
+		lowOp = lOp;
+		high = h;
+		highOp = hOp;
+	}
+
+	/**
+	 * True if key is above low (GT) or not below it (GTE).
+	 */
+	bool satisfiesLow( const T& key ) const
+	{
+		return lowOp == GT ? low < key : !(key < low);
+	}
+
+	/**
+	 * True if key is below high (LT) or not above it (LTE).
+	 */
+	bool satisfiesHigh( const T& key ) const
+	{
+		return highOp == LT ? key < high : !(high < key);
+	}
+
+	/**
+	 * True if every key of this range is smaller than every key of next.
+	 */
+	bool precedes( const ScanRange& next ) const
+	{
+		return high < next.low || (!(next.low < high) && (highOp == LT || next.lowOp == GT));
+	}
+};
+
 /**
  * @brief Structure to store a key page pair which is used to pass the key and page to functions that make 
  * any modifications to the non leaf pages of the tree.
@@ -106,6 +502,135 @@ bool operator<( const RIDKeyPair<T>& r1, const RIDKeyPair<T>& r2)
 		return r1.rid.page_number < r2.rid.page_number;
 }
 
+/**
+ * @brief One step of a root-to-leaf path through the tree. Records the node together with the range of keys
+ * (low, high] that descent routes to it, so that a later key falling into the same range can resume the
+ * descent from this node instead of from the root. Missing bounds are unbounded. childIndex is the position
+ * of the node among its parent's children, where a split inserts the new sibling.
+ */
+template <class T>
+class PathEntry{
+public:
+	PageId pageNo;
+	int childIndex;
+	bool isLeaf;
+	bool hasLow;
+	T low;
+	bool hasHigh;
+	T high;
+
+	/**
+	 * True if descent routes key to this node.
+	 */
+	bool covers( const T& key ) const
+	{
+		return ( !hasLow || low < key ) && ( !hasHigh || !( high < key ) );
+	}
+};
+
+/**
+ * @brief Sorted in-memory store of the entries inserted into an index but not yet merged into its leaves: a skip
+ * list ordered by key and, among equal keys, by insertion. Inserts exclude each other with a mutex; readers take
+ * nothing and may run alongside them, since an entry is complete before it is linked into any level.
+ * Entries are only removed all at once, by clear(), while nothing else uses the store.
+ */
+template <class T>
+class DeltaStore{
+public:
+	/**
+	 * Most levels an entry is linked into; each level links about a quarter of the entries of the one below.
+	 */
+	static const int MAXHEIGHT = 12;
+
+	/**
+	 * @brief An entry of the store. It is allocated with room for the next pointers of its levels only.
+	 */
+	struct Node{
+		RIDKeyPair<T> entry;
+		std::atomic<Node*> next[ 1 ];
+
+		/**
+		 * Next entry at the given level, or null at the end of the level.
+		 */
+		Node* successor( int level ) const
+		{
+			return next[ level ].load( std::memory_order_acquire );
+		}
+	};
+
+	DeltaStore();
+
+	~DeltaStore();
+
+	DeltaStore( const DeltaStore& ) = delete;
+	DeltaStore& operator=( const DeltaStore& ) = delete;
+
+	/**
+	 * Add an entry after the entries with an equal key. May run alongside readers and other inserts.
+	 */
+	void insert( const T& key, const RecordId rid );
+
+	/**
+	 * First entry whose key is not below key, or above it if strict; null if there is none.
+	 */
+	const Node* seek( const T& key, bool strict ) const;
+
+	/**
+	 * First entry, or null if the store is empty.
+	 */
+	const Node* first() const
+	{
+		return head->successor( 0 );
+	}
+
+	/**
+	 * Number of entries.
+	 */
+	int size() const
+	{
+		return count;
+	}
+
+	/**
+	 * Remove all entries. Nothing else may use the store meanwhile.
+	 */
+	void clear();
+
+private:
+	/**
+	 * Allocate an entry linked into height levels.
+	 */
+	static Node* allocNode( int height );
+
+	static void freeNode( Node* node );
+
+	/**
+	 * Entry in front of the first one, linked into all levels. Its own key is not used.
+	 */
+	Node* head;
+
+	std::atomic<int> count;
+
+	/**
+	 * Held by inserts.
+	 */
+	std::mutex insertMutex;
+
+	/**
+	 * State of the generator of entry heights, only used by inserts.
+	 */
+	std::uint32_t randomState;
+};
+
+/**
+ * @brief A column a covering index copies from every record into the leaf entry of the record: the length bytes
+ * at offset in the record. Passed to the BTreeIndex constructor.
+ */
+struct PayloadColumn{
+	int offset;
+	int length;
+};
+
 /**
  * @brief The meta page, which holds metadata for Index file, is always first page of the btree index file and is cast
  * to the following structure to store or retrieve information from it.
@@ -149,95 +674,1454 @@ struct IndexMetaInfo{
     * Depth of the tree. If the tree only has root node, depth = 0.
     */
 	int depth;
-};
-
-/*
-Each node is a page, so once we read the page in we just cast the pointer to the page to this struct and use it to access the parts
-These structures basically are the format in which the information is stored in the pages for the index file depending on what kind of 
-node they are. The level member of each non leaf structure seen below is set to 1 if the nodes
-at this level are just above the leaf nodes. Otherwise set to 0.
-*/
-
-/**
- * @brief Structure for all non-leaf nodes when the key is of INTEGER type.
- */
-struct NonLeafNodeInt{
-
-   /**
-   * Should be initialized as NONLEAF.
-   */
-   Nodetype type;
 
     /**
-    * Number of keys in the node.
+    * Page number of the first page on the list of pages freed by deletions, or MAX_PAGEID if the list is empty.
     */
-    int size;
+	PageId freePageNo;
 
-   /**
-    * Level of the node in the tree.
+    /**
+    * Layout of the leaves.
     */
-	int level;
+	LeafFormat leafFormat;
 
     /**
-    * PageId of its parent node. 0 represents this page is root.
+    * Number of payload columns of a covering index, 0 for other indexes.
     */
-    PageId parentId;
+	int numPayloadColumns;
 
     /**
-    * Stores keys.
+    * Payload columns of a covering index, in the order their bytes follow each other in the payload of an entry.
     */
-	int keyArray[ INTARRAYNONLEAFSIZE ];
+	PayloadColumn payloadColumns[ MAXPAYLOADCOLUMNS ];
 
     /**
-    * Stores page numbers of child pages which themselves are other non-leaf/leaf nodes in the tree.
+    * Number of attributes of a COMPOSITE key, 0 for other indexes.
     */
-	PageId pageNoArray[ INTARRAYNONLEAFSIZE + 1 ];
-};
-
+	int numKeyColumns;
 
-/**
- * @brief Structure for all leaf nodes when the key is of INTEGER type.
- */
-struct LeafNodeInt{
     /**
-    * Should be initialized as LEAF.
+    * Attributes of a COMPOSITE key, most significant first.
     */
-    Nodetype type;
+	KeyColumn keyColumns[ MAXKEYCOLUMNS ];
 
     /**
-    * Number of keys in the node.
+    * Number of pages of the Bloom filter, 0 if the index has none.
     */
-    int size;
+	int numBloomPages;
 
     /**
-    * PageId of its parent node. 0 represents this page is root.
+    * Pages of the Bloom filter, in the order of the blocks they hold.
     */
-    PageId parentId;
+	PageId bloomPageNos[ MAXBLOOMPAGES ];
 
     /**
-    * Page number of the leaf on the right side.
-    * This linking of leaves allows to easily move from one leaf to the next leaf during index scan.
+    * Bits per entry of the Bloom filter, 0 if the index has none.
     */
-    PageId rightSibPageNo;
+	int bloomBitsPerKey;
 
     /**
-    * Stores keys.
+    * Number of entries the Bloom filter was sized for.
     */
-	int keyArray[ INTARRAYLEAFSIZE ];
+	int bloomCapacity;
 
     /**
-    * Stores RecordIds.
+    * True if the nonleaves keep the number of entries below each child.
     */
-	RecordId ridArray[ INTARRAYLEAFSIZE ];
+	bool countEntries;
 
+    /**
+    * First page of the list of message buffers of the nonleaves, or MAX_PAGEID if no nonleaf has one.
+    */
+	PageId nodeBufferPageNo;
 };
 
-
 /**
- * @brief BTreeIndex class. It implements a B+ Tree index on a single attribute of a
- * relation. This index supports only one scan at a time.
-*/
-class BTreeIndex {
+ * @brief Structure a page of the Bloom filter of an index is cast to: BLOOMBLOCKSPERPAGE blocks of
+ * BLOOMBLOCKWORDS words each.
+ */
+struct BloomPage{
+	std::uint64_t words[ BLOOMBLOCKSPERPAGE * BLOOMBLOCKWORDS ];
+};
+
+/**
+ * @brief Structure a page of the index file is cast to while it sits on the free list. Freed pages are
+ * reused by later splits before the file is grown.
+ */
+struct FreePage{
+    /**
+    * Page number of the next free page, or MAX_PAGEID at the end of the list.
+    */
+	PageId nextFreePageNo;
+};
+
+/**
+ * @brief Structure a page of the index file is cast to when it holds the message buffer of a nonleaf: entries
+ * inserted below the nonleaf that have not been pushed down to its children yet, in no particular order, as
+ * RIDKeyPair of the key type of the index.
+ */
+struct NodeBufferPage{
+    /**
+    * Page number of the nonleaf the buffer belongs to.
+    */
+	PageId nodePageNo;
+
+    /**
+    * Next buffer page on the list the meta page starts, or MAX_PAGEID at its end. Only written when the index is
+    * closed.
+    */
+	PageId nextPageNo;
+
+    /**
+    * Number of levels the nonleaf lies above the leaves, 1 if its children are leaves.
+    */
+	int height;
+
+    /**
+    * Number of entries in the buffer.
+    */
+	int size;
+
+    /**
+    * The entries.
+    */
+	char data[ Page::SIZE - 2 * sizeof( PageId ) - 2 * sizeof( int ) ];
+
+    /**
+    * Number of entries of key type T a buffer holds.
+    */
+	template <class T>
+	static int capacity() { return sizeof( data ) / sizeof( RIDKeyPair<T> ); }
+
+	template <class T>
+	RIDKeyPair<T>* entries() { return (RIDKeyPair<T>*)data; }
+};
+
+/**
+ * @brief Where the message buffer of a nonleaf is kept.
+ */
+struct NodeBuffer{
+    /**
+    * Page number of the NodeBufferPage.
+    */
+	PageId pageNo;
+
+    /**
+    * Number of levels the nonleaf lies above the leaves.
+    */
+	int height;
+};
+
+/*
+Each node is a page, so once we read the page in we just cast the pointer to the page to this struct and use it to access the parts
+These structures basically are the format in which the information is stored in the pages for the index file depending on what kind of 
+node they are. The level member of each non leaf structure seen below is set to 1 if the nodes
+at this level are just above the leaf nodes. Otherwise set to 0.
+The tree routines only go through the member functions of the nodes, so a key type can bring its own page layout
+by specializing the node templates, as STRING keys do below. Leaves of indexes created with POSTING_LEAVES are laid
+out as PostingLeafNode instead, whatever the key type, those of INTEGER indexes created with PACKED_LEAVES as
+PackedLeafNode, and those of indexes with payload columns as CoveringLeafNode.
+*/
+
+/**
+ * @brief Structure for all non-leaf nodes, templated for the key type. Non-leaves of indexes that count entries
+ * have type COUNTEDNONLEAF and also store the number of leaf entries below each child. They hold at most
+ * COUNTEDNONLEAFSIZE keys, and their children and counts follow that many keys in keyArray and pageNoArray
+ * rather than starting at pageNoArray, see children() and counts().
+ */
+template <class T>
+struct NonLeafNode{
+
+   /**
+   * Should be initialized as NONLEAF or COUNTEDNONLEAF.
+   */
+   Nodetype type;
+
+    /**
+    * Number of keys in the node.
+    */
+    int size;
+
+   /**
+    * Level of the node in the tree.
+    */
+	int level;
+
+    /**
+    * Stores keys.
+    */
+	T keyArray[ KeyTraits<T>::NONLEAFSIZE ];
+
+    /**
+    * Stores page numbers of child pages which themselves are other non-leaf/leaf nodes in the tree.
+    */
+	PageId pageNoArray[ KeyTraits<T>::NONLEAFSIZE + 1 ];
+
+    /**
+    * Make this an empty node at the given level whose only child is firstChild, with count entries below it
+    * if counted is set.
+    */
+	void init( int level, PageId firstChild, std::uint32_t count, bool counted );
+
+    /**
+    * True if the node stores the number of leaf entries below each child.
+    */
+	bool counted() const { return type == COUNTEDNONLEAF; }
+
+    /**
+    * Number of keys that fit in the node.
+    */
+	int capacity() const { return counted() ? KeyTraits<T>::COUNTEDNONLEAFSIZE : KeyTraits<T>::NONLEAFSIZE; }
+
+    /**
+    * True if insert() is sure to succeed, so a split of a child stops at this node.
+    */
+	bool hasRoom() const { return size < capacity(); }
+
+    /**
+    * Page numbers of the children.
+    */
+	PageId* children() { return counted() ? (PageId*)(keyArray + KeyTraits<T>::COUNTEDNONLEAFSIZE) : pageNoArray; }
+	const PageId* children() const { return const_cast<NonLeafNode*>(this)->children(); }
+
+    /**
+    * Number of leaf entries below each child, only if counted().
+    */
+	std::uint32_t* counts() { return (std::uint32_t*)(children() + KeyTraits<T>::COUNTEDNONLEAFSIZE + 1); }
+	const std::uint32_t* counts() const { return const_cast<NonLeafNode*>(this)->counts(); }
+
+    /**
+    * Copy the numMoved children from index from of source to index to of this node, with their counts.
+    * The ranges may overlap.
+    */
+	void moveChildren( int to, const NonLeafNode* source, int from, int numMoved );
+
+    /**
+    * Key i of the node.
+    */
+	T key( int i ) const;
+
+    /**
+    * Page number of child i of the node.
+    */
+	PageId child( int i ) const;
+
+    /**
+    * Number of leaf entries below child i, or 0 if the node does not count them.
+    */
+	std::uint32_t count( int i ) const;
+
+    /**
+    * Overwrite the number of leaf entries below child i. Does nothing if the node does not count them.
+    */
+	void setCount( int i, std::uint32_t count );
+
+    /**
+    * Add delta to the number of leaf entries below child i. The update is atomic, so inserts that only hold
+    * the latch of their leaf may count their entry in the ancestors at the same time.
+    */
+	void addCount( int i, int delta );
+
+    /**
+    * Number of leaf entries below the node.
+    */
+	std::uint32_t total() const;
+
+    /**
+    * Index of the first key not less than key, which is the index of the child key is routed to. int keys
+    * are found by interpolation search, other keys by binary search.
+    */
+	int lowerBound( const T& key ) const;
+
+    /**
+    * Index of the first key greater than key, which is the index of the last child that may hold key.
+    */
+	int upperBound( const T& key ) const;
+
+    /**
+    * False if the header of the node cannot belong to a nonleaf. Readers that do not latch the node check it
+    * before searching, so a node caught in the middle of a change is not searched past its end.
+    */
+	bool plausible() const;
+
+    /**
+    * Insert key at index pos and pageNo, with count entries below it, as the child right after it.
+    * @return False, leaving the node unchanged, if the node is full.
+    */
+	bool insert( int pos, const T& key, PageId pageNo, std::uint32_t count );
+
+    /**
+    * Remove key pos and the child right after it.
+    */
+	void remove( int pos );
+
+    /**
+    * Overwrite key i.
+    * @return False, leaving the node unchanged, if the key does not fit.
+    */
+	bool replaceKey( int i, const T& key );
+
+    /**
+    * Split this full node, into which the insert of key and pageNo at pos failed, with the empty page right.
+    * The lower keys stay in place, the upper ones move to right. With append set the node stays full and
+    * right starts with pageNo as its only child.
+    * @return The middle key, which belongs to neither node and moves up into the parent.
+    */
+	T split( NonLeafNode* right, int pos, const T& key, PageId pageNo, std::uint32_t count, bool append );
+
+    /**
+    * True if the node holds less than half of its capacity().
+    */
+	bool underfull() const;
+
+    /**
+    * Append separator and the right sibling right to this node.
+    * @return False, leaving both nodes unchanged, if they do not fit in one page.
+    */
+	bool merge( const T& separator, NonLeafNode* right );
+
+    /**
+    * Even out this node and its right sibling right by rotating children through their separator, key
+    * sepIndex of parent.
+    * @return False, leaving all three nodes unchanged, if there is no better split that fits.
+    */
+	bool redistribute( NonLeafNode* right, NonLeafNode* parent, int sepIndex );
+};
+
+
+/**
+ * @brief Where a sequential read of the record ids of a leaf through LeafNode::copyRids() stopped. Leaves that
+ * compress their record ids resume decoding there when the next read starts at entry, rather than decoding the
+ * list from its start again.
+ */
+struct RidReadPosition{
+    /**
+    * Index of the next entry to read, or -1 if there is none.
+    */
+	int entry;
+
+    /**
+    * Byte offset of the encoding of that entry's record id.
+    */
+	int offset;
+
+    /**
+    * Record id of the entry before it, which the encoding is relative to.
+    */
+	RecordId last;
+};
+
+/**
+ * @brief Entry of the key directory of a posting list leaf.
+ */
+template <class T>
+struct PostingGroup{
+    /**
+    * A distinct key of the leaf.
+    */
+	T key;
+
+    /**
+    * Index of the first entry with this key among the entries of the leaf.
+    */
+	int first;
+
+    /**
+    * Byte offset of the record id list of the key in the data of the leaf.
+    */
+	int offset;
+
+    /**
+    * Largest record id of the list, so that ascending record ids are appended without decoding it.
+    */
+	RecordId last;
+};
+
+/**
+ * @brief Leaf node layout of indexes created with POSTING_LEAVES. Every distinct key of the leaf is stored once,
+ * in a directory at the end of data, and its record ids as one list at the front of data, sorted by page and slot
+ * and stored as varint coded gaps to the previous one: the page gap, then the slot gap on the same page or the slot
+ * itself on a new one. A record id of a low-cardinality column takes two or three bytes this way instead of the
+ * twelve or more of an array leaf. A key with more record ids than fit in one leaf continues its list in the
+ * following leaves. Entries are numbered by key and record id like in an array leaf, and the header matches
+ * LeafNode, which hands its calls on to this layout when type is POSTINGLEAF.
+ */
+template <class T>
+struct PostingLeafNode{
+	Nodetype type;
+
+    /**
+    * Number of entries, that is record ids, in the leaf.
+    */
+	int size;
+	PageId rightSibPageNo;
+
+    /**
+    * Number of distinct keys in the leaf.
+    */
+	int keyCount;
+
+    /**
+    * Number of bytes of data taken by the record id lists.
+    */
+	int listLength;
+	char data[ POSTINGNODEDATASIZE ];
+
+	void init( PageId rightSib );
+	T key( int i ) const;
+	RecordId rid( int i ) const;
+	void copyRids( int from, int count, RecordId* out, RidReadPosition* position ) const;
+	int lowerBound( int from, const T& key ) const;
+	int upperBound( int from, const T& key ) const;
+
+    /**
+    * Insert the key-rid pair. rid goes to its place in the list of key, whatever pos is.
+    */
+	bool insert( int pos, const T& key, RecordId rid );
+	void remove( int pos );
+	int insertSorted( const RIDKeyPair<T>* entries, int count );
+	void split( PostingLeafNode* right, int pos, const T& key, RecordId rid, bool append );
+	bool underfull() const;
+	bool merge( PostingLeafNode* right );
+	bool redistribute( PostingLeafNode* right, NonLeafNode<T>* parent, int sepIndex );
+
+    /**
+    * The key directory, one entry per distinct key in key order.
+    */
+	PostingGroup<T>* groups() { return (PostingGroup<T>*)( data + POSTINGNODEDATASIZE ) - keyCount; }
+	const PostingGroup<T>* groups() const { return (const PostingGroup<T>*)( data + POSTINGNODEDATASIZE ) - keyCount; }
+
+    /**
+    * Index of the directory entry of the key of entry i.
+    */
+	int groupOf( int i ) const;
+
+    /**
+    * Number of record ids of key g of the directory.
+    */
+	int groupSize( int g ) const;
+
+    /**
+    * Byte offset one past the end of the record id list of key g of the directory.
+    */
+	int listEnd( int g ) const;
+
+    /**
+    * Number of bytes of data not taken by the directory or the lists.
+    */
+	int freeSpace() const;
+
+    /**
+    * Copy the record ids of key g of the directory to out.
+    */
+	void decodeList( int g, RecordId* out ) const;
+
+    /**
+    * Replace the bytes [from, to) of the lists, which belong to key g of the directory, with the length bytes
+    * at bytes and move the lists of the keys after g accordingly. The leaf must have room for them.
+    */
+	void spliceList( int g, int from, int to, const unsigned char* bytes, int length );
+
+    /**
+    * Copy the entries of the leaf to entries[0, size).
+    */
+	void decode( RIDKeyPair<T>* entries ) const;
+
+    /**
+    * Overwrite the leaf with entries[0, count), which must be sorted by key and record id and fit().
+    */
+	void encode( const RIDKeyPair<T>* entries, int count );
+
+    /**
+    * True if a leaf with the sorted entries[0, count) fits in a page.
+    */
+	static bool fits( const RIDKeyPair<T>* entries, int count );
+};
+
+/**
+ * @brief Leaf node layout of INTEGER indexes created with PACKED_LEAVES. Keys are stored as offsets from the
+ * smallest key of the leaf (keyBase), page numbers as offsets from the smallest page number (pageBase), and
+ * slot numbers as they are, each with as many bits as the largest of them needs. The three bit packed streams
+ * lie one after the other in data, each for rows of four entries: entry i goes to lane i % 4 of row i / 4, and
+ * the bits of every lane run through the words of the stream with a stride of four. Rows therefore unpack four
+ * entries at a time with SIMD shifts and masks, and entry i can still be read on its own.
+ * Keys 0 to 5000 with record ids from a few dozen pages take about 30 bits per entry instead of 96, so a leaf
+ * holds up to PACKEDLEAFSIZE entries rather than INTARRAYLEAFSIZE. Inserts that fit the bit widths and removals
+ * repack the rows from their entry on in place, other changes decode the leaf and encode it again with new widths. The header matches LeafNode,
+ * which hands its calls on to this layout when type is PACKEDLEAF.
+ */
+template <class T>
+struct PackedLeafNode{
+	Nodetype type;
+	int size;
+	PageId rightSibPageNo;
+
+    /**
+    * Smallest key of the leaf.
+    */
+	int keyBase;
+
+    /**
+    * Smallest page number of the record ids of the leaf.
+    */
+	PageId pageBase;
+
+    /**
+    * Number of bits of every key offset, page number offset and slot number.
+    */
+	unsigned char keyBits;
+	unsigned char pageBits;
+	unsigned char slotBits;
+	unsigned char padding;
+
+    /**
+    * Number of rows of four entries the streams have room for.
+    */
+	int rows;
+	unsigned data[ PACKEDNODEDATAWORDS ];
+
+	void init( PageId rightSib );
+	T key( int i ) const;
+	RecordId rid( int i ) const;
+	void copyRids( int from, int count, RecordId* out ) const;
+	int lowerBound( int from, const T& key ) const;
+	int upperBound( int from, const T& key ) const;
+	bool insert( int pos, const T& key, RecordId rid );
+	void remove( int pos );
+	int insertSorted( const RIDKeyPair<T>* entries, int count );
+	void split( PackedLeafNode* right, int pos, const T& key, RecordId rid, bool append );
+	bool underfull() const;
+	bool merge( PackedLeafNode* right );
+	bool redistribute( PackedLeafNode* right, NonLeafNode<T>* parent, int sepIndex );
+
+    /**
+    * First word of the key offsets, page number offsets and slot numbers.
+    */
+	unsigned* keyStream() { return data; }
+	const unsigned* keyStream() const { return data; }
+	unsigned* pageStream();
+	const unsigned* pageStream() const;
+	unsigned* slotStream();
+	const unsigned* slotStream() const;
+
+    /**
+    * Copy the entries of the leaf to entries[0, size).
+    */
+	void decode( RIDKeyPair<T>* entries ) const;
+
+    /**
+    * Overwrite the leaf with entries[0, count), which must be sorted by key and fit().
+    */
+	void encode( const RIDKeyPair<T>* entries, int count );
+
+    /**
+    * True if a leaf with the sorted entries[0, count) fits in a page.
+    */
+	static bool fits( const RIDKeyPair<T>* entries, int count );
+};
+
+/**
+ * @brief Leaf node layout of covering indexes, created with payload columns. Entries are fixed width slots of
+ * the key, the record id and payloadLength bytes copied from the payload columns of the record, so scans can
+ * return the columns without reading the records. Keys are stored whole, STRING keys too. The header matches
+ * LeafNode, which hands its calls on to this layout when type is COVERINGLEAF.
+ */
+template <class T>
+struct CoveringLeafNode{
+	Nodetype type;
+	int size;
+	PageId rightSibPageNo;
+
+    /**
+    * Number of payload bytes of every entry.
+    */
+	int payloadLength;
+	char data[ COVERINGNODEDATASIZE ];
+
+	void init( PageId rightSib, int payloadLength );
+	T key( int i ) const;
+	RecordId rid( int i ) const;
+	void copyRids( int from, int count, RecordId* out ) const;
+	void copyPayloads( int from, int count, char* out ) const;
+	int lowerBound( int from, const T& key ) const;
+	int upperBound( int from, const T& key ) const;
+
+    /**
+    * Insert the entry with the payloadLength bytes at payload, or with a zero payload if payload is null.
+    */
+	bool insert( int pos, const T& key, RecordId rid, const char* payload );
+	void remove( int pos );
+	int insertSorted( const RIDKeyPair<T>* entries, int count );
+	void split( CoveringLeafNode* right, int pos, const T& key, RecordId rid, const char* payload, bool append );
+	bool underfull() const;
+	bool merge( CoveringLeafNode* right );
+	bool redistribute( CoveringLeafNode* right, NonLeafNode<T>* parent, int sepIndex );
+
+    /**
+    * Number of bytes of an entry.
+    */
+	int entryLength() const { return sizeof( T ) + sizeof( RecordId ) + payloadLength; }
+
+    /**
+    * Most entries the leaf holds.
+    */
+	int capacity() const { return COVERINGNODEDATASIZE / entryLength(); }
+
+    /**
+    * Start of entry i.
+    */
+	char* entry( int i ) { return data + i * entryLength(); }
+	const char* entry( int i ) const { return data + i * entryLength(); }
+};
+
+/**
+ * @brief Structure for all leaf nodes, templated for the key type.
+ */
+template <class T>
+struct LeafNode{
+    /**
+    * Should be initialized as LEAF.
+    */
+    Nodetype type;
+
+    /**
+    * Number of keys in the node.
+    */
+    int size;
+
+    /**
+    * Page number of the leaf on the right side.
+    * This linking of leaves allows to easily move from one leaf to the next leaf during index scan.
+    */
+    PageId rightSibPageNo;
+
+    /**
+    * Stores keys.
+    */
+	T keyArray[ KeyTraits<T>::LEAFSIZE ];
+
+    /**
+    * Stores RecordIds.
+    */
+	RecordId ridArray[ KeyTraits<T>::LEAFSIZE ];
+
+    /**
+    * Make this an empty leaf with the given layout whose right sibling is rightSib. Covering leaves take
+    * payloadLength bytes of payload per entry.
+    */
+	void init( PageId rightSib, LeafFormat format, int payloadLength = 0 );
+
+    /**
+    * Key of entry i.
+    */
+	T key( int i ) const;
+
+    /**
+    * Record id of entry i.
+    */
+	RecordId rid( int i ) const;
+
+    /**
+    * Copy the record ids of entries [from, from + count) to out. A reader going through the leaf in order
+    * passes the same position to every call, see RidReadPosition.
+    */
+	void copyRids( int from, int count, RecordId* out, RidReadPosition* position = nullptr ) const;
+
+    /**
+    * Copy the payloads of entries [from, from + count) of a covering leaf to out, one after the other. Leaves
+    * of other layouts have no payload and copy nothing.
+    */
+	void copyPayloads( int from, int count, char* out ) const;
+
+    /**
+    * Index of the first entry at or after from whose key is not less than key. Array leaves of int keys
+    * are searched by interpolation, like nonleaves.
+    */
+	int lowerBound( int from, const T& key ) const;
+
+    /**
+    * Index of the first entry at or after from whose key is greater than key.
+    */
+	int upperBound( int from, const T& key ) const;
+
+    /**
+    * Insert the key-rid pair at index pos, with payload as its payload in a covering leaf.
+    * @return False, leaving the leaf unchanged, if the leaf is full.
+    */
+	bool insert( int pos, const T& key, RecordId rid, const char* payload = nullptr );
+
+    /**
+    * Remove entry pos.
+    */
+	void remove( int pos );
+
+    /**
+    * Merge a prefix of the sorted entries[0, count), all of which belong in this leaf, into the leaf.
+    * @return Number of entries merged, less than count only if the leaf filled up.
+    */
+	int insertSorted( const RIDKeyPair<T>* entries, int count );
+
+    /**
+    * Split this full leaf, into which the insert of key and rid at pos failed, with the empty page right.
+    * The lower entries stay in place, the upper ones move to right. With append set the leaf stays full
+    * and right starts with the new entry alone. Sibling links are left to the caller.
+    */
+	void split( LeafNode* right, int pos, const T& key, RecordId rid, const char* payload, bool append );
+
+    /**
+    * Separator to put between this leaf and its right sibling right in the parent: not less than any key
+    * of this leaf and not greater than any key of right.
+    */
+	T separator( const LeafNode* right ) const;
+
+    /**
+    * True if the leaf holds less than half of what fits in a page.
+    */
+	bool underfull() const;
+
+    /**
+    * Append the entries of the right sibling right to this leaf. Sibling links are left to the caller.
+    * @return False, leaving both leaves unchanged, if they do not fit in one page.
+    */
+	bool merge( LeafNode* right );
+
+    /**
+    * Even out this leaf and its right sibling right, and update their separator, key sepIndex of parent.
+    * @return False, leaving all three nodes unchanged, if there is no better split that fits.
+    */
+	bool redistribute( LeafNode* right, NonLeafNode<T>* parent, int sepIndex );
+
+    /**
+    * This leaf as a posting list leaf, which it is if type is POSTINGLEAF.
+    */
+	PostingLeafNode<T>* postings() { return (PostingLeafNode<T>*)this; }
+	const PostingLeafNode<T>* postings() const { return (const PostingLeafNode<T>*)this; }
+
+    /**
+    * This leaf as a packed leaf, which it is if type is PACKEDLEAF.
+    */
+	PackedLeafNode<T>* packed() { return (PackedLeafNode<T>*)this; }
+	const PackedLeafNode<T>* packed() const { return (const PackedLeafNode<T>*)this; }
+
+    /**
+    * This leaf as a covering leaf, which it is if type is COVERINGLEAF.
+    */
+	CoveringLeafNode<T>* covering() { return (CoveringLeafNode<T>*)this; }
+	const CoveringLeafNode<T>* covering() const { return (const CoveringLeafNode<T>*)this; }
+};
+
+/**
+ * @brief Child of a STRING non-leaf node: its page number and the number of leaf entries in its subtree.
+ */
+struct ChildEntry{
+	PageId pageNo;
+	std::uint32_t count;
+};
+
+/**
+ * @brief Non-leaf node for STRING keys. Keys are stored with their common prefix cut off and written once in
+ * prefix, and with the zero padding cut off, in slots of slotLength bytes, the length of the longest remaining
+ * key. Separators are chosen as short as possible (see LeafNode<StringKey>::separator()), so slots are usually
+ * much shorter than STRINGSIZE and the fanout grows accordingly. Children fill data from the front, as
+ * ChildEntry if type is COUNTEDNONLEAF and as their page number alone otherwise, key slots from the back.
+ * data comes before prefix so that the counts of the children are aligned.
+ */
+template <>
+struct NonLeafNode<StringKey>{
+	Nodetype type;
+	int size;
+	int level;
+
+    /**
+    * Number of leading bytes all keys of the node share, stored in prefix.
+    */
+	int prefixLength;
+
+    /**
+    * Number of bytes stored per key.
+    */
+	int slotLength;
+	char data[ STRINGNODEDATASIZE ];
+	char prefix[ STRINGSIZE ];
+
+	void init( int level, PageId firstChild, std::uint32_t count, bool counted );
+	bool counted() const { return type == COUNTEDNONLEAF; }
+	StringKey key( int i ) const;
+	PageId child( int i ) const;
+	std::uint32_t count( int i ) const;
+	void setCount( int i, std::uint32_t count );
+	void addCount( int i, int delta );
+	std::uint32_t total() const;
+	int lowerBound( const StringKey& key ) const;
+	int upperBound( const StringKey& key ) const;
+	bool plausible() const;
+	bool insert( int pos, const StringKey& key, PageId pageNo, std::uint32_t count );
+	void remove( int pos );
+	bool replaceKey( int i, const StringKey& key );
+	StringKey split( NonLeafNode* right, int pos, const StringKey& key, PageId pageNo, std::uint32_t count, bool append );
+	bool underfull() const;
+	bool merge( const StringKey& separator, NonLeafNode* right );
+	bool redistribute( NonLeafNode* right, NonLeafNode* parent, int sepIndex );
+
+    /**
+    * Start of the key slots.
+    */
+	char* slots() { return data + STRINGNODEDATASIZE - size * slotLength; }
+	const char* slots() const { return data + STRINGNODEDATASIZE - size * slotLength; }
+
+    /**
+    * Number of bytes stored per child.
+    */
+	int childLength() const { return counted() ? sizeof( ChildEntry ) : sizeof( PageId ); }
+
+    /**
+    * Number of bytes of data taken by count children and count keys of slotLength bytes.
+    */
+	int usedLength( int count, int slotLength ) const { return ( count + 1 ) * childLength() + count * slotLength; }
+
+    /**
+    * True if insert() is sure to succeed, even of a key that needs slots of the full STRINGSIZE bytes.
+    */
+	bool hasRoom() const { return usedLength( size + 1, STRINGSIZE ) <= STRINGNODEDATASIZE; }
+
+    /**
+    * Copy the keys and children of the node to keys[0, size) and children[0, size]. Children get a count of 0
+    * if the node does not count entries.
+    */
+	void decode( StringKey* keys, ChildEntry* children ) const;
+
+    /**
+    * Overwrite the node with keys[0, count) and children[0, count], which must fit().
+    */
+	void encode( const StringKey* keys, const ChildEntry* children, int count );
+
+    /**
+    * True if a node of the type of this one with the sorted keys[0, count) fits in a page.
+    */
+	bool fits( const StringKey* keys, int count ) const;
+};
+
+/**
+ * @brief Leaf node for STRING keys. The prefix common to all keys of the leaf is stored once in prefix and
+ * only the remaining STRINGSIZE - prefixLength bytes of each key are kept, so leaves of keys that share long
+ * prefixes hold several times more entries. Record ids fill data from the front, key slots from the back.
+ */
+template <>
+struct LeafNode<StringKey>{
+	Nodetype type;
+	int size;
+	PageId rightSibPageNo;
+
+    /**
+    * Number of leading bytes all keys of the leaf share, stored in prefix.
+    */
+	int prefixLength;
+
+    /**
+    * Number of bytes stored per key, always STRINGSIZE - prefixLength.
+    */
+	int slotLength;
+	char prefix[ STRINGSIZE ];
+	char data[ STRINGNODEDATASIZE ];
+
+	void init( PageId rightSib, LeafFormat format, int payloadLength = 0 );
+	StringKey key( int i ) const;
+	RecordId rid( int i ) const;
+	void copyRids( int from, int count, RecordId* out, RidReadPosition* position = nullptr ) const;
+	void copyPayloads( int from, int count, char* out ) const;
+	int lowerBound( int from, const StringKey& key ) const;
+	int upperBound( int from, const StringKey& key ) const;
+	bool insert( int pos, const StringKey& key, RecordId rid, const char* payload = nullptr );
+	void remove( int pos );
+	int insertSorted( const RIDKeyPair<StringKey>* entries, int count );
+	void split( LeafNode* right, int pos, const StringKey& key, RecordId rid, const char* payload, bool append );
+	StringKey separator( const LeafNode* right ) const;
+	bool underfull() const;
+	bool merge( LeafNode* right );
+	bool redistribute( LeafNode* right, NonLeafNode<StringKey>* parent, int sepIndex );
+	PostingLeafNode<StringKey>* postings() { return (PostingLeafNode<StringKey>*)this; }
+	const PostingLeafNode<StringKey>* postings() const { return (const PostingLeafNode<StringKey>*)this; }
+	CoveringLeafNode<StringKey>* covering() { return (CoveringLeafNode<StringKey>*)this; }
+	const CoveringLeafNode<StringKey>* covering() const { return (const CoveringLeafNode<StringKey>*)this; }
+
+    /**
+    * Start of the key slots.
+    */
+	char* slots() { return data + STRINGNODEDATASIZE - size * slotLength; }
+	const char* slots() const { return data + STRINGNODEDATASIZE - size * slotLength; }
+
+    /**
+    * Copy the entries of the leaf to keys[0, size) and rids[0, size).
+    */
+	void decode( StringKey* keys, RecordId* rids ) const;
+
+    /**
+    * Overwrite the leaf with the entries keys[0, count) and rids[0, count), which must fit().
+    */
+	void encode( const StringKey* keys, const RecordId* rids, int count );
+
+    /**
+    * True if a leaf with the sorted keys[0, count) fits in a page.
+    */
+	static bool fits( const StringKey* keys, int count );
+};
+
+/**
+ * @brief Structure for all non-leaf nodes when the key is of INTEGER type.
+ */
+typedef NonLeafNode<int> NonLeafNodeInt;
+
+/**
+ * @brief Structure for all non-leaf nodes when the key is of DOUBLE type.
+ */
+typedef NonLeafNode<double> NonLeafNodeDouble;
+
+/**
+ * @brief Structure for all non-leaf nodes when the key is of STRING type.
+ */
+typedef NonLeafNode<StringKey> NonLeafNodeString;
+
+/**
+ * @brief Structure for all leaf nodes when the key is of INTEGER type.
+ */
+typedef LeafNode<int> LeafNodeInt;
+
+/**
+ * @brief Structure for all leaf nodes when the key is of DOUBLE type.
+ */
+typedef LeafNode<double> LeafNodeDouble;
+
+/**
+ * @brief Structure for all leaf nodes when the key is of STRING type.
+ */
+typedef LeafNode<StringKey> LeafNodeString;
+
+/**
+ * @brief Structure for all non-leaf nodes when the key is of COMPOSITE type.
+ */
+typedef NonLeafNode<CompositeKey> NonLeafNodeComposite;
+
+/**
+ * @brief Structure for all leaf nodes when the key is of COMPOSITE type.
+ */
+typedef LeafNode<CompositeKey> LeafNodeComposite;
+
+static_assert( sizeof( NonLeafNodeInt ) <= Page::SIZE, "NonLeafNodeInt must fit in a page" );
+static_assert( offsetof( NonLeafNodeInt, keyArray ) + INTARRAYCOUNTEDNONLEAFSIZE * sizeof( int ) + 2 * ( INTARRAYCOUNTEDNONLEAFSIZE + 1 ) * sizeof( PageId ) <= Page::SIZE, "counted NonLeafNodeInt must fit in a page" );
+static_assert( sizeof( LeafNodeInt ) <= Page::SIZE, "LeafNodeInt must fit in a page" );
+static_assert( sizeof( NonLeafNodeDouble ) <= Page::SIZE, "NonLeafNodeDouble must fit in a page" );
+static_assert( offsetof( NonLeafNodeDouble, keyArray ) + DOUBLEARRAYCOUNTEDNONLEAFSIZE * sizeof( double ) + 2 * ( DOUBLEARRAYCOUNTEDNONLEAFSIZE + 1 ) * sizeof( PageId ) <= Page::SIZE, "counted NonLeafNodeDouble must fit in a page" );
+static_assert( sizeof( LeafNodeDouble ) <= Page::SIZE, "LeafNodeDouble must fit in a page" );
+static_assert( sizeof( NonLeafNodeString ) <= Page::SIZE, "NonLeafNodeString must fit in a page" );
+static_assert( sizeof( LeafNodeString ) <= Page::SIZE, "LeafNodeString must fit in a page" );
+static_assert( sizeof( NonLeafNodeComposite ) <= Page::SIZE, "NonLeafNodeComposite must fit in a page" );
+static_assert( offsetof( NonLeafNodeComposite, keyArray ) + COMPOSITEARRAYCOUNTEDNONLEAFSIZE * sizeof( CompositeKey ) + 2 * ( COMPOSITEARRAYCOUNTEDNONLEAFSIZE + 1 ) * sizeof( PageId ) <= Page::SIZE, "counted NonLeafNodeComposite must fit in a page" );
+static_assert( sizeof( LeafNodeComposite ) <= Page::SIZE, "LeafNodeComposite must fit in a page" );
+static_assert( sizeof( PostingLeafNode<double> ) <= Page::SIZE, "PostingLeafNode must fit in a page" );
+static_assert( sizeof( PackedLeafNode<int> ) <= Page::SIZE, "PackedLeafNode must fit in a page" );
+static_assert( sizeof( CoveringLeafNode<double> ) <= Page::SIZE, "CoveringLeafNode must fit in a page" );
+
+/**
+ * @brief Copies of the keys of int nonleaves in Eytzinger order, the order of a breadth-first walk of the binary
+ * search tree over them: the keys compared after key k are at 2k and 2k + 1. The first levels of every search
+ * share a few cache lines, and the line of the keys four levels further down is prefetched at each step. Only
+ * nodes whose keys interpolation search mispredicts are copied; evenly spaced keys are found faster in place.
+ * A fixed number of slots is indexed by the buffer frame of the node. A copy is valid for the page version it
+ * was made at, which every change of the node and every reuse of the frame advances, and is made on the first
+ * search of the node at a new version. A slot may be rebuilt while other threads search it: its sequence number is
+ * odd while it is written, and a search that sees the number change meanwhile falls back to the node.
+ */
+class EytzingerCache{
+public:
+	EytzingerCache( int numSlots );
+
+	~EytzingerCache();
+
+	EytzingerCache( const EytzingerCache& ) = delete;
+	EytzingerCache& operator=( const EytzingerCache& ) = delete;
+
+	/**
+	 * Search the copy of the nonleaf in page, if its slot holds one made at version.
+	 * @param key
+	 * @param upper		True for the index of the first key greater than key rather than not less than it
+	 * @param index		Receives the index, as NonLeafNode::lowerBound() or upperBound() would return it
+	 * @return False, leaving index unchanged, if there is no such copy.
+	 */
+	bool search( const Page* page, std::uint32_t version, int key, bool upper, int& index ) const;
+
+	/**
+	 * Copy the keys of node, the nonleaf in page, into the slot of page, unless another thread is writing that
+	 * slot. The copy is kept only if the node is still at version afterwards.
+	 * @param bufMgr		Buffer manager that page is pinned in, or null if the node is latched and cannot change
+	 */
+	void build( const Page* page, std::uint32_t version, const NonLeafNode<int>* node, const BufMgr* bufMgr );
+
+	/**
+	 * Search node, the nonleaf in page, by interpolation, and search its copy only if the prediction misses. A
+	 * node without a copy at version is copied then and searched by binary search.
+	 * @param bufMgr		Buffer manager that page is pinned in, or null if the node is latched and cannot change
+	 * @return The index NonLeafNode::lowerBound() or upperBound() would return.
+	 */
+	int searchNode( const Page* page, std::uint32_t version, const NonLeafNode<int>* node, int key, bool upper, const BufMgr* bufMgr );
+
+	/**
+	 * Number of nonleaves the cache holds copies of at a time.
+	 */
+	int size() const
+	{
+		return numSlots;
+	}
+
+private:
+	/**
+	 * @brief Copy of the keys of one nonleaf.
+	 */
+	struct Slot{
+		/**
+		 * Odd while the slot is being written.
+		 */
+		std::atomic<std::uint32_t> sequence;
+
+		/**
+		 * Frame and version of the node the keys were copied from. page is null if the slot holds no copy.
+		 */
+		const Page* page;
+		std::uint32_t version;
+		int size;
+
+		/**
+		 * The keys in Eytzinger order from index 1 on, and the index of every key in the node.
+		 */
+		int keys[ INTARRAYNONLEAFSIZE + 1 ];
+		short ranks[ INTARRAYNONLEAFSIZE + 1 ];
+	};
+
+	/**
+	 * Slot of the node in page.
+	 */
+	Slot& slotOf( const Page* page ) const;
+
+	/**
+	 * Copy the keys of node from index i on into the subtree of slot position k, in order.
+	 * @return Index of the first key of node not copied.
+	 */
+	static int fill( Slot& slot, const NonLeafNode<int>* node, int i, int k );
+
+	Slot* slots;
+	int numSlots;
+};
+
+
+/**
+ * @brief BTreeScanCursor class. It holds the state of one range scan over a BTreeIndex, including its own
+ * pinned leaf, so any number of cursors may be open against the same index at a time. All cursors of an
+ * index must be ended or destroyed before the index itself is destroyed.
+ * Each cursor is used by one thread, but cursors of different threads may scan while others insert. The leaf
+ * is only latched during a call; if it changed since the last one, the scan resumes after the last entry it returned.
+ * A scan may run in ASCENDING or DESCENDING order of keys.
+*/
+class BTreeScanCursor {
+
+ private:
+
+  /**
+   * Index being scanned.
+   */
+	BTreeIndex	*index;
+
+  /**
+   * True if an index scan has been started.
+   */
+	bool		scanExecuting;
+
+  /**
+   * Index of next entry to be scanned in current leaf being scanned.
+   */
+	int			nextEntry;
+
+  /**
+   * Page number of current page being scanned.
+   */
+	PageId	currentPageNum;
+
+  /**
+   * Current Page being scanned.
+   */
+	Page		*currentPageData;
+
+  /**
+   * Where the record ids of the current page were last read up to.
+   */
+	RidReadPosition	ridPosition;
+
+  /**
+   * Version of the current page when its latch was last released.
+   */
+	std::uint32_t	pageVersion;
+
+  /**
+   * True once the scan returned an entry of the tree; lastRid and the last value of the key type are that entry.
+   * Entries of the insert buffer snapshot are counted by nextDelta instead.
+   */
+	bool		hasLast;
+
+  /**
+   * True if the last entry returned was moved out of the current page by a split, so the scan resumes
+   * after it in the next page.
+   */
+	bool		resumeAfterLast;
+
+  /**
+   * Record id of the last entry of the tree returned.
+   */
+	RecordId	lastRid;
+
+  /**
+   * Key of the last entry of the tree returned, for INTEGER, DOUBLE, STRING and COMPOSITE indexes.
+   */
+	int			lastValInt;
+	double	lastValDouble;
+	StringKey	lastValString;
+	CompositeKey	lastValComposite;
+
+  /**
+   * Low INTEGER value for scan.
+   */
+	int			lowValInt;
+
+  /**
+   * Low DOUBLE value for scan.
+   */
+	double	lowValDouble;
+
+  /**
+   * Low STRING value for scan.
+   */
+	StringKey	lowValString;
+
+  /**
+   * Low COMPOSITE value for scan.
+   */
+	CompositeKey	lowValComposite;
+
+  /**
+   * High INTEGER value for scan.
+   */
+	int			highValInt;
+
+  /**
+   * High DOUBLE value for scan.
+   */
+	double	highValDouble;
+
+  /**
+   * High STRING value for scan.
+   */
+	StringKey	highValString;
+
+  /**
+   * High COMPOSITE value for scan.
+   */
+	CompositeKey	highValComposite;
+	
+  /**
+   * Low Operator. Can only be GT(>) or GTE(>=).
+   */
+	Operator	lowOp;
+
+  /**
+   * High Operator. Can only be LT(<) or LTE(<=).
+   */
+	Operator	highOp;
+
+  /**
+   * Order the scan returns its entries in. A DESCENDING scan returns the entries before nextEntry, last first.
+   */
+	ScanOrder	order;
+
+  /**
+   * Root-to-leaf path a DESCENDING scan finds left siblings through, for INTEGER, DOUBLE, STRING and COMPOSITE
+   * indexes. It leads to the current leaf or, once splits made the scan move right, to a leaf left of it.
+   */
+	std::vector<PathEntry<int> >	pathInt;
+	std::vector<PathEntry<double> >	pathDouble;
+	std::vector<PathEntry<StringKey> >	pathString;
+	std::vector<PathEntry<CompositeKey> >	pathComposite;
+
+  /**
+   * Entries of the range that were in the insert buffer of the index when the scan started, in key order, for
+   * INTEGER, DOUBLE, STRING and COMPOSITE indexes. The scan merges them with the entries of the leaves.
+   */
+	std::vector<RIDKeyPair<int> >	deltaInt;
+	std::vector<RIDKeyPair<double> >	deltaDouble;
+	std::vector<RIDKeyPair<StringKey> >	deltaString;
+	std::vector<RIDKeyPair<CompositeKey> >	deltaComposite;
+
+  /**
+   * Index of the next entry of the snapshot an ASCENDING scan returns, or one past the next one a DESCENDING
+   * scan returns.
+   */
+	int			nextDelta;
+
+  /**
+   * insertBufferGeneration of the index when the snapshot was taken. Once it moved on, the buffer was merged
+   * into the leaves, and entries of the leaves that are in the snapshot are skipped.
+   */
+	unsigned	deltaGeneration;
+
+ private:
+
+    /**
+     * Low value of the current scan range for key type T, one of lowValInt, lowValDouble, lowValString and lowValComposite.
+     */
+    template <class T>
+    T& lowVal();
+
+    /**
+     * High value of the current scan range for key type T, one of highValInt, highValDouble, highValString and
+     * highValComposite.
+     */
+    template <class T>
+    T& highVal();
+
+    /**
+     * Key of the last entry returned for key type T, one of lastValInt, lastValDouble, lastValString and lastValComposite.
+     */
+    template <class T>
+    T& lastVal();
+
+    /**
+     * Path of the current DESCENDING scan for key type T, one of pathInt, pathDouble, pathString and pathComposite.
+     */
+    template <class T>
+    std::vector<PathEntry<T> >& path();
+
+    /**
+     * Insert buffer snapshot of the current scan for key type T, one of deltaInt, deltaDouble, deltaString and
+     * deltaComposite.
+     */
+    template <class T>
+    std::vector<RIDKeyPair<T> >& delta();
+
+    /**
+     * Copy the entries of the range in the insert buffer of the index into the snapshot. The caller holds
+     * treeLatch shared.
+     */
+    template <class T>
+    void snapshotDelta();
+
+    /**
+     * Drop the record ids of entries [from, from + count) of node that are in the snapshot from rids, which
+     * holds them in order, because the buffer was merged into the leaves since the snapshot was taken. Entries
+     * inserted after the snapshot was taken are dropped too if the scan already returned an entry of the
+     * snapshot past their key.
+     * @return Number of record ids kept, at the front of rids.
+     */
+    template <class T>
+    int dropMerged(LeafNode<T> *node, int from, RecordId* rids, int count);
+
+    /**
+     * Index of the entry after the last one returned in the latched current leaf. If that entry is not in
+     * the leaf, the end of its run of equal keys while it may lie further right, else the start of the run.
+     * @param node
+     * @param movedOn		True if the leaf comes after the one the entry was returned from
+     */
+    template <class T>
+    int resumeIndex(LeafNode<T> *node, bool movedOn);
+
+    /**
+     * Index of the last entry returned by a DESCENDING scan in the latched current leaf, which is where the
+     * scan goes on below. A split may have moved the entry to a leaf further right; the current leaf is moved
+     * there then. If the entry is gone, the start of its run of equal keys.
+     */
+    template <class T>
+    int resumeBeforeLast();
+
+    /**
+     * Set scanExecuting, and count the scan among the open scans of the index while it is set.
+     */
+    void setExecuting(bool executing);
+
+    /**
+     * Release the latch of the current leaf, remembering its version.
+     */
+    void unlatchCurrent();
+
+    /**
+     * Unpin the current leaf, which is not latched, and leave the scan exhausted.
+     */
+    void releaseCurrent();
+
+    /**
+     * Checks whether the key satisfies the high end of the current scan range.
+     * @param key
+     * @return True if key is below the high value (LT) or not above it (LTE).
+     */
+    template <class T>
+    bool satisfiesHigh(const T& key);
+
+    /**
+     * Checks whether the key satisfies the low end of the current scan range.
+     * @param key
+     * @return True if key is above the low value (GT) or not below it (GTE).
+     */
+    template <class T>
+    bool satisfiesLow(const T& key);
+
+    /**
+     * Index of the first entry in the leaf that satisfies the low end of the current scan range.
+     * @param node
+     * @return Index in [0, node->size]; node->size if no entry in this leaf qualifies.
+     */
+    template <class T>
+    int lowBoundIndex(LeafNode<T> *node);
+
+    /**
+     * Index one past the last entry, starting at nextEntry, of the current leaf that satisfies
+     * the high end of the current scan range.
+     * @param node
+     * @return Index in [nextEntry, node->size].
+     */
+    template <class T>
+    int highBoundIndex(LeafNode<T> *node);
+
+    /**
+     * Unpin the current scan leaf and pin its right sibling, latching it before the current leaf is
+     * released. Leaves the scan exhausted (currentPageNum = MAX_PAGEID) if there is no right sibling, and
+     * nextEntry at the first entry of the sibling that is in range and was not returned yet otherwise.
+     * @return True if a right sibling was pinned.
+     */
+    template <class T>
+    bool advanceScanLeaf();
+
+    /**
+     * Unpin the current scan leaf, which is latched, and pin and latch its left sibling, found through the
+     * path of the scan. Leaves the scan exhausted if there is no left sibling, and nextEntry one past the last
+     * entry of the sibling that is in range and was not returned yet otherwise.
+     * @return True if a left sibling was pinned.
+     */
+    template <class T>
+    bool retreatScanLeaf();
+
+    /**
+     * Latch the last leaf that may hold entries satisfying the high end of the range and position nextEntry
+     * one past the last of them, moving left past leaves that hold none. Starts a DESCENDING scan.
+     * @return False if no leaf holds an entry satisfying the high end; the scan is left exhausted then.
+     */
+    template <class T>
+    bool seekHigh();
+
+    /**
+     * tryStartScan() once the key type of the index is known.
+     */
+    template <class T>
+    bool tryStartTyped(const T& lowValParm, const Operator lowOpParm, const T& highValParm, const Operator highOpParm, const ScanOrder orderParm);
+
+    /**
+     * scanNextBatch() once the key type of the index is known.
+     */
+    template <class T>
+    int scanNextBatchTyped(RecordId* outRids, char* outPayloads, int maxRids);
+
+    /**
+     * scanNextBatch() of a DESCENDING scan once the key type of the index is known.
+     */
+    template <class T>
+    int scanPrevBatchTyped(RecordId* outRids, char* outPayloads, int maxRids);
+
+ public:
+
+  /**
+   * BTreeScanCursor Constructor. The cursor is idle until startScan() is called.
+   * @param index	Index to scan
+   */
+	BTreeScanCursor(BTreeIndex *index);
+
+  /**
+   * BTreeScanCursor Destructor. Ends the scan, unpinning its leaf, if one is executing.
+   */
+	~BTreeScanCursor();
+
+	BTreeScanCursor(const BTreeScanCursor&) = delete;
+	BTreeScanCursor& operator=(const BTreeScanCursor&) = delete;
+
+  /**
+   * True if a scan has been started on this cursor and not yet ended.
+   */
+	bool isExecuting() const { return scanExecuting; }
+
+  /**
+   * Begin a filtered scan of the index. See BTreeIndex::startScan().
+   * @param lowVal	Low value of range, pointer to integer / double / char string
+   * @param lowOp		Low operator (GT/GTE)
+   * @param highVal	High value of range, pointer to integer / double / char string
+   * @param highOp	High operator (LT/LTE)
+   * @param order		ASCENDING to return entries from the low end up, DESCENDING from the high end down
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values
+   * @throws  BadScanrangeException If lowVal > highval
+   * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
+   */
+	void startScan(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp, const ScanOrder order = ASCENDING);
+
+  /**
+   * Non-throwing variant of startScan(). See BTreeIndex::tryStartScan().
+   * @return True if a scan was started, false if no key in the B+ tree satisfies the scan criteria.
+   */
+	bool tryStartScan(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp, const ScanOrder order = ASCENDING);
+
+  /**
+   * Fetch the record id of the next index entry that matches the scan.
+   * @param outRid	RecordId of next record found that satisfies the scan criteria returned in this
+   * @throws ScanNotInitializedException If no scan has been initialized.
+   * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
+   */
+	void scanNext(RecordId& outRid);
+
+  /**
+   * Non-throwing variant of scanNext().
+   * @return True if outRid was filled in, false if the scan is completed.
+   * @throws ScanNotInitializedException If no scan has been initialized.
+   */
+	bool tryScanNext(RecordId& outRid);
+
+  /**
+   * Fetch up to maxRids record ids of the next index entries that match the scan. See BTreeIndex::scanNextBatch().
+   * @return Number of record ids written to outRids. Less than maxRids only if the scan is completed.
+   * @throws ScanNotInitializedException If no scan has been initialized.
+   */
+	int scanNextBatch(RecordId* outRids, int maxRids);
+
+  /**
+   * Fetch up to maxRids record ids of the next index entries that match the scan together with their payloads.
+   * See BTreeIndex::scanNextBatch().
+   * @return Number of record ids written to outRids. Less than maxRids only if the scan is completed.
+   * @throws ScanNotInitializedException If no scan has been initialized.
+   */
+	int scanNextBatch(RecordId* outRids, char* outPayloads, int maxRids);
+
+  /**
+   * Terminate the scan. Unpin any pinned pages. Reset scan specific variables.
+   * @throws ScanNotInitializedException If no scan has been initialized.
+   */
+	void endScan();
+};
+
+
+/**
+ * @brief BTreeIndex class. It implements a B+ Tree index on a single attribute of a
+ * relation, of type INTEGER, DOUBLE or STRING, or on a COMPOSITE key of several attributes. Methods that take
+ * a key as a pointer to an integer, double or char string take a pointer to a record of the relation, or to a
+ * buffer laid out like one, for a COMPOSITE key; the key attributes are read at their offsets.
+ * The index itself supports one scan at a time
+ * through startScan(); further concurrent scans are run through BTreeScanCursor objects.
+ * insertEntry(), lookup() and scans through cursors may be called from several threads at once; they
+ * descend without latching nonleaves, validating their versions instead, latch only the leaf, and latch
+ * the path of a leaf that has to be split down from the lowest nonleaf with room.
+ * All other methods, including the index's own scan, are for one thread at a time.
+*/
+class BTreeIndex {
+
+	friend class BTreeScanCursor;
 
  private:
 
@@ -258,9 +2142,9 @@ class BTreeIndex {
 	PageId	headerPageNum;
 
   /**
-   * page number of root page of B+ tree inside index file.
+   * page number of root page of B+ tree inside index file. Descents read it without any latch.
    */
-	PageId	rootPageNum;
+	std::atomic<PageId>	rootPageNum;
 
   /**
    * Datatype of attribute over which index is built.
@@ -275,167 +2159,692 @@ class BTreeIndex {
   /**
    * Number of keys in leaf node, depending upon the type of key.
    */
-	int			leafOccupancy;
+	std::atomic<int>	leafOccupancy;
 
   /**
    * Number of keys in non-leaf node, depending upon the type of key.
    */
-	int			nodeOccupancy;
+	std::atomic<int>	nodeOccupancy;
 
   /**
    * Depth of the tree. If the tree has only root node, depth = 0.
    */
-	int depth;
+	std::atomic<int> depth;
+
+  /**
+   * Page number of the first page on the free list, or MAX_PAGEID if there is none.
+   */
+	PageId	freePageNum;
+
+  /**
+   * Layout of the leaves, fixed when the index is created.
+   */
+	LeafFormat	leafFormat;
+
+  /**
+   * Attributes of a COMPOSITE key, most significant first, empty for other indexes.
+   */
+	std::vector<KeyColumn>	keyColumns;
+
+  /**
+   * Columns of the records copied into the leaf entries of a covering index, empty for other indexes.
+   */
+	std::vector<PayloadColumn>	payloadColumns;
+
+  /**
+   * Number of payload bytes of every leaf entry, the sum of the lengths of the payload columns.
+   */
+	int			payloadLength;
+
+  /**
+   * Pages of the Bloom filter over the keys of the index, empty if the index has none. Their bits are only ever
+   * set, until the index holds more than bloomCapacity entries and the filter is replaced by one twice that size.
+   */
+	std::vector<PageId>	bloomPages;
+
+  /**
+   * Bits per entry of the Bloom filter, 0 if the index has none. Fixed once the index is open.
+   */
+	int			bloomBitsPerKey;
+
+  /**
+   * Number of entries the Bloom filter was sized for, INT_MAX if it has the most pages a filter may take.
+   */
+	std::atomic<int>	bloomCapacity;
+
+  /**
+   * True if the nonleaves are COUNTEDNONLEAF nodes, which keep the number of entries below each child for
+   * countRange(), rank() and select(). Fixed once the index is open.
+   */
+	bool		countEntries;
+
+  /**
+   * Copies of int nonleaves in Eytzinger order that optimistic descents search instead of the nodes whose keys
+   * interpolation mispredicts, or null if there are none. Set by setEytzingerSearch().
+   */
+	EytzingerCache*	eytzingerCache;
+
+  /**
+   * @brief A nonleaf kept pinned in the buffer pool, and the frame it is pinned in.
+   */
+	struct PinnedPage{
+		/**
+		 * Page number of the nonleaf, MAX_PAGEID if the slot is empty. Set after page, so a descent that finds its
+		 * page number here finds the frame too. An emptied slot keeps its last frame, which a descent may still
+		 * be reading.
+		 */
+		std::atomic<PageId> pageNo;
+		std::atomic<Page*> page;
+	};
+
+  /**
+   * Upper nonleaves that stay pinned while the index is open, each in one of the PINNEDPROBES slots from its
+   * page number modulo PINNEDSLOTS on. Descents take their frames from here instead of asking the buffer
+   * manager. Slots are filled and emptied under pinMutex by inserts that split nonleaves or the root, or
+   * by operations that run alone, and the slot of a page is emptied when the page leaves the tree. A descent
+   * that reads a frame from a slot checks with pinValid() that the slot still holds the page.
+   */
+	PinnedPage	pinnedPages[PINNEDSLOTS];
+
+  /**
+   * Number of levels from the root down whose nonleaves are kept pinned. Set by setPinnedLevels().
+   */
+	int		pinnedLevels;
+
+  /**
+   * Guards filling and emptying pinnedPages against other inserts. Descents read the slots without it.
+   */
+	std::mutex	pinMutex;
+
+  /**
+   * Number of entries in the insert buffer at which it is merged into the tree, 0 if entries go straight to
+   * their leaves. Set by setInsertBuffer().
+   */
+	std::atomic<int>	insertBufferCapacity;
+
+  /**
+   * Entries inserted but not yet merged into the tree, the delta store in front of it. Kept in memory only, never
+   * on a page. Only the one matching attributeType is used.
+   */
+	DeltaStore<int> insertBufferInt;
+	DeltaStore<double> insertBufferDouble;
+	DeltaStore<StringKey> insertBufferString;
+	DeltaStore<CompositeKey> insertBufferComposite;
+
+  /**
+   * True if inserts go into the message buffer of the root rather than into a leaf. Set by setNodeBuffers(),
+   * and when an index whose nonleaves hold buffered entries is opened.
+   */
+	std::atomic<bool>	nodeBuffering;
+
+  /**
+   * Message buffer of every nonleaf that has one, by the page number of the nonleaf. Only changed while
+   * treeLatch is held exclusively, and empty unless nodeBuffering is set, so splits under a shared treeLatch find
+   * no buffer to carry along.
+   */
+	std::map<PageId, NodeBuffer>	nodeBuffers;
+
+  /**
+   * Advanced by every merge of the insert buffer into the tree, which only happens with treeLatch held exclusively,
+   * and whenever buffered entries of nonleaves reach the leaves.
+   */
+	std::atomic<unsigned>	insertBufferGeneration;
+
+  /**
+   * Thread merging the insert buffer into the tree whenever it fills, if setInsertBuffer() asked for one.
+   */
+	std::thread	mergeThread;
+
+  /**
+   * Guards backgroundMerge, mergeRequested and stopMerging, and goes with mergeCondition.
+   */
+	std::mutex	mergeMutex;
+
+  /**
+   * Signalled when a merge is requested or the merge thread is to stop.
+   */
+	std::condition_variable	mergeCondition;
+
+  /**
+   * True while mergeThread runs.
+   */
+	bool		backgroundMerge;
+
+  /**
+   * True if the insert buffer filled up since the merge thread last started a merge.
+   */
+	bool		mergeRequested;
+
+  /**
+   * True once the merge thread is to stop.
+   */
+	bool		stopMerging;
+
+  /**
+   * Root-to-leaf path of the rightmost leaf, or empty if not known. Keys above the leaf's low bound
+   * are appended to it without descending from the root. Cleared whenever a split or a deletion
+   * changes the tree. Only the one matching attributeType is used.
+   */
+	std::vector<PathEntry<int> > rightmostPathInt;
+	std::vector<PathEntry<double> > rightmostPathDouble;
+	std::vector<PathEntry<StringKey> > rightmostPathString;
+	std::vector<PathEntry<CompositeKey> > rightmostPathComposite;
+
+  /**
+   * Advanced whenever the cached rightmost path is cleared, so that a path taken from the cache or recorded
+   * by a descent can be checked to be still current once its leaf is latched.
+   */
+	unsigned	rightmostVersion;
+
+  /**
+   * Guards the cached rightmost paths and rightmostVersion.
+   */
+	std::mutex	pathMutex;
+
+	// MEMBERS SPECIFIC TO CONCURRENCY
+
+  /**
+   * Held shared by the operations that may run in several threads at once: insertEntry(), lookup() and scans.
+   * The others take it exclusively and run alone, without latching pages. Shared holders only write the reader
+   * slot of their thread and check the epoch of the latch, so lookups in different threads share no lock word.
+   */
+	EpochLatch	treeLatch;
+
+  /**
+   * Only taken in an index that counts entries: exclusively by inserts that split a leaf, shared by the other
+   * inserts, so no split moves the children on their path before they count their entry in it. Splits in such
+   * an index thus run one at a time. Indexes without counts never take it.
+   */
+	EpochLatch	countLatch;
+
+  /**
+   * Guards freePageNum and the free list, which splits in different subtrees take pages from at once.
+   */
+	std::mutex	allocMutex;
+
+	// MEMBERS SPECIFIC TO SCANNING
+
+  /**
+   * Number of cursors, scanCursor included, with a scan started and not yet ended. deleteEntry() refuses to run
+   * while there are any, since cursors do not find their place again after entries left their leaf.
+   */
+	std::atomic<int>	numOpenScans;
+
+  /**
+   * Cursor serving the startScan()/scanNext()/endScan() interface of the index itself.
+   */
+	BTreeScanCursor	scanCursor;
+
+ private:
+
+    static const PageId MAX_PAGEID = 999999999;
+
+    /**
+     * Print the statistics of a node. Recognize node type within method.
+     * @param id
+     * @param page
+     */
+    template <class T>
+    void printNode(PageId id, Page* node);
+
+    /**
+     * Print the statistics about this Tree.
+     */
+    void printTreeStatus();
+
+    /**
+     * The constructors once the attributes of the key are set: open or create the index file and insert entries
+     * for every tuple in the base relation.
+     * @param relationName
+     * @param indexName			Name of the index file
+     * @param leafFormat
+     * @param payloadColumns
+     * @param bloomBitsPerKey
+     * @param countEntries
+     */
+    void openIndex(const std::string & relationName, const std::string & indexName, const LeafFormat leafFormat,
+                   const std::vector<PayloadColumn> & payloadColumns, int bloomBitsPerKey, bool countEntries);
+
+    /**
+     * Allocate the pages of a Bloom filter of bloomBitsPerKey bits for each of numKeys entries, in place of the
+     * current filter, and add the key of every entry to it, walking the leaves from the leftmost one. The caller
+     * runs alone.
+     * @param numKeys
+     */
+    template <class T>
+    void buildBloomFilter(int numKeys);
+
+    /**
+     * Replace the Bloom filter by one sized for twice the entries of the index, once it holds more entries than
+     * the filter was sized for. Takes treeLatch exclusively to do so; the caller must not hold it.
+     */
+    void growBloomFilter();
+
+    /**
+     * Pin the page of the Bloom filter that holds the block of a key hash.
+     * @param hash
+     * @param pageNo		Page number of the pinned page is returned via this reference
+     * @return The words of the block.
+     */
+    std::uint64_t* readBloomBlock(std::uint64_t hash, PageId &pageNo);
+
+    /**
+     * Set the bits of key in the Bloom filter. May run in several threads at once; the bits are set atomically.
+     * @param key
+     */
+    template <class T>
+    void addToBloomFilter(const T& key);
+
+    /**
+     * mayContain() once the key type of the index is known. True if the index has no Bloom filter.
+     * @param key
+     */
+    template <class T>
+    bool mayContainTyped(const T& key);
+
+    /**
+     * The cached rightmost path for key type T, one of rightmostPathInt, rightmostPathDouble and rightmostPathString.
+     */
+    template <class T>
+    std::vector<PathEntry<T> >& rightmostPath();
+
+    /**
+     * The insert buffer for key type T, one of insertBufferInt, insertBufferDouble, insertBufferString and
+     * insertBufferComposite.
+     */
+    template <class T>
+    DeltaStore<T>& insertBuffer();
+
+    /**
+     * Add the entry to the insert buffer. The caller holds treeLatch shared.
+     * @param key
+     * @param rid
+     * @return Number of entries in the buffer.
+     */
+    template <class T>
+    int bufferInsert(const T& key, const RecordId rid);
+
+    /**
+     * Have the insert buffer, which holds pending entries, merged into the tree: by the merge thread if there is
+     * one and it is keeping up, by the calling thread otherwise. The caller holds no latch.
+     * @param pending
+     */
+    void requestMerge(int pending);
+
+    /**
+     * Body of mergeThread: merge the insert buffer whenever that is requested, until told to stop.
+     */
+    void mergeLoop();
+
+    /**
+     * Stop mergeThread and wait for it, if it runs. The caller holds no latch.
+     */
+    void stopMergeThread();
+
+    /**
+     * Apply the entries of the insert buffer to the tree and empty it, and push the message buffers of the
+     * nonleaves down into the leaves and free them. The caller holds treeLatch exclusively.
+     * @param keepNodeBuffers	True to leave the message buffers in place and add the entries of the insert
+     *						buffer to that of the root, if there are message buffers
+     */
+    void flushInsertBuffer(bool keepNodeBuffers = false);
+
+    /**
+     * flushInsertBuffer() once the key type of the index is known.
+     */
+    template <class T>
+    void flushInsertBufferTyped(bool keepNodeBuffers);
+
+    /**
+     * Add sorted entries to the message buffers of the nonleaves height levels above the leaves they are routed
+     * to. A buffer that fills up is pushed down first with flushNodeBuffer(), and the entries are routed again
+     * from the root after that, since pushing it down may have split its nonleaf. The caller runs alone.
+     * @param sortedEntries
+     * @param height		At least 1, at most depth
+     */
+    template <class T>
+    void bufferAtNodes(const std::vector<RIDKeyPair<T> > &sortedEntries, int height);
+
+    /**
+     * Empty the message buffer of nonleaf pageNo into the buffers of its children, or into the leaves if its
+     * children are leaves. The caller runs alone.
+     * @param pageNo
+     */
+    template <class T>
+    void flushNodeBuffer(PageId pageNo);
+
+    /**
+     * Push all message buffers down into the leaves, from the root down, and free their pages. The caller runs
+     * alone.
+     */
+    template <class T>
+    void flushNodeBuffers();
+
+    /**
+     * Move the entries of the message buffer of nonleaf pageNo that are greater than midKey to a buffer of
+     * newPageNo, the right sibling pageNo was just split into. The caller runs alone.
+     * @param pageNo
+     * @param newPageNo
+     * @param midKey		Key that went up into the parent
+     */
+    template <class T>
+    void splitNodeBuffer(PageId pageNo, PageId newPageNo, const T& midKey);
 
-	// MEMBERS SPECIFIC TO SCANNING
+    /**
+     * Append the entries within range of the message buffers of nonleaf pageNo and the nonleaves below it to
+     * entries. Only nonleaves whose keys may fall in range are visited. The caller holds treeLatch, while no
+     * insert changes the tree, since nodeBuffers is not empty.
+     * @param pageNo
+     * @param range
+     * @param entries
+     */
+    template <class T>
+    void collectBuffered(PageId pageNo, const ScanRange<T> &range, std::vector<RIDKeyPair<T> > &entries);
 
-  /**
-   * True if an index scan has been started.
-   */
-	bool		scanExecuting;
+    /**
+     * Merge sorted entries into the leaves, reusing the root-to-leaf path between neighbouring keys and
+     * splitting leaves that fill up. Their keys are already in the Bloom filter. The caller holds treeLatch
+     * exclusively.
+     * @param sortedEntries
+     */
+    template <class T>
+    void insertSorted(const std::vector<RIDKeyPair<T> > &sortedEntries);
 
-  /**
-   * Index of next entry to be scanned in current leaf being scanned.
-   */
-	int			nextEntry;
+    /**
+     * Allocate a new root above leftPageNo and rightPageNo, separated by key. All keys in leftPage are smaller than
+     * those in the right page.
+     * @param key
+     * @param leftPageNo
+     * @param leftCount		Number of leaf entries below leftPageNo
+     * @param rightPageNo
+     * @param rightCount		Number of leaf entries below rightPageNo
+     * @param level			1 if the children are leaves, 0 otherwise
+     */
+    template <class T>
+    void insertNewRoot(const T& key, PageId leftPageNo, std::uint32_t leftCount, PageId rightPageNo, std::uint32_t rightCount, int level);
 
-  /**
-   * Page number of current page being scanned.
-   */
-	PageId	currentPageNum;
+    /**
+     * Allocate a page for a new node, taking it off the free list if there is one there.
+     * The page comes back pinned.
+     * @param pageNo
+     * @param page
+     */
+    void allocIndexPage(PageId &pageNo, Page *&page);
 
-  /**
-   * Current Page being scanned.
-   */
-	Page		*currentPageData;
+    /**
+     * Put a page that no longer belongs to the tree on the free list.
+     * @param pageNo
+     */
+    void freeIndexPage(PageId pageNo);
 
-  /**
-   * Low INTEGER value for scan.
-   */
-	int			lowValInt;
+    /**
+     * Pin the nonleaf pageNo for as long as the index is open, unless it already is or all its slots are taken.
+     * The caller holds pinMutex or runs alone.
+     * @param pageNo
+     */
+    void pinIndexPage(PageId pageNo);
 
-  /**
-   * Low DOUBLE value for scan.
-   */
-	double	lowValDouble;
+    /**
+     * Unpin pageNo if pinIndexPage() pinned it. The caller holds pinMutex or runs alone.
+     * @param pageNo
+     */
+    void unpinIndexPage(PageId pageNo);
 
-  /**
-   * Low STRING value for scan.
-   */
-	std::string	lowValString;
+    /**
+     * Unpin all pages pinned by pinIndexPage(). The caller holds pinMutex or runs alone.
+     */
+    void unpinIndexPages();
 
-  /**
-   * High INTEGER value for scan.
-   */
-	int			highValInt;
+    /**
+     * Pin the nonleaves of the top pinnedLevels levels of the tree instead of those pinned so far. The nonleaves
+     * are read with their latches, so other inserts may split meanwhile; the caller holds no latch. If the root
+     * changed before they are pinned, nothing is, and the insert that split the root pins its levels instead.
+     */
+    template <class T>
+    void pinUpperLevels();
 
-  /**
-   * High DOUBLE value for scan.
-   */
-	double	highValDouble;
+    /**
+     * Get the frame of the node pageNo for a descent: the one it is kept pinned in, or else pin it.
+     * @param pageNo
+     * @param page
+     * @return True if the page is kept pinned, and must not be unpinned.
+     */
+    bool readIndexPage(PageId pageNo, Page *&page);
 
-  /**
-   * High STRING value for scan.
-   */
-	std::string highValString;
-	
-  /**
-   * Low Operator. Can only be GT(>) or GTE(>=).
-   */
-	Operator	lowOp;
+    /**
+     * Check that page, a frame readIndexPage() took from a slot, is still kept pinned for pageNo. Called after the
+     * version of the page is read: if it is, any later reuse of the frame changes the version.
+     * @param pageNo
+     * @param page
+     */
+    bool pinValid(PageId pageNo, const Page* page) const;
 
-  /**
-   * High Operator. Can only be LT(<) or LTE(<=).
-   */
-	Operator	highOp;
+    /**
+     * Release a page got from readIndexPage().
+     * @param pageNo
+     * @param pinned		What readIndexPage() returned
+     */
+    void releaseIndexPage(PageId pageNo, bool pinned);
 
- private:
+    /**
+     * Push the root onto the empty path.
+     * @param path
+     * @param pageNo		Page number of the root
+     * @param isLeaf		True if the root is a leaf
+     */
+    template <class T>
+    void pushRoot(std::vector<PathEntry<T> > &path, PageId pageNo, bool isLeaf);
 
-    PageId MAX_PAGEID = 999999999;
+    /**
+     * Descend from the root to the leaf key is routed to with optimistic lock coupling: nonleaves are read
+     * without latching them and validated against their versions once the child is known and pinned, and the
+     * descent starts over from the root if any of them changed. The leaf is left pinned and latched.
+     * @param key
+     * @param exclusive		True to latch the leaf exclusively
+     * @param leafPage		Receives the pinned leaf
+     * @param path			Receives the root-to-leaf path, if not null
+     * @param last			True to descend to the last leaf that may hold key rather than the first
+     * @return Page number of the leaf.
+     */
+    template <class T>
+    PageId latchLeaf(const T& key, bool exclusive, Page *&leafPage, std::vector<PathEntry<T> > *path = nullptr, bool last = false);
 
     /**
-     * Print the statistics of a node. Recognize node type within method.
-     * @param id
-     * @param page
+     * Index of the child of node, the nonleaf in page read without its latch at version, that an optimistic
+     * descent for key takes: its lowerBound(), or upperBound() for last. int nonleaves are searched through the
+     * Eytzinger cache if the index has one.
      */
-    void printNode(PageId id, Page* node);
+    template <class T>
+    int childIndex(const NonLeafNode<T>* node, const Page* page, std::uint32_t version, const T& key, bool last);
 
     /**
-     * Print the statistics about this Tree.
+     * Latch the left sibling of leaf pageNo shared. path is the root-to-leaf path of pageNo or of a leaf left
+     * of it, recorded by an earlier descent and possibly outdated by splits since; it is moved to a leaf left
+     * of pageNo, from which the sibling is reached through right sibling links. The caller has no latch.
+     * @param path
+     * @param pageNo
+     * @param leafPage		Receives the pinned sibling
+     * @return Page number of the sibling, or MAX_PAGEID if pageNo is the leftmost leaf.
      */
-    void printTreeStatus();
+    template <class T>
+    PageId latchLeftSibling(std::vector<PathEntry<T> > &path, PageId pageNo, Page *&leafPage);
 
     /**
-     * Insert key, leftPageNo, and rightPageNo to the empty (newly created) root. All keys in leftPage are smaller than
-     * those in the right page.
+     * Descend from the root to the leaf key is routed to, latching every node on the way exclusively. A split
+     * below a nonleaf that hasRoom() stops there, so once one is latched its ancestors are unlatched and unpinned.
+     * @param path			Receives the root-to-leaf path
      * @param key
-     * @param leftPageNo
-     * @param rightPageNo
+     * @param pages			Receives the pinned pages of path, root first
+     * @return Index in path of the first node still latched and pinned; those before it are released.
      */
-    void insertNewRoot(const void *key, PageId leftPageNo, PageId rightPageNo);
+    template <class T>
+    size_t latchPath(std::vector<PathEntry<T> > &path, const T& key, std::vector<Page*> &pages);
 
     /**
-     * Recursively find the PageId of the target leaf node.
-     * @param pageId
+     * Insert the entry into its leaf if that has room, with only the leaf latched exclusively.
      * @param key
-     * @return
+     * @param rid
+     * @param payload		Payload of the entry in a covering index, null otherwise
+     * @return False if the leaf is full and has to be split; nothing was inserted then.
      */
-    PageId findTargetLeafHelper(PageId pageId, const void *key);
+    template <class T>
+    bool insertOptimistic(const T& key, const RecordId rid, const char* payload);
 
     /**
-     * Return the leaf node PageId to insert the key in.
+     * Move the path to the leaf that key is routed to. Pops entries whose range does not cover key and
+     * descends from the deepest remaining one, starting at the root if the path is empty.
+     * @param path
      * @param key
-     * @return Leaf node PageId to insert the key in.
      */
-    PageId findTargetLeaf(const void* key);
+    template <class T>
+    void descendPath(std::vector<PathEntry<T> > &path, const T& key);
 
     /**
-     * Checks whether the node is full.
-     * @param targetId
-     * @return True if the node is full, false otherwise.
+     * Push child index of node, which is the pinned page of the nonleaf at the end of path, onto path.
+     * @param path
+     * @param node
+     * @param index
      */
-    bool isFull(PageId targetId);
+    template <class T>
+    void descendChild(std::vector<PathEntry<T> > &path, NonLeafNode<T> *node, int index);
 
     /**
-     * Assume leaf is not full. Insert the key-rid pair into the leaf.
-     * @param targetLeafId
-     * @param key
-     * @param rid
+     * Move the path from its leaf to the path of the next leaf to the right.
+     * @param path
+     * @return False if the leaf was the rightmost one; path is left empty then.
+     */
+    template <class T>
+    bool nextLeafPath(std::vector<PathEntry<T> > &path);
+
+    /**
+     * Move the path from its leaf to the path of the next leaf to the left, latching each nonleaf shared while
+     * it is read. Splits only move keys and children to the right, so if the path is outdated by them, it
+     * is moved to a leaf somewhere left of its leaf instead.
+     * @param path
+     * @return False if the leaf was the leftmost one; path is left empty then.
+     */
+    template <class T>
+    bool prevLeafPath(std::vector<PathEntry<T> > &path);
+
+    /**
+     * Restore the minimum occupancy of the underfull node at the end of path by merging it with or
+     * refilling it from a sibling under the same parent, then rebalance the parent if it lost a key.
+     * A root nonleaf left with a single child is removed and the child becomes the root.
+     * @param path
      */
-    void naiveInsertLeaf(PageId targetLeafId, const void *key, const RecordId rid);
+    template <class T>
+    void rebalance(std::vector<PathEntry<T> > &path);
 
     /**
-     * Assume nonleaf is not full. Insert the key-pageNo pair into the nonleaf.
-     * @param targetNonLeafId
+     * Append the entries equal to key found in the right siblings of a leaf whose run of matches
+     * reached its last slot.
+     * @param rightSibPageNo
      * @param key
-     * @param pageNo
+     * @param outEntries
+     * @return Number of matching entries found.
      */
-    void naiveInsertNonLeaf(PageId targetNonLeafId, const void *key, PageId pageNo);
+    template <class T>
+    int lookupSiblings(PageId rightSibPageNo, const T& key, std::vector<RIDKeyPair<T> > &outEntries);
 
     /**
-     * Assume leaf is full. Insert key-rid pair and perform recursive split.
-     * @param targetLeafId
+     * Insert the key-rid pair into the leaf at the end of path. If the leaf is full it is split in place
+     * and the split is propagated to the ancestors recorded on the path. A full rightmost leaf that is
+     * appended to keeps all its entries and starts the new right sibling with the new key alone.
+     * @param path
      * @param key
      * @param rid
+     * @param payload		Payload of the entry in a covering index, null otherwise
      */
-    void insertLeaf(PageId targetLeafId, const void *key, const RecordId rid);
+    template <class T>
+    void insertLeaf(std::vector<PathEntry<T> > &path, const T& key, const RecordId rid, const char* payload);
 
     /**
-     * Assume nonleaf is full. Insert key-pageNo pair and perform recursive split.
-     * @param targetNonLeafId
+     * Insert key and the new right sibling pageNo of the child at childIndex into the nonleaf at the end
+     * of path, or into a new root if path is empty. Full nonleaves are split in place and the split is
+     * propagated further up the path. Appends to a full rightmost nonleaf leave it full and start the new
+     * right sibling with pageNo as its only child.
+     * @param path
+     * @param childIndex
+     * @param leftCount		Number of leaf entries left below the child at childIndex
      * @param key
      * @param pageNo
+     * @param count			Number of leaf entries below pageNo
+     * @param level			1 if pageNo is a leaf, 0 otherwise
+     */
+    template <class T>
+    void insertNonLeaf(std::vector<PathEntry<T> > &path, int childIndex, std::uint32_t leftCount, const T& key, PageId pageNo, std::uint32_t count, int level);
+
+    /**
+     * Add delta to the entry counts that the nonleaves on the root-to-leaf path keep for the path below them,
+     * after delta entries were inserted into or removed from its leaf. The counts are updated atomically and the pages
+     * are not given new versions, which only routing changes need.
+     * @param path
+     * @param delta
+     */
+    template <class T>
+    void countPath(const std::vector<PathEntry<T> > &path, int delta);
+
+    /**
+     * Append the record ids of the entries in range, starting at entry pos of the pinned leaf page at the end of path
+     * and following right siblings, with path following them. Leaves the leaf the range ends in pinned in page and
+     * pos after the last entry in range, or page null, with nothing pinned, if the range runs past the last leaf.
+     * @param path
+     * @param page
+     * @param pos
+     * @param range
+     * @param outRids
+     * @return Number of entries found.
      */
-    void insertNonLeaf(PageId targetNonLeafId, const void *key, PageId pageNo);
+    template <class T>
+    int scanLeafRange(std::vector<PathEntry<T> > &path, Page *&page, int &pos, const ScanRange<T> &range, std::vector<RecordId> &outRids);
 
     /**
-     * Find the index of the given key in leaf node
+     * Number of entries whose key is less than key, or not greater than key if inclusive is set. Sums the
+     * counts of the children left of the path to key and the position of key in its leaf.
      * @param key
-     * @param leaf node
-     * @param the updated leaf node contains given key
-     * @param the page id of new leaf node
+     * @param inclusive
+     */
+    template <class T>
+    int rankTyped(const T& key, bool inclusive);
+
+    /**
+     * countRange() once the key type of the index is known.
+     */
+    template <class T>
+    int countRangeTyped(const T& lowVal, const Operator lowOp, const T& highVal, const Operator highOp);
+
+    /**
+     * insertEntry() and insertRecord() once the key type of the index is known.
+     */
+    template <class T>
+    void insertTyped(const T& key, const RecordId rid, const char* payload);
+
+    /**
+     * Insert the entry of record, whose key is at attrByteOffset, with the payload columns of the record.
+     * The caller holds treeLatch shared.
+     * @param record
+     * @param rid
+     */
+    void insertRecordEntry(const char* record, const RecordId rid);
+
+    /**
+     * lookup() once the key type of the index is known.
+     */
+    template <class T>
+    int lookupTyped(const T& key, std::vector<RecordId>& outRids);
+
+    /**
+     * deleteEntry() once the key type of the index is known.
      */
-    int searchHelper(const void *key, LeafNodeInt* node, LeafNodeInt*& new_node, PageId& new_id);
+    template <class T>
+    bool deleteTyped(const T& key, const RecordId rid);
+
+    /**
+     * Check that T is the key type of the index.
+     * @throws  BadIndexInfoException If the index is built over an attribute of another type.
+     */
+    template <class T>
+    void checkKeyType();
 
  public:
 
@@ -449,10 +2858,55 @@ class BTreeIndex {
    * @param bufMgrIn						Buffer Manager Instance
    * @param attrByteOffset			Offset of attribute, over which index is to be built, in the record
    * @param attrType						Datatype of attribute over which index is built
+   * @param leafFormat					Layout of the leaves if the index is created; an existing index keeps the one it was created with.
+   *                            POSTING_LEAVES makes indexes on attributes with few distinct values several times smaller.
+   *                            PACKED_LEAVES fits two to three times the entries in an INTEGER leaf; other key types get ARRAY_LEAVES.
+   * @param payloadColumns			Columns of the records to copy into the leaf entries if the index is created, which makes it a
+   *                            covering index with COVERING_LEAVES whatever leafFormat is; an existing index keeps the ones it was created with.
+   *                            Scans return the columns through scanNextBatch() without the records being read.
+   * @param bloomBitsPerKey		Bits per entry of a Bloom filter over the keys if the index is created, 0 for none; an existing index
+   *                            keeps the filter it was created with. lookup() answers most absent keys from the filter without
+   *                            descending the tree; 10 bits per key let about one in a hundred through. The filter is sized for
+   *                            the tuples of the relation and rebuilt twice as large whenever inserts outgrow it.
+   * @param countEntries		Whether the nonleaves keep the number of entries below each child if the index is created; an
+   *                            existing index keeps what it was created with. Needed by countRange(), rank() and select(). The
+   *                            counts cost a third of the fanout of INTEGER nonleaves, and every insert and delete updates them
+   *                            in all ancestors of its leaf.
    * @throws  BadIndexInfoException     If the index file already exists for the corresponding attribute, but values in metapage(relationName, attribute byte offset, attribute type etc.) do not match with values received through constructor parameters.
+   * @throws  BadIndexInfoException     If there are more than MAXPAYLOADCOLUMNS payload columns, one of them has a negative offset or a length below one, or together they are longer than MAXPAYLOADLENGTH.
+   * @throws  BadIndexInfoException     If bloomBitsPerKey is negative.
+   */
+	BTreeIndex(const std::string & relationName, std::string & outIndexName,
+						BufMgr *bufMgrIn,	const int attrByteOffset,	const Datatype attrType,
+						const LeafFormat leafFormat = ARRAY_LEAVES,
+						const std::vector<PayloadColumn> & payloadColumns = std::vector<PayloadColumn>(),
+						const int bloomBitsPerKey = 0,
+						const bool countEntries = false);
+
+
+  /**
+   * BTreeIndex Constructor for a COMPOSITE key over several attributes, compared one after the other. The index
+   * file is named after the relation and the offsets of all key attributes. Otherwise like the single attribute
+   * constructor.
+   *
+   * @param relationName        Name of file.
+   * @param outIndexName        Return the name of index file.
+   * @param bufMgrIn						Buffer Manager Instance
+   * @param keyColumns					Attributes of the key, most significant first
+   * @param leafFormat					Layout of the leaves if the index is created
+   * @param payloadColumns			Columns of the records to copy into the leaf entries if the index is created
+   * @param bloomBitsPerKey		Bits per entry of a Bloom filter over the keys if the index is created, 0 for none
+   * @param countEntries		Whether the nonleaves keep the number of entries below each child if the index is created
+   * @throws  BadIndexInfoException     If there are fewer than two or more than MAXKEYCOLUMNS key attributes, one of them is
+   *                            not of type INTEGER, DOUBLE or STRING or has a negative offset, or their normalized key is
+   *                            longer than COMPOSITESIZE; or if the payload columns or bloomBitsPerKey are not valid.
    */
 	BTreeIndex(const std::string & relationName, std::string & outIndexName,
-						BufMgr *bufMgrIn,	const int attrByteOffset,	const Datatype attrType);
+						BufMgr *bufMgrIn,	const std::vector<KeyColumn> & keyColumns,
+						const LeafFormat leafFormat = ARRAY_LEAVES,
+						const std::vector<PayloadColumn> & payloadColumns = std::vector<PayloadColumn>(),
+						const int bloomBitsPerKey = 0,
+						const bool countEntries = false);
 	
 
   /**
@@ -470,12 +2924,250 @@ class BTreeIndex {
    * This splitting will require addition of new leaf page number entry into the parent non-leaf, which may in-turn get split.
    * This may continue all the way upto the root causing the root to get split. If root gets split, metapage needs to be changed accordingly.
    * Make sure to unpin pages as soon as you can.
+   * May be called from several threads at once, together with lookup() and scans through BTreeScanCursor.
+   * With an insert buffer (see setInsertBuffer()) the entry only goes into the buffer, at memory speed, and with
+   * message buffers (see setNodeBuffers()) into that of the root.
    * @param key			Key to insert, pointer to integer/double/char string
    * @param rid			Record ID of a record whose entry is getting inserted into the index.
+   * @throws  BadIndexInfoException If the index has payload columns, whose entries are inserted through insertRecord().
    */
 	void insertEntry(const void* key, const RecordId rid);
 
 
+  /**
+   * Insert the entry of a whole record: its key at the attribute offset of the index and, in a covering index,
+   * its payload columns. Otherwise like insertEntry(), and may be called from several threads at once the same way.
+   * @param record		The record, as returned by FileScan::getRecord()
+   * @param rid			Record ID of the record
+   */
+	void insertRecord(const char* record, const RecordId rid);
+
+
+  /**
+   * Delete the entry <key,rid>. A leaf left less than half full is merged with a
+   * sibling if both fit in one page, and otherwise refills itself from it; nonleaves that lose a key
+   * this way are rebalanced in turn, and a root left with a single child is collapsed. Pages freed by
+   * merges are reused by later splits. No scan may be executing on the index while entries are deleted.
+   * Waits for the operations running in other threads and runs alone.
+   * @param key			Key of the entry, pointer to integer/double/char string
+   * @param rid			Record ID of the entry
+   * @return True if the entry was found and deleted, false if the index holds no such entry.
+   * @throws  BadIndexInfoException If a scan of the index has been started and not ended.
+   */
+	bool deleteEntry(const void* key, const RecordId rid);
+
+
+  /**
+   * Find all entries whose key equals the given key. Descends once from the root, binary-searches the
+   * target leaf and only moves on to right siblings while they continue a run of duplicates.
+   * Cheaper than the equivalent startScan(key, GTE, key, LTE) / scanNext / endScan sequence. With a Bloom filter,
+   * keys it rules out are answered from one filter page without descending at all. Matching entries still in the
+   * insert buffer are found there and appended after those of the tree.
+   * May be called from several threads at once, together with insertEntry() and scans through BTreeScanCursor.
+   * @param key			Key to look up, pointer to integer/double/char string
+   * @param outRids		Record ids of all matching entries are appended to this
+   * @return Number of matching entries found.
+   */
+	int lookup(const void* key, std::vector<RecordId>& outRids);
+
+
+  /**
+   * False if the index certainly holds no entry with the given key, according to its Bloom filter; true if it may,
+   * or if the index has no filter. Reads one page of the filter and none of the tree, so existence checks and
+   * anti-joins can skip lookups of most absent keys. Deleted keys stay in the filter until the index is rebuilt.
+   * May be called from several threads at once, like lookup().
+   * @param key			Key to test, pointer to integer/double/char string
+   */
+	bool mayContain(const void* key);
+
+
+  /**
+   * Look up a batch of keys. The keys are sorted and the root-to-leaf path is reused between neighbouring
+   * keys, so each leaf is pinned once for all keys that land in it. Keys the Bloom filter rules out are dropped first.
+   * Instantiated for int, double, StringKey and CompositeKey keys. Runs alone like deleteEntry().
+   * @param keys			Keys to look up, in any order
+   * @param outEntries	Key-rid pairs of all matching entries are appended to this, in key order
+   * @return Number of matching entries found.
+   * @throws  BadIndexInfoException If T is not the type of the attribute the index is built over.
+   */
+	template <class T>
+	int lookupBatch(const std::vector<T>& keys, std::vector<RIDKeyPair<T> >& outEntries);
+
+
+  /**
+   * Find all entries in any of a list of key ranges in one pass, such as the ranges of an IN list or of ORs
+   * of ranges. The leaf level is walked left to right; between ranges the root-to-leaf path is only climbed
+   * as far as the gap to the next range needs, so ranges close together cost about one descent plus the
+   * leaves they touch. Instantiated for int, double, StringKey and CompositeKey keys. Runs alone like deleteEntry().
+   * @param ranges		Ranges to scan, ascending and not overlapping
+   * @param outRids		Record ids of all matching entries are appended to this, in key order
+   * @return Number of matching entries found.
+   * @throws  BadIndexInfoException If T is not the type of the attribute the index is built over.
+   * @throws  BadOpcodesException If an operator of a range is not one of its expected values
+   * @throws  BadScanrangeException If a range has low > high, or the ranges are not ascending and disjoint
+   */
+	template <class T>
+	int scanRanges(const std::vector<ScanRange<T> >& ranges, std::vector<RecordId>& outRids);
+
+
+  /**
+   * Find all entries of a COMPOSITE index whose key attributes after the first lie in a range, whatever their first
+   * attribute, such as the entries of an index on (itemID, category) with a given category. Skip-scan: for each
+   * distinct value of the first attribute, the range is searched under that value, and the scan then seeks past
+   * all entries with that value. Costs about one descent per distinct first attribute value instead of reading
+   * every entry. Runs alone like deleteEntry().
+   * @param lowVal	Low end of the range, pointer to a record whose key attributes after the first are the low values
+   * @param lowOp		Low operator (GT/GTE)
+   * @param highVal	High end of the range, pointer to a record whose key attributes after the first are the high values
+   * @param highOp	High operator (LT/LTE)
+   * @param outRids		Record ids of all matching entries are appended to this, in key order
+   * @return Number of matching entries found.
+   * @throws  BadIndexInfoException If the index does not have a COMPOSITE key.
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values
+   * @throws  BadScanrangeException If the low values are above the high values
+   */
+	int skipScan(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp, std::vector<RecordId>& outRids);
+
+
+  /**
+   * Normalized key of a COMPOSITE index for record, a record of the relation or a buffer laid out like one that
+   * holds the key attributes at their offsets. Builds the keys lookupBatch(), scanRanges(), select() and
+   * insertBatch() take for a COMPOSITE index.
+   * @param record
+   * @throws  BadIndexInfoException If the index does not have a COMPOSITE key.
+   */
+	CompositeKey compositeKey(const char* record) const;
+
+
+  /**
+   * Count the entries in a key range without reading them. The nonleaves of an index created with countEntries
+   * keep the number of entries below each of their children, so the count is the difference of two ranks, each
+   * found by one root-to-leaf descent.
+   * Runs alone like deleteEntry().
+   * @param lowVal	Low value of range, pointer to integer / double / char string
+   * @param lowOp		Low operator (GT/GTE)
+   * @param highVal	High value of range, pointer to integer / double / char string
+   * @param highOp	High operator (LT/LTE)
+   * @return Number of entries in the range.
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values
+   * @throws  BadScanrangeException If lowVal > highval
+   * @throws  BadIndexInfoException If the index was not created with countEntries.
+   */
+	int countRange(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp);
+
+
+  /**
+   * Number of entries whose key is less than the given key, which is the position in key order of the first
+   * entry with that key, if there is one. One root-to-leaf descent. Runs alone like deleteEntry().
+   * @param key			Pointer to integer/double/char string
+   * @throws  BadIndexInfoException If the index was not created with countEntries.
+   */
+	int rank(const void* key);
+
+
+  /**
+   * Find the entry at position i in key order, entries with equal keys in the order a scan returns them.
+   * One root-to-leaf descent, steered by the entry counts of the nonleaves. Instantiated for int, double,
+   * StringKey and CompositeKey keys. Runs alone like deleteEntry().
+   * @param i				Position of the entry, from 0
+   * @param outEntry		Receives the key and record id of the entry
+   * @return False if the index holds no more than i entries.
+   * @throws  BadIndexInfoException If T is not the type of the attribute the index is built over, or the index
+   *                            was not created with countEntries.
+   */
+	template <class T>
+	bool select(int i, RIDKeyPair<T>& outEntry);
+
+
+  /**
+   * Insert a batch of entries. The entries are sorted and the root-to-leaf path is reused between
+   * neighbouring keys; all entries that land in the same leaf are merged into it in one pass.
+   * Equivalent to calling insertEntry() for every entry. Instantiated for int, double, StringKey and CompositeKey keys.
+   * Runs alone like deleteEntry().
+   * @param entries		Key-rid pairs to insert, in any order
+   * @throws  BadIndexInfoException If T is not the type of the attribute the index is built over, or the index has payload columns.
+   */
+	template <class T>
+	void insertBatch(const std::vector<RIDKeyPair<T> >& entries);
+
+
+  /**
+   * Put an in-memory delta store in front of the tree: insertEntry() only adds the entry to a sorted skip list,
+   * alongside lookups, scans and other inserts, and once capacity entries are pending they are merged into the
+   * leaves in one left-to-right pass, like insertBatch(). Random inserts then read and write each leaf once per
+   * merge instead of once per entry. lookup() and scans merge the entries of the buffer with those of the
+   * leaves; deleteEntry() and the other reads merge the buffer into the tree first. With background set, a
+   * thread of the index does the merges while inserts go on; otherwise the insert that fills the buffer does.
+   * The buffer is merged when the index is closed and whenever setInsertBuffer() is called again, and
+   * is not used for the constructor's initial load. It lives only in memory: entries not yet merged are lost if
+   * the process ends without closing the index or calling flushInserts(). Runs alone like deleteEntry().
+   * @param capacity		Number of pending entries at which they are merged, 0 to insert straight into the leaves again
+   * @param background	True to merge in a thread of the index
+   * @throws  BadIndexInfoException If capacity is negative, or the index has payload columns.
+   */
+	void setInsertBuffer(int capacity, bool background = false);
+
+
+  /**
+   * Merge the entries pending in the insert buffer, and in the message buffers of the nonleaves, into the leaves.
+   * Runs alone like deleteEntry().
+   */
+	void flushInserts();
+
+
+  /**
+   * Number of entries pending in the insert buffer and in the message buffers of the nonleaves.
+   */
+	int numBufferedInserts();
+
+
+  /**
+   * Give the nonleaves message buffers, as in a B-epsilon tree. insertEntry() then adds the entry to the buffer of
+   * the root, a page of the index file. When a buffer fills up, its entries are sorted and pushed down into the
+   * buffers of the children they are routed to, and those of nonleaves right above the leaves into the leaves in
+   * one left-to-right pass, like insertBatch(). Random inserts thus read and write a leaf once per buffer of
+   * entries rather than once per entry. lookup() and scans merge the entries buffered along their way with those
+   * of the leaves; deleteEntry() and the other reads push all buffers down into the leaves first. Buffers stay
+   * in the index file when the index is closed, and a reopened index keeps buffering until this is called with
+   * enabled unset, which pushes them down. Inserts take treeLatch exclusively while buffering, so they run one at
+   * a time, alongside no lookups or scans. Runs alone like deleteEntry().
+   * @param enabled		True to buffer inserts in the nonleaves, false to push the buffers down and insert straight
+   *					into the leaves again
+   * @throws  BadIndexInfoException If enabled is set and the index has payload columns.
+   */
+	void setNodeBuffers(bool enabled);
+
+
+  /**
+   * Search copies of the keys of int nonleaves, laid out in Eytzinger order, rather than the nodes on the way
+   * from the root to a leaf, for the nodes whose keys are too skewed for interpolation search. Such a node is
+   * copied on the first descent through it after it changed, so the copies
+   * of the upper levels, which rarely change, serve most descents. Only inserts, lookups and scan starts use
+   * them; the other descents search the nodes. Runs alone like deleteEntry().
+   * @param numNodes		Number of nonleaves to keep copies of, 0 to search the nodes themselves again
+   * @throws  BadIndexInfoException If numNodes is negative, or the index is not over an INTEGER attribute.
+   */
+	void setEytzingerSearch(int numNodes);
+
+
+  /**
+   * Keep the nonleaves of the top levels of the tree pinned in the buffer pool, and let descents take them from
+   * frames cached in the index rather than through the buffer manager. The siblings of split nonleaves in these
+   * levels are pinned as they are allocated, and the levels are pinned again whenever the root changes. Pages
+   * that leave the tree are unpinned. At most PINNEDSLOTS pages are pinned; the nodes that do not fit are read
+   * as before. Runs alone like deleteEntry().
+   * @param levels		Number of levels from the root down, 0 to pin none
+   * @throws  BadIndexInfoException If levels is negative.
+   */
+	void setPinnedLevels(int levels);
+
+
+  /**
+   * Number of pages kept pinned by setPinnedLevels().
+   */
+	int numPinnedPages();
+
+
   /**
    * Begin a filtered scan of the index.  For instance, if the method is called
    * using ("a",GT,"d",LTE) then we should seek all entries with a value
@@ -483,15 +3175,18 @@ class BTreeIndex {
    * If another scan is already executing, that needs to be ended here.
    * Set up all the variables for scan. Start from root to find out the leaf page that contains the first RecordID
    * that satisfies the scan parameters. Keep that page pinned in the buffer pool.
+   * A DESCENDING scan starts at the leaf holding the last such RecordID instead and returns the entries of the
+   * range in reverse, so a scan for the largest few keys only reads the last leaf or two of the range.
    * @param lowVal	Low value of range, pointer to integer / double / char string
    * @param lowOp		Low operator (GT/GTE)
    * @param highVal	High value of range, pointer to integer / double / char string
    * @param highOp	High operator (LT/LTE)
+   * @param order		ASCENDING to return entries from the low end up, DESCENDING from the high end down
    * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values 
    * @throws  BadScanrangeException If lowVal > highval
    * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
    */
-	void startScan(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp);
+	void startScan(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp, const ScanOrder order = ASCENDING);
 
 
   /**
@@ -504,6 +3199,55 @@ class BTreeIndex {
 	void scanNext(RecordId& outRid);  // returned record id
 
 
+  /**
+   * Non-throwing variant of startScan(). Range and operator errors are still reported through exceptions,
+   * but an empty range is reported through the return value.
+   * @param lowVal	Low value of range, pointer to integer / double / char string
+   * @param lowOp		Low operator (GT/GTE)
+   * @param highVal	High value of range, pointer to integer / double / char string
+   * @param highOp	High operator (LT/LTE)
+   * @param order		ASCENDING to return entries from the low end up, DESCENDING from the high end down
+   * @return True if a scan was started, false if no key in the B+ tree satisfies the scan criteria.
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values
+   * @throws  BadScanrangeException If lowVal > highval
+   */
+	bool tryStartScan(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp, const ScanOrder order = ASCENDING);
+
+
+  /**
+   * Non-throwing variant of scanNext().
+   * @param outRid	RecordId of next record found that satisfies the scan criteria returned in this
+   * @return True if outRid was filled in, false if the scan is completed.
+   * @throws ScanNotInitializedException If no scan has been initialized.
+   */
+	bool tryScanNext(RecordId& outRid);
+
+
+  /**
+   * Fetch up to maxRids record ids of the next index entries that match the scan. Qualifying entries of the
+   * current leaf are copied out in a single block copy before moving on to the right sibling.
+   * @param outRids	Array of at least maxRids record ids the results are written to
+   * @param maxRids	Maximum number of record ids to return
+   * @return Number of record ids written to outRids. Less than maxRids only if the scan is completed.
+   * @throws ScanNotInitializedException If no scan has been initialized.
+   */
+	int scanNextBatch(RecordId* outRids, int maxRids);
+
+
+  /**
+   * Fetch up to maxRids record ids of the next index entries that match the scan together with their payloads,
+   * the bytes of the payload columns of their records one after the other. The payload of the entry of outRids[i]
+   * is written to outPayloads + i * the sum of the payload column lengths, so a covering index answers queries
+   * over its key and payload columns without reading the records. Indexes without payload columns write no payloads.
+   * @param outRids	Array of at least maxRids record ids the results are written to
+   * @param outPayloads	Array of at least maxRids payloads the payloads are written to
+   * @param maxRids	Maximum number of record ids to return
+   * @return Number of record ids written to outRids. Less than maxRids only if the scan is completed.
+   * @throws ScanNotInitializedException If no scan has been initialized.
+   */
+	int scanNextBatch(RecordId* outRids, char* outPayloads, int maxRids);
+
+
   /**
    * Terminate the current scan. Unpin any pinned pages. Reset scan specific variables.
    * @throws ScanNotInitializedException If no scan has been initialized.
@@ -54,8 +54,10 @@ class BufHashTbl
 	 */
   hashBucket**  ht;
 
+ public:
 	/**
-	 * returns hash value between 0 and HTSIZE-1 computed using file and pageNo
+	 * returns hash value between 0 and HTSIZE-1 computed using file and pageNo, the bucket of the page.
+	 * Operations on pages in different buckets touch no common memory.
 	 *
 	 * @param file   	File object
 	 * @param pageNo  Page number in the file
@@ -63,7 +65,6 @@ class BufHashTbl
 	 */
   int	 hash(const File* file, const PageId pageNo);
 
- public:
 	/**
    * Constructor of BufHashTbl class
 	 */
@@ -55,11 +55,11 @@ BufMgr::~BufMgr() {
   delete [] bufPool;
 }
 
-void BufMgr::allocBuf(FrameId & frame) 
+void BufMgr::allocBuf(FrameId & frame, const std::mutex* heldMutex) 
 {
   // perform first part of clock algorithm to search for 
   // open buffer frame
-  // Assumes non-concurrent access to buffer manager
+  // Callers hold the mutex of the buffer manager, so no other thread changes which page a frame holds
   std::uint32_t numScanned = 0;
   bool found = 0;
 
@@ -78,6 +78,12 @@ void BufMgr::allocBuf(FrameId & frame)
     // is valid, check referenced bit
     if (! bufDescTable[clockHand].refbit)
     {
+      // the pin count is only stable under the mutex of the page's partition, which the caller may hold already
+      std::mutex &victimMutex = partitionMutex(bufDescTable[clockHand].file, bufDescTable[clockHand].pageNo);
+      std::unique_lock<std::mutex> victimGuard(victimMutex, std::defer_lock);
+      if (&victimMutex != heldMutex)
+        victimGuard.lock();
+
       // check to see if someone has it pinned
       if (bufDescTable[clockHand].pinCnt == 0)
       {
@@ -120,11 +126,33 @@ void BufMgr::allocBuf(FrameId & frame)
 	
 void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
 {
-  // check to see if it is already in the buffer pool
-  // std::cout << "readPage called on file.page " << file << "." << pageNo << endl;
+  std::mutex &pageMutex = partitionMutex(file, pageNo);
   FrameId frameNo = 0;
+  {
+    std::lock_guard<std::mutex> partitionGuard(pageMutex);
+
+    // check to see if it is already in the buffer pool
+    try
+    {
+      hashTable->lookup(file, pageNo, frameNo);
+
+      // set the referenced bit
+      bufDescTable[frameNo].refbit = true;
+      bufDescTable[frameNo].pinCnt++;
+      page = &bufPool[frameNo];
+      return;
+    }
+    catch(const HashNotFoundException &e)
+    {
+    }
+  }
+
+  // a frame is allocated under the mutex of the buffer manager, which comes before that of the partition.
+  std::lock_guard<std::mutex> guard(mutex);
+  std::lock_guard<std::mutex> partitionGuard(pageMutex);
 	try
 	{
+    // another thread may have read the page in meanwhile
   	hashTable->lookup(file, pageNo, frameNo);
 
     // set the referenced bit
@@ -135,7 +163,7 @@ void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
   catch(const HashNotFoundException &e) //not in the buffer pool, must allocate a new page
   {
     // alloc a new frame
-    allocBuf(frameNo);
+    allocBuf(frameNo, &pageMutex);
 
     // read the page into the new frame
     bufStats.diskreads++;
@@ -154,11 +182,17 @@ void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
 
 void BufMgr::unPinPage(File* file, const PageId pageNo, const bool dirty) 
 {
+  std::lock_guard<std::mutex> partitionGuard(partitionMutex(file, pageNo));
+
   // lookup in hashtable
   FrameId frameNo = 0;
   hashTable->lookup(file, pageNo, frameNo);
 
-  if (dirty == true) bufDescTable[frameNo].dirty = dirty;
+  if (dirty == true)
+  {
+    bufDescTable[frameNo].dirty = dirty;
+    bufDescTable[frameNo].version += 2;
+  }
 
   // make sure the page is actually pinned
   if (bufDescTable[frameNo].pinCnt == 0)
@@ -170,15 +204,18 @@ void BufMgr::unPinPage(File* file, const PageId pageNo, const bool dirty)
 
 void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page) 
 {
+  std::lock_guard<std::mutex> guard(mutex);
+
   FrameId frameNo;
 
   // alloc a new frame
-  allocBuf(frameNo);
+  allocBuf(frameNo, NULL);
 
   // allocate a new page in the file
 	//std::cerr << "buffer data size:" << bufPool[frameNo].data_.length() << "\n";
   bufPool[frameNo] = file->allocatePage(pageNo);
   page = &bufPool[frameNo];
+  std::lock_guard<std::mutex> partitionGuard(partitionMutex(file, pageNo));
 
   // set up the entry properly
   bufDescTable[frameNo].Set(file, pageNo);
@@ -189,11 +226,14 @@ void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page)
 
 void BufMgr::flushFile(const File* file) 
 {
+  std::lock_guard<std::mutex> guard(mutex);
+
   for (std::uint32_t i = 0; i < numBufs; i++)
 	{
   	BufDesc* tmpbuf = &(bufDescTable[i]);
   	if(tmpbuf->file && tmpbuf->valid == true && tmpbuf->file == file)
 		{
+	    std::lock_guard<std::mutex> partitionGuard(partitionMutex(file, tmpbuf->pageNo));
 	    if (tmpbuf->pinCnt > 0)
   			throw PagePinnedException(file->filename(), tmpbuf->pageNo, tmpbuf->frameNo);
 
@@ -214,6 +254,9 @@ void BufMgr::flushFile(const File* file)
 
 void BufMgr::disposePage(File* file, const PageId pageNo)
 {
+  std::lock_guard<std::mutex> guard(mutex);
+  std::lock_guard<std::mutex> partitionGuard(partitionMutex(file, pageNo));
+
 	//Deallocate from file altogether
   //See if it is in the buffer pool
   FrameId frameNo = 0;
@@ -10,6 +10,10 @@
 #include "file.h"
 #include "bufHashTbl.h"
 #include <iostream>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <pthread.h>
 
 namespace badgerdb {
 
@@ -18,6 +22,158 @@ namespace badgerdb {
 */
 class BufMgr;
 
+/**
+* @brief Reader-writer latch. Any number of threads may hold it shared, or one thread exclusively.
+*/
+class RWLatch {
+
+ private:
+	pthread_rwlock_t lock;
+
+ public:
+	RWLatch() { pthread_rwlock_init(&lock, NULL); }
+	~RWLatch() { pthread_rwlock_destroy(&lock); }
+
+	RWLatch(const RWLatch&) = delete;
+	RWLatch& operator=(const RWLatch&) = delete;
+
+	/**
+	 * Wait until the latch can be held in the given mode and take it.
+	 */
+	void acquire(bool exclusive)
+	{
+		if(exclusive)
+			pthread_rwlock_wrlock(&lock);
+		else
+			pthread_rwlock_rdlock(&lock);
+	}
+
+	/**
+	 * Give up the latch, in whichever mode it was taken.
+	 */
+	void release() { pthread_rwlock_unlock(&lock); }
+};
+
+/**
+* @brief Number of reader slots of an EpochLatch.
+*/
+const int EPOCHSLOTS = 16;
+
+/**
+* @brief Reader-writer latch for data that is read far more often than it is held exclusively. Its epoch is odd
+* while it is held exclusively. A shared holder counts itself in the slot of its thread and checks that the epoch
+* is even; the exclusive holder makes the epoch odd and waits until the slots are empty. The slots lie on cache
+* lines of their own, so threads that hold the latch shared write no cache line in common.
+*/
+class EpochLatch {
+
+ private:
+	/**
+	 * Number of shared holders whose threads map to the slot, padded to a cache line.
+	 */
+	struct Slot {
+		std::atomic<int> readers;
+		char padding[ 64 - sizeof( std::atomic<int> ) ];
+	};
+
+	Slot slots[ EPOCHSLOTS ];
+	std::atomic<std::uint32_t> epoch;
+
+	/**
+	 * Held by the exclusive holder, which is writer.
+	 */
+	std::mutex writerMutex;
+	std::atomic<std::thread::id> writer;
+
+	/**
+	 * Slot of the calling thread, the same for every EpochLatch.
+	 */
+	static int threadSlot()
+	{
+		static std::atomic<int> nextSlot( 0 );
+		static thread_local int slot = nextSlot++ % EPOCHSLOTS;
+		return slot;
+	}
+
+ public:
+	EpochLatch() : epoch( 0 )
+	{
+		for( int i = 0; i < EPOCHSLOTS; i++ )
+			slots[ i ].readers = 0;
+	}
+
+	EpochLatch(const EpochLatch&) = delete;
+	EpochLatch& operator=(const EpochLatch&) = delete;
+
+	/**
+	 * Wait until the latch can be held in the given mode and take it.
+	 */
+	void acquire(bool exclusive)
+	{
+		if(exclusive)
+		{
+			writerMutex.lock();
+			writer.store(std::this_thread::get_id(), std::memory_order_relaxed);
+			// readers that counted themselves before the epoch turned odd are waited for, later ones back off.
+			epoch.fetch_add(1);
+			for(int i = 0; i < EPOCHSLOTS; i++)
+				while(slots[i].readers.load() != 0)
+					std::this_thread::yield();
+			return;
+		}
+		Slot &slot = slots[threadSlot()];
+		while(1)
+		{
+			slot.readers.fetch_add(1);
+			if(epoch.load() % 2 == 0)
+				return;
+			slot.readers.fetch_sub(1);
+			while(epoch.load(std::memory_order_relaxed) % 2 == 1)
+				std::this_thread::yield();
+		}
+	}
+
+	/**
+	 * Give up the latch, in whichever mode it was taken.
+	 */
+	void release()
+	{
+		if(writer.load(std::memory_order_relaxed) == std::this_thread::get_id())
+		{
+			writer.store(std::thread::id(), std::memory_order_relaxed);
+			epoch.fetch_add(1, std::memory_order_release);
+			writerMutex.unlock();
+			return;
+		}
+		slots[threadSlot()].readers.fetch_sub(1, std::memory_order_release);
+	}
+};
+
+/**
+* @brief Holds a latch from its construction to the end of its scope.
+*/
+template <class Latch>
+class ScopedLatch {
+
+ private:
+	Latch* latch;
+
+ public:
+	ScopedLatch(Latch& latch, bool exclusive) : latch(&latch) { latch.acquire(exclusive); }
+
+	/**
+	 * Hold latch only if needed is set.
+	 */
+	ScopedLatch(Latch& latch, bool exclusive, bool needed) : latch(needed ? &latch : NULL) { if(needed) latch.acquire(exclusive); }
+	~ScopedLatch() { if(latch) latch->release(); }
+
+	ScopedLatch(const ScopedLatch&) = delete;
+	ScopedLatch& operator=(const ScopedLatch&) = delete;
+};
+
+typedef ScopedLatch<RWLatch> LatchGuard;
+typedef ScopedLatch<EpochLatch> EpochGuard;
+
 /**
 * @brief Class for maintaining information about buffer pool frames
 */
@@ -57,9 +213,21 @@ class BufDesc {
   bool valid;
 
 	/**
-   * Has this buffer frame been reference recently
+   * Has this buffer frame been reference recently. Set by readPage() under the mutex of the page's partition and
+   * cleared by the clock under the mutex of the buffer manager
+	 */
+  std::atomic<bool> refbit;
+
+	/**
+   * Latch of the page in this frame. Only taken while the page is pinned, so the frame cannot be reused under it
+	 */
+  RWLatch latch;
+
+	/**
+   * Advanced whenever the page in this frame may have changed: by one when the page is latched exclusively and
+   * again when it is unlatched, so it is odd while the page is being changed, and by two on every dirty unpin
 	 */
-  bool refbit;
+  std::atomic<std::uint32_t> version;
 
 	/**
    * Initialize buffer frame for a new user
@@ -72,6 +240,7 @@ class BufDesc {
     dirty = false;
     refbit = false;
 		valid = false;
+    version += 2;
   };
 
 	/**
@@ -112,6 +281,7 @@ class BufDesc {
 	 */
   BufDesc()
 	{
+		version = 0;
   	Clear();
   }
 };
@@ -156,11 +326,38 @@ struct BufStats
 
 
 /**
-* @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file 
+* @brief Number of partitions of the hash table of a BufMgr, each guarded by a mutex of its own.
+*/
+const int BUFPARTITIONS = 16;
+
+/**
+* @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file.
+* All methods may be called from several threads at once. Threads that share a pinned page coordinate through its latch.
 */
 class BufMgr 
 {
  private:
+	/**
+   * Serializes the clock and every change of the page a frame holds: allocating frames, flushing files and
+   * disposing pages. Taken before any partition mutex
+	 */
+  std::mutex mutex;
+
+	/**
+   * Mutexes of the partitions of the hash table, which a page is assigned to by its bucket. The mutex of its
+   * partition guards the bucket of a page and the pin count and dirty bit of its frame, so pinning and unpinning
+   * a page that is in the pool take only that mutex, and threads using pages in different partitions share no lock
+	 */
+  std::mutex partitionMutexes[ BUFPARTITIONS ];
+
+	/**
+   * Mutex of the partition of the page
+	 */
+  std::mutex& partitionMutex(const File* file, const PageId pageNo)
+  {
+		return partitionMutexes[ (unsigned)hashTable->hash(file, pageNo) % BUFPARTITIONS ];
+  }
+
 	/**
    * Current position of clockhand in our buffer pool
 	 */
@@ -195,12 +392,13 @@ class BufMgr
   }
 
 	/**
-	 * Allocate a free frame.  
+	 * Allocate a free frame. The caller holds the mutex of the buffer manager.
 	 *
 	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
+	 * @param heldMutex	Partition mutex the caller holds as well, or null
 	 * @throws BufferExceededException If no such buffer is found which can be allocated
 	 */
-  void allocBuf(FrameId & frame);
+  void allocBuf(FrameId & frame, const std::mutex* heldMutex);
 
  public:
 	/**
@@ -249,6 +447,89 @@ class BufMgr
 	 */
   void allocPage(File* file, PageId &PageNo, Page*& page); 
 
+	/**
+	 * Latch a pinned page, waiting for threads that hold it in a conflicting mode. Shared holders may read the
+	 * page, the exclusive holder may change it.
+	 *
+	 * @param page  	Pointer to the page, as returned by readPage() or allocPage()
+	 * @param exclusive	True to latch the page exclusively, false to latch it shared
+	 */
+  void latchPage(const Page* page, const bool exclusive)
+  {
+		bufDescTable[page - bufPool].latch.acquire(exclusive);
+		if(exclusive)
+		{
+			bufDescTable[page - bufPool].version++;
+			std::atomic_thread_fence(std::memory_order_release);
+		}
+  }
+
+	/**
+	 * Release the latch taken by latchPage(). The page stays pinned.
+	 *
+	 * @param page  	Pointer to the page
+	 * @param exclusive	True if the page was latched exclusively, which advances its version
+	 */
+  void unlatchPage(const Page* page, const bool exclusive)
+  {
+		if(exclusive)
+			bufDescTable[page - bufPool].version++;
+		bufDescTable[page - bufPool].latch.release();
+  }
+
+	/**
+	 * Version of a pinned page. Equal versions read while the page is latched mean that it did not change in between.
+	 *
+	 * @param page  	Pointer to the page
+	 */
+  std::uint32_t pageVersion(const Page* page) const
+  {
+		return bufDescTable[page - bufPool].version;
+  }
+
+	/**
+	 * Version of a pinned page for a reader that does not latch it, once no thread holds the page exclusively.
+	 * What the reader sees of the page is only known to be consistent if validateVersion() succeeds afterwards.
+	 *
+	 * @param page  	Pointer to the page
+	 */
+  std::uint32_t readVersion(const Page* page) const
+  {
+		while(1)
+		{
+			std::uint32_t version = bufDescTable[page - bufPool].version.load(std::memory_order_acquire);
+			if(version % 2 == 0)
+				return version;
+			std::this_thread::yield();
+		}
+  }
+
+	/**
+	 * Check that a pinned page read without a latch did not change since readVersion() returned version.
+	 *
+	 * @param page  	Pointer to the page
+	 * @param version	Version returned by readVersion()
+	 * @return True if everything read from the page in between is consistent.
+	 */
+  bool validateVersion(const Page* page, const std::uint32_t version) const
+  {
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return bufDescTable[page - bufPool].version.load(std::memory_order_relaxed) == version;
+  }
+
+	/**
+	 * Mark a pinned page dirty without advancing its version, for changes that no reader validating against the
+	 * version depends on.
+	 *
+	 * @param page  	Pointer to the page
+	 */
+  void markDirty(const Page* page)
+  {
+		BufDesc &desc = bufDescTable[page - bufPool];
+		std::lock_guard<std::mutex> guard(partitionMutex(desc.file, desc.pageNo));
+		desc.dirty = true;
+  }
+
 	/**
 	 * Writes out all dirty pages of the file to disk.
 	 * All the frames assigned to the file need to be unpinned from buffer pool before this function can be successfully called.
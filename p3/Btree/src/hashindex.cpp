@@ -0,0 +1,361 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include "hashindex.h"
+#include "filescan.h"
+#include "exceptions/bad_index_info_exception.h"
+#include "exceptions/end_of_file_exception.h"
+
+namespace badgerdb
+{
+
+    template <class T>
+    void HashBucket<T>::init(int depth, PageId overflow){
+        localDepth = depth;
+        size = 0;
+        overflowPageNo = overflow;
+    }
+
+    // -----------------------------------------------------------------------------
+    // HashIndex
+    // -----------------------------------------------------------------------------
+
+    /**
+     * HashIndex Constructor.
+     * Check to see if the corresponding index file exists. If so, open the file.
+     * If not, create it and insert entries for every tuple in the base relation using FileScan class.
+     *
+     * @param relationName        Name of file.
+     * @param outIndexName        Return the name of index file.
+     * @param bufMgrIn						Buffer Manager Instance
+     * @param attrByteOffset			Offset of attribute, over which index is to be built, in the record
+     * @param attrType						Datatype of attribute over which index is built
+     * @throws  BadIndexInfoException     If attrType cannot be hashed, or the meta page of an existing index does not match.
+     */
+    HashIndex::HashIndex(const std::string & relationName,
+            std::string & outIndexName,
+            BufMgr *bufMgrIn,
+            const int attrByteOffset,
+            const Datatype attrType)
+    {
+        if(attrType != INTEGER && attrType != DOUBLE && attrType != STRING)
+            throw BadIndexInfoException("Hash indexes are over one INTEGER, DOUBLE or STRING attribute");
+        bufMgr = bufMgrIn;
+        attributeType = attrType;
+        this->attrByteOffset = attrByteOffset;
+        // find index file.
+        std::ostringstream idxStr;
+        idxStr << relationName << '.' << attrByteOffset << ".hash";
+        outIndexName = idxStr.str();
+
+        if(BlobFile::exists(outIndexName)){
+            // index file exists, read the directory back in.
+            file = new BlobFile(outIndexName, false);
+            headerPageNum = file->getFirstPageNo();
+            Page *metaPage;
+            bufMgr->readPage(file, headerPageNum, metaPage);
+            HashMetaInfo *metaInfo = (HashMetaInfo*)metaPage;
+            if(relationName.compare(0, sizeof(metaInfo->relationName) - 1, metaInfo->relationName) != 0
+                    || metaInfo->attrByteOffset != attrByteOffset || metaInfo->attrType != attrType){
+                bufMgr->unPinPage(file, headerPageNum, false);
+                bufMgr->flushFile(file);
+                delete file;
+                throw BadIndexInfoException("Hash index file does not match the relation and attribute");
+            }
+            globalDepth = metaInfo->globalDepth;
+            numEntries = metaInfo->numEntries;
+            freePageNum = metaInfo->freePageNo;
+            directoryPages.assign(metaInfo->directoryPageNos, metaInfo->directoryPageNos + metaInfo->numDirectoryPages);
+            bufMgr->unPinPage(file, headerPageNum, false);
+            directory.resize((std::size_t)1 << globalDepth);
+            for(std::size_t i = 0; i < directoryPages.size(); i++){
+                Page *page;
+                bufMgr->readPage(file, directoryPages[i], page);
+                std::size_t first = i * HASHDIRECTORYSIZE;
+                std::size_t count = std::min((std::size_t)HASHDIRECTORYSIZE, directory.size() - first);
+                std::memcpy(&directory[first], ((HashDirectoryPage*)page)->bucketPageNos, count * sizeof(PageId));
+                bufMgr->unPinPage(file, directoryPages[i], false);
+            }
+            return;
+        }
+
+        // index file doesn't exist: one empty bucket that every key hashes to.
+        file = new BlobFile(outIndexName, true);
+        Page *metaPage, *bucketPage;
+        PageId bucketPageNo;
+        bufMgr->allocPage(file, headerPageNum, metaPage);
+        HashMetaInfo *metaInfo = (HashMetaInfo*)metaPage;
+        std::memset(metaInfo, 0, sizeof(HashMetaInfo));
+        strncpy(metaInfo->relationName, relationName.c_str(), sizeof(metaInfo->relationName) - 1);
+        bufMgr->unPinPage(file, headerPageNum, true);
+        bufMgr->allocPage(file, bucketPageNo, bucketPage);
+        // the bucket header is the same for every key type.
+        ((HashBucket<int>*)bucketPage)->init(0, MAX_PAGEID);
+        bufMgr->unPinPage(file, bucketPageNo, true);
+        globalDepth = 0;
+        numEntries = 0;
+        freePageNum = MAX_PAGEID;
+        directory.assign(1, bucketPageNo);
+
+        // insert all tuples in relation file.
+        FileScan fscan = FileScan(relationName, bufMgr);
+        try{
+            RecordId scanRid;
+            while(1){
+                fscan.scanNext(scanRid);
+                std::string recordStr = fscan.getRecord();
+                insertEntry(recordStr.c_str() + attrByteOffset, scanRid);
+            }
+        } catch(const EndOfFileException &e){
+        }
+    }
+
+    /**
+     * HashIndex Destructor.
+     * Write the directory and the meta page, flush the index file and close it.
+     */
+    HashIndex::~HashIndex()
+    {
+        // write the directory, adding pages if it grew since it was last written.
+        std::size_t numPages = (directory.size() + HASHDIRECTORYSIZE - 1) / HASHDIRECTORYSIZE;
+        for(std::size_t i = 0; i < numPages; i++){
+            PageId pageNo;
+            Page *page;
+            if(i < directoryPages.size()){
+                pageNo = directoryPages[i];
+                bufMgr->readPage(file, pageNo, page);
+            } else{
+                allocHashPage(pageNo, page);
+                directoryPages.push_back(pageNo);
+            }
+            std::size_t first = i * HASHDIRECTORYSIZE;
+            std::size_t count = std::min((std::size_t)HASHDIRECTORYSIZE, directory.size() - first);
+            std::memcpy(((HashDirectoryPage*)page)->bucketPageNos, &directory[first], count * sizeof(PageId));
+            bufMgr->unPinPage(file, pageNo, true);
+        }
+        // update meta page.
+        Page *metaPage;
+        bufMgr->readPage(file, headerPageNum, metaPage);
+        HashMetaInfo *metaInfo = (HashMetaInfo*)metaPage;
+        metaInfo->attrByteOffset = attrByteOffset;
+        metaInfo->attrType = attributeType;
+        metaInfo->globalDepth = globalDepth;
+        metaInfo->numEntries = numEntries;
+        metaInfo->freePageNo = freePageNum;
+        metaInfo->numDirectoryPages = directoryPages.size();
+        std::copy(directoryPages.begin(), directoryPages.end(), metaInfo->directoryPageNos);
+        bufMgr->unPinPage(file, headerPageNum, true);
+        // flush index file.
+        bufMgr->flushFile(file);
+        // delete index file.
+        delete file;
+    }
+
+    /**
+     * Allocate a page, taking it off the free list if there is one there. The page comes back pinned.
+     * @param pageNo
+     * @param page
+     */
+    void HashIndex::allocHashPage(PageId &pageNo, Page *&page){
+        if(freePageNum == MAX_PAGEID){
+            bufMgr->allocPage(file, pageNo, page);
+            return;
+        }
+        pageNo = freePageNum;
+        bufMgr->readPage(file, pageNo, page);
+        freePageNum = ((FreePage*)page)->nextFreePageNo;
+    }
+
+    /**
+     * Put an overflow page that is no longer used on the free list.
+     * @param pageNo
+     */
+    void HashIndex::freeHashPage(PageId pageNo){
+        Page *page;
+        bufMgr->readPage(file, pageNo, page);
+        ((FreePage*)page)->nextFreePageNo = freePageNum;
+        bufMgr->unPinPage(file, pageNo, true);
+        freePageNum = pageNo;
+    }
+
+    void HashIndex::insertEntry(const void *key, const RecordId rid)
+    {
+        LatchGuard guard(latch, true);
+        switch(attributeType){
+            case INTEGER: insertTyped(*(const int*)key, rid); break;
+            case DOUBLE: insertTyped(*(const double*)key, rid); break;
+            case STRING: insertTyped(StringKey((const char*)key), rid); break;
+            default: break;
+        }
+    }
+
+    /**
+     * Insert into the bucket of the key if it has room. A full bucket is split and the insert tried again, unless
+     * the split cannot separate its keys or the directory is as large as it may get; the entry then goes to an
+     * overflow page.
+     */
+    template <class T>
+    void HashIndex::insertTyped(const T& key, const RecordId rid)
+    {
+        RIDKeyPair<T> entry;
+        entry.set(rid, key);
+        std::uint64_t hash = keyHash(key);
+        while(1){
+            std::size_t index = hash & (directory.size() - 1);
+            PageId pageNo = directory[index];
+            Page *page;
+            bufMgr->readPage(file, pageNo, page);
+            HashBucket<T> *bucket = (HashBucket<T>*)page;
+            if(bucket->size < HashBucket<T>::CAPACITY){
+                bucket->append(entry, hash);
+                bufMgr->unPinPage(file, pageNo, true);
+                break;
+            }
+            int localDepth = bucket->localDepth;
+            bufMgr->unPinPage(file, pageNo, false);
+            if(localDepth >= MAXHASHDEPTH || !splittable<T>(pageNo, hash)){
+                appendEntry(pageNo, entry, hash);
+                break;
+            }
+            splitBucket<T>(pageNo, index);
+        }
+        numEntries++;
+    }
+
+    template <class T>
+    void HashIndex::appendEntry(PageId pageNo, const RIDKeyPair<T>& entry, std::uint64_t hash)
+    {
+        Page *page;
+        bufMgr->readPage(file, pageNo, page);
+        HashBucket<T> *bucket = (HashBucket<T>*)page;
+        while(bucket->size == HashBucket<T>::CAPACITY && bucket->overflowPageNo != MAX_PAGEID){
+            PageId nextPageNo = bucket->overflowPageNo;
+            bufMgr->unPinPage(file, pageNo, false);
+            pageNo = nextPageNo;
+            bufMgr->readPage(file, pageNo, page);
+            bucket = (HashBucket<T>*)page;
+        }
+        if(bucket->size == HashBucket<T>::CAPACITY){
+            // chain a new overflow page to the end of the bucket.
+            PageId overflowPageNo;
+            Page *overflowPage;
+            allocHashPage(overflowPageNo, overflowPage);
+            ((HashBucket<T>*)overflowPage)->init(bucket->localDepth, MAX_PAGEID);
+            bucket->overflowPageNo = overflowPageNo;
+            bufMgr->unPinPage(file, pageNo, true);
+            pageNo = overflowPageNo;
+            page = overflowPage;
+            bucket = (HashBucket<T>*)page;
+        }
+        bucket->append(entry, hash);
+        bufMgr->unPinPage(file, pageNo, true);
+    }
+
+    template <class T>
+    bool HashIndex::splittable(PageId pageNo, std::uint64_t hash)
+    {
+        bool found = false;
+        while(pageNo != MAX_PAGEID && !found){
+            Page *page;
+            bufMgr->readPage(file, pageNo, page);
+            HashBucket<T> *bucket = (HashBucket<T>*)page;
+            for(int i = 0; i < bucket->size && !found; i++)
+                found = keyHash(bucket->entries[i].key) != hash;
+            PageId nextPageNo = bucket->overflowPageNo;
+            bufMgr->unPinPage(file, pageNo, false);
+            pageNo = nextPageNo;
+        }
+        return found;
+    }
+
+    template <class T>
+    void HashIndex::splitBucket(PageId pageNo, std::size_t index)
+    {
+        // take all entries out of the bucket, freeing its overflow pages.
+        std::vector<RIDKeyPair<T> > entries;
+        Page *page;
+        bufMgr->readPage(file, pageNo, page);
+        HashBucket<T> *bucket = (HashBucket<T>*)page;
+        int localDepth = bucket->localDepth;
+        PageId overflowPageNo = bucket->overflowPageNo;
+        entries.assign(bucket->entries, bucket->entries + bucket->size);
+        bucket->init(localDepth + 1, MAX_PAGEID);
+        bufMgr->unPinPage(file, pageNo, true);
+        while(overflowPageNo != MAX_PAGEID){
+            bufMgr->readPage(file, overflowPageNo, page);
+            bucket = (HashBucket<T>*)page;
+            entries.insert(entries.end(), bucket->entries, bucket->entries + bucket->size);
+            PageId nextPageNo = bucket->overflowPageNo;
+            bufMgr->unPinPage(file, overflowPageNo, false);
+            freeHashPage(overflowPageNo);
+            overflowPageNo = nextPageNo;
+        }
+
+        if(localDepth == globalDepth){
+            // the bucket used every bit of the directory: double it, each new slot pointing where its twin does.
+            std::size_t size = directory.size();
+            directory.resize(2 * size);
+            std::copy(directory.begin(), directory.begin() + size, directory.begin() + size);
+            globalDepth++;
+        }
+        // slots of the bucket whose next bit is set move to the new bucket.
+        PageId newPageNo;
+        Page *newPage;
+        allocHashPage(newPageNo, newPage);
+        ((HashBucket<T>*)newPage)->init(localDepth + 1, MAX_PAGEID);
+        bufMgr->unPinPage(file, newPageNo, true);
+        std::size_t step = (std::size_t)1 << localDepth;
+        for(std::size_t i = index & (step - 1); i < directory.size(); i += step)
+            if(i & step)
+                directory[i] = newPageNo;
+        for(std::size_t i = 0; i < entries.size(); i++){
+            std::uint64_t hash = keyHash(entries[i].key);
+            appendEntry(hash & step ? newPageNo : pageNo, entries[i], hash);
+        }
+    }
+
+    int HashIndex::lookup(const void *key, std::vector<RecordId> &outRids)
+    {
+        LatchGuard guard(latch, false);
+        switch(attributeType){
+            case INTEGER: return lookupTyped(*(const int*)key, outRids);
+            case DOUBLE: return lookupTyped(*(const double*)key, outRids);
+            case STRING: return lookupTyped(StringKey((const char*)key), outRids);
+            default: return 0;
+        }
+    }
+
+    template <class T>
+    int HashIndex::lookupTyped(const T& key, std::vector<RecordId> &outRids)
+    {
+        int numFound = 0;
+        std::uint64_t hash = keyHash(key);
+        unsigned char fingerprint = hash >> 56;
+        PageId pageNo = directory[hash & (directory.size() - 1)];
+        while(pageNo != MAX_PAGEID){
+            Page *page;
+            bufMgr->readPage(file, pageNo, page);
+            HashBucket<T> *bucket = (HashBucket<T>*)page;
+            const unsigned char *fingerprints = bucket->fingerprints, *end = fingerprints + bucket->size;
+            for(const unsigned char *match = fingerprints;
+                    (match = (const unsigned char*)std::memchr(match, fingerprint, end - match)) != nullptr; match++){
+                const RIDKeyPair<T> &entry = bucket->entries[match - fingerprints];
+                if(entry.key == key){
+                    outRids.push_back(entry.rid);
+                    numFound++;
+                }
+            }
+            PageId nextPageNo = bucket->overflowPageNo;
+            bufMgr->unPinPage(file, pageNo, false);
+            pageNo = nextPageNo;
+        }
+        return numFound;
+    }
+
+}
@@ -0,0 +1,326 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "types.h"
+#include "page.h"
+#include "file.h"
+#include "buffer.h"
+#include "btree.h"
+
+namespace badgerdb
+{
+
+/**
+ * @brief Most low bits of the key hashes the directory of a HashIndex may be indexed by.
+ */
+const  int MAXHASHDEPTH = 20;
+
+/**
+ * @brief Number of directory slots a page holds.
+ */
+const  int HASHDIRECTORYSIZE = Page::SIZE / sizeof( PageId );
+
+/**
+ * @brief Most pages the directory of a HashIndex may take, listed in its meta page.
+ */
+const  int MAXHASHDIRECTORYPAGES = ( 1 << MAXHASHDEPTH ) / HASHDIRECTORYSIZE;
+
+/**
+ * @brief The meta page of a HashIndex, the first page of its file.
+ */
+struct HashMetaInfo{
+    /**
+    * Name of base relation.
+    */
+	char relationName[20];
+
+    /**
+    * Offset of attribute, over which index is built, inside the record stored in pages.
+    */
+	int attrByteOffset;
+
+    /**
+    * Type of the attribute over which index is built.
+    */
+	Datatype attrType;
+
+    /**
+    * Number of low bits of the key hashes that index the directory.
+    */
+	int globalDepth;
+
+    /**
+    * Number of entries in the index.
+    */
+	int numEntries;
+
+    /**
+    * Page number of the first page on the list of freed overflow pages, or MAX_PAGEID if the list is empty.
+    */
+	PageId freePageNo;
+
+    /**
+    * Number of pages the directory takes.
+    */
+	int numDirectoryPages;
+
+    /**
+    * Pages of the directory, each holding HASHDIRECTORYSIZE slots in order.
+    */
+	PageId directoryPageNos[ MAXHASHDIRECTORYPAGES ];
+};
+
+/**
+ * @brief Structure a directory page of a HashIndex is cast to: HASHDIRECTORYSIZE consecutive slots of the
+ * directory, each the page number of a bucket.
+ */
+struct HashDirectoryPage{
+	PageId bucketPageNos[ HASHDIRECTORYSIZE ];
+};
+
+/**
+ * @brief Structure a bucket page of a HashIndex is cast to, and the overflow pages chained to it. Entries are
+ * unordered key-rid slots, each with a byte of its key's hash in front of them, so a lookup compares those
+ * bytes and only reads the keys of the few entries whose byte matches.
+ */
+template <class T>
+struct HashBucket{
+	/**
+	 * Number of entries a page holds. One entry less than would fit leaves room for aligning the entries.
+	 */
+	static const int CAPACITY = ( Page::SIZE - 2 * sizeof( int ) - sizeof( PageId ) - sizeof( RIDKeyPair<T> ) )
+		/ ( sizeof( RIDKeyPair<T> ) + 1 );
+
+	/**
+	 * Number of low bits of the hash that all keys in the bucket share. Not used in overflow pages.
+	 */
+	int localDepth;
+
+	/**
+	 * Number of entries in this page.
+	 */
+	int size;
+
+	/**
+	 * Page number of the next overflow page of the bucket, or MAX_PAGEID at the end of the chain.
+	 */
+	PageId overflowPageNo;
+
+	/**
+	 * Top byte of the hash of every entry's key.
+	 */
+	unsigned char fingerprints[ CAPACITY ];
+
+	RIDKeyPair<T> entries[ CAPACITY ];
+
+	void init( int depth, PageId overflow );
+
+	/**
+	 * Add an entry whose key has the given hash. The page must have room.
+	 */
+	void append( const RIDKeyPair<T>& entry, std::uint64_t hash )
+	{
+		fingerprints[ size ] = hash >> 56;
+		entries[ size++ ] = entry;
+	}
+};
+
+static_assert( sizeof( HashBucket<int> ) <= Page::SIZE, "HashBucket<int> must fit in a page" );
+static_assert( sizeof( HashBucket<double> ) <= Page::SIZE, "HashBucket<double> must fit in a page" );
+static_assert( sizeof( HashBucket<StringKey> ) <= Page::SIZE, "HashBucket<StringKey> must fit in a page" );
+static_assert( sizeof( HashMetaInfo ) <= Page::SIZE, "HashMetaInfo must fit in a page" );
+static_assert( sizeof( HashDirectoryPage ) <= Page::SIZE, "HashDirectoryPage must fit in a page" );
+
+/**
+ * @brief Extendible hash index over one INTEGER, DOUBLE or STRING attribute of a relation, for equality lookups.
+ * A directory of 2^globalDepth slots, indexed by the low bits of the key hash, points to bucket pages; buckets
+ * that share a slot pattern share a page. A full bucket is split in two and the directory doubled if the
+ * bucket already used all of its bits. Buckets whose entries all have one hash, runs of duplicates, cannot be
+ * split and grow a chain of overflow pages instead. The directory is kept in memory while the index is open,
+ * so a lookup reads the bucket page and its overflow pages, usually one page.
+ * Inserts run alone; lookups may run in several threads at once.
+ */
+class HashIndex {
+
+ private:
+
+  /**
+   * File object for the index file.
+   */
+	File		*file;
+
+  /**
+   * Buffer Manager Instance.
+   */
+	BufMgr	*bufMgr;
+
+  /**
+   * Page number of meta page.
+   */
+	PageId	headerPageNum;
+
+  /**
+   * Datatype of attribute over which index is built.
+   */
+	Datatype	attributeType;
+
+  /**
+   * Offset of attribute, over which index is built, inside records.
+   */
+	int 		attrByteOffset;
+
+  /**
+   * Number of low bits of the key hashes that index the directory.
+   */
+	int			globalDepth;
+
+  /**
+   * Number of entries in the index.
+   */
+	int			numEntries;
+
+  /**
+   * Page number of the first page on the free list, or MAX_PAGEID if there is none.
+   */
+	PageId	freePageNum;
+
+  /**
+   * Bucket page of every slot, 2^globalDepth of them.
+   */
+	std::vector<PageId>	directory;
+
+  /**
+   * Pages the directory is written to when the index is closed.
+   */
+	std::vector<PageId>	directoryPages;
+
+  /**
+   * Held exclusively by inserts and shared by lookups.
+   */
+	RWLatch	latch;
+
+    static const PageId MAX_PAGEID = 999999999;
+
+    /**
+     * Allocate a page, taking it off the free list if there is one there. The page comes back pinned.
+     * @param pageNo
+     * @param page
+     */
+    void allocHashPage(PageId &pageNo, Page *&page);
+
+    /**
+     * Put an overflow page that is no longer used on the free list.
+     * @param pageNo
+     */
+    void freeHashPage(PageId pageNo);
+
+    /**
+     * insertEntry() once the key type of the index is known.
+     * @param key
+     * @param rid
+     */
+    template <class T>
+    void insertTyped(const T& key, const RecordId rid);
+
+    /**
+     * Add entry to the last page of the chain of bucket pageNo, chaining a new overflow page if that is full.
+     * @param pageNo
+     * @param entry
+     * @param hash			Hash of the key of entry
+     */
+    template <class T>
+    void appendEntry(PageId pageNo, const RIDKeyPair<T>& entry, std::uint64_t hash);
+
+    /**
+     * True if splitting bucket pageNo and adding a key with the given hash would leave some entries in each
+     * half eventually: the bucket and the key do not all have the same hash.
+     * @param pageNo
+     * @param hash
+     */
+    template <class T>
+    bool splittable(PageId pageNo, std::uint64_t hash);
+
+    /**
+     * Split bucket pageNo, the bucket of directory slot index, in two by the next bit of the hash, doubling the
+     * directory first if the bucket already uses all of its bits. Its overflow pages are freed and its entries
+     * go to whichever half they belong to.
+     * @param pageNo
+     * @param index
+     */
+    template <class T>
+    void splitBucket(PageId pageNo, std::size_t index);
+
+    /**
+     * lookup() once the key type of the index is known.
+     * @param key
+     * @param outRids
+     */
+    template <class T>
+    int lookupTyped(const T& key, std::vector<RecordId> &outRids);
+
+ public:
+
+  /**
+   * HashIndex Constructor.
+   * Check to see if the corresponding index file exists. If so, open the file.
+   * If not, create it and insert entries for every tuple in the base relation using FileScan class.
+   *
+   * @param relationName        Name of file.
+   * @param outIndexName        Return the name of index file, the relation name, the attribute offset and "hash".
+   * @param bufMgrIn						Buffer Manager Instance
+   * @param attrByteOffset			Offset of attribute, over which index is to be built, in the record
+   * @param attrType						Datatype of attribute over which index is built: INTEGER, DOUBLE or STRING
+   * @throws  BadIndexInfoException     If attrType is not one of those, or the index file exists but its meta page
+   *                            names another relation, attribute offset or type.
+   */
+	HashIndex(const std::string & relationName, std::string & outIndexName,
+						BufMgr *bufMgrIn,	const int attrByteOffset,	const Datatype attrType);
+
+
+  /**
+   * HashIndex Destructor.
+   * Write the directory and the meta page, flush the index file and close it.
+   */
+	~HashIndex();
+
+
+  /**
+   * Insert a new entry using the pair <value,rid>. Runs alone.
+   * @param key			Key to insert, pointer to integer/double/char string
+   * @param rid			Record ID of a record whose entry is getting inserted into the index.
+   */
+	void insertEntry(const void* key, const RecordId rid);
+
+
+  /**
+   * Find all entries whose key equals the given key, reading the bucket of the key and its overflow pages.
+   * May be called from several threads at once.
+   * @param key			Key to look up, pointer to integer/double/char string
+   * @param outRids		Record ids of all matching entries are appended to this, in no particular order
+   * @return Number of matching entries found.
+   */
+	int lookup(const void* key, std::vector<RecordId>& outRids);
+
+
+  /**
+   * Number of entries in the index.
+   */
+	int size() const { return numEntries; }
+
+
+  /**
+   * Number of low bits of the key hashes that index the directory, which has 2^depth() slots.
+   */
+	int depth() const { return globalDepth; }
+};
+
+}
@@ -6,7 +6,13 @@
  */
 
 #include <vector>
+#include <climits>
+#include <algorithm>
+#include <fstream>
+#include <thread>
+#include <atomic>
 #include "btree.h"
+#include "hashindex.h"
 #include "page.h"
 #include "filescan.h"
 #include "page_iterator.h"
@@ -19,6 +25,7 @@
 #include "exceptions/bad_opcodes_exception.h"
 #include "exceptions/scan_not_initialized_exception.h"
 #include "exceptions/end_of_file_exception.h"
+#include "exceptions/bad_index_info_exception.h"
 
 #define checkPassFail(a, b) 																				\
 {																																		\
@@ -42,7 +49,7 @@ using namespace badgerdb;
 const std::string relationName = "relA";
 //If the relation size is changed then the second parameter 2 chechPassFail may need to be changed to number of record that are expected to be found during the scan, else tests will erroneously be reported to have failed.
 const int	relationSize = 5000;
-std::string intIndexName, doubleIndexName, stringIndexName;
+std::string intIndexName, doubleIndexName, stringIndexName, hashIndexName;
 
 // This is the structure for tuples in the base relation
 
@@ -67,22 +74,113 @@ void createRelationForward();
 void createRelationForwardWithNegative();
 void createRelationBackward();
 void createRelationRandom();
+void createRelationDuplicates();
+void createRelationEmpty();
 void intTests();
 void intTests1();
 void intTests2();
 void intTests3();
+void intTests4();
+void intTests5();
+void intTests6();
+void intTests7();
+void intTests8();
+void intTests9();
+void intTests10();
+void intTests11();
+void intTests12();
+void intTests13();
+void intTests14();
+void intTests15();
+void intTests16();
+void intTests17();
+void intTests18();
+void intTests19();
+void intTests20();
+void intTests21();
+void intTests22();
+void intTests23();
+void intTests24();
+void intTests25();
+void intTests26();
+void intTests27();
 int intScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
 int intScan1(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
+int intScanBatch(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
+int intScanDescending(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
+int coveringMismatches(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp, ScanOrder order, int &numResults);
+int compositeScan(BTreeIndex *index, int lowI, double lowD, Operator lowOp, int highI, double highD, Operator highOp);
+int compositeSkipScan(BTreeIndex *index, double lowD, Operator lowOp, double highD, Operator highOp);
+int deltaScan(BTreeIndex *index, int lowVal, int highVal, ScanOrder order, bool mergeMidway);
+void doubleTests();
+int doubleScan(BTreeIndex *index, double lowVal, Operator lowOp, double highVal, Operator highOp);
+void stringTests();
+void stringTests1(bool countEntries);
+void hashTests();
+int stringScanCount(BTreeIndex *index, const char *lowVal, Operator lowOp, const char *highVal, Operator highOp);
+int stringScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
 void indexTests();
 void indexTests1();
 void indexTests2();
 void indexTests3();
+void indexTests4();
+void indexTests5();
+void indexTests6();
+void indexTests7();
+void indexTests8();
+void indexTests9();
+void indexTests10();
+void indexTests11();
+void indexTests12();
+void indexTests13();
+void indexTests14();
+void indexTests15();
+void indexTests16();
+void indexTests17();
+void indexTests18();
+void indexTests19();
+void indexTests20();
+void indexTests21();
+void indexTests22();
+void indexTests23();
+void indexTests24();
+void indexTests25();
+void indexTests26();
+void indexTests27();
+void indexTests28();
+void indexTests29();
 void test1();
 void test2();
 void test3();
 void test4();
 void test5();
 void test6();
+void test7();
+void test8();
+void test9();
+void test10();
+void test11();
+void test12();
+void test13();
+void test14();
+void test15();
+void test16();
+void test17();
+void test18();
+void test19();
+void test20();
+void test21();
+void test22();
+void test23();
+void test24();
+void test25();
+void test26();
+void test27();
+void test28();
+void test29();
+void test30();
+void test31();
+void test32();
 void errorTests();
 void deleteRelation();
 
@@ -151,6 +249,32 @@ int main(int argc, char **argv)
 	test4();
     test5();
     test6();
+    test7();
+    test8();
+    test9();
+    test10();
+    test11();
+    test12();
+    test13();
+    test14();
+    test15();
+    test16();
+    test17();
+    test18();
+    test19();
+    test20();
+    test21();
+    test22();
+    test23();
+    test24();
+    test25();
+    test26();
+    test27();
+    test28();
+    test29();
+    test30();
+    test31();
+    test32();
 	errorTests();
 
 	delete bufMgr;
@@ -224,6 +348,293 @@ void test6()
     deleteRelation();
 }
 
+void test7()
+{
+    // Create a relation with tuples valued 0 to relationSize in random order and scan it
+    // through the non-throwing, batched scan interface
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Batched scans" << std::endl;
+    createRelationRandom(); // assigned relation to file 1
+    indexTests4();
+    deleteRelation();
+}
+
+void test8()
+{
+    // Create a relation with tuples valued 0 to relationSize in random order and run several
+    // scan cursors against one index at the same time
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Concurrent scan cursors" << std::endl;
+    createRelationRandom(); // assigned relation to file 1
+    indexTests5();
+    deleteRelation();
+}
+
+void test9()
+{
+    // Create a relation where every key appears several times and run point lookups,
+    // including on runs of duplicates that span leaves
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Point lookups" << std::endl;
+    createRelationDuplicates(); // assigned relation to file 1
+    indexTests6();
+    deleteRelation();
+}
+
+void test10()
+{
+    // Create a relation with tuples valued 0 to relationSize, then grow and probe
+    // its index through the batch interfaces
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Batch insert and lookup" << std::endl;
+    createRelationForward();
+    indexTests7();
+    deleteRelation();
+}
+
+void test11()
+{
+    // Create a relation with tuples valued 0 to relationSize, then keep appending
+    // ascending keys past the right edge of its index
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Ascending appends" << std::endl;
+    createRelationForward();
+    indexTests8();
+    deleteRelation();
+}
+
+void test12()
+{
+    // Create a relation with tuples valued 0 to relationSize, then shrink its index
+    // through deletions and grow it back
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Deletion" << std::endl;
+    createRelationForward();
+    indexTests9();
+    deleteRelation();
+}
+
+void test13()
+{
+    // Create a relation with tuples valued 0 to relationSize, then add string keys that share
+    // long prefixes to its string index and delete most of them again
+    std::cout << "--------------------" << std::endl;
+    std::cout << "String keys with shared prefixes" << std::endl;
+    createRelationForward();
+    indexTests10();
+    deleteRelation();
+}
+
+void test14()
+{
+    // Create a relation where every key appears several times, then pile record ids onto one
+    // key of an index with posting list leaves
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Posting list leaves" << std::endl;
+    createRelationDuplicates(); // assigned relation to file 1
+    indexTests11();
+    deleteRelation();
+}
+
+void test15()
+{
+    // Create a relation with tuples valued 0 to relationSize in random order, then grow and shrink
+    // an index with packed leaves past the relation's keys
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Packed leaves" << std::endl;
+    createRelationRandom(); // assigned relation to file 1
+    indexTests12();
+    deleteRelation();
+}
+
+void test16()
+{
+    // Create a relation with tuples valued 0 to relationSize, then insert into its index from several
+    // threads while others scan and look up keys
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Concurrent inserts and scans" << std::endl;
+    createRelationForward();
+    indexTests13();
+    deleteRelation();
+}
+
+void test17()
+{
+    // Create a relation with tuples valued 0 to relationSize, then split leaves all over its index from
+    // several threads while others look up and scan its keys
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Concurrent lookups during splits" << std::endl;
+    createRelationForward();
+    indexTests14();
+    deleteRelation();
+}
+
+void test18()
+{
+    // Create a relation with tuples valued 0 to relationSize in random order and scan its index
+    // from the high end of ranges down, with each leaf layout
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Descending scans" << std::endl;
+    createRelationRandom();
+    indexTests15();
+    deleteRelation();
+}
+
+void test19()
+{
+    // Create a relation with tuples valued 0 to relationSize in random order and scan lists of
+    // ranges of its index in one pass
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Multi-range scans" << std::endl;
+    createRelationRandom();
+    indexTests16();
+    deleteRelation();
+}
+
+void test20()
+{
+    // Create a relation with tuples valued 0 to relationSize in random order and count, rank and select
+    // entries of its index through the entry counts of the nonleaves
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Range counts" << std::endl;
+    createRelationRandom();
+    indexTests17();
+    deleteRelation();
+}
+
+void test21()
+{
+    // Create a relation with tuples valued 0 to relationSize in random order and read the double field and a
+    // prefix of the string field of its tuples out of a covering index on the integer field
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Covering index" << std::endl;
+    createRelationRandom();
+    indexTests18();
+    deleteRelation();
+}
+
+void test22()
+{
+    // Create a relation with tuples valued 0 to relationSize in random order and index its integer and double
+    // fields together, with many more entries sharing their integer field inserted, and skip-scan the double field
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Composite keys" << std::endl;
+    createRelationRandom();
+    indexTests19();
+    deleteRelation();
+}
+
+void test23()
+{
+    // Create a relation with tuples valued 0 to relationSize in random order and probe indexes with Bloom filters
+    // over its integer and double fields for keys that are and are not in them
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Bloom filters" << std::endl;
+    createRelationRandom();
+    indexTests20();
+    deleteRelation();
+}
+
+void test24()
+{
+    // Create a relation with tuples valued 0 to relationSize in random order and look its tuples up through hash
+    // indexes on its integer, double and string fields
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Hash indexes" << std::endl;
+    createRelationRandom();
+    indexTests21();
+    deleteRelation();
+}
+
+void test25()
+{
+    // Create a relation with tuples valued 0 to relationSize in random order, index its integer field and insert
+    // more entries through the insert buffer, looking them up and scanning them before and after it is flushed
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Buffered inserts" << std::endl;
+    createRelationRandom();
+    indexTests22();
+    deleteRelation();
+}
+
+void test26()
+{
+    // Create a relation with tuples valued 0 to relationSize in random order, index its integer field and scan
+    // entries of the insert buffer merged with those of the leaves, with merges in the middle of scans and in a
+    // thread of the index while other threads insert and scan
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Delta store scans" << std::endl;
+    createRelationRandom();
+    indexTests23();
+    deleteRelation();
+}
+
+void test27()
+{
+    // Create a relation with tuples valued 0 to relationSize, index its integer field and insert keys that are
+    // far from uniform, so node searches have to correct the interpolated position or fall back to binary search
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Skewed integer keys" << std::endl;
+    createRelationForward();
+    indexTests24();
+    deleteRelation();
+}
+
+void test28()
+{
+    // Create a relation with tuples valued 0 to relationSize in random order, index its integer field and grow
+    // the tree to two levels of nonleaves while descents search Eytzinger copies of the nonleaves
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Eytzinger search" << std::endl;
+    createRelationRandom();
+    indexTests25();
+    deleteRelation();
+}
+
+void test29()
+{
+    // Create a relation with tuples valued 0 to relationSize in random order, index its integer field and keep
+    // the upper levels of the tree pinned while inserts split the root and deletes collapse it again
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Pinned upper levels" << std::endl;
+    createRelationRandom();
+    indexTests26();
+    deleteRelation();
+}
+
+void test30()
+{
+    // Create a relation without tuples, index its integer field with a Bloom filter and fill the index by inserts,
+    // which outgrow the filter sized for the empty relation
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Bloom filter grown by inserts" << std::endl;
+    createRelationEmpty();
+    indexTests27();
+    deleteRelation();
+}
+
+void test31()
+{
+    // Create a relation without tuples and fill indexes on its integer field, one with entry counts in the
+    // nonleaves and one without, by inserts
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Nonleaves with and without entry counts" << std::endl;
+    createRelationEmpty();
+    indexTests28();
+    deleteRelation();
+}
+
+void test32()
+{
+    // Create a relation with tuples valued 0 to relationSize in random order and buffer inserts into an index on
+    // its integer field in the pages of its nonleaves
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Message buffers in the nonleaves" << std::endl;
+    createRelationRandom();
+    indexTests29();
+    deleteRelation();
+}
+
 // -----------------------------------------------------------------------------
 // createRelationForward
 // -----------------------------------------------------------------------------
@@ -431,6 +842,88 @@ void createRelationRandom()
 	file1->writePage(new_page_number, new_page);
 }
 
+// -----------------------------------------------------------------------------
+// createRelationEmpty
+// -----------------------------------------------------------------------------
+
+void createRelationEmpty()
+{
+  // destroy any old copies of relation file
+	try
+	{
+		File::remove(relationName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+  file1 = new PageFile(relationName, true);
+
+  // a single page without records
+	PageId new_page_number;
+  Page new_page = file1->allocatePage(new_page_number);
+	file1->writePage(new_page_number, new_page);
+}
+
+// -----------------------------------------------------------------------------
+// createRelationDuplicates
+// -----------------------------------------------------------------------------
+
+const int duplicateFactor = 10;
+
+void createRelationDuplicates()
+{
+  // destroy any old copies of relation file
+	try
+	{
+		File::remove(relationName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+  file1 = new PageFile(relationName, true);
+
+  // initialize all of record1.s to keep purify happy
+  memset(record1.s, ' ', sizeof(record1.s));
+	PageId new_page_number;
+  Page new_page = file1->allocatePage(new_page_number);
+
+  // insert relationSize records in random order, duplicateFactor copies of every value
+  std::vector<int> intvec(relationSize);
+  for( int i = 0; i < relationSize; i++ )
+  {
+    intvec[i] = i / duplicateFactor;
+  }
+  for( int i = relationSize - 1; i > 0; i-- )
+  {
+    std::swap(intvec[i], intvec[random() % (i + 1)]);
+  }
+
+  for( int i = 0; i < relationSize; i++ )
+  {
+    sprintf(record1.s, "%05d string record", intvec[i]);
+    record1.i = intvec[i];
+    record1.d = intvec[i];
+
+    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(RECORD));
+
+		while(1)
+		{
+			try
+			{
+    		new_page.insertRecord(new_data);
+				break;
+			}
+			catch(const InsufficientSpaceException &e)
+			{
+      	file1->writePage(new_page_number, new_page);
+  			new_page = file1->allocatePage(new_page_number);
+			}
+		}
+  }
+
+	file1->writePage(new_page_number, new_page);
+}
+
 // -----------------------------------------------------------------------------
 // indexTests
 // -----------------------------------------------------------------------------
@@ -445,6 +938,24 @@ void indexTests()
   catch(const FileNotFoundException &e)
   {
   }
+
+  doubleTests();
+	try
+	{
+		File::remove(doubleIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+
+  stringTests();
+	try
+	{
+		File::remove(stringIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
 }
 
 void indexTests1()
@@ -483,62 +994,2727 @@ void indexTests3()
     }
 }
 
-// -----------------------------------------------------------------------------
-// intTests
-// -----------------------------------------------------------------------------
+void indexTests4()
+{
+    intTests4();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+}
 
-void intTests()
+void indexTests5()
 {
-  std::cout << "Create a B+ Tree index on the integer field" << std::endl;
-  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    intTests5();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+}
 
-	// run some tests
-	checkPassFail(intScan(&index,25,GT,40,LT), 14)
-	checkPassFail(intScan(&index,20,GTE,35,LTE), 16)
-	checkPassFail(intScan(&index,-3,GT,3,LT), 3)
-	checkPassFail(intScan(&index,996,GT,1001,LT), 4)
-	checkPassFail(intScan(&index,0,GT,1,LT), 0)
-	checkPassFail(intScan(&index,0,GT,145,LT), 144)
-	checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+void indexTests6()
+{
+    intTests6();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
 }
 
-void intTests1()
+void indexTests7()
+{
+    intTests7();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+}
+
+void indexTests8()
+{
+    intTests8();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+}
+
+void indexTests9()
+{
+    intTests9();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+}
+
+void indexTests10()
+{
+    stringTests1(false);
+    File::remove(stringIndexName);
+    stringTests1(true);
+    try
+    {
+        File::remove(stringIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+}
+
+void indexTests11()
+{
+    intTests10();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+}
+
+void indexTests12()
+{
+    intTests11();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+}
+
+void indexTests13()
+{
+    intTests12();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+}
+
+void indexTests14()
+{
+    intTests13();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+}
+
+void indexTests15()
+{
+    intTests14();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+}
+
+void indexTests16()
+{
+    intTests15();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+}
+
+void indexTests17()
+{
+    intTests16();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+}
+
+void indexTests18()
+{
+    intTests17();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+}
+
+void indexTests19()
+{
+    intTests18();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+}
+
+void indexTests25()
+{
+    intTests23();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+}
+
+void indexTests27()
+{
+    intTests25();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+}
+
+void indexTests29()
+{
+    intTests27();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+}
+
+void indexTests28()
+{
+    intTests26();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+}
+
+void indexTests26()
+{
+    intTests24();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+}
+
+void indexTests24()
+{
+    intTests22();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+}
+
+void indexTests23()
+{
+    intTests21();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+}
+
+void indexTests22()
+{
+    intTests20();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+}
+
+void indexTests21()
+{
+    hashTests();
+    try
+    {
+        File::remove(hashIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+}
+
+void indexTests20()
+{
+    intTests19();
+    try
+    {
+        File::remove(intIndexName);
+        File::remove(doubleIndexName);
+    }
+    catch(const FileNotFoundException &e)
+    {
+    }
+}
+
+// -----------------------------------------------------------------------------
+// intTests
+// -----------------------------------------------------------------------------
+
+void intTests()
+{
+  std::cout << "Create a B+ Tree index on the integer field" << std::endl;
+  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+	// run some tests
+	checkPassFail(intScan(&index,25,GT,40,LT), 14)
+	checkPassFail(intScan(&index,20,GTE,35,LTE), 16)
+	checkPassFail(intScan(&index,-3,GT,3,LT), 3)
+	checkPassFail(intScan(&index,996,GT,1001,LT), 4)
+	checkPassFail(intScan(&index,0,GT,1,LT), 0)
+	checkPassFail(intScan(&index,0,GT,145,LT), 144)
+	checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+}
+
+void intTests1()
 {
     std::cout << "Create a B+ Tree index on the integer field" << std::endl;
     BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
 
-    // run some tests
-    checkPassFail(intScan(&index,5005,GTE,5010,LT), 0)
-    checkPassFail(intScan(&index,2677,GTE,2788,LT), 111)
-    checkPassFail(intScan(&index,654,GT,1001,LT), 346)
-    checkPassFail(intScan(&index,-3,GT,3,LTE), 4)
-    checkPassFail(intScan(&index,380,GT,400,LT), 19)
-    checkPassFail(intScan(&index,-400,GT,400,LTE), 401)
+    // run some tests
+    checkPassFail(intScan(&index,5005,GTE,5010,LT), 0)
+    checkPassFail(intScan(&index,2677,GTE,2788,LT), 111)
+    checkPassFail(intScan(&index,654,GT,1001,LT), 346)
+    checkPassFail(intScan(&index,-3,GT,3,LTE), 4)
+    checkPassFail(intScan(&index,380,GT,400,LT), 19)
+    checkPassFail(intScan(&index,-400,GT,400,LTE), 401)
+
+}
+
+void intTests2()
+{
+    std::cout << "Create a B+ Tree index on the integer field" << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+    // run some tests
+    checkPassFail(intScan(&index,-5000,GTE,4000,LT), 9000)
+    checkPassFail(intScan(&index,-3,GT,3,LTE), 6)
+
+}
+
+void intTests3()
+{
+    std::cout << "Create a B+ Tree index on the integer field" << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+    // run some tests
+    checkPassFail(intScan1(&index,4999,GTE,5000,LT), 1)
+
+}
+
+void intTests4()
+{
+    std::cout << "Create a B+ Tree index on the integer field" << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+    // run some tests
+    checkPassFail(intScanBatch(&index,25,GT,40,LT), 14)
+    checkPassFail(intScanBatch(&index,0,GTE,relationSize,LT), relationSize)
+    checkPassFail(intScanBatch(&index,996,GT,1001,LT), 4)
+    checkPassFail(intScanBatch(&index,5005,GTE,5010,LT), 0)
+    checkPassFail(intScanBatch(&index,4999,GTE,5000,LT), 1)
+
+    // a completed scan keeps reporting completion until it is ended
+    int low = 10, high = 12;
+    RecordId scanRid;
+    int numResults = 0;
+    checkPassFail(index.tryStartScan(&low, GTE, &high, LTE), true)
+    while(index.tryScanNext(scanRid))
+        numResults++;
+    checkPassFail(numResults, 3)
+    checkPassFail(index.tryScanNext(scanRid), false)
+    checkPassFail(index.scanNextBatch(&scanRid, 1), 0)
+    index.endScan();
+}
+
+void intTests5()
+{
+    std::cout << "Create a B+ Tree index on the integer field" << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+    // interleave two cursors and the index's own scan, none may disturb the others
+    int low1 = 100, high1 = 2100, low2 = 3000, high2 = 3500, low3 = 0, high3 = 50;
+    RecordId scanRid;
+    int numResults1 = 0, numResults2 = 0, numResults3 = 0;
+    {
+        BTreeScanCursor cursor1(&index), cursor2(&index);
+        cursor1.startScan(&low1, GTE, &high1, LT);
+        cursor2.startScan(&low2, GT, &high2, LTE);
+        index.startScan(&low3, GTE, &high3, LT);
+        bool more1 = true, more2 = true, more3 = true;
+        while(more1 || more2 || more3)
+        {
+            if(more1 && (more1 = cursor1.tryScanNext(scanRid))) numResults1++;
+            if(more2 && (more2 = cursor2.tryScanNext(scanRid))) numResults2++;
+            if(more3 && (more3 = index.tryScanNext(scanRid))) numResults3++;
+        }
+        index.endScan();
+        // cursor2 is left executing, its destructor must unpin its leaf
+        cursor1.endScan();
+    }
+    checkPassFail(numResults1, 2000)
+    checkPassFail(numResults2, 500)
+    checkPassFail(numResults3, 50)
+
+    // index nested-loop style probes: an outer cursor drives a new inner cursor per key
+    int outerLow = 1000, outerHigh = 1200, numMatches = 0;
+    BTreeScanCursor outer(&index);
+    outer.startScan(&outerLow, GTE, &outerHigh, LT);
+    while(outer.tryScanNext(scanRid))
+    {
+        Page *curPage;
+        bufMgr->readPage(file1, scanRid.page_number, curPage);
+        RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRid).data()));
+        bufMgr->unPinPage(file1, scanRid.page_number, false);
+
+        BTreeScanCursor inner(&index);
+        RecordId innerRid;
+        if(inner.tryStartScan(&myRec.i, GTE, &myRec.i, LTE))
+            while(inner.tryScanNext(innerRid))
+                numMatches++;
+    }
+    outer.endScan();
+    checkPassFail(numMatches, 200)
+}
+
+void intTests6()
+{
+    std::cout << "Create a B+ Tree index on the integer field" << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+    // every present key must be found duplicateFactor times, by lookup and by scan alike
+    int numKeys = relationSize / duplicateFactor, numMismatches = 0;
+    std::vector<RecordId> rids;
+    for(int key = 0; key < numKeys; key++)
+    {
+        rids.clear();
+        if(index.lookup(&key, rids) != duplicateFactor || (int)rids.size() != duplicateFactor)
+            numMismatches++;
+    }
+    checkPassFail(numMismatches, 0)
+    checkPassFail(intScan(&index,100,GTE,100,LTE), duplicateFactor)
+    checkPassFail(intScan(&index,0,GTE,numKeys,LT), relationSize)
+
+    // absent keys on either side of the key range
+    int belowAll = -1, aboveAll = numKeys;
+    rids.clear();
+    checkPassFail(index.lookup(&belowAll, rids), 0)
+    checkPassFail(index.lookup(&aboveAll, rids), 0)
+    checkPassFail(rids.size(), 0)
+}
+
+void intTests7()
+{
+    std::cout << "Create a B+ Tree index on the integer field" << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+    // batch insert keys relationSize to 3 * relationSize in random order, with a second copy of
+    // every tenth key. The record ids are synthetic, page_number carries the key.
+    std::vector<RIDKeyPair<int> > entries;
+    for(int key = relationSize; key < 3 * relationSize; key++)
+    {
+        RecordId fakeRid;
+        fakeRid.page_number = key;
+        fakeRid.slot_number = 0;
+        fakeRid.padding = 0;
+        RIDKeyPair<int> entry;
+        entry.set(fakeRid, key);
+        entries.push_back(entry);
+        if(key % 10 == 0)
+            entries.push_back(entry);
+    }
+    for(int i = entries.size() - 1; i > 0; i--)
+        std::swap(entries[i], entries[random() % (i + 1)]);
+    index.insertBatch(entries);
+
+    // batch lookup every key, plus keys that are absent on either side of the key range
+    std::vector<int> keys;
+    for(int key = -10; key < 3 * relationSize + 10; key++)
+        keys.push_back(key);
+    for(int i = keys.size() - 1; i > 0; i--)
+        std::swap(keys[i], keys[random() % (i + 1)]);
+    std::vector<RIDKeyPair<int> > found;
+    int expected = 3 * relationSize + 2 * relationSize / 10;
+    checkPassFail(index.lookupBatch(keys, found), expected)
+
+    // results come back in key order and match single lookups
+    int numMismatches = 0;
+    for(size_t i = 0; i < found.size(); i++)
+    {
+        if(i > 0 && found[i].key < found[i - 1].key)
+            numMismatches++;
+        if(found[i].key >= relationSize && (int)found[i].rid.page_number != found[i].key)
+            numMismatches++;
+    }
+    checkPassFail(numMismatches, 0)
+    std::vector<RecordId> rids;
+    int key = 2 * relationSize;
+    checkPassFail(index.lookup(&key, rids), 2)
+
+    // the leaf level holds every entry in order
+    int low = 0, high = 3 * relationSize, numResults = 0;
+    RecordId scanRid;
+    index.startScan(&low, GTE, &high, LT);
+    while(index.tryScanNext(scanRid))
+        numResults++;
+    index.endScan();
+    checkPassFail(numResults, expected)
+}
+
+void intTests8()
+{
+    std::cout << "Create a B+ Tree index on the integer field" << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+    // append keys relationSize to 4 * relationSize in ascending order, so the right edge
+    // splits over and over. The record ids are synthetic, page_number carries the key.
+    RecordId fakeRid;
+    fakeRid.slot_number = 0;
+    fakeRid.padding = 0;
+    for(int key = relationSize; key < 4 * relationSize; key++)
+    {
+        fakeRid.page_number = key;
+        index.insertEntry(&key, fakeRid);
+    }
+
+    // the leaves left behind by appends are packed full, inserts into them must still split correctly
+    for(int key = relationSize + 5; key < 4 * relationSize; key += 1000)
+    {
+        fakeRid.page_number = key;
+        index.insertEntry(&key, fakeRid);
+    }
+    int belowAll = -1;
+    fakeRid.page_number = 0;
+    index.insertEntry(&belowAll, fakeRid);
+
+    int numMismatches = 0;
+    std::vector<RecordId> rids;
+    for(int key = relationSize; key < 4 * relationSize; key++)
+    {
+        rids.clear();
+        int expected = key % 1000 == relationSize % 1000 + 5 ? 2 : 1;
+        if(index.lookup(&key, rids) != expected || (int)rids[0].page_number != key)
+            numMismatches++;
+    }
+    checkPassFail(numMismatches, 0)
+
+    // the leaf level holds every entry in order
+    int low = -1, high = 4 * relationSize, numResults = 0;
+    RecordId scanRid;
+    index.startScan(&low, GTE, &high, LT);
+    while(index.tryScanNext(scanRid))
+        numResults++;
+    index.endScan();
+    checkPassFail(numResults, 4 * relationSize + 3 * relationSize / 1000 + 1)
+    checkPassFail(intScan(&index,25,GT,40,LT), 14)
+}
+
+void intTests9()
+{
+    std::cout << "Create a B+ Tree index on the integer field" << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+    // keys are unique, so the i-th record id of a full scan belongs to key i
+    std::vector<RecordId> rids(relationSize);
+    int low = 0, high = relationSize;
+    index.startScan(&low, GTE, &high, LT);
+    for(int key = 0; key < relationSize; key++)
+        index.scanNext(rids[key]);
+    index.endScan();
+
+    // delete all keys but the multiples of ten, in random order, so leaves both merge and borrow
+    std::vector<int> keys;
+    for(int key = 0; key < relationSize; key++)
+        if(key % 10 != 0)
+            keys.push_back(key);
+    for(int i = keys.size() - 1; i > 0; i--)
+        std::swap(keys[i], keys[random() % (i + 1)]);
+    int numFailed = 0;
+    for(size_t i = 0; i < keys.size(); i++)
+        if(!index.deleteEntry(&keys[i], rids[keys[i]]))
+            numFailed++;
+    checkPassFail(numFailed, 0)
+    checkPassFail(index.deleteEntry(&keys[0], rids[keys[0]]), false)
+    int tenth = 10;
+    checkPassFail(index.deleteEntry(&tenth, rids[0]), false)
+
+    checkPassFail(intScan(&index,25,GT,40,LT), 1)
+    checkPassFail(intScan(&index,-3,GT,3000,LT), 300)
+    checkPassFail(intScan(&index,0,GTE,relationSize,LT), relationSize / 10)
+
+    // empty the index, then refill it with every key
+    for(int key = 0; key < relationSize; key += 10)
+        if(!index.deleteEntry(&key, rids[key]))
+            numFailed++;
+    checkPassFail(numFailed, 0)
+    checkPassFail(index.tryStartScan(&low, GTE, &high, LT), false)
+    for(int key = 0; key < relationSize; key++)
+        index.insertEntry(&key, rids[key]);
+    checkPassFail(intScan(&index,25,GT,40,LT), 14)
+    checkPassFail(intScan(&index,0,GTE,relationSize,LT), relationSize)
+}
+
+bool ridBefore(const RecordId &a, const RecordId &b)
+{
+    return a.page_number != b.page_number ? a.page_number < b.page_number : a.slot_number < b.slot_number;
+}
+
+void intTests10()
+{
+    // synthetic record ids for one hot key, mostly ascending as a heap file hands them out and a
+    // few out of order. They point past the relation, so they are only counted, never read.
+    const int hotKey = 100, numAscending = 30000, numShuffled = 1000;
+    std::vector<RecordId> hotRids;
+    for(int i = 0; i < numAscending + numShuffled; i++)
+    {
+        RecordId fakeRid;
+        fakeRid.page_number = i < numAscending ? relationSize + i / 50 : 2 * relationSize + i;
+        fakeRid.slot_number = i < numAscending ? i % 50 + 1 : 1;
+        fakeRid.padding = 0;
+        hotRids.push_back(fakeRid);
+    }
+    for(int i = hotRids.size() - 1; i > numAscending; i--)
+        std::swap(hotRids[i], hotRids[numAscending + random() % (i + 1 - numAscending)]);
+
+    // the same entries in an index with array leaves, for comparing file sizes at the end
+    {
+        std::cout << "Create a B+ Tree index on the integer field" << std::endl;
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        for(size_t i = 0; i < hotRids.size(); i++)
+            index.insertEntry(&hotKey, hotRids[i]);
+    }
+    std::streamoff arrayFileSize = std::ifstream(intIndexName.c_str(), std::ios::binary | std::ios::ate).tellg();
+    File::remove(intIndexName);
+
+    std::cout << "Create a B+ Tree index on the integer field with posting list leaves" << std::endl;
+    BTreeIndex *index = new BTreeIndex(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, POSTING_LEAVES);
+    for(size_t i = 0; i < hotRids.size(); i++)
+        index->insertEntry(&hotKey, hotRids[i]);
+
+    // every key is found as often as it was inserted, however long its posting list
+    int numKeys = relationSize / duplicateFactor, numMismatches = 0;
+    std::vector<RecordId> rids;
+    for(int key = 0; key < numKeys; key++)
+    {
+        rids.clear();
+        int expected = key == hotKey ? duplicateFactor + (int)hotRids.size() : duplicateFactor;
+        if(index->lookup(&key, rids) != expected || (int)rids.size() != expected)
+            numMismatches++;
+    }
+    checkPassFail(numMismatches, 0)
+
+    // the hot key's lookup holds every synthetic record id once
+    rids.clear();
+    index->lookup(&hotKey, rids);
+    std::vector<RecordId> sortedHot(hotRids);
+    std::sort(sortedHot.begin(), sortedHot.end(), ridBefore);
+    std::sort(rids.begin(), rids.end(), ridBefore);
+    int numFound = 0;
+    for(size_t i = 0, j = 0; i < rids.size() && j < sortedHot.size(); i++)
+        if(rids[i] == sortedHot[j])
+        {
+            numFound++;
+            j++;
+        }
+    checkPassFail(numFound, (int)hotRids.size())
+
+    // scans and batch lookups step through the run of the hot key across leaves
+    int low = hotKey - 1, high = hotKey + 1, numResults = 0;
+    RecordId scanRid;
+    index->startScan(&low, GTE, &high, LTE);
+    while(index->tryScanNext(scanRid))
+        numResults++;
+    index->endScan();
+    checkPassFail(numResults, 3 * duplicateFactor + (int)hotRids.size())
+    RecordId scanRids[64];
+    int n;
+    low = 0;
+    high = numKeys;
+    numResults = 0;
+    index->startScan(&low, GTE, &high, LT);
+    while((n = index->scanNextBatch(scanRids, 64)) > 0)
+        numResults += n;
+    index->endScan();
+    checkPassFail(numResults, relationSize + (int)hotRids.size())
+    std::vector<int> keys;
+    keys.push_back(hotKey + 1);
+    keys.push_back(hotKey);
+    keys.push_back(numKeys);
+    std::vector<RIDKeyPair<int> > found;
+    checkPassFail(index->lookupBatch(keys, found), 2 * duplicateFactor + (int)hotRids.size())
+
+    // delete two thirds of the hot record ids in random order, so posting lists shrink and merge
+    for(int i = hotRids.size() - 1; i > 0; i--)
+        std::swap(hotRids[i], hotRids[random() % (i + 1)]);
+    int numFailed = 0, numKept = hotRids.size() / 3;
+    for(size_t i = numKept; i < hotRids.size(); i++)
+        if(!index->deleteEntry(&hotKey, hotRids[i]))
+            numFailed++;
+    checkPassFail(numFailed, 0)
+    checkPassFail(index->deleteEntry(&hotKey, hotRids[numKept]), false)
+    rids.clear();
+    checkPassFail(index->lookup(&hotKey, rids), duplicateFactor + numKept)
+    checkPassFail(intScan(index,hotKey - 2,GT,hotKey,LT), duplicateFactor)
+    checkPassFail(intScanBatch(index,hotKey,GT,numKeys,LT), relationSize - (hotKey + 1) * duplicateFactor)
+
+    // index files never shrink, so both sizes are taken with every hot record id in place.
+    // Posting lists must need a fraction of the pages of array leaves.
+    delete index;
+    std::streamoff postingFileSize = std::ifstream(intIndexName.c_str(), std::ios::binary | std::ios::ate).tellg();
+    bool compressed = postingFileSize * 3 < arrayFileSize;
+    checkPassFail(compressed, true)
+}
+
+void intTests11()
+{
+    // synthetic entries above the relation's keys with ascending record ids, as an append heavy
+    // table produces them, plus the two extreme keys with a far away page so that leaves must widen
+    // their bit widths. They point past the relation, so they are only counted, never read.
+    const int numExtra = 60000;
+    std::vector<RIDKeyPair<int> > entries;
+    for(int i = 0; i < numExtra; i++)
+    {
+        RecordId fakeRid;
+        fakeRid.page_number = relationSize + i / 50;
+        fakeRid.slot_number = i % 50 + 1;
+        fakeRid.padding = 0;
+        RIDKeyPair<int> entry;
+        entry.set(fakeRid, relationSize + i);
+        entries.push_back(entry);
+    }
+    const int extremeKeys[2] = {INT_MIN, INT_MAX};
+    RecordId farRid;
+    farRid.page_number = 0x7ffffff0;
+    farRid.slot_number = 0xffff;
+    farRid.padding = 0;
+
+    // the same entries in an index with array leaves, for comparing file sizes at the end
+    {
+        std::cout << "Create a B+ Tree index on the integer field" << std::endl;
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        index.insertBatch(entries);
+    }
+    std::streamoff arrayFileSize = std::ifstream(intIndexName.c_str(), std::ios::binary | std::ios::ate).tellg();
+    File::remove(intIndexName);
+
+    std::cout << "Create a B+ Tree index on the integer field with packed leaves" << std::endl;
+    BTreeIndex *index = new BTreeIndex(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, PACKED_LEAVES);
+    index->insertBatch(entries);
+    for(int i = 0; i < 2; i++)
+        index->insertEntry(&extremeKeys[i], farRid);
+
+    checkPassFail(intScan(index,25,GT,40,LT), 14)
+    checkPassFail(intScan(index,20,GTE,35,LTE), 16)
+    checkPassFail(intScanBatch(index,-3,GT,3,LT), 3)
+    checkPassFail(intScanBatch(index,996,GT,1001,LT), 4)
+    checkPassFail(intScanBatch(index,0,GTE,relationSize,LT), relationSize)
+
+    // every key is found once, the extreme ones with their wide record id intact
+    std::vector<RecordId> rids;
+    int numMismatches = 0;
+    for(int key = 0; key < relationSize + numExtra; key += 7)
+    {
+        rids.clear();
+        if(index->lookup(&key, rids) != 1 ||
+           (key >= relationSize && rids[0] != entries[key - relationSize].rid))
+            numMismatches++;
+    }
+    for(int i = 0; i < 2; i++)
+    {
+        rids.clear();
+        if(index->lookup(&extremeKeys[i], rids) != 1 || rids[0] != farRid)
+            numMismatches++;
+    }
+    checkPassFail(numMismatches, 0)
+    RecordId scanRids[64];
+    int low = INT_MIN, high = INT_MAX, numResults = 0, n;
+    index->startScan(&low, GTE, &high, LTE);
+    while((n = index->scanNextBatch(scanRids, 64)) > 0)
+        numResults += n;
+    index->endScan();
+    checkPassFail(numResults, relationSize + numExtra + 2)
+
+    // delete every other synthetic entry and the extreme keys, so leaves shrink and merge
+    int numFailed = 0;
+    for(int i = 0; i < numExtra; i += 2)
+        if(!index->deleteEntry(&entries[i].key, entries[i].rid))
+            numFailed++;
+    for(int i = 0; i < 2; i++)
+        if(!index->deleteEntry(&extremeKeys[i], farRid))
+            numFailed++;
+    checkPassFail(numFailed, 0)
+    checkPassFail(index->deleteEntry(&entries[0].key, entries[0].rid), false)
+    numResults = 0;
+    index->startScan(&low, GTE, &high, LTE);
+    while((n = index->scanNextBatch(scanRids, 64)) > 0)
+        numResults += n;
+    index->endScan();
+    checkPassFail(numResults, relationSize + numExtra / 2)
+    checkPassFail(intScan(index,3000,GTE,3010,LTE), 11)
+
+    // index files never shrink, so both sizes are taken with every synthetic entry in place.
+    // Packed leaves must need less than half the pages of array leaves.
+    delete index;
+    std::streamoff packedFileSize = std::ifstream(intIndexName.c_str(), std::ios::binary | std::ios::ate).tellg();
+    bool compressed = packedFileSize * 2 < arrayFileSize;
+    checkPassFail(compressed, true)
+}
+
+void intTests12()
+{
+    // inserter threads take interleaved keys above the relation's, so they split the same leaves. The
+    // synthetic record ids point past the relation, so they are only counted, never read.
+    const int numInserters = 4, numReaders = 2, numPerInserter = 10000;
+    const int numExtra = numInserters * numPerInserter;
+    std::vector<RIDKeyPair<int> > entries(numExtra);
+    for(int i = 0; i < numExtra; i++)
+    {
+        RecordId fakeRid;
+        fakeRid.page_number = relationSize + i / 50;
+        fakeRid.slot_number = i % 50 + 1;
+        fakeRid.padding = 0;
+        entries[i].set(fakeRid, relationSize + i);
+    }
+
+    std::cout << "Create a B+ Tree index on the integer field" << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+    // readers scan the relation's keys, which must all be there all the time, and the growing range of
+    // the inserted ones, which must never show an entry twice or one out of range.
+    std::atomic<int> numInsertersDone(0), numReaderErrors(0), numReaderPasses(0);
+    std::vector<std::thread> threads;
+    for(int r = 0; r < numReaders; r++)
+        threads.push_back(std::thread([&, r]()
+        {
+            BTreeScanCursor cursor(&index);
+            RecordId scanRids[64];
+            std::vector<RecordId> rids;
+            int n;
+            while(numInsertersDone < numInserters)
+            {
+                int low = 0, high = relationSize, numResults = 0;
+                cursor.startScan(&low, GTE, &high, LT);
+                while((n = cursor.scanNextBatch(scanRids, 64)) > 0)
+                    numResults += n;
+                cursor.endScan();
+                if(numResults != relationSize)
+                    numReaderErrors++;
+
+                low = relationSize;
+                high = relationSize + numExtra;
+                rids.clear();
+                if(cursor.tryStartScan(&low, GTE, &high, LT))
+                {
+                    while((n = cursor.scanNextBatch(scanRids, 1 + r * 31)) > 0)
+                        rids.insert(rids.end(), scanRids, scanRids + n);
+                    cursor.endScan();
+                }
+                std::sort(rids.begin(), rids.end(), ridBefore);
+                for(size_t i = 0; i < rids.size(); i++)
+                    if((i > 0 && rids[i] == rids[i - 1]) || rids[i].page_number < (PageId)relationSize)
+                        numReaderErrors++;
+
+                int key = random() % relationSize;
+                rids.clear();
+                if(index.lookup(&key, rids) != 1)
+                    numReaderErrors++;
+                numReaderPasses++;
+            }
+        }));
+    for(int t = 0; t < numInserters; t++)
+        threads.push_back(std::thread([&, t]()
+        {
+            for(int i = t; i < numExtra; i += numInserters)
+                index.insertEntry(&entries[i].key, entries[i].rid);
+            numInsertersDone++;
+        }));
+    for(size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+    checkPassFail(numReaderErrors, 0)
+    std::cout << "Reader passes: " << numReaderPasses << std::endl;
+
+    // every insert landed exactly once
+    std::vector<RecordId> rids;
+    int numMismatches = 0;
+    for(int i = 0; i < numExtra; i++)
+    {
+        rids.clear();
+        if(index.lookup(&entries[i].key, rids) != 1 || rids[0] != entries[i].rid)
+            numMismatches++;
+    }
+    checkPassFail(numMismatches, 0)
+    checkPassFail(intScanBatch(&index,0,GTE,relationSize,LT), relationSize)
+    RecordId scanRids[64];
+    int low = relationSize, high = relationSize + numExtra, numResults = 0, n;
+    index.startScan(&low, GTE, &high, LT);
+    while((n = index.scanNextBatch(scanRids, 64)) > 0)
+        numResults += n;
+    index.endScan();
+    checkPassFail(numResults, numExtra)
+}
+
+void intTests13()
+{
+    // inserter threads add duplicates of random keys of the relation, so leaves split all over the tree while
+    // readers descend it without latching its nonleaves, scanning in both orders. Every key keeps exactly one
+    // entry whose record id lies in the relation; the synthetic ones point past it.
+    const int numInserters = 4, numReaders = 2, numPerInserter = 10000, scanWidth = 20;
+    const int numExtra = numInserters * numPerInserter;
+    std::vector<RIDKeyPair<int> > entries(numExtra);
+    std::vector<int> numCopies(relationSize, 0);
+    for(int i = 0; i < numExtra; i++)
+    {
+        RecordId fakeRid;
+        fakeRid.page_number = relationSize + i / 50;
+        fakeRid.slot_number = i % 50 + 1;
+        fakeRid.padding = 0;
+        entries[i].set(fakeRid, random() % relationSize);
+        numCopies[entries[i].key]++;
+    }
+
+    std::cout << "Create a B+ Tree index on the integer field" << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+    std::atomic<int> numInsertersDone(0), numReaderErrors(0), numReaderPasses(0);
+    std::vector<std::thread> threads;
+    for(int r = 0; r < numReaders; r++)
+        threads.push_back(std::thread([&, r]()
+        {
+            BTreeScanCursor cursor(&index);
+            RecordId scanRids[16];
+            std::vector<RecordId> rids;
+            int n;
+            while(numInsertersDone < numInserters)
+            {
+                int key = random() % relationSize, numReal = 0;
+                rids.clear();
+                index.lookup(&key, rids);
+                for(size_t i = 0; i < rids.size(); i++)
+                    numReal += rids[i].page_number < (PageId)relationSize;
+                if(numReal != 1)
+                    numReaderErrors++;
+
+                int high = key + scanWidth;
+                numReal = 0;
+                cursor.startScan(&key, GTE, &high, LT, r % 2 == 0 ? ASCENDING : DESCENDING);
+                while((n = cursor.scanNextBatch(scanRids, 16)) > 0)
+                    for(int i = 0; i < n; i++)
+                        numReal += scanRids[i].page_number < (PageId)relationSize;
+                cursor.endScan();
+                if(numReal != std::min(scanWidth, relationSize - key))
+                    numReaderErrors++;
+                numReaderPasses++;
+            }
+        }));
+    for(int t = 0; t < numInserters; t++)
+        threads.push_back(std::thread([&, t]()
+        {
+            for(int i = t; i < numExtra; i += numInserters)
+                index.insertEntry(&entries[i].key, entries[i].rid);
+            numInsertersDone++;
+        }));
+    for(size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+    checkPassFail(numReaderErrors, 0)
+    std::cout << "Reader passes: " << numReaderPasses << std::endl;
+
+    std::vector<RecordId> rids;
+    int numMismatches = 0;
+    for(int key = 0; key < relationSize; key++)
+    {
+        rids.clear();
+        if(index.lookup(&key, rids) != 1 + numCopies[key])
+            numMismatches++;
+    }
+    checkPassFail(numMismatches, 0)
+    RecordId scanRids[64];
+    int low = 0, high = relationSize, numResults = 0, n;
+    index.startScan(&low, GTE, &high, LT);
+    while((n = index.scanNextBatch(scanRids, 64)) > 0)
+        numResults += n;
+    index.endScan();
+    checkPassFail(numResults, relationSize + numExtra)
+}
+
+void intTests14()
+{
+    // synthetic duplicates of one key, enough to run over several leaves. They point past the relation,
+    // so they are only counted, never read.
+    const int numDuplicates = 5000, dupKey = 100;
+    const LeafFormat formats[3] = {ARRAY_LEAVES, POSTING_LEAVES, PACKED_LEAVES};
+    for(int f = 0; f < 3; f++)
+    {
+        std::cout << "Create a B+ Tree index on the integer field with leaf format " << formats[f] << std::endl;
+        BTreeIndex *index = new BTreeIndex(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, formats[f]);
+
+        checkPassFail(intScanDescending(index,25,GT,40,LT), 14)
+        checkPassFail(intScanDescending(index,20,GTE,35,LTE), 16)
+        checkPassFail(intScanDescending(index,-3,GT,3,LT), 3)
+        checkPassFail(intScanDescending(index,996,GT,1001,LT), 4)
+        checkPassFail(intScanDescending(index,0,GTE,relationSize,LT), relationSize)
+        checkPassFail(intScanDescending(index,relationSize,GTE,relationSize + 10,LTE), 0)
+
+        // the first entry of a descending scan holds the largest key
+        int low = 0, high = relationSize;
+        RecordId rid;
+        Page *curPage;
+        index->startScan(&low, GTE, &high, LTE, DESCENDING);
+        index->scanNext(rid);
+        index->endScan();
+        bufMgr->readPage(file1, rid.page_number, curPage);
+        RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(rid).data()));
+        bufMgr->unPinPage(file1, rid.page_number, false);
+        checkPassFail(myRec.i, relationSize - 1)
+
+        for(int i = 0; i < numDuplicates; i++)
+        {
+            RecordId fakeRid;
+            fakeRid.page_number = relationSize + i / 50;
+            fakeRid.slot_number = i % 50 + 1;
+            fakeRid.padding = 0;
+            index->insertEntry(&dupKey, fakeRid);
+        }
+
+        // a descending scan returns the entries of the ascending one in reverse, across the run of duplicates
+        std::vector<RecordId> ascending, descending;
+        RecordId scanRids[7];
+        int n;
+        index->startScan(&low, GTE, &high, LTE);
+        while((n = index->scanNextBatch(scanRids, 7)) > 0)
+            ascending.insert(ascending.end(), scanRids, scanRids + n);
+        index->endScan();
+        index->startScan(&low, GTE, &high, LTE, DESCENDING);
+        while((n = index->scanNextBatch(scanRids, 7)) > 0)
+            descending.insert(descending.end(), scanRids, scanRids + n);
+        index->endScan();
+        std::reverse(descending.begin(), descending.end());
+        checkPassFail((int)descending.size(), relationSize + numDuplicates)
+        bool reversed = descending == ascending;
+        checkPassFail(reversed, true)
+
+        int numResults = 0;
+        index->startScan(&dupKey, GTE, &dupKey, LTE, DESCENDING);
+        while((n = index->scanNextBatch(scanRids, 7)) > 0)
+            numResults += n;
+        index->endScan();
+        checkPassFail(numResults, numDuplicates + 1)
+
+        delete index;
+        File::remove(intIndexName);
+    }
+}
+
+void intTests15()
+{
+    std::cout << "Create a B+ Tree index on the integer field" << std::endl;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+    // an IN list, every key of which is found once and in order
+    const int inKeys[] = {-5, 0, 3, 17, 18, 500, 501, 2999, 4999, 5000};
+    const int numInKeys = sizeof(inKeys) / sizeof(inKeys[0]);
+    std::vector<ScanRange<int> > ranges(numInKeys);
+    for(int i = 0; i < numInKeys; i++)
+        ranges[i].set(inKeys[i], GTE, inKeys[i], LTE);
+    std::vector<RecordId> rids;
+    checkPassFail(index.scanRanges(ranges, rids), 8)
+    int numMismatches = 0;
+    for(size_t i = 0; i < rids.size(); i++)
+    {
+        Page *curPage;
+        bufMgr->readPage(file1, rids[i].page_number, curPage);
+        RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(rids[i]).data()));
+        bufMgr->unPinPage(file1, rids[i].page_number, false);
+        if(myRec.i != inKeys[i + 1])
+            numMismatches++;
+    }
+    checkPassFail(numMismatches, 0)
+
+    // ranges that share an end point, one leaf apart and far apart return what separate scans do
+    ranges.resize(5);
+    ranges[0].set(25, GT, 40, LT);
+    ranges[1].set(40, GTE, 40, LTE);
+    ranges[2].set(40, GT, 60, LTE);
+    ranges[3].set(900, GTE, 1700, LT);
+    ranges[4].set(4990, GT, 6000, LTE);
+    std::vector<RecordId> scanned;
+    RecordId scanRids[64];
+    int n;
+    for(size_t r = 0; r < ranges.size(); r++)
+    {
+        index.startScan(&ranges[r].low, ranges[r].lowOp, &ranges[r].high, ranges[r].highOp);
+        while((n = index.scanNextBatch(scanRids, 64)) > 0)
+            scanned.insert(scanned.end(), scanRids, scanRids + n);
+        index.endScan();
+    }
+    rids.clear();
+    checkPassFail(index.scanRanges(ranges, rids), 14 + 1 + 20 + 800 + 9)
+    bool sameEntries = rids == scanned;
+    checkPassFail(sameEntries, true)
+
+    // a run of duplicates over several leaves, split between two ranges by the operators
+    const int numDuplicates = 3000, dupKey = 1000;
+    for(int i = 0; i < numDuplicates; i++)
+    {
+        RecordId fakeRid;
+        fakeRid.page_number = relationSize + i / 50;
+        fakeRid.slot_number = i % 50 + 1;
+        fakeRid.padding = 0;
+        index.insertEntry(&dupKey, fakeRid);
+    }
+    ranges.resize(3);
+    ranges[0].set(990, GT, dupKey, LT);
+    ranges[1].set(dupKey, GTE, dupKey, LTE);
+    ranges[2].set(dupKey, GT, 1010, LT);
+    rids.clear();
+    checkPassFail(index.scanRanges(ranges, rids), 9 + numDuplicates + 1 + 9)
+}
+
+void intTests16()
+{
+    const int numDuplicates = 3000, dupKey = 1000;
+    const LeafFormat formats[3] = {ARRAY_LEAVES, POSTING_LEAVES, PACKED_LEAVES};
+    for(int f = 0; f < 3; f++)
+    {
+        std::cout << "Create a B+ Tree index on the integer field with leaf format " << formats[f] << std::endl;
+        BTreeIndex *index = new BTreeIndex(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, formats[f],
+            std::vector<PayloadColumn>(), 0, true);
+
+        int low = 25, high = 40;
+        checkPassFail(index->countRange(&low, GT, &high, LT), 14)
+        low = 20; high = 35;
+        checkPassFail(index->countRange(&low, GTE, &high, LTE), 16)
+        low = -3; high = 3;
+        checkPassFail(index->countRange(&low, GT, &high, LT), 3)
+        low = 996; high = 1001;
+        checkPassFail(index->countRange(&low, GT, &high, LT), 4)
+        low = 0; high = relationSize;
+        checkPassFail(index->countRange(&low, GTE, &high, LT), relationSize)
+        low = relationSize; high = relationSize + 10;
+        checkPassFail(index->countRange(&low, GTE, &high, LTE), 0)
+
+        // key k is at position k, and the entry at position k holds key k
+        int numMismatches = 0;
+        for(int key = -1; key <= relationSize; key += 7)
+        {
+            RIDKeyPair<int> entry;
+            bool found = index->select(key, entry);
+            if(index->rank(&key) != std::min(std::max(key, 0), relationSize)
+                || found != (key >= 0 && key < relationSize) || (found && entry.key != key))
+                numMismatches++;
+        }
+        checkPassFail(numMismatches, 0)
+
+        // a run of duplicates over several leaves is counted whole and shifts the ranks after it
+        for(int i = 0; i < numDuplicates; i++)
+        {
+            RecordId fakeRid;
+            fakeRid.page_number = relationSize + i / 50;
+            fakeRid.slot_number = i % 50 + 1;
+            fakeRid.padding = 0;
+            index->insertEntry(&dupKey, fakeRid);
+        }
+        checkPassFail(index->countRange(&dupKey, GTE, &dupKey, LTE), numDuplicates + 1)
+        low = 990; high = 1010;
+        checkPassFail(index->countRange(&low, GT, &dupKey, LT), 9)
+        checkPassFail(index->countRange(&dupKey, GT, &high, LT), 9)
+        checkPassFail(index->rank(&high), high + numDuplicates)
+        RIDKeyPair<int> entry;
+        index->select(dupKey + numDuplicates, entry);
+        checkPassFail(entry.key, dupKey)
+        index->select(dupKey + numDuplicates + 1, entry);
+        checkPassFail(entry.key, dupKey + 1)
+
+        // after deletes that merge and refill leaves, counts still match scans
+        for(int key = 0; key < relationSize; key += 3)
+        {
+            std::vector<RecordId> rids;
+            if(key != dupKey && index->lookup(&key, rids) == 1)
+                index->deleteEntry(&key, rids[0]);
+        }
+        numMismatches = 0;
+        RecordId scanRids[64];
+        int n;
+        for(low = -10; low < relationSize; low += 397)
+        {
+            high = low + 1234;
+            int numScanned = 0;
+            if(index->tryStartScan(&low, GTE, &high, LT))
+            {
+                while((n = index->scanNextBatch(scanRids, 64)) > 0)
+                    numScanned += n;
+                index->endScan();
+            }
+            if(index->countRange(&low, GTE, &high, LT) != numScanned)
+                numMismatches++;
+        }
+        checkPassFail(numMismatches, 0)
+
+        delete index;
+        File::remove(intIndexName);
+    }
+}
+
+/**
+ * Number of entries of the scan of a covering index over the integer field, with the double field and the first
+ * twelve bytes of the string field as payload, whose payload differs from the fields of their record. Records
+ * past the relation are the ones intTests17() inserts, with i * 2 as double field and "cover %05d" as string field.
+ */
+int coveringMismatches(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp, ScanOrder order, int &numResults)
+{
+    const int batchSize = 64, payloadLength = sizeof(double) + 12;
+    RecordId scanRids[batchSize];
+    char payloads[batchSize * payloadLength];
+    Page *curPage;
+    int numMismatches = 0, n;
+    numResults = 0;
+    if(!index->tryStartScan(&lowVal, lowOp, &highVal, highOp, order))
+        return 0;
+    while((n = index->scanNextBatch(scanRids, payloads, batchSize)) > 0)
+    {
+        for(int j = 0; j < n; j++)
+        {
+            RECORD myRec;
+            if(scanRids[j].page_number < relationSize)
+            {
+                bufMgr->readPage(file1, scanRids[j].page_number, curPage);
+                myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRids[j]).data()));
+                bufMgr->unPinPage(file1, scanRids[j].page_number, false);
+            }
+            else
+            {
+                myRec.i = scanRids[j].slot_number - 1 + relationSize + (scanRids[j].page_number - relationSize) * 50;
+                myRec.d = myRec.i * 2.0;
+                sprintf(myRec.s, "cover %05d", myRec.i);
+            }
+            const char *payload = payloads + j * payloadLength;
+            if(memcmp(payload, &myRec.d, sizeof(double)) != 0 || memcmp(payload + sizeof(double), myRec.s, 12) != 0)
+                numMismatches++;
+        }
+        numResults += n;
+    }
+    index->endScan();
+    return numMismatches;
+}
+
+void intTests17()
+{
+    const int numInserted = 2000;
+    std::vector<PayloadColumn> columns(2);
+    columns[0].offset = offsetof(tuple,d);
+    columns[0].length = sizeof(double);
+    columns[1].offset = offsetof(tuple,s);
+    columns[1].length = 12;
+    std::cout << "Create a covering B+ Tree index on the integer field" << std::endl;
+    BTreeIndex *index = new BTreeIndex(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, ARRAY_LEAVES, columns,
+        0, true);
+
+    // scans in both orders return the payload of every entry, and the index answers like one without payload
+    int numResults;
+    checkPassFail(coveringMismatches(index, 25, GT, 40, LT, ASCENDING, numResults), 0)
+    checkPassFail(numResults, 14)
+    checkPassFail(coveringMismatches(index, 20, GTE, 35, LTE, DESCENDING, numResults), 0)
+    checkPassFail(numResults, 16)
+    checkPassFail(coveringMismatches(index, -3, GT, relationSize, LT, ASCENDING, numResults), 0)
+    checkPassFail(numResults, relationSize)
+    checkPassFail(intScan(index,996,GT,1001,LT), 4)
+    int low = 100, high = 300;
+    checkPassFail(index->countRange(&low, GTE, &high, LTE), 201)
+
+    // inserts of whole records split the leaves and keep their payloads, entries without one are refused
+    for(int i = 0; i < numInserted; i++)
+    {
+        RECORD myRec;
+        memset(&myRec, 0, sizeof(myRec));
+        myRec.i = relationSize + i;
+        myRec.d = myRec.i * 2.0;
+        sprintf(myRec.s, "cover %05d", myRec.i);
+        RecordId fakeRid;
+        fakeRid.page_number = relationSize + i / 50;
+        fakeRid.slot_number = i % 50 + 1;
+        fakeRid.padding = 0;
+        index->insertRecord(reinterpret_cast<const char*>(&myRec), fakeRid);
+    }
+    checkPassFail(coveringMismatches(index, 0, GTE, relationSize + numInserted, LT, DESCENDING, numResults), 0)
+    checkPassFail(numResults, relationSize + numInserted)
+    bool refused = false;
+    try
+    {
+        RecordId fakeRid;
+        fakeRid.page_number = relationSize + numInserted;
+        fakeRid.slot_number = 1;
+        fakeRid.padding = 0;
+        index->insertEntry(&high, fakeRid);
+    }
+    catch(const BadIndexInfoException &e)
+    {
+        refused = true;
+    }
+    checkPassFail(refused, true)
+
+    // deletes that merge and refill leaves move payloads with their entries
+    int numDeleted = 0;
+    for(int key = 0; key < relationSize + numInserted; key += 3)
+    {
+        std::vector<RecordId> rids;
+        if(index->lookup(&key, rids) == 1 && index->deleteEntry(&key, rids[0]))
+            numDeleted++;
+    }
+    checkPassFail(coveringMismatches(index, 0, GTE, relationSize + numInserted, LT, ASCENDING, numResults), 0)
+    checkPassFail(numResults, relationSize + numInserted - numDeleted)
+
+    // a reopened index keeps its payload columns, and adds the payloads of the relation's records again
+    delete index;
+    index = new BTreeIndex(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    checkPassFail(coveringMismatches(index, 0, GTE, relationSize + numInserted, LT, ASCENDING, numResults), 0)
+    checkPassFail(numResults, 2 * relationSize + numInserted - numDeleted)
+
+    delete index;
+    File::remove(intIndexName);
+}
+
+void intTests18()
+{
+    // inserted entries have integer fields -15 to 14 and double fields from -10 in steps of 0.5
+    const int numInserted = 3000;
+    std::vector<KeyColumn> columns(2);
+    columns[0].offset = offsetof(tuple,i);
+    columns[0].type = INTEGER;
+    columns[1].offset = offsetof(tuple,d);
+    columns[1].type = DOUBLE;
+    std::cout << "Create a B+ Tree index on the integer and double fields" << std::endl;
+    BTreeIndex *index = new BTreeIndex(relationName, intIndexName, bufMgr, columns, ARRAY_LEAVES,
+        std::vector<PayloadColumn>(), 0, true);
+
+    // keys order by the integer field, then by the double field
+    RECORD key;
+    memset(&key, 0, sizeof(key));
+    key.i = 42;
+    key.d = 42;
+    std::vector<RecordId> rids;
+    checkPassFail(index->lookup(&key, rids), 1)
+    key.d = 43;
+    checkPassFail(index->lookup(&key, rids), 0)
+    checkPassFail(compositeScan(index, 100, 0, GTE, 200, 0, LT), 100)
+    checkPassFail(compositeScan(index, 100, 100, GT, 200, 200, LTE), 100)
+    checkPassFail(compositeSkipScan(index, 10, GTE, 20, LTE), 11)
+
+    for(int k = 0; k < numInserted; k++)
+    {
+        key.i = k % 30 - 15;
+        key.d = (k / 30) * 0.5 - 10;
+        RecordId fakeRid;
+        fakeRid.page_number = relationSize + k / 50;
+        fakeRid.slot_number = k % 50 + 1;
+        fakeRid.padding = 0;
+        index->insertEntry(&key, fakeRid);
+    }
+    // negative fields order before positive ones, and the skip-scan finds the double field under every integer one
+    checkPassFail(compositeScan(index, -15, -10, GTE, -1, 100, LTE), 15 * 100)
+    checkPassFail(compositeScan(index, -3, 0, GT, 0, 0, LT), 79 + 2 * 100 + 20)
+    checkPassFail(compositeSkipScan(index, -2, GTE, 3, LT), 30 * 10 + 3)
+    checkPassFail(compositeSkipScan(index, -10, GT, -9.5, LTE), 30)
+    checkPassFail(compositeSkipScan(index, 4998, GTE, 5000, LTE), 2)
+
+    // deleting every other inserted entry removes those under every other integer field
+    int numDeleted = 0;
+    for(int k = 0; k < numInserted; k += 2)
+    {
+        key.i = k % 30 - 15;
+        key.d = (k / 30) * 0.5 - 10;
+        RecordId fakeRid;
+        fakeRid.page_number = relationSize + k / 50;
+        fakeRid.slot_number = k % 50 + 1;
+        fakeRid.padding = 0;
+        if(index->deleteEntry(&key, fakeRid))
+            numDeleted++;
+    }
+    checkPassFail(numDeleted, numInserted / 2)
+    checkPassFail(compositeSkipScan(index, -2, GTE, 3, LT), 15 * 10 + 3)
+
+    // a reopened index keeps its key attributes, and adds the relation's records again
+    delete index;
+    index = new BTreeIndex(relationName, intIndexName, bufMgr, columns);
+    checkPassFail(compositeSkipScan(index, -2, GTE, 3, LT), 15 * 10 + 2 * 3)
+    checkPassFail(compositeScan(index, -15, -10, GTE, relationSize, 0, LT), 2 * relationSize + numInserted - numDeleted)
+
+    delete index;
+    File::remove(intIndexName);
+}
+
+void intTests19()
+{
+    const int numInserted = 2000;
+    const int numProbes = 100000;
+    std::cout << "Create a B+ Tree index with a Bloom filter on the integer field" << std::endl;
+    BTreeIndex *index = new BTreeIndex(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, ARRAY_LEAVES,
+        std::vector<PayloadColumn>(), 10, true);
+
+    // every key in the index passes the filter, about one in a hundred absent ones does
+    std::vector<RecordId> rids;
+    int numFound = 0;
+    for(int key = 0; key < relationSize; key++)
+        numFound += index->lookup(&key, rids);
+    checkPassFail(numFound, relationSize)
+    int numPassed = 0;
+    for(int key = relationSize; key < relationSize + numProbes; key++)
+        if(index->mayContain(&key))
+            numPassed++;
+    std::cout << "Absent keys passing the filter: " << numPassed << " of " << numProbes << std::endl;
+    checkPassFail((numPassed < numProbes / 50), true)
+    numFound = 0;
+    for(int key = -numProbes; key < 0; key++)
+        numFound += index->lookup(&key, rids);
+    checkPassFail(numFound, 0)
+
+    // inserted keys are added to the filter, and batched lookups drop the keys it rules out
+    for(int i = 0; i < numInserted; i++)
+    {
+        int key = relationSize + i;
+        RecordId fakeRid;
+        fakeRid.page_number = relationSize + i / 50;
+        fakeRid.slot_number = i % 50 + 1;
+        fakeRid.padding = 0;
+        index->insertEntry(&key, fakeRid);
+    }
+    std::vector<int> keys;
+    for(int key = 0; key < 2 * (relationSize + numInserted); key += 7)
+        keys.push_back(key);
+    std::vector<RIDKeyPair<int> > entries;
+    checkPassFail(index->lookupBatch(keys, entries), (relationSize + numInserted + 6) / 7)
+    int low = relationSize - 5, high = relationSize + 5;
+    checkPassFail(index->countRange(&low, GT, &high, LT), 9)
+
+    // a reopened index keeps its filter, and adds the relation's records to it again
+    delete index;
+    index = new BTreeIndex(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    numFound = 0;
+    for(int key = 0; key < relationSize + numInserted; key++)
+        numFound += index->lookup(&key, rids);
+    checkPassFail(numFound, 2 * relationSize + numInserted)
+    numPassed = 0;
+    for(int key = relationSize + numInserted; key < relationSize + numInserted + numProbes; key++)
+        if(index->mayContain(&key))
+            numPassed++;
+    checkPassFail((numPassed < numProbes / 50), true)
+    delete index;
+
+    // equal doubles hash the same, -0.0 included
+    std::cout << "Create a B+ Tree index with a Bloom filter on the double field" << std::endl;
+    index = new BTreeIndex(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE, ARRAY_LEAVES,
+        std::vector<PayloadColumn>(), 10);
+    double zero = -0.0, half = 0.5;
+    checkPassFail(index->lookup(&zero, rids), 1)
+    checkPassFail(index->lookup(&half, rids), 0)
+    checkPassFail(doubleScan(index,25,GT,40,LT), 14)
+    delete index;
+    File::remove(doubleIndexName);
+    File::remove(intIndexName);
+}
+
+void intTests20()
+{
+    const int capacity = 500;
+    const int numInserted = 2000;
+    std::cout << "Create a B+ Tree index on the integer field and buffer inserts into it" << std::endl;
+    BTreeIndex *index = new BTreeIndex(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, ARRAY_LEAVES,
+        std::vector<PayloadColumn>(), 0, true);
+    index->setInsertBuffer(capacity);
+
+    // keys relationSize to relationSize + numInserted in scattered order, but for those that are multiples of
+    // five, and a duplicate of every fifth key of the relation instead. The buffer is flushed each time it fills.
+    std::vector<RecordId> rids;
+    for(int i = 0; i < numInserted; i++)
+    {
+        int key = i % 5 == 0 ? i : relationSize + (i * 7919) % numInserted;
+        RecordId fakeRid;
+        fakeRid.page_number = relationSize + i / 50;
+        fakeRid.slot_number = i % 50 + 1;
+        fakeRid.padding = 0;
+        index->insertEntry(&key, fakeRid);
+    }
+    checkPassFail(index->numBufferedInserts(), numInserted % capacity)
+
+    // lookups merge the entries still in the buffer with those in the leaves
+    int numFound = 0;
+    for(int key = 0; key < relationSize + numInserted; key++)
+        numFound += index->lookup(&key, rids);
+    checkPassFail(numFound, relationSize + numInserted)
+    int key = 1995;
+    rids.clear();
+    checkPassFail(index->lookup(&key, rids), 2)
+    checkPassFail(index->numBufferedInserts(), numInserted % capacity)
+
+    // range counts see the buffered entries, which are merged into the tree first, and scans merge them
+    int low = relationSize - 10, high = relationSize + 10;
+    checkPassFail(index->countRange(&low, GT, &high, LT), 9 + 8)
+    checkPassFail(index->numBufferedInserts(), 0)
+    for(key = relationSize + numInserted; key < relationSize + numInserted + 10; key++)
+    {
+        RecordId fakeRid;
+        fakeRid.page_number = relationSize + numInserted;
+        fakeRid.slot_number = key - relationSize - numInserted + 1;
+        fakeRid.padding = 0;
+        index->insertEntry(&key, fakeRid);
+    }
+    int numScanned = 0;
+    low = relationSize + numInserted - 5;
+    high = relationSize + numInserted + 20;
+    if(index->tryStartScan(&low, GTE, &high, LTE))
+    {
+        RecordId scanRid;
+        while(index->tryScanNext(scanRid))
+            numScanned++;
+        index->endScan();
+    }
+    checkPassFail(numScanned, 4 + 10)
+    checkPassFail(index->numBufferedInserts(), 10)
+
+    // deleting a buffered entry flushes it into its leaf first
+    key = relationSize + numInserted;
+    RecordId fakeRid;
+    fakeRid.page_number = relationSize + numInserted;
+    fakeRid.slot_number = 1;
+    fakeRid.padding = 0;
+    index->insertEntry(&key, fakeRid);
+    checkPassFail(index->deleteEntry(&key, fakeRid), true)
+    checkPassFail(index->deleteEntry(&key, fakeRid), true)
+    checkPassFail(index->deleteEntry(&key, fakeRid), false)
+
+    // entries still buffered when the index is closed are applied to it. The reopened index inserts the
+    // relation's records again.
+    for(int i = 0; i < 10; i++)
+    {
+        key = -1 - i;
+        index->insertEntry(&key, fakeRid);
+    }
+    checkPassFail(index->numBufferedInserts(), 10)
+    delete index;
+    index = new BTreeIndex(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    checkPassFail(index->numBufferedInserts(), 0)
+    low = -100;
+    high = -1;
+    checkPassFail(index->countRange(&low, GTE, &high, LTE), 10)
+    low = 25;
+    high = 40;
+    checkPassFail(index->countRange(&low, GT, &high, LT), 2 * 14 + 2)
+    delete index;
+    File::remove(intIndexName);
+}
+
+void intTests21()
+{
+    const int base = 2 * relationSize;
+    const int numKeys = 1000;
+    std::cout << "Create a B+ Tree index on the integer field with entries in the leaves and in the insert buffer" << std::endl;
+    BTreeIndex *index = new BTreeIndex(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, ARRAY_LEAVES,
+        std::vector<PayloadColumn>(), 0, true);
+
+    // even keys go into the leaves, odd ones and a duplicate of every tenth even one into the buffer. The page
+    // number of an entry is its key and the slot number 1 in the leaves, 2 in the buffer, so scans can check order.
+    RecordId fakeRid;
+    fakeRid.padding = 0;
+    for(int i = 0; i < numKeys; i++)
+    {
+        int key = base + 2 * i;
+        fakeRid.page_number = key;
+        fakeRid.slot_number = 1;
+        index->insertEntry(&key, fakeRid);
+    }
+    index->setInsertBuffer(10 * numKeys);
+    for(int i = 0; i < numKeys; i++)
+    {
+        int key = i % 10 == 0 ? base + 2 * i : base + 2 * i + 1;
+        fakeRid.page_number = key;
+        fakeRid.slot_number = 2;
+        index->insertEntry(&key, fakeRid);
+        if(i % 10 == 0)
+        {
+            key++;
+            fakeRid.page_number = key;
+            index->insertEntry(&key, fakeRid);
+        }
+    }
+    checkPassFail(index->numBufferedInserts(), numKeys + numKeys / 10)
+
+    // scans return the entries of both in key order
+    const int numEntries = 2 * numKeys + numKeys / 10;
+    checkPassFail(deltaScan(index, base, base + 2 * numKeys, ASCENDING, false), numEntries)
+    checkPassFail(deltaScan(index, base, base + 2 * numKeys, DESCENDING, false), numEntries)
+    checkPassFail(deltaScan(index, base + 11, base + 31, ASCENDING, false), 20 + 1)
+    checkPassFail(deltaScan(index, base + 11, base + 31, DESCENDING, false), 20 + 1)
+    checkPassFail(deltaScan(index, base - 10, base, ASCENDING, false), 0)
+    checkPassFail(index->numBufferedInserts(), numKeys + numKeys / 10)
+
+    // a merge in the middle of a scan neither repeats nor loses entries
+    checkPassFail(deltaScan(index, base, base + 2 * numKeys, ASCENDING, true), numEntries)
+    checkPassFail(index->numBufferedInserts(), 0)
+    checkPassFail(deltaScan(index, base, base + 2 * numKeys, DESCENDING, false), numEntries)
+    for(int i = 0; i < numKeys; i++)
+    {
+        int key = base + 2 * i + 1;
+        fakeRid.page_number = key;
+        fakeRid.slot_number = 3;
+        index->insertEntry(&key, fakeRid);
+    }
+    checkPassFail(deltaScan(index, base, base + 2 * numKeys, DESCENDING, true), numEntries + numKeys)
+    checkPassFail(index->numBufferedInserts(), 0)
+
+    // a thread of the index merges while other threads insert and scan
+    const int numInserters = 4;
+    const int numReaders = 2;
+    const int numExtra = 8000;
+    index->setInsertBuffer(300, true);
+    std::atomic<int> numInsertersDone(0), numReaderErrors(0);
+    std::vector<std::thread> threads;
+    for(int r = 0; r < numReaders; r++)
+        threads.push_back(std::thread([&, r]()
+        {
+            BTreeScanCursor cursor(index);
+            RecordId scanRids[64];
+            std::vector<RecordId> rids;
+            int n;
+            while(numInsertersDone < numInserters)
+            {
+                int low = 3 * relationSize, high = 3 * relationSize + numExtra;
+                rids.clear();
+                if(cursor.tryStartScan(&low, GTE, &high, LT, r == 0 ? ASCENDING : DESCENDING))
+                {
+                    while((n = cursor.scanNextBatch(scanRids, 1 + r * 31)) > 0)
+                        rids.insert(rids.end(), scanRids, scanRids + n);
+                    cursor.endScan();
+                }
+                for(size_t i = 1; i < rids.size(); i++)
+                    if(r == 0 ? rids[i].page_number <= rids[i - 1].page_number : rids[i].page_number >= rids[i - 1].page_number)
+                        numReaderErrors++;
+                int key = random() % relationSize;
+                rids.clear();
+                if(index->lookup(&key, rids) != 1)
+                    numReaderErrors++;
+            }
+        }));
+    for(int t = 0; t < numInserters; t++)
+        threads.push_back(std::thread([&, t]()
+        {
+            RecordId rid;
+            rid.slot_number = 1;
+            rid.padding = 0;
+            for(int key = 3 * relationSize + t; key < 3 * relationSize + numExtra; key += numInserters)
+            {
+                rid.page_number = key;
+                index->insertEntry(&key, rid);
+            }
+            numInsertersDone++;
+        }));
+    for(size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+    checkPassFail(numReaderErrors, 0)
+    int low = 3 * relationSize, high = 3 * relationSize + numExtra;
+    checkPassFail(deltaScan(index, low, high, ASCENDING, false), numExtra)
+    index->setInsertBuffer(0);
+    checkPassFail(index->numBufferedInserts(), 0)
+    checkPassFail(index->countRange(&low, GTE, &high, LT), numExtra)
+    checkPassFail(intScan(index,25,GT,40,LT), 14)
+    delete index;
+    File::remove(intIndexName);
+}
+
+void intTests22()
+{
+    std::cout << "Create a B+ Tree index on the integer field with cubes, clusters and the extreme int keys added" << std::endl;
+    BTreeIndex *index = new BTreeIndex(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, ARRAY_LEAVES,
+        std::vector<PayloadColumn>(), 0, true);
+    std::vector<int> keys;
+    for(int i = 0; i < relationSize; i++)
+        keys.push_back(i);
+    // cubes crowd around 0 and spread out to the ends of the int range, a cluster of duplicates and a run of
+    // consecutive keys sit between two of them.
+    for(int i = -1290; i <= 1290; i++)
+        keys.push_back(i * i * i);
+    for(int i = 0; i < 300; i++)
+        keys.push_back(1000000000);
+    for(int i = 0; i < 300; i++)
+        keys.push_back(1000000001 + i);
+    keys.push_back(INT_MIN);
+    keys.push_back(INT_MAX);
+    keys.push_back(INT_MAX);
+    RecordId fakeRid;
+    fakeRid.page_number = 1;
+    fakeRid.slot_number = 1;
+    fakeRid.padding = 0;
+    for(size_t i = relationSize; i < keys.size(); i++)
+        index->insertEntry(&keys[i], fakeRid);
+    std::sort(keys.begin(), keys.end());
+
+    // every key is found as often as it was inserted, and keys between them not at all
+    std::vector<RecordId> rids;
+    int numWrong = 0;
+    for(int i = -1290; i <= 1290; i++)
+    {
+        int probes[3] = {i * i * i, i * i * i + 1, i * i * i - 1};
+        for(int p = 0; p < 3; p++)
+        {
+            rids.clear();
+            int expected = std::upper_bound(keys.begin(), keys.end(), probes[p]) - std::lower_bound(keys.begin(), keys.end(), probes[p]);
+            if(index->lookup(&probes[p], rids) != expected)
+                numWrong++;
+        }
+    }
+    checkPassFail(numWrong, 0)
+    // 1000000000 is a cube too
+    int probe = 1000000000;
+    rids.clear();
+    checkPassFail(index->lookup(&probe, rids), 300 + 1)
+    probe = INT_MAX;
+    rids.clear();
+    checkPassFail(index->lookup(&probe, rids), 2)
+    probe = INT_MIN;
+    rids.clear();
+    checkPassFail(index->lookup(&probe, rids), 1)
+    probe = INT_MIN + 1;
+    rids.clear();
+    checkPassFail(index->lookup(&probe, rids), 0)
+
+    // range counts descend through the nonleaves on both bounds
+    int lows[5] = {INT_MIN, -1000, 0, 999999999, 1000000150};
+    int highs[5] = {INT_MAX, 1000, 5000, 1000000000, INT_MAX};
+    for(int r = 0; r < 5; r++)
+    {
+        int expected = std::upper_bound(keys.begin(), keys.end(), highs[r]) - std::lower_bound(keys.begin(), keys.end(), lows[r]);
+        checkPassFail(index->countRange(&lows[r], GTE, &highs[r], LTE), expected)
+    }
+    // and so is 27
+    checkPassFail(intScan(index,25,GT,40,LT), 14 + 1)
+    delete index;
+    File::remove(intIndexName);
+}
+
+void intTests23()
+{
+    const int numExtra = 400000;
+    std::cout << "Create a B+ Tree index on the integer field and search Eytzinger copies of its nonleaves" << std::endl;
+    BTreeIndex *index = new BTreeIndex(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    index->setEytzingerSearch(4);
+    checkPassFail(intScan(index,25,GT,40,LT), 14)
+
+    // only nonleaves that interpolation mispredicts are copied, so the keys grow quadratically. Random inserts
+    // split leaves and nonleaves, whose copies are made again on the next descent through them
+    auto skewedKey = [](int i) { return relationSize + i + (int)((long long)i * i / 4096); };
+    std::vector<int> keys(numExtra);
+    for(int i = 0; i < numExtra; i++)
+        keys[i] = skewedKey(i);
+    std::random_shuffle(keys.begin(), keys.end());
+    // the page number of every entry is its key, so scans can check order
+    RecordId fakeRid;
+    fakeRid.slot_number = 1;
+    fakeRid.padding = 0;
+    for(int i = 0; i < numExtra; i++)
+    {
+        fakeRid.page_number = keys[i];
+        index->insertEntry(&keys[i], fakeRid);
+    }
+    std::vector<RecordId> rids;
+    int numMissing = 0;
+    for(int i = 0; i < relationSize + numExtra; i += 7)
+    {
+        int key = i < relationSize ? i : skewedKey(i - relationSize);
+        rids.clear();
+        if(index->lookup(&key, rids) != 1)
+            numMissing++;
+    }
+    checkPassFail(numMissing, 0)
+    int low = skewedKey(numExtra / 3), high = skewedKey(numExtra / 2);
+    checkPassFail(deltaScan(index, low, high, ASCENDING, false), numExtra / 2 - numExtra / 3)
+    checkPassFail(deltaScan(index, low, high, DESCENDING, false), numExtra / 2 - numExtra / 3)
+
+    // threads insert and look up keys while other threads rebuild the copies they search
+    const int numThreads = 4;
+    const int numPerThread = 20000;
+    std::atomic<int> numWrong(0);
+    std::vector<std::thread> threads;
+    for(int t = 0; t < numThreads; t++)
+        threads.push_back(std::thread([&, t]()
+        {
+            RecordId rid;
+            rid.slot_number = 2;
+            rid.padding = 0;
+            std::vector<RecordId> found;
+            for(int i = 0; i < numPerThread; i++)
+            {
+                int key = skewedKey(numExtra) + t + i * numThreads;
+                rid.page_number = key;
+                index->insertEntry(&key, rid);
+                key = skewedKey((i * 7919 + t) % numExtra);
+                found.clear();
+                if(index->lookup(&key, found) != 1)
+                    numWrong++;
+            }
+        }));
+    for(int t = 0; t < numThreads; t++)
+        threads[t].join();
+    checkPassFail(numWrong, 0)
+    low = skewedKey(numExtra);
+    high = low + numThreads * numPerThread;
+    checkPassFail(deltaScan(index, low, high, ASCENDING, false), numThreads * numPerThread)
+
+    // the nodes themselves give the same answers
+    index->setEytzingerSearch(0);
+    checkPassFail(deltaScan(index, low, high, DESCENDING, false), numThreads * numPerThread)
+    checkPassFail(intScan(index,25,GT,40,LT), 14)
+    delete index;
+    File::remove(intIndexName);
+}
+
+void intTests24()
+{
+    const int numExtra = 600000;
+    std::cout << "Create a B+ Tree index on the integer field and keep its upper levels pinned" << std::endl;
+    BTreeIndex *index = new BTreeIndex(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    // the relation fits under a single nonleaf
+    index->setPinnedLevels(1);
+    checkPassFail(index->numPinnedPages(), 1)
+    checkPassFail(intScan(index,25,GT,40,LT), 14)
+
+    // random inserts in several threads split the root and the nonleaves below it, in different subtrees at
+    // once. Only the new root is pinned, the old one moves below the pinned level and is unpinned
+    const int numInserters = 4;
+    std::vector<int> keys(numExtra);
+    for(int i = 0; i < numExtra; i++)
+        keys[i] = relationSize + i;
+    std::random_shuffle(keys.begin(), keys.end());
+    // the page number of every entry is its key, so scans can check order
+    RecordId fakeRid;
+    fakeRid.slot_number = 1;
+    fakeRid.padding = 0;
+    std::vector<std::thread> inserters;
+    for(int t = 0; t < numInserters; t++)
+        inserters.push_back(std::thread([&, t]()
+        {
+            RecordId rid = fakeRid;
+            for(int i = t; i < numExtra; i += numInserters)
+            {
+                rid.page_number = keys[i];
+                index->insertEntry(&keys[i], rid);
+            }
+        }));
+    for(int t = 0; t < numInserters; t++)
+        inserters[t].join();
+    checkPassFail(index->numPinnedPages(), 1)
+    index->setPinnedLevels(8);
+    checkPassFail((index->numPinnedPages() > 1), true)
+    std::vector<RecordId> rids;
+    int numMissing = 0;
+    for(int key = 0; key < relationSize + numExtra; key += 7)
+    {
+        rids.clear();
+        if(index->lookup(&key, rids) != 1)
+            numMissing++;
+    }
+    checkPassFail(numMissing, 0)
+    int low = relationSize + numExtra / 3, high = relationSize + numExtra / 2;
+    checkPassFail(deltaScan(index, low, high, ASCENDING, false), high - low)
+    checkPassFail(deltaScan(index, low, high, DESCENDING, false), high - low)
+
+    // threads descend through the pinned nonleaves while other threads split them
+    const int numThreads = 4;
+    const int numPerThread = 20000;
+    std::atomic<int> numWrong(0);
+    std::vector<std::thread> threads;
+    for(int t = 0; t < numThreads; t++)
+        threads.push_back(std::thread([&, t]()
+        {
+            RecordId rid;
+            rid.slot_number = 2;
+            rid.padding = 0;
+            std::vector<RecordId> found;
+            for(int i = 0; i < numPerThread; i++)
+            {
+                int key = relationSize + numExtra + t + i * numThreads;
+                rid.page_number = key;
+                index->insertEntry(&key, rid);
+                key = (i * 7919 + t) % (relationSize + numExtra);
+                found.clear();
+                if(index->lookup(&key, found) != 1)
+                    numWrong++;
+            }
+        }));
+    for(int t = 0; t < numThreads; t++)
+        threads[t].join();
+    checkPassFail(numWrong, 0)
+    low = relationSize + numExtra;
+    high = low + numThreads * numPerThread;
+    checkPassFail(deltaScan(index, low, high, ASCENDING, false), numThreads * numPerThread)
+
+    // deletes shrink the tree back under a single nonleaf. The nonleaves they free are unpinned, and the
+    // collapsed root is pinned in place of the old one
+    int numFailed = 0;
+    for(int i = 0; i < numExtra; i++)
+    {
+        fakeRid.page_number = keys[i];
+        if(!index->deleteEntry(&keys[i], fakeRid))
+            numFailed++;
+    }
+    fakeRid.slot_number = 2;
+    for(int key = low; key < high; key++)
+    {
+        fakeRid.page_number = key;
+        if(!index->deleteEntry(&key, fakeRid))
+            numFailed++;
+    }
+    checkPassFail(numFailed, 0)
+    checkPassFail(index->numPinnedPages(), 1)
+    index->setPinnedLevels(1);
+    checkPassFail(index->numPinnedPages(), 1)
+    checkPassFail(intScan(index,25,GT,40,LT), 14)
+    checkPassFail(intScan(index,0,GTE,relationSize,LT), relationSize)
+    index->setPinnedLevels(0);
+    checkPassFail(index->numPinnedPages(), 0)
+    checkPassFail(intScan(index,-3,GT,3000,LT), 3000)
+    delete index;
+    File::remove(intIndexName);
+}
+
+void intTests25()
+{
+    const int numInserted = 100000;
+    const int numProbes = 100000;
+    std::cout << "Create a B+ Tree index with a Bloom filter on the integer field of an empty relation" << std::endl;
+    BTreeIndex *index = new BTreeIndex(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, ARRAY_LEAVES,
+        std::vector<PayloadColumn>(), 10);
+    int key = 0;
+    checkPassFail(index->mayContain(&key), false)
+
+    // the filter made for no entries is rebuilt larger as inserts fill the index, so it keeps ruling out absent keys
+    RecordId fakeRid;
+    fakeRid.slot_number = 1;
+    fakeRid.padding = 0;
+    for(int i = 0; i < numInserted; i++)
+    {
+        key = (i * 7919) % numInserted;
+        fakeRid.page_number = key + 1;
+        index->insertEntry(&key, fakeRid);
+    }
+    std::vector<RecordId> rids;
+    int numFound = 0;
+    for(key = 0; key < numInserted; key++)
+        numFound += index->lookup(&key, rids);
+    checkPassFail(numFound, numInserted)
+    int numPassed = 0;
+    for(key = numInserted; key < numInserted + numProbes; key++)
+        if(index->mayContain(&key))
+            numPassed++;
+    std::cout << "Absent keys passing the filter: " << numPassed << " of " << numProbes << std::endl;
+    checkPassFail((numPassed < numProbes / 50), true)
+
+    // batches and the insert buffer grow it too, and a reopened index keeps the size it grew to
+    std::vector<RIDKeyPair<int> > entries(numInserted);
+    for(int i = 0; i < numInserted; i++)
+    {
+        fakeRid.page_number = numInserted + i + 1;
+        entries[i].set(fakeRid, numInserted + i);
+    }
+    index->insertBatch(entries);
+    index->setInsertBuffer(1000);
+    for(key = 2 * numInserted; key < 3 * numInserted; key++)
+    {
+        fakeRid.page_number = key + 1;
+        index->insertEntry(&key, fakeRid);
+    }
+    delete index;
+    index = new BTreeIndex(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    numFound = 0;
+    for(key = 0; key < 3 * numInserted; key += 3)
+        numFound += index->lookup(&key, rids);
+    checkPassFail(numFound, numInserted)
+    numPassed = 0;
+    for(key = 3 * numInserted; key < 3 * numInserted + numProbes; key++)
+        if(index->mayContain(&key))
+            numPassed++;
+    std::cout << "Absent keys passing the filter: " << numPassed << " of " << numProbes << std::endl;
+    checkPassFail((numPassed < numProbes / 50), true)
+    delete index;
+    File::remove(intIndexName);
+}
+
+void intTests26()
+{
+    // more full leaves than a nonleaf with counts has children, fewer than one without counts has
+    const int numInserted = (INTARRAYCOUNTEDNONLEAFSIZE + INTARRAYNONLEAFSIZE) / 2 * (INTARRAYLEAFSIZE + 1);
+    for(int counted = 0; counted <= 1; counted++)
+    {
+        std::cout << "Create a B+ Tree index on the integer field of an empty relation"
+            << (counted ? " that counts entries" : "") << std::endl;
+        BTreeIndex *index = new BTreeIndex(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, ARRAY_LEAVES,
+            std::vector<PayloadColumn>(), 0, counted);
+
+        // appends fill the leaves, which fit under a single root only without counts. The page number of every
+        // entry is its key, so scans can check order
+        RecordId fakeRid;
+        fakeRid.slot_number = 1;
+        fakeRid.padding = 0;
+        for(int key = 0; key < numInserted; key++)
+        {
+            fakeRid.page_number = key;
+            index->insertEntry(&key, fakeRid);
+        }
+        index->setPinnedLevels(2);
+        checkPassFail(index->numPinnedPages(), (counted ? 3 : 1))
+        index->setPinnedLevels(0);
+
+        // deletes that merge and refill leaves and nonleaves leave every other entry
+        int numFailed = 0;
+        for(int key = 0; key < numInserted; key += 2)
+        {
+            fakeRid.page_number = key;
+            if(!index->deleteEntry(&key, fakeRid))
+                numFailed++;
+        }
+        checkPassFail(numFailed, 0)
+        std::vector<RecordId> rids;
+        int numFound = 0;
+        for(int key = 0; key < numInserted; key++)
+            numFound += index->lookup(&key, rids);
+        checkPassFail(numFound, numInserted / 2)
+        int low = 1000, high = 3000;
+        checkPassFail(deltaScan(index, low, high, ASCENDING, false), (high - low) / 2)
+        if(counted)
+            checkPassFail(index->countRange(&low, GTE, &high, LT), (high - low) / 2)
+        delete index;
+        File::remove(intIndexName);
+    }
+}
+
+void intTests27()
+{
+    // enough leaves for the root to split, so that the nonleaves below it get message buffers too
+    const int numInserted = 600000;
+    std::cout << "Create a B+ Tree index on the integer field and buffer inserts in its nonleaves" << std::endl;
+    BTreeIndex *index = new BTreeIndex(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    index->setNodeBuffers(true);
+
+    // keys above the relation's in scattered order. The page number of every entry is its key, so scans can check
+    // order. Full buffers are pushed down into those of the children, and those into the leaves.
+    RecordId fakeRid;
+    fakeRid.slot_number = 1;
+    fakeRid.padding = 0;
+    for(int i = 0; i < numInserted; i++)
+    {
+        int key = relationSize + (i * 7919LL) % numInserted;
+        fakeRid.page_number = key;
+        index->insertEntry(&key, fakeRid);
+    }
+    checkPassFail((index->numBufferedInserts() > 0), true)
+    index->setPinnedLevels(2);
+    checkPassFail((index->numPinnedPages() > 1), true)
+    index->setPinnedLevels(0);
+
+    // lookups and scans merge the entries buffered on the way down with those of the leaves
+    std::vector<RecordId> rids;
+    int numMissing = 0;
+    for(int key = 0; key < relationSize + numInserted; key += 7)
+    {
+        rids.clear();
+        if(index->lookup(&key, rids) != 1)
+            numMissing++;
+    }
+    checkPassFail(numMissing, 0)
+    int low = relationSize + numInserted / 3, high = low + 20000;
+    checkPassFail(deltaScan(index, low, high, ASCENDING, false), high - low)
+    checkPassFail((index->numBufferedInserts() > 0), true)
+
+    // flushing midway through a scan pushes every buffer down to the leaves
+    checkPassFail(deltaScan(index, low, high, DESCENDING, true), high - low)
+    checkPassFail(index->numBufferedInserts(), 0)
+
+    // the buffers are pages of the index file: a reopened index finds the entries left in them, and keeps buffering.
+    // It inserts the relation's records again.
+    for(int key = -2000; key < 0; key++)
+        index->insertEntry(&key, fakeRid);
+    checkPassFail((index->numBufferedInserts() > 0), true)
+    delete index;
+    index = new BTreeIndex(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    checkPassFail((index->numBufferedInserts() > 0), true)
+    int numFound = 0;
+    for(int key = -2000; key < 0; key++)
+        numFound += index->lookup(&key, rids);
+    checkPassFail(numFound, 2000)
+    int key = 25;
+    rids.clear();
+    checkPassFail(index->lookup(&key, rids), 2)
+
+    // deletes push the buffered entries down first
+    key = -1;
+    checkPassFail(index->deleteEntry(&key, fakeRid), true)
+    checkPassFail(index->numBufferedInserts(), 0)
+    checkPassFail(index->deleteEntry(&key, fakeRid), false)
+
+    // without message buffers inserts go straight to the leaves again
+    for(key = -3000; key < -2000; key++)
+        index->insertEntry(&key, fakeRid);
+    checkPassFail((index->numBufferedInserts() > 0), true)
+    index->setNodeBuffers(false);
+    checkPassFail(index->numBufferedInserts(), 0)
+    key = -2001;
+    checkPassFail(index->deleteEntry(&key, fakeRid), true)
+    key = relationSize;
+    index->insertEntry(&key, fakeRid);
+    checkPassFail(index->numBufferedInserts(), 0)
+    rids.clear();
+    checkPassFail(index->lookup(&key, rids), 2)
+    delete index;
+}
+
+/**
+ * Scan [lowVal, highVal) in the given order, in batches, and count the entries. The page number of every
+ * record id is expected to be its key, so the keys must come in order and no record id twice.
+ * @param mergeMidway		Merge the insert buffer into the tree once half of the entries were returned
+ * @return Number of entries returned, or -1 if they were out of order or repeated.
+ */
+int deltaScan(BTreeIndex *index, int lowVal, int highVal, ScanOrder order, bool mergeMidway)
+{
+    std::cout << "Scan for [" << lowVal << "," << highVal << ")" << (order == DESCENDING ? " descending" : "") << std::endl;
+    std::vector<RecordId> rids;
+    RecordId scanRids[100];
+    if(!index->tryStartScan(&lowVal, GTE, &highVal, LT, order))
+        return 0;
+    int n;
+    while((n = index->scanNextBatch(scanRids, 100)) > 0)
+    {
+        rids.insert(rids.end(), scanRids, scanRids + n);
+        if(mergeMidway && (int)rids.size() >= (highVal - lowVal) / 2 && index->numBufferedInserts() > 0)
+            index->flushInserts();
+    }
+    index->endScan();
+    for(size_t i = 1; i < rids.size(); i++)
+        if(order == ASCENDING ? rids[i].page_number < rids[i - 1].page_number : rids[i].page_number > rids[i - 1].page_number)
+            return -1;
+    int numResults = rids.size();
+    std::sort(rids.begin(), rids.end(), ridBefore);
+    for(size_t i = 1; i < rids.size(); i++)
+        if(!ridBefore(rids[i - 1], rids[i]))
+            return -1;
+    return numResults;
+}
+
+int compositeScan(BTreeIndex *index, int lowI, double lowD, Operator lowOp, int highI, double highD, Operator highOp)
+{
+    RECORD low, high;
+    memset(&low, 0, sizeof(low));
+    memset(&high, 0, sizeof(high));
+    low.i = lowI;
+    low.d = lowD;
+    high.i = highI;
+    high.d = highD;
+    std::cout << "Scan for ";
+    if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+    std::cout << "(" << lowI << "," << lowD << "),(" << highI << "," << highD << ")";
+    if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+    std::cout << std::endl;
+
+    int numResults = 0;
+    try
+    {
+        index->startScan(&low, lowOp, &high, highOp);
+        RecordId scanRid;
+        while(1)
+        {
+            index->scanNext(scanRid);
+            numResults++;
+        }
+    }
+    catch(const NoSuchKeyFoundException &e)
+    {
+        return 0;
+    }
+    catch(const IndexScanCompletedException &e)
+    {
+    }
+    index->endScan();
+    // the entry counts agree with the scan
+    if(index->countRange(&low, lowOp, &high, highOp) != numResults)
+        return -1;
+    std::cout << "Number of results: " << numResults << std::endl;
+    return numResults;
+}
+
+int compositeSkipScan(BTreeIndex *index, double lowD, Operator lowOp, double highD, Operator highOp)
+{
+    RECORD low, high;
+    memset(&low, 0, sizeof(low));
+    memset(&high, 0, sizeof(high));
+    low.d = lowD;
+    high.d = highD;
+    std::cout << "Skip-scan for ";
+    if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+    std::cout << lowD << "," << highD;
+    if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+    std::cout << std::endl;
+
+    std::vector<RecordId> rids;
+    int numResults = index->skipScan(&low, lowOp, &high, highOp, rids);
+    if(numResults != (int)rids.size())
+        return -1;
+    std::cout << "Number of results: " << numResults << std::endl;
+    return numResults;
+}
+
+int intScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
+{
+  RecordId scanRid;
+	Page *curPage;
+
+  std::cout << "Scan for ";
+  if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+  std::cout << lowVal << "," << highVal;
+  if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+  std::cout << std::endl;
+
+  int numResults = 0;
+	
+	try
+	{
+  	index->startScan(&lowVal, lowOp, &highVal, highOp);
+	}
+	catch(const NoSuchKeyFoundException &e)
+	{
+    std::cout << "No Key Found satisfying the scan criteria." << std::endl;
+		return 0;
+	}
+
+	while(1)
+	{
+		try
+		{
+			index->scanNext(scanRid);
+
+			bufMgr->readPage(file1, scanRid.page_number, curPage);
+			RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRid).data()));
+			bufMgr->unPinPage(file1, scanRid.page_number, false);
+
+			if( numResults < 5 )
+			{
+				std::cout << "at:" << scanRid.page_number << "," << scanRid.slot_number;
+				std::cout << " -->:" << myRec.i << ":" << myRec.d << ":" << myRec.s << ":" <<std::endl;
+			}
+			else if( numResults == 5 )
+			{
+				std::cout << "..." << std::endl;
+			}
+		}
+		catch(const IndexScanCompletedException &e)
+		{
+		    break;
+		}
+
+		numResults++;
+	}
+
+  if( numResults >= 5 )
+  {
+    std::cout << "Number of results: " << numResults << std::endl;
+  }
+  index->endScan();
+  std::cout << std::endl;
+	return numResults;
+}
+
+int intScan1(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
+{
+    RecordId scanRid;
+    Page *curPage;
+
+    std::cout << "Scan for ";
+    if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+    std::cout << lowVal << "," << highVal;
+    if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+    std::cout << std::endl;
+
+    int numResults = 0;
+
+    try
+    {
+        index->startScan(&lowVal, lowOp, &highVal, highOp);
+    }
+    catch(const NoSuchKeyFoundException &e)
+    {
+        std::cout << "No Key Found satisfying the scan criteria." << std::endl;
+        return 0;
+    }
+    try
+    {
+        index->scanNext(scanRid);
+    }
+    catch(const IndexScanCompletedException &e)
+    {
+        bufMgr->readPage(file1, scanRid.page_number, curPage);
+        RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRid).data()));
+        bufMgr->unPinPage(file1, scanRid.page_number, false);
+
+        if( numResults < 5 )
+        {
+            std::cout << "at:" << scanRid.page_number << "," << scanRid.slot_number;
+            std::cout << " -->:" << myRec.i << ":" << myRec.d << ":" << myRec.s << ":" <<std::endl;
+        }
+        else if( numResults == 5 )
+        {
+            std::cout << "..." << std::endl;
+        }
+    }
+
+    numResults++;
+
+    if( numResults >= 5 )
+    {
+        std::cout << "Number of results: " << numResults << std::endl;
+    }
+    index->endScan();
+    std::cout << std::endl;
+    return numResults;
+}
+int intScanBatch(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
+{
+    const int batchSize = 100;
+    RecordId scanRids[batchSize];
+    Page *curPage;
+
+    std::cout << "Batch scan for ";
+    if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+    std::cout << lowVal << "," << highVal;
+    if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+    std::cout << std::endl;
+
+    if(!index->tryStartScan(&lowVal, lowOp, &highVal, highOp))
+    {
+        std::cout << "No Key Found satisfying the scan criteria." << std::endl;
+        return 0;
+    }
+
+    int numResults = 0, numOutOfRange = 0, n;
+    while((n = index->scanNextBatch(scanRids, batchSize)) > 0)
+    {
+        // every returned record must lie inside the scan range
+        for(int i = 0; i < n; i++)
+        {
+            bufMgr->readPage(file1, scanRids[i].page_number, curPage);
+            RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRids[i]).data()));
+            bufMgr->unPinPage(file1, scanRids[i].page_number, false);
+
+            if(!((lowOp == GT ? myRec.i > lowVal : myRec.i >= lowVal) &&
+                 (highOp == LT ? myRec.i < highVal : myRec.i <= highVal)))
+                numOutOfRange++;
+        }
+        numResults += n;
+    }
+    checkPassFail(numOutOfRange, 0)
+
+    std::cout << "Number of results: " << numResults << std::endl;
+    index->endScan();
+    std::cout << std::endl;
+    return numResults;
+}
+
+int intScanDescending(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
+{
+    const int batchSize = 7;
+    RecordId scanRids[batchSize];
+    Page *curPage;
+
+    std::cout << "Descending scan for ";
+    if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+    std::cout << lowVal << "," << highVal;
+    if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+    std::cout << std::endl;
+
+    if(!index->tryStartScan(&lowVal, lowOp, &highVal, highOp, DESCENDING))
+    {
+        std::cout << "No Key Found satisfying the scan criteria." << std::endl;
+        return 0;
+    }
+
+    int numResults = 0, numOutOfRange = 0, numOutOfOrder = 0, prevKey = highVal, n;
+    while((n = index->scanNextBatch(scanRids, batchSize)) > 0)
+    {
+        // every returned record must lie inside the scan range, keys coming in descending order
+        for(int i = 0; i < n; i++)
+        {
+            bufMgr->readPage(file1, scanRids[i].page_number, curPage);
+            RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRids[i]).data()));
+            bufMgr->unPinPage(file1, scanRids[i].page_number, false);
+
+            if(!((lowOp == GT ? myRec.i > lowVal : myRec.i >= lowVal) &&
+                 (highOp == LT ? myRec.i < highVal : myRec.i <= highVal)))
+                numOutOfRange++;
+            if(myRec.i > prevKey)
+                numOutOfOrder++;
+            prevKey = myRec.i;
+        }
+        numResults += n;
+    }
+    checkPassFail(numOutOfRange, 0)
+    checkPassFail(numOutOfOrder, 0)
+
+    std::cout << "Number of results: " << numResults << std::endl;
+    index->endScan();
+    std::cout << std::endl;
+    return numResults;
+}
+
+// -----------------------------------------------------------------------------
+// doubleTests
+// -----------------------------------------------------------------------------
+
+void doubleTests()
+{
+  std::cout << "Create a B+ Tree index on the double field" << std::endl;
+  BTreeIndex index(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE);
+
+	// run some tests
+	checkPassFail(doubleScan(&index,25,GT,40,LT), 14)
+	checkPassFail(doubleScan(&index,20,GTE,35,LTE), 16)
+	checkPassFail(doubleScan(&index,-3,GT,3,LT), 3)
+	checkPassFail(doubleScan(&index,996,GT,1001,LT), 4)
+	checkPassFail(doubleScan(&index,0,GT,1,LT), 0)
+	checkPassFail(doubleScan(&index,0,GT,145,LT), 144)
+	checkPassFail(doubleScan(&index,3000,GTE,4000,LT), 1000)
+	checkPassFail(doubleScan(&index,24.5,GT,25.5,LT), 1)
+
+	std::vector<double> keys;
+	keys.push_back(7);
+	keys.push_back(7.5);
+	keys.push_back(4999);
+	std::vector<RIDKeyPair<double> > found;
+	checkPassFail(index.lookupBatch(keys, found), 2)
+}
+
+int doubleScan(BTreeIndex * index, double lowVal, Operator lowOp, double highVal, Operator highOp)
+{
+  RecordId scanRid;
+	Page *curPage;
+
+  std::cout << "Scan for ";
+  if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+  std::cout << lowVal << "," << highVal;
+  if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+  std::cout << std::endl;
+
+  int numResults = 0;
+
+	try
+	{
+  	index->startScan(&lowVal, lowOp, &highVal, highOp);
+	}
+	catch(const NoSuchKeyFoundException &e)
+	{
+    std::cout << "No Key Found satisfying the scan criteria." << std::endl;
+		return 0;
+	}
+
+	while(1)
+	{
+		try
+		{
+			index->scanNext(scanRid);
+
+			bufMgr->readPage(file1, scanRid.page_number, curPage);
+			RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRid).data()));
+			bufMgr->unPinPage(file1, scanRid.page_number, false);
+
+			if( numResults < 5 )
+			{
+				std::cout << "rid:" << scanRid.page_number << "," << scanRid.slot_number;
+				std::cout << " -->:" << myRec.i << ":" << myRec.d << ":" << myRec.s << ":" <<std::endl;
+			}
+			else if( numResults == 5 )
+			{
+				std::cout << "..." << std::endl;
+			}
+		}
+		catch(const IndexScanCompletedException &e)
+		{
+			break;
+		}
+
+		numResults++;
+	}
 
+  if( numResults >= 5 )
+  {
+    std::cout << "Number of results: " << numResults << std::endl;
+  }
+  index->endScan();
+  std::cout << std::endl;
+
+	return numResults;
 }
 
-void intTests2()
+// -----------------------------------------------------------------------------
+// stringTests
+// -----------------------------------------------------------------------------
+
+void hashTests()
 {
-    std::cout << "Create a B+ Tree index on the integer field" << std::endl;
-    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    const int numInserted = 20000;
+    const int numDuplicates = 3000;
+    std::cout << "Create a hash index on the integer field" << std::endl;
+    HashIndex *index = new HashIndex(relationName, hashIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    checkPassFail(index->size(), relationSize)
 
-    // run some tests
-    checkPassFail(intScan(&index,-5000,GTE,4000,LT), 9000)
-    checkPassFail(intScan(&index,-3,GT,3,LTE), 6)
+    // every tuple is found, and no absent key
+    std::vector<RecordId> rids;
+    int numFound = 0;
+    for(int key = -relationSize; key < 2 * relationSize; key++)
+        numFound += index->lookup(&key, rids);
+    checkPassFail(numFound, relationSize)
+    int key = 42;
+    rids.clear();
+    checkPassFail(index->lookup(&key, rids), 1)
+    Page *curPage;
+    bufMgr->readPage(file1, rids[0].page_number, curPage);
+    RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(rids[0]).data()));
+    bufMgr->unPinPage(file1, rids[0].page_number, false);
+    checkPassFail(myRec.i, 42)
+
+    // inserts split buckets and grow the directory; duplicates of one key go to overflow pages
+    int depth = index->depth();
+    for(int i = 0; i < numInserted + numDuplicates; i++)
+    {
+        key = i < numInserted ? relationSize + i : -1;
+        RecordId fakeRid;
+        fakeRid.page_number = relationSize + i / 50;
+        fakeRid.slot_number = i % 50 + 1;
+        fakeRid.padding = 0;
+        index->insertEntry(&key, fakeRid);
+    }
+    checkPassFail((index->depth() > depth), true)
+    numFound = 0;
+    for(key = 0; key < relationSize + numInserted; key++)
+        numFound += index->lookup(&key, rids);
+    checkPassFail(numFound, relationSize + numInserted)
+    key = -1;
+    checkPassFail(index->lookup(&key, rids), numDuplicates)
+
+    // a reopened index keeps its directory and entries
+    delete index;
+    index = new HashIndex(relationName, hashIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    checkPassFail(index->size(), relationSize + numInserted + numDuplicates)
+    numFound = 0;
+    for(key = -1; key < relationSize + numInserted; key++)
+        numFound += index->lookup(&key, rids);
+    checkPassFail(numFound, relationSize + numInserted + numDuplicates)
+    delete index;
+    File::remove(hashIndexName);
 
+    // double keys, -0.0 included, and string keys compare like in a B+ Tree
+    std::cout << "Create hash indexes on the double and string fields" << std::endl;
+    index = new HashIndex(relationName, hashIndexName, bufMgr, offsetof(tuple,d), DOUBLE);
+    double zero = -0.0, half = 0.5, last = relationSize - 1;
+    checkPassFail(index->lookup(&zero, rids), 1)
+    checkPassFail(index->lookup(&half, rids), 0)
+    checkPassFail(index->lookup(&last, rids), 1)
+    delete index;
+    File::remove(hashIndexName);
+    index = new HashIndex(relationName, hashIndexName, bufMgr, offsetof(tuple,s), STRING);
+    char keyString[64];
+    sprintf(keyString, "%05d string record", 1234);
+    checkPassFail(index->lookup(keyString, rids), 1)
+    sprintf(keyString, "%05d string record", relationSize);
+    checkPassFail(index->lookup(keyString, rids), 0)
+    delete index;
+    File::remove(hashIndexName);
 }
 
-void intTests3()
+void stringTests()
 {
-    std::cout << "Create a B+ Tree index on the integer field" << std::endl;
-    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+  std::cout << "Create a B+ Tree index on the string field" << std::endl;
+  BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING);
 
-    // run some tests
-    checkPassFail(intScan1(&index,4999,GTE,5000,LT), 1)
+	// run some tests
+	checkPassFail(stringScan(&index,25,GT,40,LT), 14)
+	checkPassFail(stringScan(&index,20,GTE,35,LTE), 16)
+	checkPassFail(stringScan(&index,-3,GT,3,LT), 3)
+	checkPassFail(stringScan(&index,996,GT,1001,LT), 4)
+	checkPassFail(stringScan(&index,0,GT,1,LT), 0)
+	checkPassFail(stringScan(&index,0,GT,145,LT), 144)
+	checkPassFail(stringScan(&index,3000,GTE,4000,LT), 1000)
 
+	// only the first STRINGSIZE characters are indexed
+	std::vector<RecordId> rids;
+	checkPassFail(index.lookup("00042 string record", rids), 1)
+	checkPassFail(index.lookup("00042 stringXXX", rids), 1)
+	checkPassFail(index.deleteEntry("00042 stri", rids[0]), true)
+	checkPassFail(stringScan(&index,40,GTE,45,LT), 4)
+
+	// only int nonleaves have Eytzinger copies
+	bool rejected = false;
+	try
+	{
+		index.setEytzingerSearch(16);
+	}
+	catch(const BadIndexInfoException &e)
+	{
+		rejected = true;
+	}
+	checkPassFail(rejected, true)
 }
 
-int intScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
+void stringTests1(bool countEntries)
+{
+  std::cout << "Create a B+ Tree index on the string field" << (countEntries ? " that counts entries" : "") << std::endl;
+  BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING, ARRAY_LEAVES,
+    std::vector<PayloadColumn>(), 0, countEntries);
+
+  // append user ids that share their first bytes, enough of them for nonleaves to split.
+  // The record ids are synthetic, page_number carries the number in the key.
+  const int numKeys = 200 * relationSize;
+  char key[32];
+  RecordId fakeRid;
+  fakeRid.slot_number = 0;
+  fakeRid.padding = 0;
+  for(int n = 0; n < numKeys; n++)
+  {
+    sprintf(key, "user%06d", n);
+    fakeRid.page_number = n;
+    index.insertEntry(key, fakeRid);
+  }
+  // keys that land in the middle of the full leaves left behind by the appends, and a run of
+  // duplicates of a key shorter than STRINGSIZE that sorts before all the others
+  for(int n = 0; n < numKeys; n += 1000)
+  {
+    sprintf(key, "user%05d:", n / 10);
+    fakeRid.page_number = n;
+    index.insertEntry(key, fakeRid);
+  }
+  for(int i = 0; i < 3000; i++)
+  {
+    fakeRid.page_number = i;
+    index.insertEntry("user", fakeRid);
+  }
+
+  int numMismatches = 0;
+  std::vector<RecordId> rids;
+  for(int n = 0; n < numKeys; n += 7)
+  {
+    rids.clear();
+    sprintf(key, "user%06d", n);
+    if(index.lookup(key, rids) != 1 || (int)rids[0].page_number != n)
+      numMismatches++;
+  }
+  checkPassFail(numMismatches, 0)
+  checkPassFail(index.lookup("user", rids), 3000)
+  checkPassFail(index.lookup("user0", rids), 0)
+  checkPassFail(stringScanCount(&index, "user000100", GTE, "user000199", LTE), 100)
+  checkPassFail(stringScanCount(&index, "user", GTE, "user:", LT), numKeys + numKeys / 1000 + 3000)
+  if(countEntries)
+  {
+    checkPassFail(index.countRange("user000100", GTE, "user000199", LTE), 100)
+    checkPassFail(index.countRange("user", GTE, "user:", LT), numKeys + numKeys / 1000 + 3000)
+  }
+  checkPassFail(stringScan(&index,25,GT,40,LT), 14)
+
+  // delete three quarters of the user ids so nodes merge and borrow
+  int numFailed = 0;
+  for(int n = 0; n < numKeys; n++)
+  {
+    if(n % 4 == 0)
+      continue;
+    sprintf(key, "user%06d", n);
+    fakeRid.page_number = n;
+    if(!index.deleteEntry(key, fakeRid))
+      numFailed++;
+  }
+  checkPassFail(numFailed, 0)
+  for(int n = 0; n < numKeys; n += 7)
+  {
+    rids.clear();
+    sprintf(key, "user%06d", n);
+    if(index.lookup(key, rids) != (n % 4 == 0 ? 1 : 0))
+      numMismatches++;
+  }
+  checkPassFail(numMismatches, 0)
+  checkPassFail(stringScanCount(&index, "user000100", GTE, "user000199", LTE), 25)
+  checkPassFail(stringScanCount(&index, "user", GT, "user:", LT), numKeys / 4 + numKeys / 1000)
+  if(countEntries)
+  {
+    checkPassFail(index.countRange("user000100", GTE, "user000199", LTE), 25)
+    checkPassFail(index.countRange("user", GT, "user:", LT), numKeys / 4 + numKeys / 1000)
+  }
+  checkPassFail(stringScan(&index,25,GT,40,LT), 14)
+}
+
+int stringScanCount(BTreeIndex * index, const char *lowVal, Operator lowOp, const char *highVal, Operator highOp)
+{
+  RecordId scanRid;
+  int numResults = 0;
+  if(!index->tryStartScan(lowVal, lowOp, highVal, highOp))
+    return 0;
+  while(index->tryScanNext(scanRid))
+    numResults++;
+  index->endScan();
+  return numResults;
+}
+
+int stringScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
 {
   RecordId scanRid;
 	Page *curPage;
@@ -549,11 +3725,16 @@ int intScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operato
   if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
   std::cout << std::endl;
 
+  char lowValStr[100];
+  sprintf(lowValStr,"%05d string record",lowVal);
+  char highValStr[100];
+  sprintf(highValStr,"%05d string record",highVal);
+
   int numResults = 0;
-	
+
 	try
 	{
-  	index->startScan(&lowVal, lowOp, &highVal, highOp);
+  	index->startScan(lowValStr, lowOp, highValStr, highOp);
 	}
 	catch(const NoSuchKeyFoundException &e)
 	{
@@ -573,7 +3754,7 @@ int intScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operato
 
 			if( numResults < 5 )
 			{
-				std::cout << "at:" << scanRid.page_number << "," << scanRid.slot_number;
+				std::cout << "rid:" << scanRid.page_number << "," << scanRid.slot_number;
 				std::cout << " -->:" << myRec.i << ":" << myRec.d << ":" << myRec.s << ":" <<std::endl;
 			}
 			else if( numResults == 5 )
@@ -583,7 +3764,7 @@ int intScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operato
 		}
 		catch(const IndexScanCompletedException &e)
 		{
-		    break;
+			break;
 		}
 
 		numResults++;
@@ -595,62 +3776,10 @@ int intScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operato
   }
   index->endScan();
   std::cout << std::endl;
+
 	return numResults;
 }
 
-int intScan1(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
-{
-    RecordId scanRid;
-    Page *curPage;
-
-    std::cout << "Scan for ";
-    if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
-    std::cout << lowVal << "," << highVal;
-    if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
-    std::cout << std::endl;
-
-    int numResults = 0;
-
-    try
-    {
-        index->startScan(&lowVal, lowOp, &highVal, highOp);
-    }
-    catch(const NoSuchKeyFoundException &e)
-    {
-        std::cout << "No Key Found satisfying the scan criteria." << std::endl;
-        return 0;
-    }
-    try
-    {
-        index->scanNext(scanRid);
-    }
-    catch(const IndexScanCompletedException &e)
-    {
-        bufMgr->readPage(file1, scanRid.page_number, curPage);
-        RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRid).data()));
-        bufMgr->unPinPage(file1, scanRid.page_number, false);
-
-        if( numResults < 5 )
-        {
-            std::cout << "at:" << scanRid.page_number << "," << scanRid.slot_number;
-            std::cout << " -->:" << myRec.i << ":" << myRec.d << ":" << myRec.s << ":" <<std::endl;
-        }
-        else if( numResults == 5 )
-        {
-            std::cout << "..." << std::endl;
-        }
-    }
-
-    numResults++;
-
-    if( numResults >= 5 )
-    {
-        std::cout << "Number of results: " << numResults << std::endl;
-    }
-    index->endScan();
-    std::cout << std::endl;
-    return numResults;
-}
 // -----------------------------------------------------------------------------
 // errorTests
 // -----------------------------------------------------------------------------
@@ -702,7 +3831,8 @@ void errorTests()
 
 		file1->writePage(new_page_number, new_page);
 
-		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, ARRAY_LEAVES,
+			std::vector<PayloadColumn>(), 0, true);
 		
 		int int2 = 2;
 		int int5 = 5;
@@ -765,6 +3895,231 @@ void errorTests()
 			std::cout << "BadScanrangeException Test 1 Passed." << std::endl;
 		}
 
+		std::cout << "Multi-range scan with overlapping ranges" << std::endl;
+		try
+		{
+			std::vector<ScanRange<int> > ranges(2);
+			ranges[0].set(int2, GTE, int5, LTE);
+			ranges[1].set(int5, GTE, int5, LTE);
+			std::vector<RecordId> rids;
+			index.scanRanges(ranges, rids);
+			std::cout << "BadScanrangeException Test 2 Failed." << std::endl;
+		}
+		catch(const BadScanrangeException &e)
+		{
+			std::cout << "BadScanrangeException Test 2 Passed." << std::endl;
+		}
+
+		std::cout << "Range count with bad range" << std::endl;
+		try
+		{
+			index.countRange(&int5, GTE, &int2, LTE);
+			std::cout << "BadScanrangeException Test 3 Failed." << std::endl;
+		}
+		catch(const BadScanrangeException &e)
+		{
+			std::cout << "BadScanrangeException Test 3 Passed." << std::endl;
+		}
+
+		std::cout << "Covering index with too many payload columns" << std::endl;
+		try
+		{
+			std::string coveringIndexName;
+			std::vector<PayloadColumn> columns(MAXPAYLOADCOLUMNS + 1);
+			for(size_t i = 0; i < columns.size(); i++)
+			{
+				columns[i].offset = offsetof(tuple,s) + i;
+				columns[i].length = 1;
+			}
+			BTreeIndex coveringIndex(relationName, coveringIndexName, bufMgr, offsetof(tuple,d), DOUBLE, ARRAY_LEAVES, columns);
+			std::cout << "BadIndexInfoException Test 1 Failed." << std::endl;
+		}
+		catch(const BadIndexInfoException &e)
+		{
+			std::cout << "BadIndexInfoException Test 1 Passed." << std::endl;
+		}
+
+		std::cout << "Covering index with too long payload columns" << std::endl;
+		try
+		{
+			std::string coveringIndexName;
+			std::vector<PayloadColumn> columns(1);
+			columns[0].offset = 0;
+			columns[0].length = MAXPAYLOADLENGTH + 1;
+			BTreeIndex coveringIndex(relationName, coveringIndexName, bufMgr, offsetof(tuple,d), DOUBLE, ARRAY_LEAVES, columns);
+			std::cout << "BadIndexInfoException Test 2 Failed." << std::endl;
+		}
+		catch(const BadIndexInfoException &e)
+		{
+			std::cout << "BadIndexInfoException Test 2 Passed." << std::endl;
+		}
+
+		std::cout << "Composite index with one key attribute" << std::endl;
+		try
+		{
+			std::string compositeIndexName;
+			std::vector<KeyColumn> columns(1);
+			columns[0].offset = offsetof(tuple,i);
+			columns[0].type = INTEGER;
+			BTreeIndex compositeIndex(relationName, compositeIndexName, bufMgr, columns);
+			std::cout << "BadIndexInfoException Test 3 Failed." << std::endl;
+		}
+		catch(const BadIndexInfoException &e)
+		{
+			std::cout << "BadIndexInfoException Test 3 Passed." << std::endl;
+		}
+
+		std::cout << "Skip-scan of an index on one attribute" << std::endl;
+		try
+		{
+			std::vector<RecordId> rids;
+			index.skipScan(&int2, GTE, &int5, LTE, rids);
+			std::cout << "BadIndexInfoException Test 4 Failed." << std::endl;
+		}
+		catch(const BadIndexInfoException &e)
+		{
+			std::cout << "BadIndexInfoException Test 4 Passed." << std::endl;
+		}
+
+		std::cout << "Bloom filter of negative size" << std::endl;
+		try
+		{
+			std::string bloomIndexName;
+			BTreeIndex bloomIndex(relationName, bloomIndexName, bufMgr, offsetof(tuple,d), DOUBLE, ARRAY_LEAVES,
+				std::vector<PayloadColumn>(), -1);
+			std::cout << "BadIndexInfoException Test 5 Failed." << std::endl;
+		}
+		catch(const BadIndexInfoException &e)
+		{
+			std::cout << "BadIndexInfoException Test 5 Passed." << std::endl;
+		}
+
+		std::cout << "Hash index on a composite key" << std::endl;
+		try
+		{
+			std::string hashIndexName;
+			HashIndex hashIndex(relationName, hashIndexName, bufMgr, offsetof(tuple,i), COMPOSITE);
+			std::cout << "BadIndexInfoException Test 6 Failed." << std::endl;
+		}
+		catch(const BadIndexInfoException &e)
+		{
+			std::cout << "BadIndexInfoException Test 6 Passed." << std::endl;
+		}
+
+		std::cout << "Hash index reopened with another attribute type" << std::endl;
+		{
+			std::string hashIndexName;
+			{
+				HashIndex hashIndex(relationName, hashIndexName, bufMgr, offsetof(tuple,d), DOUBLE);
+			}
+			try
+			{
+				HashIndex hashIndex(relationName, hashIndexName, bufMgr, offsetof(tuple,d), INTEGER);
+				std::cout << "BadIndexInfoException Test 7 Failed." << std::endl;
+			}
+			catch(const BadIndexInfoException &e)
+			{
+				std::cout << "BadIndexInfoException Test 7 Passed." << std::endl;
+			}
+			File::remove(hashIndexName);
+		}
+
+		std::cout << "Insert buffer with negative capacity" << std::endl;
+		try
+		{
+			index.setInsertBuffer(-1);
+			std::cout << "BadIndexInfoException Test 8 Failed." << std::endl;
+		}
+		catch(const BadIndexInfoException &e)
+		{
+			std::cout << "BadIndexInfoException Test 8 Passed." << std::endl;
+		}
+
+		std::cout << "Eytzinger search with a negative number of nodes" << std::endl;
+		try
+		{
+			index.setEytzingerSearch(-1);
+			std::cout << "BadIndexInfoException Test 9 Failed." << std::endl;
+		}
+		catch(const BadIndexInfoException &e)
+		{
+			std::cout << "BadIndexInfoException Test 9 Passed." << std::endl;
+		}
+
+		std::cout << "Pinned upper levels with a negative number of levels" << std::endl;
+		try
+		{
+			index.setPinnedLevels(-1);
+			std::cout << "BadIndexInfoException Test 10 Failed." << std::endl;
+		}
+		catch(const BadIndexInfoException &e)
+		{
+			std::cout << "BadIndexInfoException Test 10 Passed." << std::endl;
+		}
+
+		std::cout << "Range count on an index without entry counts" << std::endl;
+		{
+			std::string uncountedIndexName;
+			{
+				BTreeIndex uncountedIndex(relationName, uncountedIndexName, bufMgr, offsetof(tuple,s), STRING);
+				try
+				{
+					uncountedIndex.countRange("00002", GTE, "00005", LTE);
+					std::cout << "BadIndexInfoException Test 11 Failed." << std::endl;
+				}
+				catch(const BadIndexInfoException &e)
+				{
+					std::cout << "BadIndexInfoException Test 11 Passed." << std::endl;
+				}
+			}
+			File::remove(uncountedIndexName);
+		}
+
+		std::cout << "Message buffers in a covering index" << std::endl;
+		{
+			std::string coveringIndexName;
+			{
+				std::vector<PayloadColumn> columns(1);
+				columns[0].offset = offsetof(tuple,i);
+				columns[0].length = sizeof(int);
+				BTreeIndex coveringIndex(relationName, coveringIndexName, bufMgr, offsetof(tuple,d), DOUBLE, ARRAY_LEAVES,
+					columns);
+				try
+				{
+					coveringIndex.setNodeBuffers(true);
+					std::cout << "BadIndexInfoException Test 13 Failed." << std::endl;
+				}
+				catch(const BadIndexInfoException &e)
+				{
+					std::cout << "BadIndexInfoException Test 13 Passed." << std::endl;
+				}
+			}
+			File::remove(coveringIndexName);
+		}
+
+		std::cout << "Delete while a descending scan is open" << std::endl;
+		{
+			BTreeScanCursor cursor(&index);
+			cursor.startScan(&int2, GTE, &int5, LT, DESCENDING);
+			RecordId rid;
+			cursor.scanNext(rid);
+			int key = 4;
+			try
+			{
+				index.deleteEntry(&key, rid);
+				std::cout << "BadIndexInfoException Test 12 Failed." << std::endl;
+			}
+			catch(const BadIndexInfoException &e)
+			{
+				// once the scan ends the entry can be deleted
+				cursor.endScan();
+				if(index.deleteEntry(&key, rid))
+					std::cout << "BadIndexInfoException Test 12 Passed." << std::endl;
+				else
+					std::cout << "BadIndexInfoException Test 12 Failed." << std::endl;
+			}
+		}
+
 		deleteRelation();
 	}
 
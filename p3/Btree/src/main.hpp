@@ -68,6 +68,12 @@
  * If you want to edit what <code>badgerdb_main</code> does, edit
  * <code>src/main.cpp</code>.
  *
+ * To build and run the index benchmarks (all of them, or a single one by name):
+ * @code
+ *   $ make bench
+ *   $ ./src/badgerdb_bench [all|lookup|batch|leaves|threads|desc|ranges|counts|covering|skip|bloom|hash|buffered|delta|search|pinned]
+ * @endcode
+ *
  * @subsection documentation_sec Rebuilding the documentation
  *
  * Documentation is generated by using Doxygen.  If you have updated the